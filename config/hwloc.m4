@@ -666,6 +666,9 @@ EOF])
     AC_CHECK_HEADERS([sys/utsname.h])
     AC_CHECK_FUNCS([uname])
 
+    # for timing discovery backends
+    AC_CHECK_FUNCS([clock_gettime gettimeofday])
+
     dnl Don't check for valgrind in embedded mode because this may conflict
     dnl with the embedder projects also checking for it.
     dnl We only use Valgrind to nicely disable the x86 backend with a warning,
@@ -217,6 +217,7 @@ AC_DEFUN([_HWLOC_CHECK_ATTRIBUTES], [
     hwloc_cv___attribute__cold=0
     hwloc_cv___attribute__const=0
     hwloc_cv___attribute__deprecated=0
+    hwloc_cv___attribute__destructor=0
     hwloc_cv___attribute__format=0
     hwloc_cv___attribute__hot=0
     hwloc_cv___attribute__malloc=0
@@ -272,6 +273,15 @@ AC_DEFUN([_HWLOC_CHECK_ATTRIBUTES], [
         [])
 
 
+    _HWLOC_CHECK_SPECIFIC_ATTRIBUTE([destructor],
+        [
+         static void foo(void) __attribute__ ((__destructor__));
+         static void foo(void) { }
+        ],
+        [],
+        [])
+
+
     HWLOC_ATTRIBUTE_CFLAGS=
     case "$hwloc_c_vendor" in
         gnu)
@@ -504,6 +514,8 @@ AC_DEFUN([_HWLOC_CHECK_ATTRIBUTES], [
                      [Whether your compiler has __attribute__ const or not])
   AC_DEFINE_UNQUOTED(HWLOC_HAVE_ATTRIBUTE_DEPRECATED, [$hwloc_cv___attribute__deprecated],
                      [Whether your compiler has __attribute__ deprecated or not])
+  AC_DEFINE_UNQUOTED(HWLOC_HAVE_ATTRIBUTE_DESTRUCTOR, [$hwloc_cv___attribute__destructor],
+                     [Whether your compiler has __attribute__ destructor or not])
   AC_DEFINE_UNQUOTED(HWLOC_HAVE_ATTRIBUTE_FORMAT, [$hwloc_cv___attribute__format],
                      [Whether your compiler has __attribute__ format or not])
   AC_DEFINE_UNQUOTED(HWLOC_HAVE_ATTRIBUTE_HOT, [$hwloc_cv___attribute__hot],
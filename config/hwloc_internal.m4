@@ -418,14 +418,17 @@ int foo(void) {
         hwloc_config_prefix[tests/hwloc/x86/test-topology.sh]
         hwloc_config_prefix[tests/hwloc/xml/test-topology.sh]
         hwloc_config_prefix[tests/hwloc/wrapper.sh]
-        hwloc_config_prefix[utils/hwloc/hwloc-compress-dir]
         hwloc_config_prefix[utils/hwloc/hwloc-gather-topology]
         hwloc_config_prefix[utils/hwloc/test-hwloc-annotate.sh]
+        hwloc_config_prefix[utils/hwloc/test-hwloc-bind.sh]
         hwloc_config_prefix[utils/hwloc/test-hwloc-calc.sh]
         hwloc_config_prefix[utils/hwloc/test-hwloc-compress-dir.sh]
         hwloc_config_prefix[utils/hwloc/test-hwloc-diffpatch.sh]
         hwloc_config_prefix[utils/hwloc/test-hwloc-distrib.sh]
+        hwloc_config_prefix[utils/hwloc/test-hwloc-gather-fsroot.sh]
         hwloc_config_prefix[utils/hwloc/test-hwloc-info.sh]
+        hwloc_config_prefix[utils/hwloc/test-hwloc-ps.sh]
+        hwloc_config_prefix[utils/hwloc/test-hwlocd.sh]
         hwloc_config_prefix[utils/hwloc/test-fake-plugin.sh]
         hwloc_config_prefix[utils/hwloc/test-hwloc-dump-hwdata/Makefile]
         hwloc_config_prefix[utils/hwloc/test-hwloc-dump-hwdata/test-hwloc-dump-hwdata.sh]
@@ -442,14 +445,17 @@ chmod +x ]hwloc_config_prefix[tests/hwloc/linux/test-topology.sh \
       ]hwloc_config_prefix[tests/hwloc/xml/test-topology.sh \
       ]hwloc_config_prefix[tests/hwloc/linux/gather/test-gather-topology.sh \
       ]hwloc_config_prefix[tests/hwloc/wrapper.sh \
-      ]hwloc_config_prefix[utils/hwloc/hwloc-compress-dir \
       ]hwloc_config_prefix[utils/hwloc/hwloc-gather-topology \
       ]hwloc_config_prefix[utils/hwloc/test-hwloc-annotate.sh \
+      ]hwloc_config_prefix[utils/hwloc/test-hwloc-bind.sh \
       ]hwloc_config_prefix[utils/hwloc/test-hwloc-calc.sh \
       ]hwloc_config_prefix[utils/hwloc/test-hwloc-compress-dir.sh \
       ]hwloc_config_prefix[utils/hwloc/test-hwloc-diffpatch.sh \
       ]hwloc_config_prefix[utils/hwloc/test-hwloc-distrib.sh \
+      ]hwloc_config_prefix[utils/hwloc/test-hwloc-gather-fsroot.sh \
       ]hwloc_config_prefix[utils/hwloc/test-hwloc-info.sh \
+      ]hwloc_config_prefix[utils/hwloc/test-hwloc-ps.sh \
+      ]hwloc_config_prefix[utils/hwloc/test-hwlocd.sh \
       ]hwloc_config_prefix[utils/hwloc/test-fake-plugin.sh \
       ]hwloc_config_prefix[utils/hwloc/test-hwloc-dump-hwdata/test-hwloc-dump-hwdata.sh \
       ]hwloc_config_prefix[utils/lstopo/test-lstopo.sh \
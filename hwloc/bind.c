@@ -715,6 +715,85 @@ hwloc_alloc_membind(hwloc_topology_t topology, size_t len, hwloc_const_bitmap_t
   return ret;
 }
 
+void *
+hwloc_alloc_membind_striped(hwloc_topology_t topology, size_t len, size_t stripe_size,
+			    unsigned nr_objs, hwloc_obj_t *objs, const unsigned *weights,
+			    int flags)
+{
+  unsigned i, w, total_weight = 0;
+  size_t offset;
+  char *p;
+
+  if (flags & ~(HWLOC_MEMBIND_STRICT|HWLOC_MEMBIND_NOCPUBIND)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (!nr_objs || !stripe_size) {
+    errno = EINVAL;
+    return NULL;
+  }
+#ifdef hwloc_getpagesize
+  if (stripe_size % hwloc_getpagesize()) {
+    errno = EINVAL;
+    return NULL;
+  }
+#endif
+
+  for(i=0; i<nr_objs; i++) {
+    if (weights && !weights[i])
+      continue;
+    if (!objs[i]->nodeset || hwloc_bitmap_iszero(objs[i]->nodeset)) {
+      errno = EINVAL;
+      return NULL;
+    }
+    total_weight += weights ? weights[i] : 1;
+  }
+  if (!total_weight) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  p = hwloc_alloc(topology, len);
+  if (!p)
+    return NULL;
+
+  if (!topology->binding_hooks.set_area_membind) {
+    errno = ENOSYS;
+    goto fallback;
+  }
+
+  /* bind stripe by stripe, each object gets weights[i] consecutive stripes */
+  i = 0;
+  w = 0;
+  for(offset = 0; offset < len; offset += stripe_size) {
+    size_t stripe_len = len - offset < stripe_size ? len - offset : stripe_size;
+    int err;
+
+    while (w == (weights ? weights[i] : 1)) {
+      i = (i+1) % nr_objs;
+      w = 0;
+    }
+
+    err = hwloc_set_area_membind_by_nodeset(topology, p + offset, stripe_len, objs[i]->nodeset, HWLOC_MEMBIND_BIND, flags);
+    if (err < 0 && (flags & HWLOC_MEMBIND_STRICT))
+      goto fallback;
+    w++;
+  }
+
+  return p;
+
+fallback:
+  if (flags & HWLOC_MEMBIND_STRICT) {
+    int error = errno;
+    hwloc_free(topology, p, len);
+    errno = error;
+    return NULL;
+  }
+  /* Never mind, keep the unbound memory */
+  return p;
+}
+
 int
 hwloc_free(hwloc_topology_t topology, void *addr, size_t len)
 {
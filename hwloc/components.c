@@ -20,7 +20,18 @@
  */
 static struct hwloc_disc_component * hwloc_disc_components = NULL;
 
-static unsigned hwloc_components_users = 0; /* first one initializes, last ones destroys */
+/* number of topologies (or XML exports, etc.) currently using components */
+static unsigned hwloc_components_users = 0;
+/* whether components are currently registered in the above list.
+ * The first user registers them. If the library destructor is available,
+ * they remain registered until the process exits (or the library is unloaded)
+ * so that short-lived topologies don't scan plugins again.
+ * Otherwise the last user destroys them.
+ */
+static int hwloc_components_registered = 0;
+#if HWLOC_HAVE_ATTRIBUTE_DESTRUCTOR
+#define HWLOC_COMPONENTS_PERSISTENT 1
+#endif
 
 static int hwloc_components_verbose = 0;
 #ifdef HWLOC_HAVE_PLUGINS
@@ -327,7 +338,8 @@ hwloc_components_init(void)
 
   HWLOC_COMPONENTS_LOCK();
   assert((unsigned) -1 != hwloc_components_users);
-  if (0 != hwloc_components_users++) {
+  hwloc_components_users++;
+  if (hwloc_components_registered) {
     HWLOC_COMPONENTS_UNLOCK();
     return;
   }
@@ -412,6 +424,7 @@ hwloc_components_init(void)
   }
 #endif
 
+  hwloc_components_registered = 1;
   HWLOC_COMPONENTS_UNLOCK();
 }
 
@@ -467,6 +480,24 @@ hwloc_disc_component_force_enable(struct hwloc_topology *topology,
     return -1;
 }
 
+/* components that declared their object types don't need to be instantiated
+ * if none of these types may appear in the topology.
+ */
+static int
+hwloc_disc_component_may_add_objects(struct hwloc_topology *topology,
+				     struct hwloc_disc_component *comp)
+{
+  hwloc_obj_type_t type;
+
+  if (!comp->objtypes)
+    return 1;
+  for(type = HWLOC_OBJ_SYSTEM; type < HWLOC_OBJ_TYPE_MAX; type++)
+    if ((comp->objtypes & HWLOC_DISC_COMPONENT_OBJTYPE(type))
+	&& topology->type_filter[type] != HWLOC_TYPE_FILTER_KEEP_NONE)
+      return 1;
+  return 0;
+}
+
 static int
 hwloc_disc_component_try_enable(struct hwloc_topology *topology,
 				struct hwloc_disc_component *comp,
@@ -475,6 +506,13 @@ hwloc_disc_component_try_enable(struct hwloc_topology *topology,
 {
   struct hwloc_backend *backend;
 
+  if (!envvar_forced && !hwloc_disc_component_may_add_objects(topology, comp)) {
+    if (hwloc_components_verbose)
+      fprintf(stderr, "Skipping %s discovery component `%s', all its object types are filtered out\n",
+	      hwloc_disc_component_type_string(comp->type), comp->name);
+    return -1;
+  }
+
   if (topology->backend_excludes & comp->type) {
     if (hwloc_components_verbose)
       /* do not warn if envvar_forced since system-wide HWLOC_COMPONENTS must be silently ignored after set_xml() etc.
@@ -606,18 +644,12 @@ nextcomp:
   free(env);
 }
 
-void
-hwloc_components_fini(void)
+/* must be called with the components mutex held */
+static void
+hwloc__components_destroy(void)
 {
   unsigned i;
 
-  HWLOC_COMPONENTS_LOCK();
-  assert(0 != hwloc_components_users);
-  if (0 != --hwloc_components_users) {
-    HWLOC_COMPONENTS_UNLOCK();
-    return;
-  }
-
   for(i=0; i<hwloc_component_finalize_cb_count; i++)
     hwloc_component_finalize_cbs[hwloc_component_finalize_cb_count-i-1](0);
   free(hwloc_component_finalize_cbs);
@@ -633,8 +665,35 @@ hwloc_components_fini(void)
   hwloc_plugins_exit();
 #endif
 
+  hwloc_components_registered = 0;
+}
+
+void
+hwloc_components_fini(void)
+{
+  HWLOC_COMPONENTS_LOCK();
+  assert(0 != hwloc_components_users);
+  hwloc_components_users--;
+#ifndef HWLOC_COMPONENTS_PERSISTENT
+  if (!hwloc_components_users)
+    hwloc__components_destroy();
+#endif
+  HWLOC_COMPONENTS_UNLOCK();
+}
+
+#ifdef HWLOC_COMPONENTS_PERSISTENT
+/* components are only destroyed when the process exits or when the library is unloaded */
+static void hwloc_components_destructor(void) __attribute__((__destructor__));
+static void
+hwloc_components_destructor(void)
+{
+  HWLOC_COMPONENTS_LOCK();
+  /* don't unload plugins that some leaked topologies could still use */
+  if (hwloc_components_registered && !hwloc_components_users)
+    hwloc__components_destroy();
   HWLOC_COMPONENTS_UNLOCK();
 }
+#endif
 
 struct hwloc_backend *
 hwloc_backend_alloc(struct hwloc_disc_component *component)
@@ -25,8 +25,17 @@ int hwloc_topology_diff_destroy(hwloc_topology_diff_t diff)
 				free(diff->obj_attr.diff.string.oldvalue);
 				free(diff->obj_attr.diff.string.newvalue);
 				break;
+			case HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET:
+				hwloc_bitmap_free(diff->obj_attr.diff.set.oldvalue);
+				hwloc_bitmap_free(diff->obj_attr.diff.set.newvalue);
+				break;
 			}
 			break;
+		case HWLOC_TOPOLOGY_DIFF_OBJ_INSERT:
+		case HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE:
+			if (diff->obj_subtree.obj)
+				hwloc_free_object_and_children(diff->obj_subtree.obj);
+			break;
 		}
 		free(diff);
 		diff = next;
@@ -34,6 +43,33 @@ int hwloc_topology_diff_destroy(hwloc_topology_diff_t diff)
 	return 0;
 }
 
+/* return the address of the given set in an object */
+static hwloc_bitmap_t *
+hwloc_diff_obj_set(hwloc_obj_t obj, hwloc_topology_diff_obj_set_t idx)
+{
+	switch (idx) {
+	case HWLOC_TOPOLOGY_DIFF_OBJ_SET_CPUSET: return &obj->cpuset;
+	case HWLOC_TOPOLOGY_DIFF_OBJ_SET_COMPLETE_CPUSET: return &obj->complete_cpuset;
+	case HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_CPUSET: return &obj->allowed_cpuset;
+	case HWLOC_TOPOLOGY_DIFF_OBJ_SET_NODESET: return &obj->nodeset;
+	case HWLOC_TOPOLOGY_DIFF_OBJ_SET_COMPLETE_NODESET: return &obj->complete_nodeset;
+	case HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET: return &obj->allowed_nodeset;
+	default: return NULL;
+	}
+}
+
+/* return the address of the list of children where an object of this type is stored */
+static hwloc_obj_t *
+hwloc_diff_children_list(hwloc_obj_t parent, hwloc_obj_type_t type)
+{
+	if (type == HWLOC_OBJ_MISC)
+		return &parent->misc_first_child;
+	else if (hwloc_obj_type_is_io(type))
+		return &parent->io_first_child;
+	else
+		return &parent->first_child;
+}
+
 /************************
  * Computing diffs
  */
@@ -114,6 +150,300 @@ static int hwloc_append_diff_obj_attr_uint64(hwloc_obj_t obj,
 	return 0;
 }
 
+static int hwloc_append_diff_obj_attr_set(hwloc_obj_t obj,
+					  hwloc_topology_diff_obj_set_t idx,
+					  hwloc_const_bitmap_t oldvalue,
+					  hwloc_const_bitmap_t newvalue,
+					  hwloc_topology_diff_t *firstdiffp,
+					  hwloc_topology_diff_t *lastdiffp)
+{
+	hwloc_topology_diff_t newdiff;
+	newdiff = malloc(sizeof(*newdiff));
+	if (!newdiff)
+		return -1;
+
+	newdiff->obj_attr.type = HWLOC_TOPOLOGY_DIFF_OBJ_ATTR;
+	newdiff->obj_attr.obj_depth = obj->depth;
+	newdiff->obj_attr.obj_index = obj->logical_index;
+	newdiff->obj_attr.diff.set.type = HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET;
+	newdiff->obj_attr.diff.set.index = idx;
+	newdiff->obj_attr.diff.set.oldvalue = hwloc_bitmap_dup(oldvalue);
+	newdiff->obj_attr.diff.set.newvalue = hwloc_bitmap_dup(newvalue);
+	hwloc_append_diff(newdiff, firstdiffp, lastdiffp);
+	return 0;
+}
+
+static int hwloc_append_diff_obj_subtree(hwloc_topology_diff_type_t type,
+					 hwloc_obj_t parent1, hwloc_obj_t parent2,
+					 unsigned position, hwloc_obj_t obj,
+					 hwloc_topology_diff_t *firstdiffp,
+					 hwloc_topology_diff_t *lastdiffp)
+{
+	hwloc_topology_diff_t newdiff;
+	newdiff = malloc(sizeof(*newdiff));
+	if (!newdiff)
+		return -1;
+
+	newdiff->obj_subtree.type = type;
+	newdiff->obj_subtree.parent_depth = parent1->depth;
+	newdiff->obj_subtree.old_parent_index = parent1->logical_index;
+	newdiff->obj_subtree.new_parent_index = parent2->logical_index;
+	newdiff->obj_subtree.position = position;
+	newdiff->obj_subtree.obj = hwloc__duplicate_detached_objects(obj);
+	if (!newdiff->obj_subtree.obj) {
+		free(newdiff);
+		return -1;
+	}
+	hwloc_append_diff(newdiff, firstdiffp, lastdiffp);
+	return 0;
+}
+
+/* check whether two children of matching parents may be the same object */
+static int
+hwloc_diff_objs_match(hwloc_obj_t obj1, hwloc_obj_t obj2)
+{
+	if (obj1->type != obj2->type
+	    || obj1->depth != obj2->depth
+	    || obj1->os_index != obj2->os_index)
+		return 0;
+	if ((!obj1->subtype) != (!obj2->subtype)
+	    || (obj1->subtype && strcmp(obj1->subtype, obj2->subtype)))
+		return 0;
+	/* objects without os_index (caches, groups, etc) are matched by their location */
+	if (obj1->complete_cpuset && obj2->complete_cpuset
+	    && !hwloc_bitmap_iszero(obj1->complete_cpuset)
+	    && !hwloc_bitmap_iszero(obj2->complete_cpuset)
+	    && !hwloc_bitmap_intersects(obj1->complete_cpuset, obj2->complete_cpuset))
+		return 0;
+	return 1;
+}
+
+/************************
+ * Subtree hashes
+ */
+
+/* 64-bit FNV-1a */
+#define HWLOC_DIFF_HASH_INIT 14695981039346656037ULL
+#define HWLOC_DIFF_HASH_PRIME 1099511628211ULL
+
+static uint64_t
+hwloc_diff_hash_bytes(uint64_t hash, const void *buffer, size_t len)
+{
+	const unsigned char *bytes = buffer;
+	size_t i;
+	for(i=0; i<len; i++) {
+		hash ^= bytes[i];
+		hash *= HWLOC_DIFF_HASH_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t
+hwloc_diff_hash_string(uint64_t hash, const char *string)
+{
+	/* hash the ending \0 so that consecutive strings don't collide, and NULL differently from "" */
+	if (!string)
+		return hwloc_diff_hash_bytes(hash, "\1", 1);
+	return hwloc_diff_hash_bytes(hash, string, strlen(string)+1);
+}
+
+static uint64_t
+hwloc_diff_hash_bitmap(uint64_t hash, hwloc_const_bitmap_t set)
+{
+	hwloc_bitmap_t tmp = NULL;
+	unsigned long ulong;
+	unsigned char infinite;
+	int last;
+	unsigned i;
+
+	if (!set)
+		return hwloc_diff_hash_bytes(hash, "\1", 1);
+
+	/* infinite sets are hashed through their finite complement */
+	last = hwloc_bitmap_last(set);
+	infinite = (last == -1 && !hwloc_bitmap_iszero(set));
+	if (infinite) {
+		tmp = hwloc_bitmap_alloc();
+		hwloc_bitmap_not(tmp, set);
+		set = tmp;
+		last = hwloc_bitmap_last(set);
+	}
+	hash = hwloc_diff_hash_bytes(hash, &infinite, sizeof(infinite));
+	if (last >= 0)
+		for(i=0; i <= (unsigned) last / (8*sizeof(unsigned long)); i++) {
+			ulong = hwloc_bitmap_to_ith_ulong(set, i);
+			hash = hwloc_diff_hash_bytes(hash, &ulong, sizeof(ulong));
+		}
+	hwloc_bitmap_free(tmp);
+	return hash;
+}
+
+static uint64_t hwloc_diff_subtree_hash(hwloc_topology_t topology, hwloc_obj_t obj);
+
+/* hash everything that hwloc_diff_trees() compares */
+static uint64_t
+hwloc_diff_compute_subtree_hash(hwloc_topology_t topology, hwloc_obj_t obj)
+{
+	uint64_t hash = HWLOC_DIFF_HASH_INIT, childhash;
+	hwloc_obj_t child;
+	size_t attrsize = 0;
+	unsigned i;
+
+	hash = hwloc_diff_hash_bytes(hash, &obj->depth, sizeof(obj->depth));
+	hash = hwloc_diff_hash_bytes(hash, &obj->type, sizeof(obj->type));
+	hash = hwloc_diff_hash_string(hash, obj->subtype);
+	hash = hwloc_diff_hash_bytes(hash, &obj->os_index, sizeof(obj->os_index));
+	for(i=HWLOC_TOPOLOGY_DIFF_OBJ_SET_CPUSET; i<=HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET; i++)
+		hash = hwloc_diff_hash_bitmap(hash, *hwloc_diff_obj_set(obj, (hwloc_topology_diff_obj_set_t) i));
+	hash = hwloc_diff_hash_string(hash, obj->name);
+	hash = hwloc_diff_hash_bytes(hash, &obj->memory.local_memory, sizeof(obj->memory.local_memory));
+
+	switch (obj->type) {
+	default:
+		break;
+	case HWLOC_OBJ_L1CACHE:
+	case HWLOC_OBJ_L2CACHE:
+	case HWLOC_OBJ_L3CACHE:
+	case HWLOC_OBJ_L4CACHE:
+	case HWLOC_OBJ_L5CACHE:
+	case HWLOC_OBJ_L1ICACHE:
+	case HWLOC_OBJ_L2ICACHE:
+	case HWLOC_OBJ_L3ICACHE:
+		attrsize = sizeof(obj->attr->cache);
+		break;
+	case HWLOC_OBJ_GROUP:
+		attrsize = sizeof(obj->attr->group);
+		break;
+	case HWLOC_OBJ_PCI_DEVICE:
+		attrsize = sizeof(obj->attr->pcidev);
+		break;
+	case HWLOC_OBJ_BRIDGE:
+		attrsize = sizeof(obj->attr->bridge);
+		break;
+	case HWLOC_OBJ_OS_DEVICE:
+		attrsize = sizeof(obj->attr->osdev);
+		break;
+	}
+	hash = hwloc_diff_hash_bytes(hash, obj->attr, attrsize);
+
+	hash = hwloc_diff_hash_bytes(hash, &obj->infos_count, sizeof(obj->infos_count));
+	for(i=0; i<obj->infos_count; i++) {
+		hash = hwloc_diff_hash_string(hash, obj->infos[i].name);
+		hash = hwloc_diff_hash_string(hash, obj->infos[i].value);
+	}
+
+	/* children lists are separated by a marker */
+	for(child = obj->first_child; child; child = child->next_sibling) {
+		childhash = hwloc_diff_subtree_hash(topology, child);
+		hash = hwloc_diff_hash_bytes(hash, &childhash, sizeof(childhash));
+	}
+	hash = hwloc_diff_hash_bytes(hash, "\1", 1);
+	for(child = obj->io_first_child; child; child = child->next_sibling) {
+		childhash = hwloc_diff_subtree_hash(topology, child);
+		hash = hwloc_diff_hash_bytes(hash, &childhash, sizeof(childhash));
+	}
+	hash = hwloc_diff_hash_bytes(hash, "\1", 1);
+	for(child = obj->misc_first_child; child; child = child->next_sibling) {
+		childhash = hwloc_diff_subtree_hash(topology, child);
+		hash = hwloc_diff_hash_bytes(hash, &childhash, sizeof(childhash));
+	}
+
+	/* 0 means not computed yet */
+	return hash ? hash : 1;
+}
+
+/* return the cached hash of the subtree below obj, compute it if needed */
+static uint64_t
+hwloc_diff_subtree_hash(hwloc_topology_t topology, hwloc_obj_t obj)
+{
+	uint64_t hash;
+
+	if (!topology->diff_hashes) {
+		topology->diff_hashes = calloc(topology->next_gp_index, sizeof(*topology->diff_hashes));
+		topology->nr_diff_hashes = topology->diff_hashes ? topology->next_gp_index : 0;
+	}
+
+	if (obj->gp_index < topology->nr_diff_hashes && topology->diff_hashes[obj->gp_index])
+		return topology->diff_hashes[obj->gp_index];
+
+	hash = hwloc_diff_compute_subtree_hash(topology, obj);
+	if (obj->gp_index < topology->nr_diff_hashes)
+		topology->diff_hashes[obj->gp_index] = hash;
+	return hash;
+}
+
+void
+hwloc_topology_diff_invalidate_hashes(hwloc_topology_t topology)
+{
+	free(topology->diff_hashes);
+	topology->diff_hashes = NULL;
+	topology->nr_diff_hashes = 0;
+}
+
+static int
+hwloc_diff_trees(hwloc_topology_t topo1, hwloc_obj_t obj1,
+		 hwloc_topology_t topo2, hwloc_obj_t obj2,
+		 unsigned flags,
+		 hwloc_topology_diff_t *firstdiffp, hwloc_topology_diff_t *lastdiffp);
+
+/* compare two lists of children.
+ * matching children are compared recursively,
+ * others are reported as removed from the first list or inserted in the second one.
+ */
+static int
+hwloc_diff_children(hwloc_topology_t topo1, hwloc_obj_t obj1, hwloc_obj_t child1,
+		    hwloc_topology_t topo2, hwloc_obj_t obj2, hwloc_obj_t child2,
+		    unsigned flags,
+		    hwloc_topology_diff_t *firstdiffp, hwloc_topology_diff_t *lastdiffp)
+{
+	unsigned pos1 = 0, pos2 = 0;
+	int err;
+
+	while (child1 || child2) {
+		if (child1 && child2 && hwloc_diff_objs_match(child1, child2)) {
+			err = hwloc_diff_trees(topo1, child1,
+					       topo2, child2,
+					       flags,
+					       firstdiffp, lastdiffp);
+			if (err < 0)
+				return err;
+			child1 = child1->next_sibling;
+			pos1++;
+			child2 = child2->next_sibling;
+			pos2++;
+			continue;
+		}
+
+		if (child1) {
+			/* does child1 match any of the next children in the second list? */
+			hwloc_obj_t tmp = child2 ? child2->next_sibling : NULL;
+			while (tmp && !hwloc_diff_objs_match(child1, tmp))
+				tmp = tmp->next_sibling;
+			if (!tmp) {
+				err = hwloc_append_diff_obj_subtree(HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE,
+								    obj1, obj2, pos1, child1,
+								    firstdiffp, lastdiffp);
+				if (err < 0)
+					return err;
+				child1 = child1->next_sibling;
+				pos1++;
+				continue;
+			}
+		}
+
+		/* child1 matches a later child in the second list, or doesn't exist */
+		err = hwloc_append_diff_obj_subtree(HWLOC_TOPOLOGY_DIFF_OBJ_INSERT,
+						    obj1, obj2, pos2, child2,
+						    firstdiffp, lastdiffp);
+		if (err < 0)
+			return err;
+		child2 = child2->next_sibling;
+		pos2++;
+	}
+
+	return 0;
+}
+
 static int
 hwloc_diff_trees(hwloc_topology_t topo1, hwloc_obj_t obj1,
 		 hwloc_topology_t topo2, hwloc_obj_t obj2,
@@ -122,7 +452,11 @@ hwloc_diff_trees(hwloc_topology_t topo1, hwloc_obj_t obj1,
 {
 	unsigned i;
 	int err;
-	hwloc_obj_t child1, child2;
+
+	if ((flags & HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES)
+	    && hwloc_diff_subtree_hash(topo1, obj1) == hwloc_diff_subtree_hash(topo2, obj2))
+		/* identical subtrees */
+		return 0;
 
 	if (obj1->depth != obj2->depth)
 		goto out_too_complex;
@@ -138,17 +472,25 @@ hwloc_diff_trees(hwloc_topology_t topo1, hwloc_obj_t obj1,
 		 * but it's likely useless anyway */
 		goto out_too_complex;
 
-#define _SETS_DIFFERENT(_set1, _set2) \
- (   ( !(_set1) != !(_set2) ) \
-  || ( (_set1) && !hwloc_bitmap_isequal(_set1, _set2) ) )
-#define SETS_DIFFERENT(_set, _obj1, _obj2) _SETS_DIFFERENT((_obj1)->_set, (_obj2)->_set)
-	if (SETS_DIFFERENT(cpuset, obj1, obj2)
-	    || SETS_DIFFERENT(complete_cpuset, obj1, obj2)
-	    || SETS_DIFFERENT(allowed_cpuset, obj1, obj2)
-	    || SETS_DIFFERENT(nodeset, obj1, obj2)
-	    || SETS_DIFFERENT(complete_nodeset, obj1, obj2)
-	    || SETS_DIFFERENT(allowed_nodeset, obj1, obj2))
-		goto out_too_complex;
+	/* sets may be modified, but not added or removed */
+	for(i=HWLOC_TOPOLOGY_DIFF_OBJ_SET_CPUSET; i<=HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET; i++) {
+		hwloc_bitmap_t set1 = *hwloc_diff_obj_set(obj1, (hwloc_topology_diff_obj_set_t) i);
+		hwloc_bitmap_t set2 = *hwloc_diff_obj_set(obj2, (hwloc_topology_diff_obj_set_t) i);
+		if (!set1 != !set2)
+			goto out_too_complex;
+	}
+	for(i=HWLOC_TOPOLOGY_DIFF_OBJ_SET_CPUSET; i<=HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET; i++) {
+		hwloc_bitmap_t set1 = *hwloc_diff_obj_set(obj1, (hwloc_topology_diff_obj_set_t) i);
+		hwloc_bitmap_t set2 = *hwloc_diff_obj_set(obj2, (hwloc_topology_diff_obj_set_t) i);
+		if (set1 && !hwloc_bitmap_isequal(set1, set2)) {
+			err = hwloc_append_diff_obj_attr_set(obj1,
+							    (hwloc_topology_diff_obj_set_t) i,
+							    set1, set2,
+							    firstdiffp, lastdiffp);
+			if (err < 0)
+				return err;
+		}
+	}
 
 	/* no need to check logical_index, sibling_rank, symmetric_subtree,
 	 * the parents did it */
@@ -234,46 +576,28 @@ hwloc_diff_trees(hwloc_topology_t topo1, hwloc_obj_t obj1,
 	/* ignore userdata */
 
 	/* children */
-	for(child1 = obj1->first_child, child2 = obj2->first_child;
-	    child1 != NULL && child2 != NULL;
-	    child1 = child1->next_sibling, child2 = child2->next_sibling) {
-		err = hwloc_diff_trees(topo1, child1,
-				       topo2, child2,
-				       flags,
-				       firstdiffp, lastdiffp);
-		if (err < 0)
-			return err;
-	}
-	if (child1 || child2)
-		goto out_too_complex;
+	err = hwloc_diff_children(topo1, obj1, obj1->first_child,
+				  topo2, obj2, obj2->first_child,
+				  flags,
+				  firstdiffp, lastdiffp);
+	if (err < 0)
+		return err;
 
 	/* I/O children */
-	for(child1 = obj1->io_first_child, child2 = obj2->io_first_child;
-	    child1 != NULL && child2 != NULL;
-	    child1 = child1->next_sibling, child2 = child2->next_sibling) {
-		err = hwloc_diff_trees(topo1, child1,
-				       topo2, child2,
-				       flags,
-				       firstdiffp, lastdiffp);
-		if (err < 0)
-			return err;
-	}
-	if (child1 || child2)
-		goto out_too_complex;
+	err = hwloc_diff_children(topo1, obj1, obj1->io_first_child,
+				  topo2, obj2, obj2->io_first_child,
+				  flags,
+				  firstdiffp, lastdiffp);
+	if (err < 0)
+		return err;
 
 	/* misc children */
-	for(child1 = obj1->misc_first_child, child2 = obj2->misc_first_child;
-	    child1 != NULL && child2 != NULL;
-	    child1 = child1->next_sibling, child2 = child2->next_sibling) {
-		err = hwloc_diff_trees(topo1, child1,
-				       topo2, child2,
-				       flags,
-				       firstdiffp, lastdiffp);
-		if (err < 0)
-			return err;
-	}
-	if (child1 || child2)
-		goto out_too_complex;
+	err = hwloc_diff_children(topo1, obj1, obj1->misc_first_child,
+				  topo2, obj2, obj2->misc_first_child,
+				  flags,
+				  firstdiffp, lastdiffp);
+	if (err < 0)
+		return err;
 
 	return 0;
 
@@ -292,7 +616,7 @@ int hwloc_topology_diff_build(hwloc_topology_t topo1,
 	unsigned i;
 	int err;
 
-	if (flags != 0) {
+	if (flags & ~HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -314,9 +638,7 @@ int hwloc_topology_diff_build(hwloc_topology_t topo1,
 	}
 
 	if (!err) {
-		/* distances */
-		hwloc_internal_distances_refresh(topo1);
-		hwloc_internal_distances_refresh(topo2);
+		/* distances (objs arrays are always valid in loaded topologies) */
 		dist1 = topo1->first_dist;
 		dist2 = topo2->first_dist;
 		while (dist1 || dist2) {
@@ -348,12 +670,171 @@ int hwloc_topology_diff_build(hwloc_topology_t topo1,
 	return err;
 }
 
+/************************
+ * Fingerprints
+ */
+
+/* integers are hashed in little-endian order so that fingerprints don't depend on the host */
+static uint64_t
+hwloc_fingerprint_hash_uint64(uint64_t hash, uint64_t value)
+{
+	unsigned char bytes[8];
+	unsigned i;
+	for(i=0; i<8; i++)
+		bytes[i] = (unsigned char) (value >> (8*i));
+	return hwloc_diff_hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+/* bitmaps are hashed as 32-bit words so that fingerprints don't depend on the size of longs */
+static uint64_t
+hwloc_fingerprint_hash_bitmap(uint64_t hash, hwloc_const_bitmap_t set)
+{
+	hwloc_bitmap_t tmp = NULL;
+	int infinite, last;
+	unsigned i;
+
+	if (!set)
+		return hwloc_fingerprint_hash_uint64(hash, 2);
+
+	last = hwloc_bitmap_last(set);
+	infinite = (last == -1 && !hwloc_bitmap_iszero(set));
+	if (infinite) {
+		tmp = hwloc_bitmap_alloc();
+		hwloc_bitmap_not(tmp, set);
+		set = tmp;
+		last = hwloc_bitmap_last(set);
+	}
+	hash = hwloc_fingerprint_hash_uint64(hash, infinite);
+	if (last >= 0)
+		for(i=0; i <= (unsigned) last / 32; i++) {
+			unsigned long ulong = hwloc_bitmap_to_ith_ulong(set, i*32 / (8*sizeof(unsigned long)));
+			hash = hwloc_fingerprint_hash_uint64(hash, (ulong >> ((i*32) % (8*sizeof(unsigned long)))) & 0xffffffffUL);
+		}
+	hwloc_bitmap_free(tmp);
+	return hash;
+}
+
+static uint64_t
+hwloc_fingerprint_hash_pcidev(uint64_t hash, struct hwloc_pcidev_attr_s *pcidev)
+{
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->domain);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->bus);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->dev);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->func);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->class_id);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->vendor_id);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->device_id);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->subvendor_id);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->subdevice_id);
+	hash = hwloc_fingerprint_hash_uint64(hash, pcidev->revision);
+	/* in MB/s */
+	hash = hwloc_fingerprint_hash_uint64(hash, (uint64_t) (pcidev->linkspeed * 1000));
+	return hash;
+}
+
+static uint64_t
+hwloc_fingerprint_obj(uint64_t hash, hwloc_obj_t obj, unsigned long flags)
+{
+	hwloc_obj_t child;
+	unsigned i;
+
+	hash = hwloc_diff_hash_string(hash, hwloc_type_name(obj->type));
+	hash = hwloc_diff_hash_string(hash, obj->subtype);
+	hash = hwloc_fingerprint_hash_uint64(hash, obj->os_index);
+	hash = hwloc_fingerprint_hash_bitmap(hash, obj->cpuset);
+	hash = hwloc_fingerprint_hash_bitmap(hash, obj->complete_cpuset);
+	hash = hwloc_fingerprint_hash_bitmap(hash, obj->nodeset);
+	hash = hwloc_fingerprint_hash_bitmap(hash, obj->complete_nodeset);
+	hash = hwloc_fingerprint_hash_uint64(hash, obj->memory.local_memory);
+	hash = hwloc_fingerprint_hash_uint64(hash, obj->memory.page_types_len);
+	for(i=0; i<obj->memory.page_types_len; i++) {
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->memory.page_types[i].size);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->memory.page_types[i].count);
+	}
+
+	switch (obj->type) {
+	default:
+		break;
+	case HWLOC_OBJ_L1CACHE:
+	case HWLOC_OBJ_L2CACHE:
+	case HWLOC_OBJ_L3CACHE:
+	case HWLOC_OBJ_L4CACHE:
+	case HWLOC_OBJ_L5CACHE:
+	case HWLOC_OBJ_L1ICACHE:
+	case HWLOC_OBJ_L2ICACHE:
+	case HWLOC_OBJ_L3ICACHE:
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->cache.size);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->cache.depth);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->cache.linesize);
+		hash = hwloc_fingerprint_hash_uint64(hash, (uint64_t) (int64_t) obj->attr->cache.associativity);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->cache.type);
+		break;
+	case HWLOC_OBJ_GROUP:
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->group.depth);
+		break;
+	case HWLOC_OBJ_PCI_DEVICE:
+		hash = hwloc_fingerprint_hash_pcidev(hash, &obj->attr->pcidev);
+		break;
+	case HWLOC_OBJ_BRIDGE:
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->bridge.upstream_type);
+		if (obj->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_PCI)
+			hash = hwloc_fingerprint_hash_pcidev(hash, &obj->attr->bridge.upstream.pci);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->bridge.downstream_type);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->bridge.downstream.pci.domain);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->bridge.downstream.pci.secondary_bus);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->bridge.downstream.pci.subordinate_bus);
+		break;
+	case HWLOC_OBJ_OS_DEVICE:
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->attr->osdev.type);
+		break;
+	}
+
+	if (flags & HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS) {
+		hash = hwloc_diff_hash_string(hash, obj->name);
+		hash = hwloc_fingerprint_hash_uint64(hash, obj->infos_count);
+		for(i=0; i<obj->infos_count; i++) {
+			hash = hwloc_diff_hash_string(hash, obj->infos[i].name);
+			hash = hwloc_diff_hash_string(hash, obj->infos[i].value);
+		}
+	}
+
+	/* children are enclosed between markers so that the structure is part of the hash */
+	hash = hwloc_diff_hash_bytes(hash, "(", 1);
+	for(child = obj->first_child; child; child = child->next_sibling)
+		hash = hwloc_fingerprint_obj(hash, child, flags);
+	hash = hwloc_diff_hash_bytes(hash, "|", 1);
+	if (flags & HWLOC_TOPOLOGY_FINGERPRINT_FLAG_IO)
+		for(child = obj->io_first_child; child; child = child->next_sibling)
+			hash = hwloc_fingerprint_obj(hash, child, flags);
+	hash = hwloc_diff_hash_bytes(hash, "|", 1);
+	if (flags & HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS)
+		for(child = obj->misc_first_child; child; child = child->next_sibling)
+			hash = hwloc_fingerprint_obj(hash, child, flags);
+	hash = hwloc_diff_hash_bytes(hash, ")", 1);
+	return hash;
+}
+
+int hwloc_topology_fingerprint(hwloc_topology_t topology,
+			       unsigned long flags,
+			       hwloc_uint64_t *fingerprint)
+{
+	if (!topology->is_loaded
+	    || (flags & ~(HWLOC_TOPOLOGY_FINGERPRINT_FLAG_IO|HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS))) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*fingerprint = hwloc_fingerprint_obj(HWLOC_DIFF_HASH_INIT, hwloc_get_root_obj(topology), flags);
+	return 0;
+}
+
 /********************
  * Applying diffs
  */
 
+/* apply an attribute entry to obj, which was looked up by the caller */
 static int
-hwloc_apply_diff_one(hwloc_topology_t topology,
+hwloc_apply_diff_one(hwloc_obj_t obj,
 		     hwloc_topology_diff_t diff,
 		     unsigned long flags)
 {
@@ -362,7 +843,6 @@ hwloc_apply_diff_one(hwloc_topology_t topology,
 	switch (diff->generic.type) {
 	case HWLOC_TOPOLOGY_DIFF_OBJ_ATTR: {
 		struct hwloc_topology_diff_obj_attr_s *obj_attr = &diff->obj_attr;
-		hwloc_obj_t obj = hwloc_get_obj_by_depth(topology, obj_attr->obj_depth, obj_attr->obj_index);
 		if (!obj)
 			return -1;
 
@@ -410,6 +890,15 @@ hwloc_apply_diff_one(hwloc_topology_t topology,
 				return -1;
 			break;
 		}
+		case HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET: {
+			hwloc_const_bitmap_t oldvalue = reverse ? obj_attr->diff.set.newvalue : obj_attr->diff.set.oldvalue;
+			hwloc_const_bitmap_t newvalue = reverse ? obj_attr->diff.set.oldvalue : obj_attr->diff.set.newvalue;
+			hwloc_bitmap_t *setp = hwloc_diff_obj_set(obj, obj_attr->diff.set.index);
+			if (!setp || !*setp || !hwloc_bitmap_isequal(*setp, oldvalue))
+				return -1;
+			hwloc_bitmap_copy(*setp, newvalue);
+			break;
+		}
 		default:
 			return -1;
 		}
@@ -423,11 +912,237 @@ hwloc_apply_diff_one(hwloc_topology_t topology,
 	return 0;
 }
 
+static int
+hwloc_diff_is_subtree(hwloc_topology_diff_t diff)
+{
+	return diff->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_INSERT
+		|| diff->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE;
+}
+
+/* check whether an existing object is the one described in the diff payload.
+ * depth isn't compared since payloads imported from XML don't have any.
+ */
+static int
+hwloc_diff_obj_is_payload(hwloc_obj_t obj, hwloc_obj_t payload)
+{
+	if (obj->type != payload->type
+	    || obj->os_index != payload->os_index)
+		return 0;
+	if ((!obj->subtype) != (!payload->subtype)
+	    || (obj->subtype && strcmp(obj->subtype, payload->subtype)))
+		return 0;
+	if ((!obj->complete_cpuset) != (!payload->complete_cpuset)
+	    || (obj->complete_cpuset && !hwloc_bitmap_isequal(obj->complete_cpuset, payload->complete_cpuset)))
+		return 0;
+	return 1;
+}
+
+/* Structural entries are applied in two phases:
+ * all parents and removed objects are first looked up (and stored in these arrays)
+ * before the topology is modified, since logical indexes change when removing objects.
+ * Then all removals are done before all insertions, in the order of the diff list,
+ * so that each insertion position is relative to the final list of children.
+ */
+struct hwloc_diff_subtree_apply_s {
+	unsigned nr;
+	hwloc_obj_t *parents;
+	hwloc_obj_t *removed; /* NULL for insertions */
+	hwloc_obj_t *inserted; /* filled during commit, NULL for removals */
+};
+
+static int
+hwloc_diff_subtree_is_removal(hwloc_topology_diff_t diff, int reverse)
+{
+	return (diff->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE) ^ reverse;
+}
+
+/* return 0 on success, or the index (starting at 1) of the first entry that cannot be applied */
+static int
+hwloc_diff_subtrees_prepare(hwloc_topology_t topology,
+			    hwloc_topology_diff_t diff,
+			    int reverse,
+			    struct hwloc_diff_subtree_apply_s *apply)
+{
+	hwloc_topology_diff_t tmpdiff;
+	unsigned i;
+	int nr;
+
+	for(tmpdiff = diff, nr = 1, i = 0; tmpdiff; tmpdiff = tmpdiff->generic.next, nr++) {
+		struct hwloc_topology_diff_obj_subtree_s *subtree = &tmpdiff->obj_subtree;
+		hwloc_obj_t parent, child;
+		unsigned j;
+
+		if (!hwloc_diff_is_subtree(tmpdiff))
+			continue;
+
+		parent = hwloc_get_obj_by_depth(topology, subtree->parent_depth,
+						reverse ? subtree->new_parent_index : subtree->old_parent_index);
+		if (!parent || !subtree->obj)
+			return nr;
+		apply->parents[i] = parent;
+		apply->removed[i] = NULL;
+
+		if (hwloc_diff_subtree_is_removal(tmpdiff, reverse)) {
+			child = *hwloc_diff_children_list(parent, subtree->obj->type);
+			for(j=0; child && j<subtree->position; j++)
+				child = child->next_sibling;
+			if (!child || !hwloc_diff_obj_is_payload(child, subtree->obj))
+				return nr;
+			apply->removed[i] = child;
+		}
+		i++;
+	}
+
+	return 0;
+}
+
+static void
+hwloc_diff_mark_gp_indexes(hwloc_bitmap_t used, hwloc_obj_t obj)
+{
+	hwloc_obj_t child;
+	hwloc_bitmap_set(used, (unsigned) obj->gp_index);
+	for(child = obj->first_child; child; child = child->next_sibling)
+		hwloc_diff_mark_gp_indexes(used, child);
+	for(child = obj->io_first_child; child; child = child->next_sibling)
+		hwloc_diff_mark_gp_indexes(used, child);
+	for(child = obj->misc_first_child; child; child = child->next_sibling)
+		hwloc_diff_mark_gp_indexes(used, child);
+}
+
+/* keep the gp_index of inserted objects when it's not used in the topology yet,
+ * so that patching gives the same topology as the one the diff was built from.
+ * fix bridge depth since it cannot be imported from XML.
+ */
+static void
+hwloc_diff_fixup_inserted_subtree(hwloc_topology_t topology, hwloc_bitmap_t used,
+				  hwloc_obj_t obj, unsigned bridge_depth)
+{
+	hwloc_obj_t child;
+
+	if (!obj->gp_index || obj->gp_index != (unsigned) obj->gp_index
+	    || hwloc_bitmap_isset(used, (unsigned) obj->gp_index))
+		obj->gp_index = topology->next_gp_index++;
+	else if (obj->gp_index >= topology->next_gp_index)
+		topology->next_gp_index = obj->gp_index + 1;
+	hwloc_bitmap_set(used, (unsigned) obj->gp_index);
+
+	if (obj->type == HWLOC_OBJ_BRIDGE)
+		obj->attr->bridge.depth = bridge_depth;
+
+	for(child = obj->first_child; child; child = child->next_sibling)
+		hwloc_diff_fixup_inserted_subtree(topology, used, child, 0);
+	for(child = obj->io_first_child; child; child = child->next_sibling)
+		hwloc_diff_fixup_inserted_subtree(topology, used, child,
+						  hwloc_obj_type_is_io(obj->type) ? bridge_depth+1 : 0);
+	for(child = obj->misc_first_child; child; child = child->next_sibling)
+		hwloc_diff_fixup_inserted_subtree(topology, used, child, 0);
+}
+
+static int
+hwloc_diff_subtrees_commit(hwloc_topology_t topology,
+			   hwloc_topology_diff_t diff,
+			   int reverse,
+			   struct hwloc_diff_subtree_apply_s *apply)
+{
+	hwloc_topology_diff_t tmpdiff;
+	hwloc_bitmap_t used;
+	unsigned i;
+
+	/* allocate before modifying anything so that a failure leaves the topology unchanged */
+	used = hwloc_bitmap_alloc();
+	if (!used)
+		return -1;
+
+	/* remove objects first */
+	for(i=0; i<apply->nr; i++) {
+		hwloc_obj_t removed = apply->removed[i];
+		hwloc_obj_t *pchild;
+		if (!removed)
+			continue;
+		for(pchild = hwloc_diff_children_list(apply->parents[i], removed->type);
+		    *pchild != removed;
+		    pchild = &(*pchild)->next_sibling);
+		*pchild = removed->next_sibling;
+		removed->next_sibling = NULL;
+		hwloc_free_object_and_children(removed);
+	}
+
+	hwloc_diff_mark_gp_indexes(used, hwloc_get_root_obj(topology));
+
+	/* then insert new objects at their final position */
+	for(tmpdiff = diff, i = 0; tmpdiff; tmpdiff = tmpdiff->generic.next) {
+		struct hwloc_topology_diff_obj_subtree_s *subtree = &tmpdiff->obj_subtree;
+		hwloc_obj_t parent, newobj, *pchild, tmp;
+		unsigned j, bridge_depth;
+
+		if (!hwloc_diff_is_subtree(tmpdiff))
+			continue;
+		apply->inserted[i] = NULL;
+		parent = apply->parents[i++];
+		if (hwloc_diff_subtree_is_removal(tmpdiff, reverse))
+			continue;
+
+		/* duplicating appends at the end of the list of children, move it where it belongs */
+		hwloc__duplicate_objects(topology, parent, subtree->obj);
+		for(pchild = hwloc_diff_children_list(parent, subtree->obj->type);
+		    (*pchild)->next_sibling;
+		    pchild = &(*pchild)->next_sibling);
+		newobj = *pchild;
+		*pchild = NULL;
+		for(pchild = hwloc_diff_children_list(parent, subtree->obj->type), j = 0;
+		    *pchild && j < subtree->position;
+		    pchild = &(*pchild)->next_sibling, j++);
+		newobj->next_sibling = *pchild;
+		*pchild = newobj;
+		apply->inserted[i-1] = newobj;
+
+		/* bridge depth is the number of I/O parents */
+		for(tmp = parent, bridge_depth = 0; hwloc_obj_type_is_io(tmp->type); tmp = tmp->parent)
+			bridge_depth++;
+		hwloc_diff_fixup_inserted_subtree(topology, used, newobj, bridge_depth);
+	}
+	hwloc_bitmap_free(used);
+
+	topology->modified = 1;
+	return hwloc_topology_propagate_changes(topology);
+}
+
+static int
+hwloc_diff_subtrees_apply(hwloc_topology_t topology,
+			  hwloc_topology_diff_t diff,
+			  int reverse,
+			  struct hwloc_diff_subtree_apply_s *apply)
+{
+	int err = hwloc_diff_subtrees_prepare(topology, diff, reverse, apply);
+	if (err)
+		return -err;
+	if (hwloc_diff_subtrees_commit(topology, diff, reverse, apply) < 0)
+		return -1;
+	return 0;
+}
+
+/* check whether obj belongs to one of the given subtrees */
+static int
+hwloc_diff_obj_is_in_subtrees(hwloc_obj_t obj, hwloc_obj_t *subtrees, unsigned nr)
+{
+	unsigned i;
+	for( ; obj; obj = obj->parent)
+		for(i=0; i<nr; i++)
+			if (subtrees[i] == obj)
+				return 1;
+	return 0;
+}
+
 int hwloc_topology_diff_apply(hwloc_topology_t topology,
 			      hwloc_topology_diff_t diff,
 			      unsigned long flags)
 {
+	struct hwloc_diff_subtree_apply_s apply;
 	hwloc_topology_diff_t tmpdiff, tmpdiff2;
+	hwloc_obj_t *objs = NULL;
+	char *skipped = NULL;
+	int reverse = !!(flags & HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE);
+	unsigned nrattrs, i;
 	int err, nr;
 
 	if (flags & ~HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE) {
@@ -435,24 +1150,132 @@ int hwloc_topology_diff_apply(hwloc_topology_t topology,
 		return -1;
 	}
 
+	hwloc_topology_diff_invalidate_hashes(topology);
+
+	/* attribute entries refer to objects of the old topology,
+	 * structural changes must be applied after them, or reverted before them.
+	 */
+	apply.nr = 0;
+	nrattrs = 0;
+	for(tmpdiff = diff; tmpdiff; tmpdiff = tmpdiff->generic.next)
+		if (hwloc_diff_is_subtree(tmpdiff))
+			apply.nr++;
+		else
+			nrattrs++;
+	apply.parents = NULL;
+	apply.removed = NULL;
+	apply.inserted = NULL;
+	if (nrattrs) {
+		objs = malloc(nrattrs * sizeof(*objs));
+		skipped = calloc(nrattrs, sizeof(*skipped));
+		if (!objs || !skipped) {
+			free(objs);
+			free(skipped);
+			return -1;
+		}
+	}
+	if (apply.nr) {
+		apply.parents = malloc(apply.nr * sizeof(*apply.parents));
+		apply.removed = malloc(apply.nr * sizeof(*apply.removed));
+		apply.inserted = malloc(apply.nr * sizeof(*apply.inserted));
+		if (!apply.parents || !apply.removed || !apply.inserted) {
+			err = -1;
+			goto out_with_apply;
+		}
+		if (reverse) {
+			err = hwloc_diff_subtrees_apply(topology, diff, 1, &apply);
+			if (err < 0)
+				goto out_with_apply;
+		} else {
+			/* check that structural changes may be applied before modifying anything */
+			err = hwloc_diff_subtrees_prepare(topology, diff, 0, &apply);
+			if (err) {
+				err = -err;
+				goto out_with_apply;
+			}
+		}
+	}
+
+	/* look attribute targets up before structural changes modify logical indexes,
+	 * so that attribute changes may still be reverted if the structural commit fails.
+	 * Objects of removed subtrees are going away, and those of subtrees inserted
+	 * by a reverse application come back from the payload with their old attributes,
+	 * skip changes to both.
+	 */
+	for(tmpdiff = diff, i = 0; tmpdiff; tmpdiff = tmpdiff->generic.next) {
+		hwloc_obj_t obj;
+		if (hwloc_diff_is_subtree(tmpdiff))
+			continue;
+		obj = NULL;
+		if (tmpdiff->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR)
+			obj = hwloc_get_obj_by_depth(topology, tmpdiff->obj_attr.obj_depth, tmpdiff->obj_attr.obj_index);
+		if (obj && apply.nr
+		    && hwloc_diff_obj_is_in_subtrees(obj, reverse ? apply.inserted : apply.removed, apply.nr))
+			skipped[i] = 1;
+		objs[i++] = obj;
+	}
+
 	tmpdiff = diff;
 	nr = 0;
+	i = 0;
 	while (tmpdiff) {
 		nr++;
-		err = hwloc_apply_diff_one(topology, tmpdiff, flags);
-		if (err < 0)
-			goto cancel;
+		if (!hwloc_diff_is_subtree(tmpdiff)) {
+			if (!skipped[i]) {
+				err = hwloc_apply_diff_one(objs[i], tmpdiff, flags);
+				if (err < 0)
+					goto cancel;
+			}
+			i++;
+		}
 		tmpdiff = tmpdiff->generic.next;
 	}
-	return 0;
+
+	err = 0;
+	if (apply.nr && !reverse) {
+		/* parents were looked up before attributes changed, their logical indexes didn't change */
+		err = hwloc_diff_subtrees_commit(topology, diff, 0, &apply);
+		if (err < 0) {
+			/* applied attribute targets are not in removed subtrees, revert their changes */
+			for(tmpdiff = diff, i = 0; tmpdiff; tmpdiff = tmpdiff->generic.next)
+				if (!hwloc_diff_is_subtree(tmpdiff)) {
+					if (!skipped[i])
+						hwloc_apply_diff_one(objs[i], tmpdiff, flags ^ HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE);
+					i++;
+				}
+		}
+	}
+
+ out_with_apply:
+	free(objs);
+	free(skipped);
+	free(apply.parents);
+	free(apply.removed);
+	free(apply.inserted);
+	if (err < 0)
+		errno = EINVAL;
+	return err;
 
 cancel:
 	tmpdiff2 = tmpdiff;
 	tmpdiff = diff;
+	i = 0;
 	while (tmpdiff != tmpdiff2) {
-		hwloc_apply_diff_one(topology, tmpdiff, flags ^ HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE);
+		if (!hwloc_diff_is_subtree(tmpdiff)) {
+			if (!skipped[i])
+				hwloc_apply_diff_one(objs[i], tmpdiff, flags ^ HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE);
+			i++;
+		}
 		tmpdiff = tmpdiff->generic.next;
 	}
+	if (apply.nr && reverse)
+		/* restore the structure that was reverted earlier */
+		hwloc_diff_subtrees_apply(topology, diff, 0, &apply);
+	free(objs);
+	free(skipped);
+	free(apply.parents);
+	free(apply.removed);
+	free(apply.inserted);
 	errno = EINVAL;
 	return -nr; /* return the index (starting at 1) of the first element that couldn't be applied */
 }
@@ -572,10 +572,9 @@ hwloc__distances_get(hwloc_topology_t topology,
     return -1;
   }
 
-  /* we could refresh only the distances that match, but we won't have many distances anyway,
-   * so performance is totally negligible.
+  /* objs arrays were refreshed when the topology was loaded or modified,
+   * there's nothing to update here, which keeps concurrent queries safe.
    */
-  hwloc_internal_distances_refresh(topology);
 
   for(dist = topology->first_dist; dist; dist = dist->next) {
     unsigned long kind_from = kind & HWLOC_DISTANCES_KIND_FROM_ALL;
@@ -652,7 +651,7 @@ static void hwloc_report_user_distance_error(const char *msg, int line)
 {
     static int reported = 0;
 
-    if (!reported && !hwloc_hide_errors()) {
+    if (!hwloc_hide_errors() && !hwloc_test_and_set_flag(&reported)) {
         fprintf(stderr, "****************************************************************************\n");
         fprintf(stderr, "* hwloc %s has encountered what looks like an error from user-given distances.\n", HWLOC_VERSION);
         fprintf(stderr, "*\n");
@@ -662,7 +661,6 @@ static void hwloc_report_user_distance_error(const char *msg, int line)
         fprintf(stderr, "* Please make sure that distances given through the interface or environment\n");
         fprintf(stderr, "* variables do not contradict any other topology information.\n");
         fprintf(stderr, "****************************************************************************\n");
-        reported = 1;
     }
 }
 
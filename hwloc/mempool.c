@@ -0,0 +1,520 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <private/autogen/config.h>
+#include <hwloc.h>
+#include <private/private.h>
+#include <private/misc.h>
+
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+
+/* Blocks are powers of two from HWLOC_MEMPOOL_MIN_BLOCK_SIZE (64 = 1<<6)
+ * to HWLOC_MEMPOOL_MAX_BLOCK_SIZE (256k = 1<<18).
+ */
+#define HWLOC_MEMPOOL_MIN_BLOCK_SHIFT 6
+#define HWLOC_MEMPOOL_NR_CLASSES 13
+#define HWLOC_MEMPOOL_CLASS_SIZE(c) ((size_t) HWLOC_MEMPOOL_MIN_BLOCK_SIZE << (c))
+
+#define HWLOC_MEMPOOL_DEFAULT_CHUNK_SIZE (2*1024*1024)
+
+/* a thread cache keeps at most 64 blocks or 1MB per class, and at least 2 blocks */
+#define HWLOC_MEMPOOL_CACHE_MAX_BLOCKS 64
+#define HWLOC_MEMPOOL_CACHE_MAX_BYTES (1024*1024)
+
+#define HWLOC_MEMPOOL_ALLFLAGS (HWLOC_MEMPOOL_FLAG_THREAD_CACHE)
+
+#ifdef HWLOC_WIN_SYS
+/* Same basic mutex as hwloc_components_mutex,
+ * no thread cache since we don't use Windows TLS. */
+#include <windows.h>
+typedef LONG hwloc__mempool_lock_t;
+#define HWLOC_MEMPOOL_LOCK_INIT(pool) do { (pool)->lock = 0; } while (0)
+#define HWLOC_MEMPOOL_LOCK_DESTROY(pool) do { } while (0)
+#define HWLOC_MEMPOOL_LOCK(pool) do {					\
+  while (InterlockedCompareExchange(&(pool)->lock, 1, 0) != 0)		\
+    SwitchToThread();							\
+} while (0)
+#define HWLOC_MEMPOOL_UNLOCK(pool) do {					\
+  assert((pool)->lock == 1);						\
+  (pool)->lock = 0;							\
+} while (0)
+
+#elif defined HWLOC_HAVE_PTHREAD_MUTEX
+#include <pthread.h>
+typedef pthread_mutex_t hwloc__mempool_lock_t;
+#define HWLOC_MEMPOOL_LOCK_INIT(pool) pthread_mutex_init(&(pool)->lock, NULL)
+#define HWLOC_MEMPOOL_LOCK_DESTROY(pool) pthread_mutex_destroy(&(pool)->lock)
+#define HWLOC_MEMPOOL_LOCK(pool) pthread_mutex_lock(&(pool)->lock)
+#define HWLOC_MEMPOOL_UNLOCK(pool) pthread_mutex_unlock(&(pool)->lock)
+/* pthread keys are always available together with pthread mutexes */
+#define HWLOC_MEMPOOL_HAVE_THREAD_CACHE 1
+
+#else /* HWLOC_WIN_SYS || HWLOC_HAVE_PTHREAD_MUTEX */
+#error No mutex implementation available
+#endif
+
+/* free blocks are linked through their first bytes */
+struct hwloc__mempool_block {
+  struct hwloc__mempool_block *next;
+};
+
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+struct hwloc__mempool_cache {
+  struct hwloc_mempool_s *pool;
+  struct hwloc__mempool_block *heads[HWLOC_MEMPOOL_NR_CLASSES];
+  unsigned counts[HWLOC_MEMPOOL_NR_CLASSES];
+  hwloc_uint64_t nr_allocs, nr_frees, nr_cache_hits;
+  struct hwloc__mempool_cache *prev, *next;
+};
+#endif
+
+struct hwloc_mempool_s {
+  hwloc_topology_t topology;
+  hwloc_bitmap_t set;
+  hwloc_membind_policy_t policy;
+  int membind_flags;
+  size_t chunk_size;
+  unsigned long flags;
+
+  /* everything below is protected by the lock */
+  hwloc__mempool_lock_t lock;
+  struct hwloc__mempool_block *heads[HWLOC_MEMPOOL_NR_CLASSES];
+  char *bump; /* next unused byte in the last chunk */
+  size_t bump_left; /* number of unused bytes in the last chunk */
+  void **chunks;
+  unsigned nr_chunks, allocated_chunks;
+  struct hwloc_mempool_stats_s stats; /* central counters, including those of exited threads */
+
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+  int use_cache;
+  pthread_key_t cache_key;
+  struct hwloc__mempool_cache *first_cache; /* caches of live threads */
+#endif
+};
+
+static __hwloc_inline unsigned
+hwloc__mempool_class(size_t len)
+{
+  if (len <= HWLOC_MEMPOOL_MIN_BLOCK_SIZE)
+    return 0;
+  return hwloc_flsl((unsigned long) len - 1) - HWLOC_MEMPOOL_MIN_BLOCK_SHIFT;
+}
+
+/* Give unused bytes of the last chunk back to the free lists
+ * so that nothing is wasted when the pool grows.
+ * Called with the lock held.
+ */
+static void
+hwloc__mempool_recycle_bump(struct hwloc_mempool_s *pool)
+{
+  while (pool->bump_left >= HWLOC_MEMPOOL_MIN_BLOCK_SIZE) {
+    struct hwloc__mempool_block *block = (struct hwloc__mempool_block *) pool->bump;
+    unsigned c = hwloc_flsl((unsigned long) pool->bump_left) - 1 - HWLOC_MEMPOOL_MIN_BLOCK_SHIFT;
+    size_t size;
+    if (c >= HWLOC_MEMPOOL_NR_CLASSES)
+      c = HWLOC_MEMPOOL_NR_CLASSES-1;
+    size = HWLOC_MEMPOOL_CLASS_SIZE(c);
+    block->next = pool->heads[c];
+    pool->heads[c] = block;
+    pool->bump += size;
+    pool->bump_left -= size;
+  }
+}
+
+/* Allocate a new chunk from the OS.
+ * Called with the lock held.
+ */
+static int
+hwloc__mempool_grow(struct hwloc_mempool_s *pool)
+{
+  void *chunk;
+
+  if (pool->nr_chunks == pool->allocated_chunks) {
+    unsigned allocated = pool->allocated_chunks ? 2*pool->allocated_chunks : 8;
+    void **tmp = realloc(pool->chunks, allocated * sizeof(*pool->chunks));
+    if (!tmp)
+      return -1;
+    pool->chunks = tmp;
+    pool->allocated_chunks = allocated;
+  }
+
+  chunk = hwloc_alloc_membind(pool->topology, pool->chunk_size, pool->set, pool->policy, pool->membind_flags);
+  if (!chunk)
+    return -1;
+
+  hwloc__mempool_recycle_bump(pool);
+  pool->chunks[pool->nr_chunks++] = chunk;
+  pool->bump = chunk;
+  pool->bump_left = pool->chunk_size;
+  pool->stats.nr_chunks++;
+  pool->stats.chunk_bytes += pool->chunk_size;
+  return 0;
+}
+
+/* Get one block of class c from the free list or from the last chunk.
+ * Called with the lock held.
+ */
+static struct hwloc__mempool_block *
+hwloc__mempool_get_block(struct hwloc_mempool_s *pool, unsigned c)
+{
+  struct hwloc__mempool_block *block = pool->heads[c];
+  size_t size = HWLOC_MEMPOOL_CLASS_SIZE(c);
+
+  if (block) {
+    pool->heads[c] = block->next;
+    return block;
+  }
+
+  if (pool->bump_left < size && hwloc__mempool_grow(pool) < 0)
+    return NULL;
+
+  block = (struct hwloc__mempool_block *) pool->bump;
+  pool->bump += size;
+  pool->bump_left -= size;
+  return block;
+}
+
+/*****************
+ * Thread caches
+ */
+
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+
+static __hwloc_inline unsigned
+hwloc__mempool_cache_max(unsigned c)
+{
+  size_t max = HWLOC_MEMPOOL_CACHE_MAX_BYTES / HWLOC_MEMPOOL_CLASS_SIZE(c);
+  if (max > HWLOC_MEMPOOL_CACHE_MAX_BLOCKS)
+    max = HWLOC_MEMPOOL_CACHE_MAX_BLOCKS;
+  if (max < 2)
+    max = 2;
+  return (unsigned) max;
+}
+
+/* Move nr blocks of class c from the cache back to the pool.
+ * Called with the lock held.
+ */
+static void
+hwloc__mempool_cache_flush(struct hwloc__mempool_cache *cache, unsigned c, unsigned nr)
+{
+  struct hwloc_mempool_s *pool = cache->pool;
+  while (nr-- && cache->heads[c]) {
+    struct hwloc__mempool_block *block = cache->heads[c];
+    cache->heads[c] = block->next;
+    cache->counts[c]--;
+    block->next = pool->heads[c];
+    pool->heads[c] = block;
+  }
+}
+
+/* Called with the lock held. */
+static void
+hwloc__mempool_cache_retire(struct hwloc__mempool_cache *cache)
+{
+  struct hwloc_mempool_s *pool = cache->pool;
+  unsigned c;
+
+  for(c=0; c<HWLOC_MEMPOOL_NR_CLASSES; c++)
+    hwloc__mempool_cache_flush(cache, c, cache->counts[c]);
+
+  pool->stats.nr_allocs += cache->nr_allocs;
+  pool->stats.nr_frees += cache->nr_frees;
+  pool->stats.nr_cache_hits += cache->nr_cache_hits;
+
+  if (cache->prev)
+    cache->prev->next = cache->next;
+  else
+    pool->first_cache = cache->next;
+  if (cache->next)
+    cache->next->prev = cache->prev;
+}
+
+/* pthread key destructor, called when a thread that used the pool exits */
+static void
+hwloc__mempool_cache_destructor(void *_cache)
+{
+  struct hwloc__mempool_cache *cache = _cache;
+  struct hwloc_mempool_s *pool = cache->pool;
+
+  HWLOC_MEMPOOL_LOCK(pool);
+  hwloc__mempool_cache_retire(cache);
+  HWLOC_MEMPOOL_UNLOCK(pool);
+  free(cache);
+}
+
+/* Return the cache of the current thread, or NULL if caches are disabled or on error. */
+static struct hwloc__mempool_cache *
+hwloc__mempool_get_cache(struct hwloc_mempool_s *pool)
+{
+  struct hwloc__mempool_cache *cache;
+
+  if (!pool->use_cache)
+    return NULL;
+
+  cache = pthread_getspecific(pool->cache_key);
+  if (cache)
+    return cache;
+
+  cache = calloc(1, sizeof(*cache));
+  if (!cache)
+    return NULL;
+  cache->pool = pool;
+  if (pthread_setspecific(pool->cache_key, cache)) {
+    free(cache);
+    return NULL;
+  }
+
+  HWLOC_MEMPOOL_LOCK(pool);
+  cache->next = pool->first_cache;
+  if (pool->first_cache)
+    pool->first_cache->prev = cache;
+  pool->first_cache = cache;
+  HWLOC_MEMPOOL_UNLOCK(pool);
+  return cache;
+}
+
+static void *
+hwloc__mempool_cache_alloc(struct hwloc__mempool_cache *cache, unsigned c)
+{
+  struct hwloc_mempool_s *pool = cache->pool;
+  struct hwloc__mempool_block *block = cache->heads[c];
+
+  if (block) {
+    cache->heads[c] = block->next;
+    cache->counts[c]--;
+    cache->nr_allocs++;
+    cache->nr_cache_hits++;
+    return block;
+  }
+
+  /* refill half of the cache at once, and return one more block */
+  HWLOC_MEMPOOL_LOCK(pool);
+  block = hwloc__mempool_get_block(pool, c);
+  if (block) {
+    unsigned nr = hwloc__mempool_cache_max(c) / 2;
+    while (nr--) {
+      struct hwloc__mempool_block *extra = hwloc__mempool_get_block(pool, c);
+      if (!extra)
+	break;
+      extra->next = cache->heads[c];
+      cache->heads[c] = extra;
+      cache->counts[c]++;
+    }
+    cache->nr_allocs++;
+  } else {
+    pool->stats.nr_failed_allocs++;
+  }
+  HWLOC_MEMPOOL_UNLOCK(pool);
+  return block;
+}
+
+static void
+hwloc__mempool_cache_free(struct hwloc__mempool_cache *cache, unsigned c, void *addr)
+{
+  struct hwloc__mempool_block *block = addr;
+  unsigned max = hwloc__mempool_cache_max(c);
+
+  block->next = cache->heads[c];
+  cache->heads[c] = block;
+  cache->counts[c]++;
+  cache->nr_frees++;
+
+  if (cache->counts[c] > max) {
+    /* give half of the cache back to the pool */
+    HWLOC_MEMPOOL_LOCK(cache->pool);
+    hwloc__mempool_cache_flush(cache, c, max/2);
+    HWLOC_MEMPOOL_UNLOCK(cache->pool);
+  }
+}
+
+#endif /* HWLOC_MEMPOOL_HAVE_THREAD_CACHE */
+
+/*****************
+ * Public API
+ */
+
+hwloc_mempool_t
+hwloc_mempool_create(hwloc_topology_t topology,
+		     hwloc_const_bitmap_t set, hwloc_membind_policy_t policy, int membind_flags,
+		     size_t chunk_size, unsigned long flags)
+{
+  struct hwloc_mempool_s *pool;
+
+  if (flags & ~HWLOC_MEMPOOL_ALLFLAGS) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (membind_flags & HWLOC_MEMBIND_MIGRATE) {
+    /* hwloc_alloc_membind() would fail anyway */
+    errno = EINVAL;
+    return NULL;
+  }
+
+  if (!chunk_size)
+    chunk_size = HWLOC_MEMPOOL_DEFAULT_CHUNK_SIZE;
+  if (chunk_size > (size_t) -1 - HWLOC_MEMPOOL_MAX_BLOCK_SIZE) {
+    errno = EINVAL;
+    return NULL;
+  }
+  chunk_size = (chunk_size + HWLOC_MEMPOOL_MAX_BLOCK_SIZE - 1) & ~((size_t) HWLOC_MEMPOOL_MAX_BLOCK_SIZE - 1);
+
+  pool = calloc(1, sizeof(*pool));
+  if (!pool)
+    goto out;
+  pool->set = hwloc_bitmap_dup(set);
+  if (!pool->set)
+    goto out_with_pool;
+  pool->topology = topology;
+  pool->policy = policy;
+  pool->membind_flags = membind_flags;
+  pool->chunk_size = chunk_size;
+  pool->flags = flags;
+
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+  if ((flags & HWLOC_MEMPOOL_FLAG_THREAD_CACHE)
+      && !pthread_key_create(&pool->cache_key, hwloc__mempool_cache_destructor))
+    pool->use_cache = 1;
+#endif
+
+  HWLOC_MEMPOOL_LOCK_INIT(pool);
+  return pool;
+
+ out_with_pool:
+  free(pool);
+ out:
+  errno = ENOMEM;
+  return NULL;
+}
+
+void *
+hwloc_mempool_alloc(hwloc_mempool_t pool, size_t len)
+{
+  void *addr;
+  unsigned c;
+
+  if (len > HWLOC_MEMPOOL_MAX_BLOCK_SIZE) {
+    addr = hwloc_alloc_membind(pool->topology, len, pool->set, pool->policy, pool->membind_flags);
+    HWLOC_MEMPOOL_LOCK(pool);
+    if (addr)
+      pool->stats.nr_large_allocs++;
+    else
+      pool->stats.nr_failed_allocs++;
+    HWLOC_MEMPOOL_UNLOCK(pool);
+    goto out;
+  }
+
+  c = hwloc__mempool_class(len);
+
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+  {
+    struct hwloc__mempool_cache *cache = hwloc__mempool_get_cache(pool);
+    if (cache) {
+      addr = hwloc__mempool_cache_alloc(cache, c);
+      goto out;
+    }
+  }
+#endif
+
+  HWLOC_MEMPOOL_LOCK(pool);
+  addr = hwloc__mempool_get_block(pool, c);
+  if (addr)
+    pool->stats.nr_allocs++;
+  else
+    pool->stats.nr_failed_allocs++;
+  HWLOC_MEMPOOL_UNLOCK(pool);
+
+ out:
+  if (!addr)
+    errno = ENOMEM;
+  return addr;
+}
+
+int
+hwloc_mempool_free(hwloc_mempool_t pool, void *addr, size_t len)
+{
+  struct hwloc__mempool_block *block = addr;
+  unsigned c;
+
+  if (!addr)
+    return 0;
+
+  if (len > HWLOC_MEMPOOL_MAX_BLOCK_SIZE) {
+    int err = hwloc_free(pool->topology, addr, len);
+    HWLOC_MEMPOOL_LOCK(pool);
+    pool->stats.nr_large_frees++;
+    HWLOC_MEMPOOL_UNLOCK(pool);
+    return err;
+  }
+
+  c = hwloc__mempool_class(len);
+
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+  {
+    struct hwloc__mempool_cache *cache = hwloc__mempool_get_cache(pool);
+    if (cache) {
+      hwloc__mempool_cache_free(cache, c, addr);
+      return 0;
+    }
+  }
+#endif
+
+  HWLOC_MEMPOOL_LOCK(pool);
+  block->next = pool->heads[c];
+  pool->heads[c] = block;
+  pool->stats.nr_frees++;
+  HWLOC_MEMPOOL_UNLOCK(pool);
+  return 0;
+}
+
+int
+hwloc_mempool_get_stats(hwloc_mempool_t pool, struct hwloc_mempool_stats_s *stats, unsigned long flags)
+{
+  if (flags) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  HWLOC_MEMPOOL_LOCK(pool);
+  memcpy(stats, &pool->stats, sizeof(*stats));
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+  {
+    struct hwloc__mempool_cache *cache;
+    for(cache = pool->first_cache; cache; cache = cache->next) {
+      stats->nr_allocs += cache->nr_allocs;
+      stats->nr_frees += cache->nr_frees;
+      stats->nr_cache_hits += cache->nr_cache_hits;
+    }
+  }
+#endif
+  HWLOC_MEMPOOL_UNLOCK(pool);
+  return 0;
+}
+
+void
+hwloc_mempool_destroy(hwloc_mempool_t pool)
+{
+  unsigned i;
+
+#ifdef HWLOC_MEMPOOL_HAVE_THREAD_CACHE
+  if (pool->use_cache) {
+    /* destructors won't be called anymore for threads that still have a cache */
+    pthread_key_delete(pool->cache_key);
+    while (pool->first_cache) {
+      struct hwloc__mempool_cache *cache = pool->first_cache;
+      pool->first_cache = cache->next;
+      free(cache);
+    }
+  }
+#endif
+
+  for(i=0; i<pool->nr_chunks; i++)
+    hwloc_free(pool->topology, pool->chunks[i], pool->chunk_size);
+  free(pool->chunks);
+  hwloc_bitmap_free(pool->set);
+  HWLOC_MEMPOOL_LOCK_DESTROY(pool);
+  free(pool);
+}
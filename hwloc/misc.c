@@ -19,6 +19,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <ctype.h>
+#include <limits.h>
+#ifndef HWLOC_WIN_SYS
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#endif
 
 #ifdef HAVE_PROGRAM_INVOCATION_NAME
 #include <errno.h>
@@ -164,3 +171,101 @@ hwloc_progname(struct hwloc_topology *topology __hwloc_attribute_unused)
   return strdup(basename);
 #endif /* !HAVE_GETMODULEFILENAME */
 }
+
+/* how long a client waits for each hwlocd operation before falling back to normal discovery */
+#define HWLOC_DAEMON_TIMEOUT_SECONDS 5
+
+int
+hwloc__daemon_get_xmlbuffer(const char *path __hwloc_attribute_unused,
+			    char **bufferp __hwloc_attribute_unused, int *buflenp __hwloc_attribute_unused)
+{
+#ifdef HWLOC_WIN_SYS
+  errno = ENOSYS;
+  return -1;
+#else /* !HWLOC_WIN_SYS */
+  struct sockaddr_un addr;
+  struct timeval timeout;
+  char header[32], *buffer, *end;
+  size_t headerlen = 0, done;
+  unsigned long len;
+  ssize_t ret;
+  int fd;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  /* a hung daemon must not hang the application */
+  timeout.tv_sec = HWLOC_DAEMON_TIMEOUT_SECONDS;
+  timeout.tv_usec = 0;
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0
+      || setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0)
+    goto out_with_fd;
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+  {
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+  }
+#endif
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    goto out_with_fd;
+  /* a dead daemon must not raise SIGPIPE in the application */
+#ifdef MSG_NOSIGNAL
+  ret = send(fd, "xml\n", 4, MSG_NOSIGNAL);
+#else
+  ret = send(fd, "xml\n", 4, 0);
+#endif
+  if (ret != 4)
+    goto out_with_fd;
+
+  /* read the "OK <length>" header byte per byte so that we don't consume the payload */
+  while (headerlen < sizeof(header)-1) {
+    ret = read(fd, &header[headerlen], 1);
+    if (ret <= 0)
+      goto out_with_fd;
+    if (header[headerlen] == '\n')
+      break;
+    headerlen++;
+  }
+  header[headerlen] = '\0';
+  if (strncmp(header, "OK ", 3)) {
+    errno = EPROTO;
+    goto out_with_fd;
+  }
+  len = strtoul(header+3, &end, 10);
+  if (*end || !len || len >= (unsigned long) INT_MAX) {
+    errno = EPROTO;
+    goto out_with_fd;
+  }
+
+  buffer = malloc(len+1);
+  if (!buffer)
+    goto out_with_fd;
+  for(done = 0; done < len; done += ret) {
+    ret = read(fd, buffer+done, len-done);
+    if (ret <= 0) {
+      if (!ret)
+	errno = EPROTO;
+      free(buffer);
+      goto out_with_fd;
+    }
+  }
+  buffer[len] = '\0';
+  close(fd);
+
+  *bufferp = buffer;
+  *buflenp = (int) len+1;
+  return 0;
+
+ out_with_fd:
+  close(fd);
+  return -1;
+#endif /* !HWLOC_WIN_SYS */
+}
@@ -114,6 +114,12 @@ hwloc_pci_discovery_init(struct hwloc_topology *topology)
   topology->pci_nonzero_domains = 0;
   topology->need_pci_belowroot_apply_locality = 0;
 
+  topology->pci_busid_index = NULL;
+  topology->pci_busid_index_nr = 0;
+  topology->pci_bridge_index = NULL;
+  topology->pci_bridge_index_nr = 0;
+  topology->pci_busid_index_failed = 0;
+
   topology->pci_has_forced_locality = 0;
   topology->pci_forced_locality_nr = 0;
   topology->pci_forced_locality = NULL;
@@ -147,6 +153,17 @@ hwloc_pci_discovery_init(struct hwloc_topology *topology)
   }
 }
 
+static void
+hwloc_pci_index_clear(struct hwloc_topology *topology)
+{
+  free(topology->pci_busid_index);
+  topology->pci_busid_index = NULL;
+  topology->pci_busid_index_nr = 0;
+  free(topology->pci_bridge_index);
+  topology->pci_bridge_index = NULL;
+  topology->pci_bridge_index_nr = 0;
+}
+
 void
 hwloc_pci_discovery_exit(struct hwloc_topology *topology __hwloc_attribute_unused)
 {
@@ -154,6 +171,9 @@ hwloc_pci_discovery_exit(struct hwloc_topology *topology __hwloc_attribute_unuse
   for(i=0; i<topology->pci_forced_locality_nr; i++)
     hwloc_bitmap_free(topology->pci_forced_locality[i].cpuset);
   free(topology->pci_forced_locality);
+
+  /* objects may be removed after discovery, drop the indexes */
+  hwloc_pci_index_clear(topology);
 }
 
 #ifdef HWLOC_DEBUG
@@ -319,23 +339,246 @@ hwloc_pci_add_object(struct hwloc_obj *parent, struct hwloc_obj **parent_io_firs
   *curp = new;
 }
 
+int
+hwloc_pci_compare_busid_ptrs(const void *_a, const void *_b)
+{
+  const struct hwloc_obj *a = *(const struct hwloc_obj **) _a;
+  const struct hwloc_obj *b = *(const struct hwloc_obj **) _b;
+  uint64_t akey = hwloc_pci_busid_key(a->attr->pcidev.domain, a->attr->pcidev.bus, a->attr->pcidev.dev, a->attr->pcidev.func);
+  uint64_t bkey = hwloc_pci_busid_key(b->attr->pcidev.domain, b->attr->pcidev.bus, b->attr->pcidev.dev, b->attr->pcidev.func);
+  return akey < bkey ? -1 : akey > bkey ? 1 : 0;
+}
+
+/* bridges are sorted by the first bus below them */
+static __hwloc_inline uint64_t
+hwloc_pci_bridge_key(const struct hwloc_obj *bridge)
+{
+  return hwloc_pci_busid_key(bridge->attr->bridge.downstream.pci.domain,
+			     bridge->attr->bridge.downstream.pci.secondary_bus, 0, 0);
+}
+
+static int
+hwloc_pci_compare_bridge_ptrs(const void *_a, const void *_b)
+{
+  uint64_t akey = hwloc_pci_bridge_key(*(const struct hwloc_obj **) _a);
+  uint64_t bkey = hwloc_pci_bridge_key(*(const struct hwloc_obj **) _b);
+  return akey < bkey ? -1 : akey > bkey ? 1 : 0;
+}
+
+static __hwloc_inline int
+hwloc_pci_obj_is_downstream_pci_bridge(const struct hwloc_obj *obj)
+{
+  return obj->type == HWLOC_OBJ_BRIDGE
+    && obj->attr->bridge.downstream_type == HWLOC_OBJ_BRIDGE_PCI;
+}
+
+static __hwloc_inline int
+hwloc_pci_bridge_contains_bus(const struct hwloc_obj *obj, unsigned domain, unsigned bus)
+{
+  return hwloc_pci_obj_is_downstream_pci_bridge(obj)
+    && obj->attr->bridge.downstream.pci.domain == domain
+    && obj->attr->bridge.downstream.pci.secondary_bus <= bus
+    && obj->attr->bridge.downstream.pci.subordinate_bus >= bus;
+}
+
 void
 hwloc_pci_tree_insert_by_busid(struct hwloc_obj **treep,
 			       struct hwloc_obj *obj)
 {
-  hwloc_pci_add_object(NULL /* no parent on top of tree */, treep, obj);
+  /* only queue the object, hwloc_pci_tree_attach_belowroot() sorts all of them at once
+   * instead of walking the siblings of each level for each insertion.
+   */
+  obj->parent = NULL;
+  obj->next_sibling = *treep;
+  *treep = obj;
+}
+
+static unsigned
+hwloc_pci_tree_count(struct hwloc_obj *tree)
+{
+  unsigned nr = 0;
+  for( ; tree; tree = tree->next_sibling)
+    nr += 1 + hwloc_pci_tree_count(tree->io_first_child);
+  return nr;
+}
+
+/* store all objects of the tree in the array and unlink them */
+static void
+hwloc_pci_tree_flatten(struct hwloc_obj *tree, struct hwloc_obj **objs, unsigned *nr)
+{
+  struct hwloc_obj *next;
+  for( ; tree; tree = next) {
+    next = tree->next_sibling;
+    hwloc_pci_tree_flatten(tree->io_first_child, objs, nr);
+    tree->io_first_child = NULL;
+    tree->next_sibling = NULL;
+    tree->parent = NULL;
+    objs[(*nr)++] = tree;
+  }
+}
+
+/* Build the tree from objects sorted by bus ID.
+ * Bridges are always sorted before the objects on their secondary and subordinate buses
+ * (but not necessarily right before them), hence each object goes below the innermost bridge
+ * that was already processed and contains its bus.
+ */
+static struct hwloc_obj *
+hwloc_pci_tree_build_sorted(struct hwloc_obj **objs, unsigned nr)
+{
+  struct hwloc_pci_tree_bridge_s {
+    struct hwloc_obj *bridge;
+    struct hwloc_obj **nextp; /* where to append the next child of this bridge */
+  } *bridges;
+  int bus_bridge[256]; /* innermost bridge containing each bus of the current domain, or -1 */
+  struct hwloc_obj *tree = NULL, **nextp = &tree;
+  unsigned nrbridges = 0;
+  unsigned domain = 0;
+  unsigned i, j;
+
+  bridges = malloc(nr * sizeof(*bridges));
+  if (!bridges)
+    return NULL;
+  for(j=0; j<256; j++)
+    bus_bridge[j] = -1;
+
+  for(i=0; i<nr; i++) {
+    struct hwloc_obj *obj = objs[i];
+    int b;
+
+    if (obj->attr->pcidev.domain != domain) {
+      /* bridges of the previous domain cannot contain anything anymore */
+      domain = obj->attr->pcidev.domain;
+      for(j=0; j<256; j++)
+	bus_bridge[j] = -1;
+    }
+
+    b = bus_bridge[obj->attr->pcidev.bus];
+    if (b >= 0) {
+      obj->parent = bridges[b].bridge;
+      *bridges[b].nextp = obj;
+      bridges[b].nextp = &obj->next_sibling;
+    } else {
+      obj->parent = NULL;
+      *nextp = obj;
+      nextp = &obj->next_sibling;
+    }
+
+    if (hwloc_pci_obj_is_downstream_pci_bridge(obj)
+	&& obj->attr->bridge.downstream.pci.domain == domain) {
+      bridges[nrbridges].bridge = obj;
+      bridges[nrbridges].nextp = &obj->io_first_child;
+      for(j = obj->attr->bridge.downstream.pci.secondary_bus; j <= obj->attr->bridge.downstream.pci.subordinate_bus; j++)
+	bus_bridge[j] = nrbridges;
+      nrbridges++;
+    }
+  }
+
+  free(bridges);
+  return tree;
+}
+
+/* Add objects to the indexes used by hwloc_pci_belowroot_find_by_busid() during discovery.
+ * objs must be sorted. It is freed, or kept as the index if there was none yet.
+ */
+static void
+hwloc_pci_index_add(struct hwloc_topology *topology,
+		    struct hwloc_obj **objs, unsigned nr,
+		    struct hwloc_obj *hostbridges)
+{
+  struct hwloc_obj **tmp, *obj;
+  unsigned nrbridges, i;
+
+  if (topology->pci_busid_index_failed) {
+    free(objs);
+    return;
+  }
+
+  nrbridges = 0;
+  for(i=0; i<nr; i++)
+    if (hwloc_pci_obj_is_downstream_pci_bridge(objs[i]))
+      nrbridges++;
+  for(obj = hostbridges; obj; obj = obj->next_sibling)
+    if (obj->type == HWLOC_OBJ_BRIDGE && obj->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_HOST)
+      nrbridges++;
+
+  tmp = realloc(topology->pci_bridge_index, (topology->pci_bridge_index_nr + nrbridges) * sizeof(*tmp));
+  if (!tmp)
+    goto failed;
+  topology->pci_bridge_index = tmp;
+  for(i=0; i<nr; i++)
+    if (hwloc_pci_obj_is_downstream_pci_bridge(objs[i]))
+      tmp[topology->pci_bridge_index_nr++] = objs[i];
+  for(obj = hostbridges; obj; obj = obj->next_sibling)
+    if (obj->type == HWLOC_OBJ_BRIDGE && obj->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_HOST)
+      tmp[topology->pci_bridge_index_nr++] = obj;
+  qsort(tmp, topology->pci_bridge_index_nr, sizeof(*tmp), hwloc_pci_compare_bridge_ptrs);
+
+  if (!topology->pci_busid_index) {
+    topology->pci_busid_index = objs;
+    topology->pci_busid_index_nr = nr;
+    return;
+  }
+
+  /* another backend attached some PCI objects earlier, merge */
+  tmp = realloc(topology->pci_busid_index, (topology->pci_busid_index_nr + nr) * sizeof(*tmp));
+  if (!tmp)
+    goto failed;
+  topology->pci_busid_index = tmp;
+  memcpy(tmp + topology->pci_busid_index_nr, objs, nr * sizeof(*tmp));
+  topology->pci_busid_index_nr += nr;
+  qsort(tmp, topology->pci_busid_index_nr, sizeof(*tmp), hwloc_pci_compare_busid_ptrs);
+  free(objs);
+  return;
+
+ failed:
+  /* lookups will walk the tree instead */
+  free(objs);
+  hwloc_pci_index_clear(topology);
+  topology->pci_busid_index_failed = 1;
 }
 
 int
 hwloc_pci_tree_attach_belowroot(struct hwloc_topology *topology, struct hwloc_obj *old_tree)
 {
-  struct hwloc_obj **next_hb_p;
+  struct hwloc_obj **next_hb_p, **first_hb_p;
+  struct hwloc_obj **objs, *tree = NULL;
   enum hwloc_type_filter_e bfilter;
+  unsigned nr, i;
 
   if (!old_tree)
     /* found nothing, exit */
     return 0;
 
+  /* sort all objects by bus ID and build the actual hierarchy */
+  nr = hwloc_pci_tree_count(old_tree);
+  objs = malloc(nr * sizeof(*objs));
+  if (objs) {
+    i = 0;
+    hwloc_pci_tree_flatten(old_tree, objs, &i);
+    qsort(objs, nr, sizeof(*objs), hwloc_pci_compare_busid_ptrs);
+    tree = hwloc_pci_tree_build_sorted(objs, nr);
+    if (!tree) {
+      /* relink the objects for the slow path below */
+      old_tree = NULL;
+      for(i=nr; i>0; i--) {
+	objs[i-1]->next_sibling = old_tree;
+	old_tree = objs[i-1];
+      }
+      free(objs);
+      objs = NULL;
+    }
+  }
+  if (!tree) {
+    /* not enough memory for sorting, insert objects one by one */
+    struct hwloc_obj *next;
+    for( ; old_tree; old_tree = next) {
+      next = old_tree->next_sibling;
+      old_tree->next_sibling = NULL;
+      hwloc_pci_add_object(NULL /* no parent on top of tree */, &tree, old_tree);
+    }
+  }
+  old_tree = tree;
+
 #ifdef HWLOC_DEBUG
   hwloc_debug("%s", "\nPCI hierarchy:\n");
   hwloc_pci_traverse(NULL, old_tree, hwloc_pci_traverse_print_cb);
@@ -345,6 +588,7 @@ hwloc_pci_tree_attach_belowroot(struct hwloc_topology *topology, struct hwloc_ob
   next_hb_p = &hwloc_get_root_obj(topology)->io_first_child;
   while (*next_hb_p)
     next_hb_p = &((*next_hb_p)->next_sibling);
+  first_hb_p = next_hb_p;
 
   bfilter = topology->type_filter[HWLOC_OBJ_BRIDGE];
   if (bfilter == HWLOC_TYPE_FILTER_KEEP_NONE) {
@@ -411,6 +655,13 @@ hwloc_pci_tree_attach_belowroot(struct hwloc_topology *topology, struct hwloc_ob
   }
 
  done:
+  if (objs) {
+    hwloc_pci_index_add(topology, objs, nr, *first_hb_p);
+  } else {
+    /* don't let lookups use an index that misses these objects */
+    hwloc_pci_index_clear(topology);
+    topology->pci_busid_index_failed = 1;
+  }
   topology->need_pci_belowroot_apply_locality = 1;
   return 0;
 }
@@ -488,9 +739,8 @@ hwloc__pci_find_busid_parent(struct hwloc_topology *topology, struct hwloc_pcide
     env = getenv(envname);
     if (env) {
       static int warn = 0;
-      if (!topology->pci_has_forced_locality && !warn) {
+      if (!topology->pci_has_forced_locality && !hwloc_test_and_set_flag(&warn)) {
 	fprintf(stderr, "Environment variable %s is deprecated, please use HWLOC_PCI_LOCALITY instead.\n", env);
-	warn = 1;
       }
       if (*env) {
 	/* force the cpuset */
@@ -644,12 +894,66 @@ hwloc__pci_belowroot_find_by_busid(hwloc_obj_t parent,
   return parent;
 }
 
+/* binary search in the discovery indexes instead of walking PCI siblings */
+static struct hwloc_obj *
+hwloc__pci_index_find_by_busid(struct hwloc_topology *topology,
+			       unsigned domain, unsigned bus, unsigned dev, unsigned func)
+{
+  uint64_t key = hwloc_pci_busid_key(domain, bus, dev, func);
+  uint64_t buskey = hwloc_pci_busid_key(domain, bus, 0, 0);
+  hwloc_obj_t obj;
+  unsigned lo, hi;
+
+  lo = 0;
+  hi = topology->pci_busid_index_nr;
+  while (lo < hi) {
+    unsigned mid = (lo+hi)/2;
+    uint64_t midkey;
+    obj = topology->pci_busid_index[mid];
+    midkey = hwloc_pci_busid_key(obj->attr->pcidev.domain, obj->attr->pcidev.bus, obj->attr->pcidev.dev, obj->attr->pcidev.func);
+    if (midkey == key)
+      return obj;
+    if (midkey < key)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+
+  /* not found, look for the innermost bridge containing our bus.
+   * Bridge bus ranges are nested, hence it's either the last bridge whose secondary bus
+   * isn't after ours, or one of its ancestors.
+   */
+  lo = 0;
+  hi = topology->pci_bridge_index_nr;
+  while (lo < hi) {
+    unsigned mid = (lo+hi)/2;
+    if (hwloc_pci_bridge_key(topology->pci_bridge_index[mid]) <= buskey)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  if (!lo)
+    return NULL;
+  for(obj = topology->pci_bridge_index[lo-1];
+      obj && obj->type == HWLOC_OBJ_BRIDGE;
+      obj = obj->parent)
+    if (hwloc_pci_bridge_contains_bus(obj, domain, bus))
+      return obj;
+  return NULL;
+}
+
 struct hwloc_obj *
 hwloc_pci_belowroot_find_by_busid(struct hwloc_topology *topology,
 				  unsigned domain, unsigned bus, unsigned dev, unsigned func)
 {
   hwloc_obj_t root = hwloc_get_root_obj(topology);
-  hwloc_obj_t parent = hwloc__pci_belowroot_find_by_busid(root, domain, bus, dev, func);
+  hwloc_obj_t parent;
+
+  if (topology->pci_busid_index_nr
+      && domain <= 0xffff && bus <= 0xff && dev <= 0xff && func <= 0xff)
+    return hwloc__pci_index_find_by_busid(topology, domain, bus, dev, func);
+
+  parent = hwloc__pci_belowroot_find_by_busid(root, domain, bus, dev, func);
   if (parent == root)
     return NULL;
   else
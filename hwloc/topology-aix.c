@@ -863,6 +863,7 @@ static struct hwloc_disc_component hwloc_aix_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_aix_component_instantiate,
   50,
+  0,
   NULL
 };
 
@@ -295,6 +295,7 @@ static struct hwloc_disc_component hwloc_darwin_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_darwin_component_instantiate,
   50,
+  0,
   NULL
 };
 
@@ -242,6 +242,7 @@ static struct hwloc_disc_component hwloc_freebsd_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_freebsd_component_instantiate,
   50,
+  0,
   NULL
 };
 
@@ -300,6 +300,7 @@ static struct hwloc_disc_component hwloc_hpux_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_hpux_component_instantiate,
   50,
+  0,
   NULL
 };
 
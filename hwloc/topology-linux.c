@@ -36,6 +36,7 @@
 #include <pthread.h>
 #include <sys/mman.h>
 #include <sys/syscall.h>
+#include <sys/uio.h>
 #include <mntent.h>
 
 struct hwloc_linux_backend_data_s {
@@ -58,6 +59,7 @@ struct hwloc_linux_backend_data_s {
   struct utsname utsname; /* fields contain \0 when unknown */
   unsigned fallback_nbprocessors;
   unsigned pagesize;
+  int dump_fd; /* HWLOC_DUMP_ACCESSED_FILES file where accessed paths are recorded for hwloc-gather-fsroot, or -1 */
 };
 
 
@@ -294,8 +296,28 @@ static __hwloc_inline long hwloc_move_pages(int pid, unsigned long count, void *
 #ifdef HAVE_OPENAT
 /* Use our own filesystem functions if we have openat */
 
+/* Paths accessed by the backend are appended to the file given in
+ * HWLOC_DUMP_ACCESSED_FILES, opened once by the backend as dump_fd,
+ * so that hwloc-gather-fsroot only saves what the backend actually reads.
+ */
+static void
+hwloc_linux_record_access(const char *path, int dump_fd)
+{
+  struct iovec iov[2];
+
+  if (dump_fd < 0)
+    return;
+  /* a single write per line so that lines are never mixed */
+  iov[0].iov_base = (void *) path;
+  iov[0].iov_len = strlen(path);
+  iov[1].iov_base = (void *) "\n";
+  iov[1].iov_len = 1;
+  if (writev(dump_fd, iov, 2) < 0)
+    hwloc_debug("Failed to record access to %s\n", path);
+}
+
 static const char *
-hwloc_checkat(const char *path, int fsroot_fd)
+hwloc_checkat(const char *path, int fsroot_fd, int dump_fd)
 {
   const char *relative_path;
   if (fsroot_fd < 0) {
@@ -303,6 +325,8 @@ hwloc_checkat(const char *path, int fsroot_fd)
     return NULL;
   }
 
+  hwloc_linux_record_access(path, dump_fd);
+
   /* Skip leading slashes.  */
   for (relative_path = path; *relative_path == '/'; relative_path++);
 
@@ -310,11 +334,11 @@ hwloc_checkat(const char *path, int fsroot_fd)
 }
 
 static int
-hwloc_openat(const char *path, int fsroot_fd)
+hwloc_openat(const char *path, int fsroot_fd, int dump_fd)
 {
   const char *relative_path;
 
-  relative_path = hwloc_checkat(path, fsroot_fd);
+  relative_path = hwloc_checkat(path, fsroot_fd, dump_fd);
   if (!relative_path)
     return -1;
 
@@ -322,7 +346,7 @@ hwloc_openat(const char *path, int fsroot_fd)
 }
 
 static FILE *
-hwloc_fopenat(const char *path, const char *mode, int fsroot_fd)
+hwloc_fopenat(const char *path, const char *mode, int fsroot_fd, int dump_fd)
 {
   int fd;
 
@@ -331,7 +355,7 @@ hwloc_fopenat(const char *path, const char *mode, int fsroot_fd)
     return NULL;
   }
 
-  fd = hwloc_openat (path, fsroot_fd);
+  fd = hwloc_openat (path, fsroot_fd, dump_fd);
   if (fd == -1)
     return NULL;
 
@@ -339,11 +363,11 @@ hwloc_fopenat(const char *path, const char *mode, int fsroot_fd)
 }
 
 static int
-hwloc_accessat(const char *path, int mode, int fsroot_fd)
+hwloc_accessat(const char *path, int mode, int fsroot_fd, int dump_fd)
 {
   const char *relative_path;
 
-  relative_path = hwloc_checkat(path, fsroot_fd);
+  relative_path = hwloc_checkat(path, fsroot_fd, dump_fd);
   if (!relative_path)
     return -1;
 
@@ -351,11 +375,11 @@ hwloc_accessat(const char *path, int mode, int fsroot_fd)
 }
 
 static int
-hwloc_fstatat(const char *path, struct stat *st, int flags, int fsroot_fd)
+hwloc_fstatat(const char *path, struct stat *st, int flags, int fsroot_fd, int dump_fd)
 {
   const char *relative_path;
 
-  relative_path = hwloc_checkat(path, fsroot_fd);
+  relative_path = hwloc_checkat(path, fsroot_fd, dump_fd);
   if (!relative_path)
     return -1;
 
@@ -363,12 +387,12 @@ hwloc_fstatat(const char *path, struct stat *st, int flags, int fsroot_fd)
 }
 
 static DIR*
-hwloc_opendirat(const char *path, int fsroot_fd)
+hwloc_opendirat(const char *path, int fsroot_fd, int dump_fd)
 {
   int dir_fd;
   const char *relative_path;
 
-  relative_path = hwloc_checkat(path, fsroot_fd);
+  relative_path = hwloc_checkat(path, fsroot_fd, dump_fd);
   if (!relative_path)
     return NULL;
 
@@ -380,11 +404,11 @@ hwloc_opendirat(const char *path, int fsroot_fd)
 }
 
 static int
-hwloc_readlinkat(const char *path, char *buf, size_t buflen, int fsroot_fd)
+hwloc_readlinkat(const char *path, char *buf, size_t buflen, int fsroot_fd, int dump_fd)
 {
   const char *relative_path;
 
-  relative_path = hwloc_checkat(path, fsroot_fd);
+  relative_path = hwloc_checkat(path, fsroot_fd, dump_fd);
   if (!relative_path)
     return -1;
 
@@ -396,20 +420,20 @@ hwloc_readlinkat(const char *path, char *buf, size_t buflen, int fsroot_fd)
 /* Static inline version of fopen so that we can use openat if we have
    it, but still preserve compiler parameter checking */
 static __hwloc_inline int
-hwloc_open(const char *p, int d __hwloc_attribute_unused)
+hwloc_open(const char *p, int d __hwloc_attribute_unused, int dump_fd __hwloc_attribute_unused)
 {
 #ifdef HAVE_OPENAT
-    return hwloc_openat(p, d);
+    return hwloc_openat(p, d, dump_fd);
 #else
     return open(p, O_RDONLY);
 #endif
 }
 
 static __hwloc_inline FILE *
-hwloc_fopen(const char *p, const char *m, int d __hwloc_attribute_unused)
+hwloc_fopen(const char *p, const char *m, int d __hwloc_attribute_unused, int dump_fd __hwloc_attribute_unused)
 {
 #ifdef HAVE_OPENAT
-    return hwloc_fopenat(p, m, d);
+    return hwloc_fopenat(p, m, d, dump_fd);
 #else
     return fopen(p, m);
 #endif
@@ -418,30 +442,30 @@ hwloc_fopen(const char *p, const char *m, int d __hwloc_attribute_unused)
 /* Static inline version of access so that we can use openat if we have
    it, but still preserve compiler parameter checking */
 static __hwloc_inline int
-hwloc_access(const char *p, int m, int d __hwloc_attribute_unused)
+hwloc_access(const char *p, int m, int d __hwloc_attribute_unused, int dump_fd __hwloc_attribute_unused)
 {
 #ifdef HAVE_OPENAT
-    return hwloc_accessat(p, m, d);
+    return hwloc_accessat(p, m, d, dump_fd);
 #else
     return access(p, m);
 #endif
 }
 
 static __hwloc_inline int
-hwloc_stat(const char *p, struct stat *st, int d __hwloc_attribute_unused)
+hwloc_stat(const char *p, struct stat *st, int d __hwloc_attribute_unused, int dump_fd __hwloc_attribute_unused)
 {
 #ifdef HAVE_OPENAT
-    return hwloc_fstatat(p, st, 0, d);
+    return hwloc_fstatat(p, st, 0, d, dump_fd);
 #else
     return stat(p, st);
 #endif
 }
 
 static __hwloc_inline int
-hwloc_lstat(const char *p, struct stat *st, int d __hwloc_attribute_unused)
+hwloc_lstat(const char *p, struct stat *st, int d __hwloc_attribute_unused, int dump_fd __hwloc_attribute_unused)
 {
 #ifdef HAVE_OPENAT
-    return hwloc_fstatat(p, st, AT_SYMLINK_NOFOLLOW, d);
+    return hwloc_fstatat(p, st, AT_SYMLINK_NOFOLLOW, d, dump_fd);
 #else
     return lstat(p, st);
 #endif
@@ -450,20 +474,20 @@ hwloc_lstat(const char *p, struct stat *st, int d __hwloc_attribute_unused)
 /* Static inline version of opendir so that we can use openat if we have
    it, but still preserve compiler parameter checking */
 static __hwloc_inline DIR *
-hwloc_opendir(const char *p, int d __hwloc_attribute_unused)
+hwloc_opendir(const char *p, int d __hwloc_attribute_unused, int dump_fd __hwloc_attribute_unused)
 {
 #ifdef HAVE_OPENAT
-    return hwloc_opendirat(p, d);
+    return hwloc_opendirat(p, d, dump_fd);
 #else
     return opendir(p);
 #endif
 }
 
 static __hwloc_inline int
-hwloc_readlink(const char *p, char *l, size_t ll, int d __hwloc_attribute_unused)
+hwloc_readlink(const char *p, char *l, size_t ll, int d __hwloc_attribute_unused, int dump_fd __hwloc_attribute_unused)
 {
 #ifdef HAVE_OPENAT
-  return hwloc_readlinkat(p, l, ll, d);
+  return hwloc_readlinkat(p, l, ll, d, dump_fd);
 #else
   return readlink(p, l, ll);
 #endif
@@ -584,7 +608,7 @@ static int
 hwloc_linux_find_kernel_nr_cpus(hwloc_topology_t topology)
 {
   static int _nr_cpus = -1;
-  int nr_cpus = _nr_cpus;
+  int nr_cpus = hwloc_atomic_load_int(&_nr_cpus);
   FILE *possible;
 
   if (nr_cpus != -1)
@@ -619,9 +643,11 @@ hwloc_linux_find_kernel_nr_cpus(hwloc_topology_t topology)
     int err = sched_getaffinity(0, setsize, set); /* always works, unless setsize is too small */
     CPU_FREE(set);
     nr_cpus = setsize * 8; /* that's the value that was actually tested */
-    if (!err)
+    if (!err) {
       /* found it */
-      return _nr_cpus = nr_cpus;
+      hwloc_atomic_store_int(&_nr_cpus, nr_cpus);
+      return nr_cpus;
+    }
     nr_cpus *= 2;
   }
 }
@@ -1213,6 +1239,277 @@ hwloc_linux_get_tid_last_cpu_location(hwloc_topology_t topology __hwloc_attribut
   return 0;
 }
 
+/* kernel mempolicy names as printed in numa_maps, longest names first when they share a prefix */
+static const struct hwloc_linux_numa_maps_policy_s {
+  const char *name;
+  hwloc_membind_policy_t policy;
+  int flags;
+} hwloc_linux_numa_maps_policies[] = {
+  { "default", HWLOC_MEMBIND_DEFAULT, 0 },
+  { "local", HWLOC_MEMBIND_FIRSTTOUCH, 0 },
+  { "prefer (many)", HWLOC_MEMBIND_BIND, 0 },
+  { "prefer", HWLOC_MEMBIND_BIND, 0 },
+  { "bind", HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_STRICT },
+  { "weighted interleave", HWLOC_MEMBIND_INTERLEAVE, 0 },
+  { "interleave", HWLOC_MEMBIND_INTERLEAVE, 0 },
+};
+
+/* parse "<policy>[=<modeflags>][:<nodelist>]" and return a pointer to what follows */
+static char *
+hwloc_linux_parse_numa_maps_policy(char *tmp, struct hwloc_linux_numa_map_s *map)
+{
+  char *end;
+  unsigned i;
+
+  map->policy = HWLOC_MEMBIND_MIXED;
+  map->policy_flags = 0;
+  for(i=0; i<sizeof(hwloc_linux_numa_maps_policies)/sizeof(*hwloc_linux_numa_maps_policies); i++) {
+    const struct hwloc_linux_numa_maps_policy_s *p = &hwloc_linux_numa_maps_policies[i];
+    size_t len = strlen(p->name);
+    if (!strncmp(tmp, p->name, len)
+	&& (tmp[len] == '=' || tmp[len] == ':' || tmp[len] == ' ' || tmp[len] == '\0')) {
+      map->policy = p->policy;
+      map->policy_flags = p->flags;
+      tmp += len;
+      break;
+    }
+  }
+
+  /* unknown policy names and mode flags such as =static are ignored */
+  end = tmp + strcspn(tmp, " ");
+  tmp = strchr(tmp, ':');
+  if (tmp && tmp < end) {
+    char saved = *end;
+    *end = '\0';
+    hwloc_bitmap_list_sscanf(map->policy_nodeset, tmp+1);
+    *end = saved;
+  }
+  return end;
+}
+
+/* fields that the kernel may print after the mapped file path */
+static int
+hwloc_linux_numa_maps_is_field(const char *token)
+{
+  static const char *keys[] = { "anon=", "dirty=", "mapped=", "mapmax=", "swapcache=",
+				"active=", "writeback=", "kernelpagesize_kB=" };
+  unsigned i;
+
+  if (!strcmp(token, "huge"))
+    return 1;
+  if (token[0] == 'N' && token[1] >= '0' && token[1] <= '9')
+    return strchr(token, '=') != NULL;
+  for(i = 0; i < sizeof(keys)/sizeof(*keys); i++)
+    if (!strncmp(token, keys[i], strlen(keys[i])))
+      return 1;
+  return 0;
+}
+
+/* extract the path that follows file=, it may contain spaces,
+ * and the kernel escapes some characters as \ooo octal sequences.
+ * return a pointer to the following fields.
+ */
+static char *
+hwloc_linux_parse_numa_maps_file(char *path, struct hwloc_linux_numa_map_s *map)
+{
+  char *end = path + strlen(path);
+  char *src, *dst;
+
+  /* the path ends where the trailing known fields start */
+  while (end > path) {
+    char *space = end - 1;
+    char saved = *end;
+    int field;
+    while (space > path && *space != ' ')
+      space--;
+    if (*space != ' ')
+      break;
+    *end = '\0';
+    field = hwloc_linux_numa_maps_is_field(space+1);
+    *end = saved;
+    if (!field)
+      break;
+    end = space;
+  }
+
+  free(map->name);
+  map->name = malloc(end - path + 1);
+  if (!map->name)
+    return NULL;
+  for(src = path, dst = map->name; src < end; ) {
+    if (src[0] == '\\' && end - src >= 4
+	&& src[1] >= '0' && src[1] <= '3'
+	&& src[2] >= '0' && src[2] <= '7'
+	&& src[3] >= '0' && src[3] <= '7') {
+      *(dst++) = (char) (((src[1]-'0') << 6) | ((src[2]-'0') << 3) | (src[3]-'0'));
+      src += 4;
+    } else {
+      *(dst++) = *(src++);
+    }
+  }
+  *dst = '\0';
+  return end;
+}
+
+static int
+hwloc_linux_parse_numa_maps_line(char *line, struct hwloc_linux_numa_map_s *map)
+{
+  char *tmp, *next;
+
+  map->start = strtoul(line, &tmp, 16);
+  if (tmp == line || *tmp != ' ')
+    /* invalid line */
+    return 1;
+  tmp = hwloc_linux_parse_numa_maps_policy(tmp+1, map);
+
+  for( ; *tmp; tmp = next) {
+    unsigned node;
+    unsigned long value;
+
+    while (*tmp == ' ')
+      tmp++;
+    if (!strncmp(tmp, "file=", 5)) {
+      next = hwloc_linux_parse_numa_maps_file(tmp+5, map);
+      if (!next)
+	return -1;
+      continue;
+    }
+    next = tmp + strcspn(tmp, " ");
+    if (*next)
+      *(next++) = '\0';
+
+    if (!strcmp(tmp, "heap") || !strncmp(tmp, "stack", 5)) {
+      free(map->name);
+      map->name = strdup(tmp[0] == 'h' ? "heap" : "stack");
+    } else if (sscanf(tmp, "kernelpagesize_kB=%lu", &value) == 1) {
+      map->page_size = value << 10;
+    } else if (sscanf(tmp, "N%u=%lu", &node, &value) == 2) {
+      if (node >= map->nr_node_pages) {
+	unsigned long *tmppages = realloc(map->node_pages, (node+1) * sizeof(*map->node_pages));
+	if (!tmppages)
+	  return -1;
+	memset(tmppages + map->nr_node_pages, 0, (node+1-map->nr_node_pages) * sizeof(*tmppages));
+	map->node_pages = tmppages;
+	map->nr_node_pages = node+1;
+      }
+      map->node_pages[node] += value;
+      map->nr_pages += value;
+    }
+  }
+  return 0;
+}
+
+void
+hwloc_linux_free_proc_numa_maps(struct hwloc_linux_numa_map_s *maps, unsigned nr)
+{
+  unsigned i;
+  for(i=0; i<nr; i++) {
+    hwloc_bitmap_free(maps[i].policy_nodeset);
+    free(maps[i].node_pages);
+    free(maps[i].name);
+  }
+  free(maps);
+}
+
+int
+hwloc_linux_get_proc_numa_maps(hwloc_topology_t topology __hwloc_attribute_unused, pid_t pid,
+			       struct hwloc_linux_numa_map_s **mapsp, unsigned *nrp,
+			       unsigned long flags)
+{
+  struct hwloc_linux_numa_map_s *maps = NULL;
+  unsigned nr = 0, allocated = 0;
+  unsigned long pagesize = hwloc_getpagesize();
+  size_t linelen = 256;
+  char *line;
+  char path[64];
+  FILE *file;
+  int err;
+
+  if (flags) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (pid)
+    snprintf(path, sizeof(path), "/proc/%lu/numa_maps", (unsigned long) pid);
+  else
+    strcpy(path, "/proc/self/numa_maps");
+  file = fopen(path, "r");
+  if (!file) {
+    if (errno == ENOENT) {
+      /* tell a missing process from a kernel without numa_maps */
+      *strrchr(path, '/') = '\0';
+      errno = access(path, F_OK) < 0 ? ESRCH : ENOSYS;
+    }
+    return -1;
+  }
+
+  line = malloc(linelen);
+  if (!line)
+    goto out_with_file;
+
+  while (fgets(line, linelen, file)) {
+    struct hwloc_linux_numa_map_s *map;
+    size_t len = strlen(line);
+
+    /* mapped file paths may be long, read the entire line */
+    while (len == linelen-1 && line[len-1] != '\n') {
+      char *tmp = realloc(line, 2*linelen);
+      if (!tmp)
+	goto out_with_maps;
+      line = tmp;
+      linelen *= 2;
+      if (!fgets(line+len, linelen-len, file))
+	break;
+      len += strlen(line+len);
+    }
+    if (len && line[len-1] == '\n')
+      line[--len] = '\0';
+
+    if (nr == allocated) {
+      unsigned newallocated = allocated ? 2*allocated : 64;
+      struct hwloc_linux_numa_map_s *tmp = realloc(maps, newallocated * sizeof(*maps));
+      if (!tmp)
+	goto out_with_maps;
+      maps = tmp;
+      allocated = newallocated;
+    }
+
+    map = &maps[nr];
+    memset(map, 0, sizeof(*map));
+    map->page_size = pagesize;
+    map->policy_nodeset = hwloc_bitmap_alloc();
+    if (!map->policy_nodeset)
+      goto out_with_maps;
+    nr++;
+
+    err = hwloc_linux_parse_numa_maps_line(line, map);
+    if (err < 0)
+      goto out_with_maps;
+    if (err > 0) {
+      /* ignore invalid lines */
+      hwloc_bitmap_free(map->policy_nodeset);
+      free(map->node_pages);
+      free(map->name);
+      nr--;
+    }
+  }
+
+  free(line);
+  fclose(file);
+  *mapsp = maps;
+  *nrp = nr;
+  return 0;
+
+ out_with_maps:
+  hwloc_linux_free_proc_numa_maps(maps, nr);
+  free(line);
+ out_with_file:
+  fclose(file);
+  errno = ENOMEM;
+  return -1;
+}
+
 /* Per-tid proc_get_last_cpu_location callback data, callback function and caller */
 struct hwloc_linux_foreach_proc_tid_get_last_cpu_location_cb_data_s {
   hwloc_bitmap_t cpuset;
@@ -1487,22 +1784,27 @@ hwloc_linux_set_thisthread_membind(hwloc_topology_t topology, hwloc_const_nodese
 static int
 hwloc_linux_find_kernel_max_numnodes(hwloc_topology_t topology __hwloc_attribute_unused)
 {
-  static int max_numnodes = -1;
+  static int _max_numnodes = -1;
+  int max_numnodes = hwloc_atomic_load_int(&_max_numnodes);
   int linuxpolicy;
 
   if (max_numnodes != -1)
     /* already computed */
     return max_numnodes;
 
-  /* start with a single ulong, it's the minimal and it's enough for most machines */
+  /* start with a single ulong, it's the minimal and it's enough for most machines.
+   * only publish the final value so that concurrent callers never see a too small one.
+   */
   max_numnodes = HWLOC_BITS_PER_LONG;
   while (1) {
     unsigned long *mask = malloc(max_numnodes / HWLOC_BITS_PER_LONG * sizeof(long));
     int err = hwloc_get_mempolicy(&linuxpolicy, mask, max_numnodes, 0, 0);
     free(mask);
-    if (!err || errno != EINVAL)
+    if (!err || errno != EINVAL) {
       /* found it */
+      hwloc_atomic_store_int(&_max_numnodes, max_numnodes);
       return max_numnodes;
+    }
     max_numnodes *= 2;
   }
 }
@@ -1737,12 +2039,12 @@ struct hwloc_linux_cpuinfo_proc {
 };
 
 static int
-hwloc_parse_sysfs_unsigned(const char *mappath, unsigned *value, int fsroot_fd)
+hwloc_parse_sysfs_unsigned(const char *mappath, unsigned *value, int fsroot_fd, int dump_fd)
 {
   char string[11];
   FILE * fd;
 
-  fd = hwloc_fopen(mappath, "r", fsroot_fd);
+  fd = hwloc_fopen(mappath, "r", fsroot_fd, dump_fd);
   if (!fd) {
     *value = -1;
     return -1;
@@ -1771,7 +2073,8 @@ hwloc_linux_parse_cpumap_file(FILE *file, hwloc_bitmap_t set)
   unsigned long *maps;
   unsigned long map;
   int nr_maps = 0;
-  static int nr_maps_allocated = 8; /* only compute the power-of-two above the kernel cpumask size once */
+  static int _nr_maps_allocated = 8; /* only compute the power-of-two above the kernel cpumask size once */
+  int nr_maps_allocated = hwloc_atomic_load_int(&_nr_maps_allocated); /* local copy, other threads may be parsing too */
   int i;
 
   maps = malloc(nr_maps_allocated * sizeof(*maps));
@@ -1819,16 +2122,20 @@ hwloc_linux_parse_cpumap_file(FILE *file, hwloc_bitmap_t set)
 
   free(maps);
 
+  /* only grow the shared value, another thread may have grown it meanwhile */
+  if (nr_maps_allocated > hwloc_atomic_load_int(&_nr_maps_allocated))
+    hwloc_atomic_store_int(&_nr_maps_allocated, nr_maps_allocated);
+
   return 0;
 }
 
 static hwloc_bitmap_t
-hwloc_parse_cpumap(const char *mappath, int fsroot_fd)
+hwloc_parse_cpumap(const char *mappath, int fsroot_fd, int dump_fd)
 {
   hwloc_bitmap_t set;
   FILE * file;
 
-  file = hwloc_fopen(mappath, "r", fsroot_fd);
+  file = hwloc_fopen(mappath, "r", fsroot_fd, dump_fd);
   if (!file)
     return NULL;
 
@@ -1840,7 +2147,7 @@ hwloc_parse_cpumap(const char *mappath, int fsroot_fd)
 }
 
 static void
-hwloc_find_linux_cpuset_mntpnt(char **cgroup_mntpnt, char **cpuset_mntpnt, const char *root_path)
+hwloc_find_linux_cpuset_mntpnt(char **cgroup_mntpnt, char **cpuset_mntpnt, const char *root_path, int dump_fd __hwloc_attribute_unused)
 {
   char *mount_path;
   struct mntent mntent;
@@ -1862,6 +2169,9 @@ hwloc_find_linux_cpuset_mntpnt(char **cgroup_mntpnt, char **cpuset_mntpnt, const
   } else {
     fd = setmntent("/proc/mounts", "r");
   }
+#ifdef HAVE_OPENAT
+  hwloc_linux_record_access("/proc/mounts", dump_fd);
+#endif
   if (!fd)
     return;
 
@@ -1917,7 +2227,7 @@ hwloc_find_linux_cpuset_mntpnt(char **cgroup_mntpnt, char **cpuset_mntpnt, const
  * containing <name>.
  */
 static char *
-hwloc_read_linux_cpuset_name(int fsroot_fd, hwloc_pid_t pid)
+hwloc_read_linux_cpuset_name(int fsroot_fd, int dump_fd, hwloc_pid_t pid)
 {
 #define CPUSET_NAME_LEN 128
   char cpuset_name[CPUSET_NAME_LEN];
@@ -1926,11 +2236,11 @@ hwloc_read_linux_cpuset_name(int fsroot_fd, hwloc_pid_t pid)
 
   /* check whether a cgroup-cpuset is enabled */
   if (!pid)
-    fd = hwloc_fopen("/proc/self/cgroup", "r", fsroot_fd);
+    fd = hwloc_fopen("/proc/self/cgroup", "r", fsroot_fd, dump_fd);
   else {
     char path[] = "/proc/XXXXXXXXXX/cgroup";
     snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
-    fd = hwloc_fopen(path, "r", fsroot_fd);
+    fd = hwloc_fopen(path, "r", fsroot_fd, dump_fd);
   }
   if (fd) {
     /* find a cpuset line */
@@ -1956,11 +2266,11 @@ hwloc_read_linux_cpuset_name(int fsroot_fd, hwloc_pid_t pid)
 
   /* check whether a cpuset is enabled */
   if (!pid)
-    fd = hwloc_fopen("/proc/self/cpuset", "r", fsroot_fd);
+    fd = hwloc_fopen("/proc/self/cpuset", "r", fsroot_fd, dump_fd);
   else {
     char path[] = "/proc/XXXXXXXXXX/cpuset";
     snprintf(path, sizeof(path), "/proc/%d/cpuset", pid);
-    fd = hwloc_fopen(path, "r", fsroot_fd);
+    fd = hwloc_fopen(path, "r", fsroot_fd, dump_fd);
   }
   if (!fd) {
     /* found nothing */
@@ -1986,7 +2296,7 @@ hwloc_read_linux_cpuset_name(int fsroot_fd, hwloc_pid_t pid)
  * are cgroup<name>/cpuset.{cpus,mems} or cpuset<name>/{cpus,mems} files.
  */
 static char *
-hwloc_read_linux_cpuset_mask(const char *cgroup_mntpnt, const char *cpuset_mntpnt, const char *cpuset_name, const char *attr_name, int fsroot_fd)
+hwloc_read_linux_cpuset_mask(const char *cgroup_mntpnt, const char *cpuset_mntpnt, const char *cpuset_name, const char *attr_name, int fsroot_fd, int dump_fd)
 {
 #define CPUSET_FILENAME_LEN 256
   char cpuset_filename[CPUSET_FILENAME_LEN];
@@ -1999,14 +2309,14 @@ hwloc_read_linux_cpuset_mask(const char *cgroup_mntpnt, const char *cpuset_mntpn
     /* try to read the cpuset from cgroup */
     snprintf(cpuset_filename, CPUSET_FILENAME_LEN, "%s%s/cpuset.%s", cgroup_mntpnt, cpuset_name, attr_name);
     hwloc_debug("Trying to read cgroup file <%s>\n", cpuset_filename);
-    fd = hwloc_fopen(cpuset_filename, "r", fsroot_fd);
+    fd = hwloc_fopen(cpuset_filename, "r", fsroot_fd, dump_fd);
     if (fd)
       goto gotfile;
   } else if (cpuset_mntpnt) {
     /* try to read the cpuset directly */
     snprintf(cpuset_filename, CPUSET_FILENAME_LEN, "%s%s/%s", cpuset_mntpnt, cpuset_name, attr_name);
     hwloc_debug("Trying to read cpuset file <%s>\n", cpuset_filename);
-    fd = hwloc_fopen(cpuset_filename, "r", fsroot_fd);
+    fd = hwloc_fopen(cpuset_filename, "r", fsroot_fd, dump_fd);
     if (fd)
       goto gotfile;
   }
@@ -2043,7 +2353,7 @@ hwloc_admin_disable_set_from_cpuset(struct hwloc_linux_backend_data_s *data,
   hwloc_bitmap_t tmpset;
 
   cpuset_mask = hwloc_read_linux_cpuset_mask(cgroup_mntpnt, cpuset_mntpnt, cpuset_name,
-					     attr_name, data->root_fd);
+					     attr_name, data->root_fd, data->dump_fd);
   if (!cpuset_mask)
     return;
 
@@ -2086,6 +2396,50 @@ hwloc_admin_disable_set_from_cpuset(struct hwloc_linux_backend_data_s *data,
   free(cpuset_mask);
 }
 
+/* Remove the cpus and mems that are not in the cgroup/cpuset of the target process
+ * from the allowed sets of the root object.
+ * Return the cpuset name if any, it must be freed by the caller.
+ */
+static char *
+hwloc_linux__get_allowed_resources(struct hwloc_topology *topology, struct hwloc_linux_backend_data_s *data)
+{
+  char *cpuset_mntpnt, *cgroup_mntpnt, *cpuset_name = NULL;
+
+  hwloc_find_linux_cpuset_mntpnt(&cgroup_mntpnt, &cpuset_mntpnt, data->root_path, data->dump_fd);
+  if (cgroup_mntpnt || cpuset_mntpnt) {
+    cpuset_name = hwloc_read_linux_cpuset_name(data->root_fd, data->dump_fd, topology->pid);
+    if (cpuset_name) {
+      hwloc_admin_disable_set_from_cpuset(data, cgroup_mntpnt, cpuset_mntpnt, cpuset_name, "cpus", topology->levels[0][0]->allowed_cpuset);
+      hwloc_admin_disable_set_from_cpuset(data, cgroup_mntpnt, cpuset_mntpnt, cpuset_name, "mems", topology->levels[0][0]->allowed_nodeset);
+    }
+    free(cgroup_mntpnt);
+    free(cpuset_mntpnt);
+  }
+  return cpuset_name;
+}
+
+void
+hwloc_linux_restrict_allowed_resources(struct hwloc_topology *topology)
+{
+  struct hwloc_linux_backend_data_s data;
+
+  memset(&data, 0, sizeof(data));
+  data.dump_fd = -1;
+#ifdef HAVE_OPENAT
+  data.root_fd = open("/", O_RDONLY | O_DIRECTORY);
+  if (data.root_fd < 0)
+    return;
+#else
+  data.root_fd = -1;
+#endif
+
+  free(hwloc_linux__get_allowed_resources(topology, &data));
+
+#ifdef HAVE_OPENAT
+  close(data.root_fd);
+#endif
+}
+
 static void
 hwloc_parse_meminfo_info(struct hwloc_linux_backend_data_s *data,
 			 const char *path,
@@ -2098,7 +2452,7 @@ hwloc_parse_meminfo_info(struct hwloc_linux_backend_data_s *data,
   char string[64];
   FILE *fd;
 
-  fd = hwloc_fopen(path, "r", data->root_fd);
+  fd = hwloc_fopen(path, "r", data->root_fd, data->dump_fd);
   if (!fd)
     return;
 
@@ -2139,14 +2493,14 @@ hwloc_parse_hugepages_info(struct hwloc_linux_backend_data_s *data,
   char line[64];
   char path[SYSFS_NUMA_NODE_PATH_LEN];
 
-  dir = hwloc_opendir(dirpath, data->root_fd);
+  dir = hwloc_opendir(dirpath, data->root_fd, data->dump_fd);
   if (dir) {
     while ((dirent = readdir(dir)) != NULL) {
       if (strncmp(dirent->d_name, "hugepages-", 10))
         continue;
       memory->page_types[index_].size = strtoul(dirent->d_name+10, NULL, 0) * 1024ULL;
       sprintf(path, "%s/%s/nr_hugepages", dirpath, dirent->d_name);
-      hpfd = hwloc_fopen(path, "r", data->root_fd);
+      hpfd = hwloc_fopen(path, "r", data->root_fd, data->dump_fd);
       if (hpfd) {
         if (fgets(line, sizeof(line), hpfd)) {
           /* these are the actual total amount of huge pages */
@@ -2174,7 +2528,7 @@ hwloc_get_procfs_meminfo_info(struct hwloc_topology *topology,
   int types = 2;
   int err;
 
-  err = hwloc_stat("/sys/kernel/mm/hugepages", &st, data->root_fd);
+  err = hwloc_stat("/sys/kernel/mm/hugepages", &st, data->root_fd, data->dump_fd);
   if (!err) {
     types = 1 + st.st_nlink-2;
     has_sysfs_hugepages = 1;
@@ -2248,7 +2602,7 @@ hwloc_sysfs_node_meminfo_info(struct hwloc_topology *topology,
   int err;
 
   sprintf(path, "%s/node%d/hugepages", syspath, node);
-  err = hwloc_stat(path, &st, data->root_fd);
+  err = hwloc_stat(path, &st, data->root_fd, data->dump_fd);
   if (!err) {
     types = 1 + st.st_nlink-2;
     has_sysfs_hugepages = 1;
@@ -2292,13 +2646,13 @@ hwloc_sysfs_node_meminfo_info(struct hwloc_topology *topology,
 }
 
 static void
-hwloc_parse_node_distance(const char *distancepath, unsigned nbnodes, uint64_t *distances, int fsroot_fd)
+hwloc_parse_node_distance(const char *distancepath, unsigned nbnodes, uint64_t *distances, int fsroot_fd, int dump_fd)
 {
   char string[4096]; /* enough for hundreds of nodes */
   char *tmp, *next;
   FILE * fd;
 
-  fd = hwloc_fopen(distancepath, "r", fsroot_fd);
+  fd = hwloc_fopen(distancepath, "r", fsroot_fd, dump_fd);
   if (!fd)
     return;
 
@@ -2334,7 +2688,7 @@ hwloc__get_dmi_id_one_info(struct hwloc_linux_backend_data_s *data,
   FILE *fd;
 
   strcpy(path+pathlen, dmi_name);
-  fd = hwloc_fopen(path, "r", data->root_fd);
+  fd = hwloc_fopen(path, "r", data->root_fd, data->dump_fd);
   if (!fd)
     return;
 
@@ -2359,12 +2713,12 @@ hwloc__get_dmi_id_info(struct hwloc_linux_backend_data_s *data, hwloc_obj_t obj)
   DIR *dir;
 
   strcpy(path, "/sys/devices/virtual/dmi/id");
-  dir = hwloc_opendir(path, data->root_fd);
+  dir = hwloc_opendir(path, data->root_fd, data->dump_fd);
   if (dir) {
     pathlen = 27;
   } else {
     strcpy(path, "/sys/class/dmi/id");
-    dir = hwloc_opendir(path, data->root_fd);
+    dir = hwloc_opendir(path, data->root_fd, data->dump_fd);
     if (dir)
       pathlen = 17;
     else
@@ -2402,7 +2756,7 @@ hwloc__get_dmi_id_info(struct hwloc_linux_backend_data_s *data, hwloc_obj_t obj)
 /* Reads the entire file and returns bytes read if bytes_read != NULL
  * Returned pointer can be freed by using free().  */
 static void *
-hwloc_read_raw(const char *p, const char *p1, size_t *bytes_read, int root_fd)
+hwloc_read_raw(const char *p, const char *p1, size_t *bytes_read, int root_fd, int dump_fd)
 {
   char fname[256];
   char *ret = NULL;
@@ -2411,7 +2765,7 @@ hwloc_read_raw(const char *p, const char *p1, size_t *bytes_read, int root_fd)
 
   snprintf(fname, sizeof(fname), "%s/%s", p, p1);
 
-  file = hwloc_open(fname, root_fd);
+  file = hwloc_open(fname, root_fd, dump_fd);
   if (-1 == file) {
       goto out_no_close;
   }
@@ -2440,10 +2794,10 @@ hwloc_read_raw(const char *p, const char *p1, size_t *bytes_read, int root_fd)
 /* Reads the entire file and returns it as a 0-terminated string
  * Returned pointer can be freed by using free().  */
 static char *
-hwloc_read_str(const char *p, const char *p1, int root_fd)
+hwloc_read_str(const char *p, const char *p1, int root_fd, int dump_fd)
 {
   size_t cb = 0;
-  char *ret = hwloc_read_raw(p, p1, &cb, root_fd);
+  char *ret = hwloc_read_raw(p, p1, &cb, root_fd, dump_fd);
   if ((NULL != ret) && (0 < cb) && (0 != ret[cb-1])) {
     char *tmp = realloc(ret, cb + 1);
     if (!tmp) {
@@ -2458,10 +2812,10 @@ hwloc_read_str(const char *p, const char *p1, int root_fd)
 
 /* Reads first 32bit bigendian value */
 static ssize_t
-hwloc_read_unit32be(const char *p, const char *p1, uint32_t *buf, int root_fd)
+hwloc_read_unit32be(const char *p, const char *p1, uint32_t *buf, int root_fd, int dump_fd)
 {
   size_t cb = 0;
-  uint32_t *tmp = hwloc_read_raw(p, p1, &cb, root_fd);
+  uint32_t *tmp = hwloc_read_raw(p, p1, &cb, root_fd, dump_fd);
   if (sizeof(*buf) != cb) {
     errno = EINVAL;
     free(tmp); /* tmp is either NULL or contains useless things */
@@ -2589,20 +2943,20 @@ try_add_cache_from_device_tree_cpu(struct hwloc_topology *topology,
   int unified;
 
   snprintf(unified_path, sizeof(unified_path), "%s/cache-unified", cpu);
-  unified = (hwloc_stat(unified_path, &statbuf, data->root_fd) == 0);
+  unified = (hwloc_stat(unified_path, &statbuf, data->root_fd, data->dump_fd) == 0);
 
   hwloc_read_unit32be(cpu, "d-cache-line-size", &d_cache_line_size,
-      data->root_fd);
+      data->root_fd, data->dump_fd);
   hwloc_read_unit32be(cpu, "d-cache-size", &d_cache_size,
-      data->root_fd);
+      data->root_fd, data->dump_fd);
   hwloc_read_unit32be(cpu, "d-cache-sets", &d_cache_sets,
-      data->root_fd);
+      data->root_fd, data->dump_fd);
   hwloc_read_unit32be(cpu, "i-cache-line-size", &i_cache_line_size,
-      data->root_fd);
+      data->root_fd, data->dump_fd);
   hwloc_read_unit32be(cpu, "i-cache-size", &i_cache_size,
-      data->root_fd);
+      data->root_fd, data->dump_fd);
   hwloc_read_unit32be(cpu, "i-cache-sets", &i_cache_sets,
-      data->root_fd);
+      data->root_fd, data->dump_fd);
 
   if (!unified)
     try__add_cache_from_device_tree_cpu(topology, level, HWLOC_OBJ_CACHE_INSTRUCTION,
@@ -2623,7 +2977,8 @@ look_powerpc_device_tree(struct hwloc_topology *topology,
   const char ofroot[] = "/proc/device-tree/cpus";
   unsigned int i;
   int root_fd = data->root_fd;
-  DIR *dt = hwloc_opendir(ofroot, root_fd);
+  int dump_fd = data->dump_fd;
+  DIR *dt = hwloc_opendir(ofroot, root_fd, dump_fd);
   struct dirent *dirent;
 
   if (NULL == dt)
@@ -2647,16 +3002,16 @@ look_powerpc_device_tree(struct hwloc_topology *topology,
 
     snprintf(cpu, sizeof(cpu), "%s/%s", ofroot, dirent->d_name);
 
-    device_type = hwloc_read_str(cpu, "device_type", root_fd);
+    device_type = hwloc_read_str(cpu, "device_type", root_fd, dump_fd);
     if (NULL == device_type)
       continue;
 
-    hwloc_read_unit32be(cpu, "reg", &reg, root_fd);
-    if (hwloc_read_unit32be(cpu, "next-level-cache", &l2_cache, root_fd) == -1)
-      hwloc_read_unit32be(cpu, "l2-cache", &l2_cache, root_fd);
-    if (hwloc_read_unit32be(cpu, "phandle", &phandle, root_fd) == -1)
-      if (hwloc_read_unit32be(cpu, "ibm,phandle", &phandle, root_fd) == -1)
-        hwloc_read_unit32be(cpu, "linux,phandle", &phandle, root_fd);
+    hwloc_read_unit32be(cpu, "reg", &reg, root_fd, dump_fd);
+    if (hwloc_read_unit32be(cpu, "next-level-cache", &l2_cache, root_fd, dump_fd) == -1)
+      hwloc_read_unit32be(cpu, "l2-cache", &l2_cache, root_fd, dump_fd);
+    if (hwloc_read_unit32be(cpu, "phandle", &phandle, root_fd, dump_fd) == -1)
+      if (hwloc_read_unit32be(cpu, "ibm,phandle", &phandle, root_fd, dump_fd) == -1)
+        hwloc_read_unit32be(cpu, "linux,phandle", &phandle, root_fd, dump_fd);
 
     if (0 == strcmp(device_type, "cache")) {
       add_device_tree_cpus_node(&cpus, NULL, l2_cache, phandle, dirent->d_name);
@@ -2665,7 +3020,7 @@ look_powerpc_device_tree(struct hwloc_topology *topology,
       /* Found CPU */
       hwloc_bitmap_t cpuset = NULL;
       size_t cb = 0;
-      uint32_t *threads = hwloc_read_raw(cpu, "ibm,ppc-interrupt-server#s", &cb, root_fd);
+      uint32_t *threads = hwloc_read_raw(cpu, "ibm,ppc-interrupt-server#s", &cb, root_fd, dump_fd);
       uint32_t nthreads = cb / sizeof(threads[0]);
 
       if (NULL != threads) {
@@ -2774,7 +3129,7 @@ static int hwloc_linux_try_handle_knl_hwdata_properties(hwloc_topology_t topolog
     return -1;
 
   hwloc_debug("Reading knl cache data from: %s\n", knl_cache_file);
-  f = hwloc_fopen(knl_cache_file, "r", data->root_fd);
+  f = hwloc_fopen(knl_cache_file, "r", data->root_fd, data->dump_fd);
   if (!f) {
     hwloc_debug("Unable to open KNL data file `%s' (%s)\n", knl_cache_file, strerror(errno));
     free(knl_cache_file);
@@ -2888,7 +3243,7 @@ look_sysfsnode(struct hwloc_topology *topology,
   *found = 0;
 
   /* Get the list of nodes first */
-  dir = hwloc_opendir(path, data->root_fd);
+  dir = hwloc_opendir(path, data->root_fd, data->dump_fd);
   if (dir)
     {
       nodeset = hwloc_bitmap_alloc();
@@ -2957,7 +3312,7 @@ look_sysfsnode(struct hwloc_topology *topology,
 	  osnode = indexes[index_];
 
           sprintf(nodepath, "%s/node%u/cpumap", path, osnode);
-          cpuset = hwloc_parse_cpumap(nodepath, data->root_fd);
+          cpuset = hwloc_parse_cpumap(nodepath, data->root_fd, data->dump_fd);
           if (!cpuset) {
 	    /* This NUMA object won't be inserted, we'll ignore distances */
 	    failednodes++;
@@ -3019,7 +3374,7 @@ look_sysfsnode(struct hwloc_topology *topology,
 	  /* Linux nodeX/distance file contains distance from X to other localities (from ACPI SLIT table or so),
 	   * store them in slots X*N...X*N+N-1 */
           sprintf(nodepath, "%s/node%u/distance", path, osnode);
-          hwloc_parse_node_distance(nodepath, nbnodes, distances+index_*nbnodes, data->root_fd);
+          hwloc_parse_node_distance(nodepath, nbnodes, distances+index_*nbnodes, data->root_fd, data->dump_fd);
       }
 
       free(indexes);
@@ -3094,7 +3449,7 @@ look_sysfscpu(struct hwloc_topology *topology,
   int threadwithcoreid = data->is_amd15h ? -1 : 0; /* -1 means we don't know yet if threads have their own coreids within thread_siblings */
 
   /* fill the cpuset of interesting cpus */
-  dir = hwloc_opendir(path, data->root_fd);
+  dir = hwloc_opendir(path, data->root_fd, data->dump_fd);
   if (!dir)
     return -1;
   else {
@@ -3115,7 +3470,7 @@ look_sysfscpu(struct hwloc_topology *topology,
 
       /* check whether this processor is online */
       sprintf(str, "%s/cpu%lu/online", path, cpu);
-      fd = hwloc_fopen(str, "r", data->root_fd);
+      fd = hwloc_fopen(str, "r", data->root_fd, data->dump_fd);
       if (fd) {
 	if (fgets(online, sizeof(online), fd)) {
 	  if (!atoi(online)) {
@@ -3130,7 +3485,7 @@ look_sysfscpu(struct hwloc_topology *topology,
 
       /* check whether the kernel exports topology information for this cpu */
       sprintf(str, "%s/cpu%lu/topology", path, cpu);
-      if (hwloc_access(str, X_OK, data->root_fd) < 0 && errno == ENOENT) {
+      if (hwloc_access(str, X_OK, data->root_fd, data->dump_fd) < 0 && errno == ENOENT) {
 	hwloc_debug("os proc %lu has no accessible %s/cpu%lu/topology\n",
 		   cpu, path, cpu);
 	hwloc_bitmap_set(unknownset, cpu);
@@ -3156,10 +3511,10 @@ look_sysfscpu(struct hwloc_topology *topology,
       /* look at the package */
       mypackageid = 0; /* shut-up the compiler */
       sprintf(str, "%s/cpu%d/topology/physical_package_id", path, i);
-      hwloc_parse_sysfs_unsigned(str, &mypackageid, data->root_fd);
+      hwloc_parse_sysfs_unsigned(str, &mypackageid, data->root_fd, data->dump_fd);
 
       sprintf(str, "%s/cpu%d/topology/core_siblings", path, i);
-      packageset = hwloc_parse_cpumap(str, data->root_fd);
+      packageset = hwloc_parse_cpumap(str, data->root_fd, data->dump_fd);
       if (packageset
 	  && hwloc_filter_check_keep_object_type(topology, HWLOC_OBJ_PACKAGE)) {
        hwloc_bitmap_andnot(packageset, packageset, unknownset);
@@ -3177,7 +3532,7 @@ look_sysfscpu(struct hwloc_topology *topology,
 	       * merge these core_siblings to extend the existing first package object.
 	       */
 	      static int reported = 0;
-	      if (!reported && !hwloc_hide_errors()) {
+	      if (!hwloc_hide_errors() && !hwloc_test_and_set_flag(&reported)) {
 		char *a, *b;
 		hwloc_bitmap_asprintf(&a, curpackage->cpuset);
 		hwloc_bitmap_asprintf(&b, packageset);
@@ -3193,7 +3548,6 @@ look_sysfscpu(struct hwloc_topology *topology,
 		fprintf(stderr, "* please report this error message to the hwloc user's mailing list,\n");
 		fprintf(stderr, "* along with the output+tarball generated by the hwloc-gather-topology script.\n");
 		fprintf(stderr, "****************************************************************************\n");
-		reported = 1;
 		free(a);
 		free(b);
 	      }
@@ -3233,10 +3587,10 @@ package_done:
       /* look at the core */
       mycoreid = 0; /* shut-up the compiler */
       sprintf(str, "%s/cpu%d/topology/core_id", path, i);
-      hwloc_parse_sysfs_unsigned(str, &mycoreid, data->root_fd);
+      hwloc_parse_sysfs_unsigned(str, &mycoreid, data->root_fd, data->dump_fd);
 
       sprintf(str, "%s/cpu%d/topology/thread_siblings", path, i);
-      coreset = hwloc_parse_cpumap(str, data->root_fd);
+      coreset = hwloc_parse_cpumap(str, data->root_fd, data->dump_fd);
       if (coreset) {
        hwloc_bitmap_andnot(coreset, coreset, unknownset);
        if (hwloc_bitmap_weight(coreset) > 1 && threadwithcoreid == -1) {
@@ -3247,7 +3601,7 @@ package_done:
 	  siblingid = hwloc_bitmap_next(coreset, i);
 	siblingcoreid = mycoreid;
 	sprintf(str, "%s/cpu%d/topology/core_id", path, siblingid);
-	hwloc_parse_sysfs_unsigned(str, &siblingcoreid, data->root_fd);
+	hwloc_parse_sysfs_unsigned(str, &siblingcoreid, data->root_fd, data->dump_fd);
 	threadwithcoreid = (siblingcoreid != mycoreid);
        }
        if (hwloc_bitmap_first(coreset) == i || threadwithcoreid) {
@@ -3270,9 +3624,9 @@ package_done:
        /* look at the books */
        mybookid = 0; /* shut-up the compiler */
        sprintf(str, "%s/cpu%d/topology/book_id", path, i);
-       if (hwloc_parse_sysfs_unsigned(str, &mybookid, data->root_fd) == 0) {
+       if (hwloc_parse_sysfs_unsigned(str, &mybookid, data->root_fd, data->dump_fd) == 0) {
         sprintf(str, "%s/cpu%d/topology/book_siblings", path, i);
-        bookset = hwloc_parse_cpumap(str, data->root_fd);
+        bookset = hwloc_parse_cpumap(str, data->root_fd, data->dump_fd);
 	if (bookset) {
 	 hwloc_bitmap_andnot(bookset, bookset, unknownset);
          if (hwloc_bitmap_first(bookset) == i) {
@@ -3317,7 +3671,7 @@ package_done:
 
 	/* get the cache level depth */
 	sprintf(mappath, "%s/cpu%d/cache/index%d/level", path, i, j);
-	fd = hwloc_fopen(mappath, "r", data->root_fd);
+	fd = hwloc_fopen(mappath, "r", data->root_fd, data->dump_fd);
 	if (fd) {
 	  char *res = fgets(str2,sizeof(str2), fd);
 	  fclose(fd);
@@ -3330,7 +3684,7 @@ package_done:
 
 	/* cache type */
 	sprintf(mappath, "%s/cpu%d/cache/index%d/type", path, i, j);
-	fd = hwloc_fopen(mappath, "r", data->root_fd);
+	fd = hwloc_fopen(mappath, "r", data->root_fd, data->dump_fd);
 	if (fd) {
 	  if (fgets(str2, sizeof(str2), fd)) {
 	    fclose(fd);
@@ -3360,7 +3714,7 @@ package_done:
 
 	/* get the cache size */
 	sprintf(mappath, "%s/cpu%d/cache/index%d/size", path, i, j);
-	fd = hwloc_fopen(mappath, "r", data->root_fd);
+	fd = hwloc_fopen(mappath, "r", data->root_fd, data->dump_fd);
 	if (fd) {
 	  if (fgets(str2,sizeof(str2), fd))
 	    kB = atol(str2); /* in kB */
@@ -3374,7 +3728,7 @@ package_done:
 
 	/* get the line size */
 	sprintf(mappath, "%s/cpu%d/cache/index%d/coherency_line_size", path, i, j);
-	fd = hwloc_fopen(mappath, "r", data->root_fd);
+	fd = hwloc_fopen(mappath, "r", data->root_fd, data->dump_fd);
 	if (fd) {
 	  if (fgets(str2,sizeof(str2), fd))
 	    linesize = atol(str2); /* in bytes */
@@ -3386,14 +3740,14 @@ package_done:
 	 * some archs (ia64, ppc) put 0 there when fully-associative, while others (x86) put something like -1 there.
 	 */
 	sprintf(mappath, "%s/cpu%d/cache/index%d/number_of_sets", path, i, j);
-	fd = hwloc_fopen(mappath, "r", data->root_fd);
+	fd = hwloc_fopen(mappath, "r", data->root_fd, data->dump_fd);
 	if (fd) {
 	  if (fgets(str2,sizeof(str2), fd))
 	    sets = atol(str2);
 	  fclose(fd);
 	}
 	sprintf(mappath, "%s/cpu%d/cache/index%d/physical_line_partition", path, i, j);
-	fd = hwloc_fopen(mappath, "r", data->root_fd);
+	fd = hwloc_fopen(mappath, "r", data->root_fd, data->dump_fd);
 	if (fd) {
 	  if (fgets(str2,sizeof(str2), fd))
 	    lines_per_tag = atol(str2);
@@ -3401,13 +3755,13 @@ package_done:
 	}
 
 	sprintf(mappath, "%s/cpu%d/cache/index%d/shared_cpu_map", path, i, j);
-	cacheset = hwloc_parse_cpumap(mappath, data->root_fd);
+	cacheset = hwloc_parse_cpumap(mappath, data->root_fd, data->dump_fd);
         if (cacheset) {
           if (hwloc_bitmap_iszero(cacheset)) {
 	    /* ia64 returning empty L3 and L2i? use the core set instead */
 	    hwloc_bitmap_free(cacheset);
 	    sprintf(mappath, "%s/cpu%d/topology/thread_siblings", path, i);
-	    cacheset = hwloc_parse_cpumap(mappath, data->root_fd);
+	    cacheset = hwloc_parse_cpumap(mappath, data->root_fd, data->dump_fd);
 	  }
 	  hwloc_bitmap_andnot(cacheset, cacheset, unknownset);
 
@@ -3619,7 +3973,7 @@ hwloc_linux_parse_cpuinfo(struct hwloc_linux_backend_data_s *data,
   int curproc = -1;
   int (*parse_cpuinfo_func)(const char *, const char *, struct hwloc_obj_info_s **, unsigned *, int) = NULL;
 
-  if (!(fd=hwloc_fopen(path,"r", data->root_fd)))
+  if (!(fd=hwloc_fopen(path,"r", data->root_fd, data->dump_fd)))
     {
       hwloc_debug("could not open %s\n", path);
       return -1;
@@ -3912,7 +4266,7 @@ hwloc__linux_get_mic_sn(struct hwloc_topology *topology, struct hwloc_linux_back
 {
   FILE *file;
   char line[64], *tmp, *end;
-  file = hwloc_fopen("/proc/elog", "r", data->root_fd);
+  file = hwloc_fopen("/proc/elog", "r", data->root_fd, data->dump_fd);
   if (!file)
     return;
   if (!fgets(line, sizeof(line), file))
@@ -3951,7 +4305,7 @@ hwloc_gather_system_info(struct hwloc_topology *topology,
   }
 
   /* overwrite with optional /proc/hwloc-nofile-info */
-  file = hwloc_fopen("/proc/hwloc-nofile-info", "r", data->root_fd);
+  file = hwloc_fopen("/proc/hwloc-nofile-info", "r", data->root_fd, data->dump_fd);
   if (file) {
     while (fgets(line, sizeof(line), file)) {
       char *tmp = strchr(line, '\n');
@@ -4059,7 +4413,7 @@ hwloc_linux_try_hardwired_cpuinfo(struct hwloc_backend *backend)
      * "cpu             : Fujitsu SPARC64 XIfx"
      * "cpu             : Fujitsu SPARC64 IXfx"
      */
-    fd = hwloc_fopen("/proc/cpuinfo", "r", data->root_fd);
+    fd = hwloc_fopen("/proc/cpuinfo", "r", data->root_fd, data->dump_fd);
     if (!fd)
       return -1;
 
@@ -4088,7 +4442,7 @@ hwloc_look_linuxfs(struct hwloc_backend *backend)
   struct hwloc_topology *topology = backend->topology;
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   unsigned nbnodes;
-  char *cpuset_mntpnt, *cgroup_mntpnt, *cpuset_name = NULL;
+  char *cpuset_name = NULL;
   struct hwloc_linux_cpuinfo_proc * Lprocs = NULL;
   struct hwloc_obj_info_s *global_infos = NULL;
   unsigned global_infos_count = 0;
@@ -4151,16 +4505,7 @@ hwloc_look_linuxfs(struct hwloc_backend *backend)
   /**********************
    * Gather the list of admin-disabled cpus and mems
    */
-  hwloc_find_linux_cpuset_mntpnt(&cgroup_mntpnt, &cpuset_mntpnt, data->root_path);
-  if (cgroup_mntpnt || cpuset_mntpnt) {
-    cpuset_name = hwloc_read_linux_cpuset_name(data->root_fd, topology->pid);
-    if (cpuset_name) {
-      hwloc_admin_disable_set_from_cpuset(data, cgroup_mntpnt, cpuset_mntpnt, cpuset_name, "cpus", topology->levels[0][0]->allowed_cpuset);
-      hwloc_admin_disable_set_from_cpuset(data, cgroup_mntpnt, cpuset_mntpnt, cpuset_name, "mems", topology->levels[0][0]->allowed_nodeset);
-    }
-    free(cgroup_mntpnt);
-    free(cpuset_mntpnt);
-  }
+  cpuset_name = hwloc_linux__get_allowed_resources(topology, data);
 
   /*********************
    * Memory information
@@ -4200,10 +4545,10 @@ hwloc_look_linuxfs(struct hwloc_backend *backend)
 		    &global_infos, &global_infos_count);
 
   if (getenv("HWLOC_LINUX_USE_CPUINFO")
-      || (hwloc_access("/sys/devices/system/cpu/cpu0/topology/core_siblings", R_OK, data->root_fd) < 0
-	  && hwloc_access("/sys/devices/system/cpu/cpu0/topology/thread_siblings", R_OK, data->root_fd) < 0
-	  && hwloc_access("/sys/bus/cpu/devices/cpu0/topology/thread_siblings", R_OK, data->root_fd) < 0
-	  && hwloc_access("/sys/bus/cpu/devices/cpu0/topology/core_siblings", R_OK, data->root_fd) < 0)) {
+      || (hwloc_access("/sys/devices/system/cpu/cpu0/topology/core_siblings", R_OK, data->root_fd, data->dump_fd) < 0
+	  && hwloc_access("/sys/devices/system/cpu/cpu0/topology/thread_siblings", R_OK, data->root_fd, data->dump_fd) < 0
+	  && hwloc_access("/sys/bus/cpu/devices/cpu0/topology/thread_siblings", R_OK, data->root_fd, data->dump_fd) < 0
+	  && hwloc_access("/sys/bus/cpu/devices/cpu0/topology/core_siblings", R_OK, data->root_fd, data->dump_fd) < 0)) {
     /* revert to reading cpuinfo only if /sys/.../topology unavailable (before 2.6.16)
      * or not containing anything interesting */
     if (numprocs > 0)
@@ -4242,6 +4587,16 @@ hwloc_look_linuxfs(struct hwloc_backend *backend)
   /* data->utsname was filled with real uname or \0, we can safely pass it */
   hwloc_add_uname_info(topology, &data->utsname);
 
+  if (data->is_real_fsroot) {
+    /* compute kernel cpumask and nodemask sizes now,
+     * so that binding queries on the loaded topology only read them.
+     */
+#if defined(HWLOC_HAVE_CPU_SET_S) && !defined(HWLOC_HAVE_OLD_SCHED_SETAFFINITY)
+    hwloc_linux_find_kernel_nr_cpus(topology);
+#endif
+    hwloc_linux_find_kernel_max_numnodes(topology);
+  }
+
   hwloc_linux_free_cpuinfo(Lprocs, numprocs, global_infos, global_infos_count);
   return 0;
 }
@@ -4267,7 +4622,7 @@ hwloc_linux_backend_get_pci_busid_cpuset(struct hwloc_backend *backend,
   snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%01x/local_cpus",
 	   busid->domain, busid->bus,
 	   busid->dev, busid->func);
-  file = hwloc_fopen(path, "r", data->root_fd);
+  file = hwloc_fopen(path, "r", data->root_fd, data->dump_fd);
   if (file) {
     err = hwloc_linux_parse_cpumap_file(file, cpuset);
     fclose(file);
@@ -4288,6 +4643,8 @@ hwloc_linux_backend_disable(struct hwloc_backend *backend)
 {
   struct hwloc_linux_backend_data_s *data = backend->private_data;
 #ifdef HAVE_OPENAT
+  if (data->dump_fd >= 0)
+    close(data->dump_fd);
   free(data->root_path);
   close(data->root_fd);
 #endif
@@ -4307,6 +4664,9 @@ hwloc_linux_component_instantiate(struct hwloc_disc_component *component,
   struct hwloc_backend *backend;
   struct hwloc_linux_backend_data_s *data;
   const char * fsroot_path;
+#ifdef HAVE_OPENAT
+  const char *env;
+#endif
   int flags, root = -1;
 
   backend = hwloc_backend_alloc(component);
@@ -4330,6 +4690,7 @@ hwloc_linux_component_instantiate(struct hwloc_disc_component *component,
   data->is_amd15h = 0;
   data->is_real_fsroot = 1;
   data->root_path = NULL;
+  data->dump_fd = -1;
   fsroot_path = getenv("HWLOC_FSROOT");
   if (!fsroot_path)
     fsroot_path = "/";
@@ -4355,6 +4716,13 @@ hwloc_linux_component_instantiate(struct hwloc_disc_component *component,
       root = -1;
       goto out_with_data;
   }
+
+  env = getenv("HWLOC_DUMP_ACCESSED_FILES");
+  if (env && *env) {
+    data->dump_fd = open(env, O_WRONLY|O_CREAT|O_APPEND, 0600);
+    if (data->dump_fd >= 0)
+      fcntl(data->dump_fd, F_SETFD, FD_CLOEXEC);
+  }
 #else
   if (strcmp(fsroot_path, "/")) {
     errno = ENOSYS;
@@ -4393,6 +4761,7 @@ static struct hwloc_disc_component hwloc_linux_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_linux_component_instantiate,
   50,
+  0,
   NULL
 };
 
@@ -4414,7 +4783,7 @@ const struct hwloc_component hwloc_linux_component = {
  ***********************************/
 
 static hwloc_obj_t
-hwloc_linuxfs_find_osdev_parent(struct hwloc_backend *backend, int root_fd,
+hwloc_linuxfs_find_osdev_parent(struct hwloc_backend *backend, int root_fd, int dump_fd,
 				const char *osdevpath, int allowvirtual)
 {
   struct hwloc_topology *topology = backend->topology;
@@ -4428,7 +4797,7 @@ hwloc_linuxfs_find_osdev_parent(struct hwloc_backend *backend, int root_fd,
   hwloc_obj_t parent;
   int err;
 
-  err = hwloc_readlink(osdevpath, path, sizeof(path), root_fd);
+  err = hwloc_readlink(osdevpath, path, sizeof(path), root_fd, dump_fd);
   if (err < 0)
     return NULL;
   path[err] = '\0';
@@ -4482,7 +4851,7 @@ hwloc_linuxfs_find_osdev_parent(struct hwloc_backend *backend, int root_fd,
  nopci:
   /* attach directly to the right NUMA node */
   snprintf(path, sizeof(path), "%s/device/numa_node", osdevpath);
-  file = hwloc_fopen(path, "r", root_fd);
+  file = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (file) {
     err = fread(buf, 1, sizeof(buf), file);
     fclose(file);
@@ -4499,7 +4868,7 @@ hwloc_linuxfs_find_osdev_parent(struct hwloc_backend *backend, int root_fd,
   /* attach directly to the right cpuset */
   cpuset = hwloc_bitmap_alloc();
   snprintf(path, sizeof(path), "%s/device/local_cpus", osdevpath);
-  file = hwloc_fopen(path, "r", root_fd);
+  file = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (file) {
     err = hwloc_linux_parse_cpumap_file(file, cpuset);
     fclose(file);
@@ -4539,7 +4908,7 @@ hwloc_linux_add_os_device(struct hwloc_backend *backend, struct hwloc_obj *pcide
 }
 
 static void
-hwloc_linuxfs_block_class_fillinfos(struct hwloc_backend *backend __hwloc_attribute_unused, int root_fd,
+hwloc_linuxfs_block_class_fillinfos(struct hwloc_backend *backend __hwloc_attribute_unused, int root_fd, int dump_fd,
 				    struct hwloc_obj *obj, const char *osdevpath)
 {
 #ifdef HWLOC_HAVE_LIBUDEV
@@ -4558,7 +4927,7 @@ hwloc_linuxfs_block_class_fillinfos(struct hwloc_backend *backend __hwloc_attrib
   char *tmp;
 
   snprintf(path, sizeof(path), "%s/size", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char string[20];
     if (fgets(string, sizeof(string), fd)) {
@@ -4571,7 +4940,7 @@ hwloc_linuxfs_block_class_fillinfos(struct hwloc_backend *backend __hwloc_attrib
   }
 
   snprintf(path, sizeof(path), "%s/queue/hw_sector_size", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char string[20];
     if (fgets(string, sizeof(string), fd)) {
@@ -4587,7 +4956,7 @@ hwloc_linuxfs_block_class_fillinfos(struct hwloc_backend *backend __hwloc_attrib
    * without metadata.
    */
   snprintf(path, sizeof(path), "%s/device/devtype", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char string[32];
     if (fgets(string, sizeof(string), fd)) {
@@ -4606,7 +4975,7 @@ hwloc_linuxfs_block_class_fillinfos(struct hwloc_backend *backend __hwloc_attrib
   }
 
   snprintf(path, sizeof(path), "%s/dev", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (!fd)
     return;
 
@@ -4662,7 +5031,7 @@ hwloc_linuxfs_block_class_fillinfos(struct hwloc_backend *backend __hwloc_attrib
 #endif
  {
   snprintf(path, sizeof(path), "/run/udev/data/b%u:%u", major_id, minor_id);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (!fd)
     return;
 
@@ -4734,10 +5103,11 @@ hwloc_linuxfs_lookup_block_class(struct hwloc_backend *backend)
 {
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   DIR *dir;
   struct dirent *dirent;
 
-  dir = hwloc_opendir("/sys/class/block", root_fd);
+  dir = hwloc_opendir("/sys/class/block", root_fd, dump_fd);
   if (!dir)
     return 0;
 
@@ -4751,11 +5121,11 @@ hwloc_linuxfs_lookup_block_class(struct hwloc_backend *backend)
 
     /* ignore partitions */
     snprintf(path, sizeof(path), "/sys/class/block/%s/partition", dirent->d_name);
-    if (hwloc_stat(path, &stbuf, root_fd) >= 0)
+    if (hwloc_stat(path, &stbuf, root_fd, dump_fd) >= 0)
       continue;
 
     snprintf(path, sizeof(path), "/sys/class/block/%s", dirent->d_name);
-    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, path, 0 /* no virtual */);
+    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, dump_fd, path, 0 /* no virtual */);
     if (!parent)
       continue;
 
@@ -4765,7 +5135,7 @@ hwloc_linuxfs_lookup_block_class(struct hwloc_backend *backend)
 
     obj = hwloc_linux_add_os_device(backend, parent, HWLOC_OBJ_OSDEV_BLOCK, dirent->d_name);
 
-    hwloc_linuxfs_block_class_fillinfos(backend, root_fd, obj, path);
+    hwloc_linuxfs_block_class_fillinfos(backend, root_fd, dump_fd, obj, path);
   }
 
   closedir(dir);
@@ -4774,14 +5144,14 @@ hwloc_linuxfs_lookup_block_class(struct hwloc_backend *backend)
 }
 
 static void
-hwloc_linuxfs_net_class_fillinfos(int root_fd,
+hwloc_linuxfs_net_class_fillinfos(int root_fd, int dump_fd,
 				  struct hwloc_obj *obj, const char *osdevpath)
 {
   FILE *fd;
   struct stat st;
   char path[256];
   snprintf(path, sizeof(path), "%s/address", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char address[128];
     if (fgets(address, sizeof(address), fd)) {
@@ -4793,9 +5163,9 @@ hwloc_linuxfs_net_class_fillinfos(int root_fd,
     fclose(fd);
   }
   snprintf(path, sizeof(path), "%s/device/infiniband", osdevpath);
-  if (!hwloc_stat(path, &st, root_fd)) {
+  if (!hwloc_stat(path, &st, root_fd, dump_fd)) {
     snprintf(path, sizeof(path), "%s/dev_id", osdevpath);
-    fd = hwloc_fopen(path, "r", root_fd);
+    fd = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (fd) {
       char hexid[16];
       if (fgets(hexid, sizeof(hexid), fd)) {
@@ -4818,10 +5188,11 @@ hwloc_linuxfs_lookup_net_class(struct hwloc_backend *backend)
 {
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   DIR *dir;
   struct dirent *dirent;
 
-  dir = hwloc_opendir("/sys/class/net", root_fd);
+  dir = hwloc_opendir("/sys/class/net", root_fd, dump_fd);
   if (!dir)
     return 0;
 
@@ -4833,13 +5204,13 @@ hwloc_linuxfs_lookup_net_class(struct hwloc_backend *backend)
       continue;
 
     snprintf(path, sizeof(path), "/sys/class/net/%s", dirent->d_name);
-    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, path, 0 /* no virtual */);
+    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, dump_fd, path, 0 /* no virtual */);
     if (!parent)
       continue;
 
     obj = hwloc_linux_add_os_device(backend, parent, HWLOC_OBJ_OSDEV_NETWORK, dirent->d_name);
 
-    hwloc_linuxfs_net_class_fillinfos(root_fd, obj, path);
+    hwloc_linuxfs_net_class_fillinfos(root_fd, dump_fd, obj, path);
   }
 
   closedir(dir);
@@ -4848,7 +5219,7 @@ hwloc_linuxfs_lookup_net_class(struct hwloc_backend *backend)
 }
 
 static void
-hwloc_linuxfs_infiniband_class_fillinfos(int root_fd,
+hwloc_linuxfs_infiniband_class_fillinfos(int root_fd, int dump_fd,
 					 struct hwloc_obj *obj, const char *osdevpath)
 {
   FILE *fd;
@@ -4856,7 +5227,7 @@ hwloc_linuxfs_infiniband_class_fillinfos(int root_fd,
   unsigned i,j;
 
   snprintf(path, sizeof(path), "%s/node_guid", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char guidvalue[20];
     if (fgets(guidvalue, sizeof(guidvalue), fd)) {
@@ -4870,7 +5241,7 @@ hwloc_linuxfs_infiniband_class_fillinfos(int root_fd,
   }
 
   snprintf(path, sizeof(path), "%s/sys_image_guid", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char guidvalue[20];
     if (fgets(guidvalue, sizeof(guidvalue), fd)) {
@@ -4885,7 +5256,7 @@ hwloc_linuxfs_infiniband_class_fillinfos(int root_fd,
 
   for(i=1; ; i++) {
     snprintf(path, sizeof(path), "%s/ports/%u/state", osdevpath, i);
-    fd = hwloc_fopen(path, "r", root_fd);
+    fd = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (fd) {
       char statevalue[2];
       if (fgets(statevalue, sizeof(statevalue), fd)) {
@@ -4901,7 +5272,7 @@ hwloc_linuxfs_infiniband_class_fillinfos(int root_fd,
     }
 
     snprintf(path, sizeof(path), "%s/ports/%u/lid", osdevpath, i);
-    fd = hwloc_fopen(path, "r", root_fd);
+    fd = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (fd) {
       char lidvalue[11];
       if (fgets(lidvalue, sizeof(lidvalue), fd)) {
@@ -4916,7 +5287,7 @@ hwloc_linuxfs_infiniband_class_fillinfos(int root_fd,
     }
 
     snprintf(path, sizeof(path), "%s/ports/%u/lid_mask_count", osdevpath, i);
-    fd = hwloc_fopen(path, "r", root_fd);
+    fd = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (fd) {
       char lidvalue[11];
       if (fgets(lidvalue, sizeof(lidvalue), fd)) {
@@ -4932,7 +5303,7 @@ hwloc_linuxfs_infiniband_class_fillinfos(int root_fd,
 
     for(j=0; ; j++) {
       snprintf(path, sizeof(path), "%s/ports/%u/gids/%u", osdevpath, i, j);
-      fd = hwloc_fopen(path, "r", root_fd);
+      fd = hwloc_fopen(path, "r", root_fd, dump_fd);
       if (fd) {
 	char gidvalue[40];
 	if (fgets(gidvalue, sizeof(gidvalue), fd)) {
@@ -4961,10 +5332,11 @@ hwloc_linuxfs_lookup_infiniband_class(struct hwloc_backend *backend)
 {
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   DIR *dir;
   struct dirent *dirent;
 
-  dir = hwloc_opendir("/sys/class/infiniband", root_fd);
+  dir = hwloc_opendir("/sys/class/infiniband", root_fd, dump_fd);
   if (!dir)
     return 0;
 
@@ -4980,13 +5352,13 @@ hwloc_linuxfs_lookup_infiniband_class(struct hwloc_backend *backend)
       continue;
 
     snprintf(path, sizeof(path), "/sys/class/infiniband/%s", dirent->d_name);
-    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, path, 0 /* no virtual */);
+    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, dump_fd, path, 0 /* no virtual */);
     if (!parent)
       continue;
 
     obj = hwloc_linux_add_os_device(backend, parent, HWLOC_OBJ_OSDEV_OPENFABRICS, dirent->d_name);
 
-    hwloc_linuxfs_infiniband_class_fillinfos(root_fd, obj, path);
+    hwloc_linuxfs_infiniband_class_fillinfos(root_fd, dump_fd, obj, path);
   }
 
   closedir(dir);
@@ -4995,7 +5367,7 @@ hwloc_linuxfs_lookup_infiniband_class(struct hwloc_backend *backend)
 }
 
 static void
-hwloc_linuxfs_mic_class_fillinfos(int root_fd,
+hwloc_linuxfs_mic_class_fillinfos(int root_fd, int dump_fd,
 				  struct hwloc_obj *obj, const char *osdevpath)
 {
   FILE *fd;
@@ -5004,7 +5376,7 @@ hwloc_linuxfs_mic_class_fillinfos(int root_fd,
   obj->subtype = strdup("MIC");
 
   snprintf(path, sizeof(path), "%s/family", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char family[64];
     if (fgets(family, sizeof(family), fd)) {
@@ -5017,7 +5389,7 @@ hwloc_linuxfs_mic_class_fillinfos(int root_fd,
   }
 
   snprintf(path, sizeof(path), "%s/sku", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char sku[64];
     if (fgets(sku, sizeof(sku), fd)) {
@@ -5030,7 +5402,7 @@ hwloc_linuxfs_mic_class_fillinfos(int root_fd,
   }
 
   snprintf(path, sizeof(path), "%s/serialnumber", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char sn[64];
     if (fgets(sn, sizeof(sn), fd)) {
@@ -5043,7 +5415,7 @@ hwloc_linuxfs_mic_class_fillinfos(int root_fd,
   }
 
   snprintf(path, sizeof(path), "%s/active_cores", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char string[10];
     if (fgets(string, sizeof(string), fd)) {
@@ -5055,7 +5427,7 @@ hwloc_linuxfs_mic_class_fillinfos(int root_fd,
   }
 
   snprintf(path, sizeof(path), "%s/memsize", osdevpath);
-  fd = hwloc_fopen(path, "r", root_fd);
+  fd = hwloc_fopen(path, "r", root_fd, dump_fd);
   if (fd) {
     char string[20];
     if (fgets(string, sizeof(string), fd)) {
@@ -5072,11 +5444,12 @@ hwloc_linuxfs_lookup_mic_class(struct hwloc_backend *backend)
 {
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   unsigned idx;
   DIR *dir;
   struct dirent *dirent;
 
-  dir = hwloc_opendir("/sys/class/mic", root_fd);
+  dir = hwloc_opendir("/sys/class/mic", root_fd, dump_fd);
   if (!dir)
     return 0;
 
@@ -5090,13 +5463,13 @@ hwloc_linuxfs_lookup_mic_class(struct hwloc_backend *backend)
       continue;
 
     snprintf(path, sizeof(path), "/sys/class/mic/mic%u", idx);
-    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, path, 0 /* no virtual */);
+    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, dump_fd, path, 0 /* no virtual */);
     if (!parent)
       continue;
 
     obj = hwloc_linux_add_os_device(backend, parent, HWLOC_OBJ_OSDEV_COPROC, dirent->d_name);
 
-    hwloc_linuxfs_mic_class_fillinfos(root_fd, obj, path);
+    hwloc_linuxfs_mic_class_fillinfos(root_fd, dump_fd, obj, path);
   }
 
   closedir(dir);
@@ -5109,10 +5482,11 @@ hwloc_linuxfs_lookup_drm_class(struct hwloc_backend *backend)
 {
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   DIR *dir;
   struct dirent *dirent;
 
-  dir = hwloc_opendir("/sys/class/drm", root_fd);
+  dir = hwloc_opendir("/sys/class/drm", root_fd, dump_fd);
   if (!dir)
     return 0;
 
@@ -5126,14 +5500,14 @@ hwloc_linuxfs_lookup_drm_class(struct hwloc_backend *backend)
 
     /* only keep main devices, not subdevices for outputs */
     snprintf(path, sizeof(path), "/sys/class/drm/%s/dev", dirent->d_name);
-    if (hwloc_stat(path, &stbuf, root_fd) < 0)
+    if (hwloc_stat(path, &stbuf, root_fd, dump_fd) < 0)
       continue;
 
     /* FIXME: only keep cardX ? */
     /* FIXME: drop cardX for proprietary drivers that get CUDA/OpenCL devices? */
 
     snprintf(path, sizeof(path), "/sys/class/drm/%s", dirent->d_name);
-    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, path, 0 /* no virtual */);
+    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, dump_fd, path, 0 /* no virtual */);
     if (!parent)
       continue;
 
@@ -5150,10 +5524,11 @@ hwloc_linuxfs_lookup_dma_class(struct hwloc_backend *backend)
 {
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   DIR *dir;
   struct dirent *dirent;
 
-  dir = hwloc_opendir("/sys/class/dma", root_fd);
+  dir = hwloc_opendir("/sys/class/dma", root_fd, dump_fd);
   if (!dir)
     return 0;
 
@@ -5165,7 +5540,7 @@ hwloc_linuxfs_lookup_dma_class(struct hwloc_backend *backend)
       continue;
 
     snprintf(path, sizeof(path), "/sys/class/dma/%s", dirent->d_name);
-    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, path, 0 /* no virtual */);
+    parent = hwloc_linuxfs_find_osdev_parent(backend, root_fd, dump_fd, path, 0 /* no virtual */);
     if (!parent)
       continue;
 
@@ -5335,7 +5710,7 @@ hwloc__get_firmware_dmi_memory_info(struct hwloc_topology *topology,
     int err;
 
     snprintf(path, sizeof(path), "/sys/firmware/dmi/entries/17-%u/raw", i);
-    fd = hwloc_fopen(path, "r", data->root_fd);
+    fd = hwloc_fopen(path, "r", data->root_fd, data->dump_fd);
     if (!fd)
       break;
 
@@ -5361,6 +5736,28 @@ hwloc__get_firmware_dmi_memory_info(struct hwloc_topology *topology,
 #define HWLOC_PCI_REVISION_ID 0x08
 #define HWLOC_PCI_CAP_ID_EXP 0x10
 #define HWLOC_PCI_CLASS_NOT_DEFINED 0x0000
+#define HWLOC_PCI_CLASS_BRIDGE_PCI 0x0604
+
+#define CONFIG_SPACE_CACHESIZE 256
+
+/* read the beginning of the config space of a PCI device,
+ * the buffer is left untouched when the file cannot be read (missing permissions, etc).
+ */
+static void
+hwloc_linuxfs_pci_read_config(const char *busid, unsigned char *config_space_cache, int root_fd, int dump_fd)
+{
+  char path[64];
+  FILE *file;
+  size_t read;
+
+  snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/config", busid);
+  file = hwloc_fopen(path, "r", root_fd, dump_fd);
+  if (file) {
+    read = fread(config_space_cache, 1, CONFIG_SPACE_CACHESIZE, file);
+    (void) read; /* the buffer was initialized in case we don't read enough, ignore the read length */
+    fclose(file);
+  }
+}
 
 static int
 hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
@@ -5369,6 +5766,7 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
   struct hwloc_topology *topology = backend->topology;
   hwloc_obj_t tree = NULL;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   DIR *dir;
   struct dirent *dirent;
 
@@ -5378,13 +5776,13 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
    * Do a single readdir in the linear list in /sys/bus/pci/devices/...
    * and build the hierarchy manually instead.
    */
-  dir = hwloc_opendir("/sys/bus/pci/devices/", root_fd);
+  dir = hwloc_opendir("/sys/bus/pci/devices/", root_fd, dump_fd);
   if (!dir)
     return 0;
 
   while ((dirent = readdir(dir)) != NULL) {
-#define CONFIG_SPACE_CACHESIZE 256
     unsigned char config_space_cache[CONFIG_SPACE_CACHESIZE];
+    int config_space_read;
     unsigned domain, bus, dev, func;
     unsigned short class_id;
     hwloc_obj_type_t type;
@@ -5401,17 +5799,11 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
 
     /* initialize the config space in case we fail to read it (missing permissions, etc). */
     memset(config_space_cache, 0xff, CONFIG_SPACE_CACHESIZE);
-    snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/config", dirent->d_name);
-    file = hwloc_fopen(path, "r", root_fd);
-    if (file) {
-      read = fread(config_space_cache, 1, CONFIG_SPACE_CACHESIZE, file);
-      (void) read; /* we initialized config_space_cache in case we don't read enough, ignore the read length */
-      fclose(file);
-    }
+    config_space_read = 0;
 
     class_id = HWLOC_PCI_CLASS_NOT_DEFINED;
     snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/class", dirent->d_name);
-    file = hwloc_fopen(path, "r", root_fd);
+    file = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (file) {
       read = fread(value, 1, sizeof(value), file);
       fclose(file);
@@ -5419,6 +5811,11 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
         class_id = strtoul(value, NULL, 16) >> 8;
     }
 
+    /* the config space is only needed for distinguishing bridges before filtering */
+    if (class_id == HWLOC_PCI_CLASS_BRIDGE_PCI) {
+      hwloc_linuxfs_pci_read_config(dirent->d_name, config_space_cache, root_fd, dump_fd);
+      config_space_read = 1;
+    }
     type = hwloc_pci_check_bridge_type(class_id, config_space_cache);
 
     /* filtered? */
@@ -5438,6 +5835,10 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
       /* HWLOC_TYPE_FILTER_KEEP_IMPORTANT filtered later in the core */
     }
 
+    /* not filtered, we need the config space for the revision, link speed and bridge attributes */
+    if (!config_space_read)
+      hwloc_linuxfs_pci_read_config(dirent->d_name, config_space_cache, root_fd, dump_fd);
+
     obj = hwloc_alloc_setup_object(topology, type, -1);
     if (!obj)
       break;
@@ -5458,7 +5859,7 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
     attr->linkspeed = 0;
 
     snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/vendor", dirent->d_name);
-    file = hwloc_fopen(path, "r", root_fd);
+    file = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (file) {
       read = fread(value, 1, sizeof(value), file);
       fclose(file);
@@ -5466,7 +5867,7 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
         attr->vendor_id = strtoul(value, NULL, 16);
     }
     snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/device", dirent->d_name);
-    file = hwloc_fopen(path, "r", root_fd);
+    file = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (file) {
       read = fread(value, 1, sizeof(value), file);
       fclose(file);
@@ -5474,7 +5875,7 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
         attr->device_id = strtoul(value, NULL, 16);
     }
     snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/subsystem_vendor", dirent->d_name);
-    file = hwloc_fopen(path, "r", root_fd);
+    file = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (file) {
       read = fread(value, 1, sizeof(value), file);
       fclose(file);
@@ -5482,7 +5883,7 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
         attr->subvendor_id = strtoul(value, NULL, 16);
     }
     snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/subsystem_device", dirent->d_name);
-    file = hwloc_fopen(path, "r", root_fd);
+    file = hwloc_fopen(path, "r", root_fd, dump_fd);
     if (file) {
       read = fread(value, 1, sizeof(value), file);
       fclose(file);
@@ -5513,57 +5914,17 @@ hwloc_linuxfs_pci_look_pcidevices(struct hwloc_backend *backend)
   return 0;
 }
 
-static hwloc_obj_t
-hwloc_linuxfs_pci_find_pcislot_obj(struct hwloc_obj *tree,
-				   unsigned domain, unsigned bus, unsigned dev)
-{
-  for ( ; tree; tree = tree->next_sibling) {
-    if (tree->type == HWLOC_OBJ_PCI_DEVICE
-	|| (tree->type == HWLOC_OBJ_BRIDGE
-	    && tree->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_PCI)) {
-      if (tree->attr->pcidev.domain == domain
-	  && tree->attr->pcidev.bus == bus
-	  && tree->attr->pcidev.dev == dev
-	  && tree->attr->pcidev.func == 0)
-	/* that's the right bus id */
-	return tree;
-      if (tree->attr->pcidev.domain > domain
-	  || (tree->attr->pcidev.domain == domain
-	      && tree->attr->pcidev.bus > bus))
-	/* bus id too high, won't find anything later */
-	return NULL;
-      if (tree->type == HWLOC_OBJ_BRIDGE
-	  && tree->attr->bridge.downstream_type == HWLOC_OBJ_BRIDGE_PCI
-	  && tree->attr->bridge.downstream.pci.domain == domain
-	  && tree->attr->bridge.downstream.pci.secondary_bus <= bus
-	  && tree->attr->bridge.downstream.pci.subordinate_bus >= bus)
-	/* not the right bus id, but it's included in the bus below that bridge */
-	return hwloc_linuxfs_pci_find_pcislot_obj(tree->io_first_child, domain, bus, dev);
-
-    } else if (tree->type == HWLOC_OBJ_BRIDGE
-	       && tree->attr->bridge.upstream_type != HWLOC_OBJ_BRIDGE_PCI
-	       && tree->attr->bridge.downstream_type == HWLOC_OBJ_BRIDGE_PCI
-	       /* non-PCI to PCI bridge, just look at the subordinate bus */
-	       && tree->attr->bridge.downstream.pci.domain == domain
-	       && tree->attr->bridge.downstream.pci.secondary_bus <= bus
-	       && tree->attr->bridge.downstream.pci.subordinate_bus >= bus) {
-      /* contains our bus, recurse */
-      return hwloc_linuxfs_pci_find_pcislot_obj(tree->io_first_child, domain, bus, dev);
-    }
-  }
-  return NULL;
-}
-
 static int
 hwloc_linuxfs_pci_look_pcislots(struct hwloc_backend *backend)
 {
   struct hwloc_topology *topology = backend->topology;
   struct hwloc_linux_backend_data_s *data = backend->private_data;
   int root_fd = data->root_fd;
+  int dump_fd = data->dump_fd;
   DIR *dir;
   struct dirent *dirent;
 
-  dir = hwloc_opendir("/sys/bus/pci/slots/", root_fd);
+  dir = hwloc_opendir("/sys/bus/pci/slots/", root_fd, dump_fd);
   if (dir) {
     while ((dirent = readdir(dir)) != NULL) {
       char path[64];
@@ -5571,12 +5932,19 @@ hwloc_linuxfs_pci_look_pcislots(struct hwloc_backend *backend)
       if (dirent->d_name[0] == '.')
 	continue;
       snprintf(path, sizeof(path), "/sys/bus/pci/slots/%s/address", dirent->d_name);
-      file = hwloc_fopen(path, "r", root_fd);
+      file = hwloc_fopen(path, "r", root_fd, dump_fd);
       if (file) {
 	unsigned domain, bus, dev;
 	if (fscanf(file, "%x:%x:%x", &domain, &bus, &dev) == 3) {
-	  hwloc_obj_t obj = hwloc_linuxfs_pci_find_pcislot_obj(hwloc_get_root_obj(topology)->io_first_child, domain, bus, dev);
-	  if (obj) {
+	  hwloc_obj_t obj = hwloc_pci_belowroot_find_by_busid(topology, domain, bus, dev, 0);
+	  if (obj
+	      && (obj->type == HWLOC_OBJ_PCI_DEVICE
+		  || (obj->type == HWLOC_OBJ_BRIDGE && obj->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_PCI))
+	      && obj->attr->pcidev.domain == domain
+	      && obj->attr->pcidev.bus == bus
+	      && obj->attr->pcidev.dev == dev
+	      && obj->attr->pcidev.func == 0) {
+	    /* the first function of the slot was found, others are the next siblings */
 	    while (obj && obj->attr->pcidev.dev == dev /* sibling have same domain+bus */) {
 	      hwloc_obj_add_info(obj, "PCISlot", dirent->d_name);
 	      obj = obj->next_sibling;
@@ -5705,6 +6073,8 @@ static struct hwloc_disc_component hwloc_linuxio_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_linuxio_component_instantiate,
   19, /* after pci */
+  HWLOC_DISC_COMPONENT_OBJTYPE(HWLOC_OBJ_PCI_DEVICE) | HWLOC_DISC_COMPONENT_OBJTYPE(HWLOC_OBJ_BRIDGE)
+  | HWLOC_DISC_COMPONENT_OBJTYPE(HWLOC_OBJ_OS_DEVICE) | HWLOC_DISC_COMPONENT_OBJTYPE(HWLOC_OBJ_MISC),
   NULL
 };
 
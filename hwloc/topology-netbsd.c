@@ -201,6 +201,7 @@ static struct hwloc_disc_component hwloc_netbsd_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_netbsd_component_instantiate,
   50,
+  0,
   NULL
 };
 
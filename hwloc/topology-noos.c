@@ -45,6 +45,7 @@ static struct hwloc_disc_component hwloc_noos_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_noos_component_instantiate,
   40, /* lower than native OS component, higher than globals */
+  0,
   NULL
 };
 
@@ -127,11 +127,11 @@ hwloc_look_pci(struct hwloc_backend *backend)
     unsigned device_class;
     unsigned short tmp16;
     unsigned offset;
+    int config_space_read;
 
     /* initialize the config space in case we fail to read it (missing permissions, etc). */
     memset(config_space_cache, 0xff, CONFIG_SPACE_CACHESIZE);
-    pci_device_probe(pcidev);
-    pci_device_cfg_read(pcidev, config_space_cache, 0, CONFIG_SPACE_CACHESIZE, NULL);
+    config_space_read = 0;
 
     /* try to read the domain */
     domain = pcidev->domain;
@@ -139,6 +139,13 @@ hwloc_look_pci(struct hwloc_backend *backend)
     /* try to read the device_class */
     device_class = pcidev->device_class >> 8;
 
+    /* the config space is only needed for distinguishing bridges before filtering */
+    if (device_class == PCI_CLASS_BRIDGE_PCI) {
+      pci_device_probe(pcidev);
+      pci_device_cfg_read(pcidev, config_space_cache, 0, CONFIG_SPACE_CACHESIZE, NULL);
+      config_space_read = 1;
+    }
+
     /* bridge or pci dev? */
     type = hwloc_pci_check_bridge_type(device_class, config_space_cache);
 
@@ -159,6 +166,12 @@ hwloc_look_pci(struct hwloc_backend *backend)
       /* HWLOC_TYPE_FILTER_KEEP_IMPORTANT filtered later in the core */
     }
 
+    /* not filtered, we need the config space for the revision, link speed and bridge attributes */
+    if (!config_space_read) {
+      pci_device_probe(pcidev);
+      pci_device_cfg_read(pcidev, config_space_cache, 0, CONFIG_SPACE_CACHESIZE, NULL);
+    }
+
     /* fixup SR-IOV buggy VF device/vendor IDs */
     if (0xffff == pcidev->vendor_id && 0xffff == pcidev->device_id) {
       /* SR-IOV puts ffff:ffff in Virtual Function config space.
@@ -297,6 +310,7 @@ static struct hwloc_disc_component hwloc_pci_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_pci_component_instantiate,
   20,
+  HWLOC_DISC_COMPONENT_OBJTYPE(HWLOC_OBJ_PCI_DEVICE) | HWLOC_DISC_COMPONENT_OBJTYPE(HWLOC_OBJ_BRIDGE),
   NULL
 };
 
@@ -946,6 +946,7 @@ static struct hwloc_disc_component hwloc_synthetic_disc_component = {
   ~0,
   hwloc_synthetic_component_instantiate,
   30,
+  0,
   NULL
 };
 
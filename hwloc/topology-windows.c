@@ -1131,6 +1131,7 @@ static struct hwloc_disc_component hwloc_windows_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_windows_component_instantiate,
   50,
+  0,
   NULL
 };
 
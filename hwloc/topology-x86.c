@@ -23,6 +23,7 @@
 #include <private/cpuid-x86.h>
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #ifdef HAVE_DIRENT_H
 #include <dirent.h>
 #endif
@@ -35,6 +36,7 @@ struct hwloc_x86_backend_data_s {
   hwloc_bitmap_t apicid_set;
   int apicid_unique;
   char *src_cpuiddump_path;
+  struct cpuiddump_file *src_cpuiddump_file; /* if src_cpuiddump_path is a single file */
   int is_knl;
 };
 
@@ -65,9 +67,111 @@ cpuiddump_free(struct cpuiddump *cpuiddump)
   free(cpuiddump);
 }
 
+/* A single dump file starts with "Architecture: x86",
+ * then each line is prefixed with the list of PUs that share this entry.
+ */
+struct cpuiddump_file {
+  unsigned nr;
+  struct cpuiddump_file_entry {
+    hwloc_bitmap_t pus;
+    struct cpuiddump_entry entry;
+  } *entries;
+};
+
+#define CPUIDDUMP_FILE_LINE_LEN 16384
+
+static void
+cpuiddump_file_free(struct cpuiddump_file *dumpfile)
+{
+  unsigned i;
+  for(i=0; i<dumpfile->nr; i++)
+    hwloc_bitmap_free(dumpfile->entries[i].pus);
+  free(dumpfile->entries);
+  free(dumpfile);
+}
+
+/* read the whole file and return the set of PUs it describes */
+static struct cpuiddump_file *
+cpuiddump_file_read(const char *path, hwloc_bitmap_t set)
+{
+  struct cpuiddump_file *dumpfile;
+  unsigned allocated = 0;
+  char *line;
+  FILE *file;
+
+  file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Couldn't open dumped cpuid file %s\n", path);
+    return NULL;
+  }
+  line = malloc(CPUIDDUMP_FILE_LINE_LEN);
+  dumpfile = malloc(sizeof(*dumpfile));
+  if (!line || !dumpfile)
+    goto out_with_file;
+  dumpfile->nr = 0;
+  dumpfile->entries = NULL;
+
+  if (!fgets(line, CPUIDDUMP_FILE_LINE_LEN, file) || strcmp(line, "Architecture: x86\n")) {
+    fprintf(stderr, "Found non-x86 dumped cpuid file %s\n", path);
+    goto out_with_dumpfile;
+  }
+
+  while (fgets(line, CPUIDDUMP_FILE_LINE_LEN, file)) {
+    struct cpuiddump_file_entry *cur;
+    char *space;
+
+    if (*line == '#' || *line == '\n')
+      continue;
+    space = strchr(line, ' ');
+    if (!space) {
+      fprintf(stderr, "Ignoring invalid line in dumped cpuid file %s: %s", path, line);
+      continue;
+    }
+    *space = '\0';
+
+    if (dumpfile->nr == allocated) {
+      struct cpuiddump_file_entry *tmp;
+      allocated = allocated ? 2*allocated : 64;
+      tmp = realloc(dumpfile->entries, allocated * sizeof(*tmp));
+      if (!tmp)
+	goto out_with_dumpfile;
+      dumpfile->entries = tmp;
+    }
+    cur = &dumpfile->entries[dumpfile->nr];
+    cur->pus = hwloc_bitmap_alloc();
+    if (!cur->pus)
+      goto out_with_dumpfile;
+    if (hwloc_bitmap_list_sscanf(cur->pus, line) < 0
+	|| sscanf(space+1, "%x %x %x %x %x => %x %x %x %x",
+		  &cur->entry.inmask,
+		  &cur->entry.ineax, &cur->entry.inebx, &cur->entry.inecx, &cur->entry.inedx,
+		  &cur->entry.outeax, &cur->entry.outebx, &cur->entry.outecx, &cur->entry.outedx) != 9) {
+      fprintf(stderr, "Ignoring invalid line in dumped cpuid file %s: %s %s", path, line, space+1);
+      hwloc_bitmap_free(cur->pus);
+      continue;
+    }
+    hwloc_bitmap_or(set, set, cur->pus);
+    dumpfile->nr++;
+  }
+
+  free(line);
+  fclose(file);
+  return dumpfile;
+
+ out_with_dumpfile:
+  cpuiddump_file_free(dumpfile);
+  dumpfile = NULL;
+ out_with_file:
+  free(dumpfile);
+  free(line);
+  fclose(file);
+  return NULL;
+}
+
 static struct cpuiddump *
-cpuiddump_read(const char *dirpath, unsigned idx)
+cpuiddump_read(struct hwloc_x86_backend_data_s *data, unsigned idx)
 {
+  const char *dirpath = data->src_cpuiddump_path;
   struct cpuiddump *cpuiddump;
   struct cpuiddump_entry *cur;
   char *filename;
@@ -79,6 +183,24 @@ cpuiddump_read(const char *dirpath, unsigned idx)
   cpuiddump = malloc(sizeof(*cpuiddump));
   cpuiddump->nr = 0; /* return a cpuiddump that will raise errors because it matches nothing */
 
+  if (data->src_cpuiddump_file) {
+    /* extract the entries of this PU, inputs are unique within a PU so their order does not matter */
+    struct cpuiddump_file *dumpfile = data->src_cpuiddump_file;
+    unsigned i;
+    cpuiddump->entries = malloc(dumpfile->nr * sizeof(struct cpuiddump_entry));
+    if (!cpuiddump->entries)
+      return cpuiddump;
+    for(i=0, nr=0; i<dumpfile->nr; i++)
+      if (hwloc_bitmap_isset(dumpfile->entries[i].pus, idx))
+	cpuiddump->entries[nr++] = dumpfile->entries[i].entry;
+    cpuiddump->nr = nr;
+    if (!nr) {
+      fprintf(stderr, "Could not find PU #%u in dumped cpuid file %s\n", idx, dirpath);
+      free(cpuiddump->entries);
+    }
+    return cpuiddump;
+  }
+
   filename = malloc(filenamelen);
   snprintf(filename, filenamelen, "%s/pu%u", dirpath, idx);
   file = fopen(filename, "r");
@@ -993,7 +1115,7 @@ look_procs(struct hwloc_backend *backend, struct procinfo *infos, int fulldiscov
   for (i = 0; i < nbprocs; i++) {
     struct cpuiddump *src_cpuiddump = NULL;
     if (data->src_cpuiddump_path) {
-      src_cpuiddump = cpuiddump_read(data->src_cpuiddump_path, i);
+      src_cpuiddump = cpuiddump_read(data, i);
     } else {
       hwloc_bitmap_only(set, i);
       hwloc_debug("binding to CPU%d\n", i);
@@ -1095,7 +1217,7 @@ int hwloc_look_x86(struct hwloc_backend *backend, int fulldiscovery)
 
   if (data->src_cpuiddump_path) {
     /* just read cpuid from the dump */
-    src_cpuiddump = cpuiddump_read(data->src_cpuiddump_path, 0);
+    src_cpuiddump = cpuiddump_read(data, 0);
   } else {
     /* otherwise check if binding works */
     memset(&hooks, 0, sizeof(hooks));
@@ -1271,15 +1393,25 @@ fulldiscovery:
 }
 
 static int
-hwloc_x86_check_cpuiddump_input(const char *src_cpuiddump_path, hwloc_bitmap_t set)
+hwloc_x86_check_cpuiddump_input(const char *src_cpuiddump_path, hwloc_bitmap_t set,
+				struct cpuiddump_file **dumpfilep)
 {
 #if !(defined HWLOC_WIN_SYS && !defined __MINGW32__) /* needs a lot of work */
   struct dirent *dirent;
+  struct stat st;
   DIR *dir;
   char *path;
   FILE *file;
   char line [32];
 
+  *dumpfilep = NULL;
+  if (!stat(src_cpuiddump_path, &st) && S_ISREG(st.st_mode)) {
+    *dumpfilep = cpuiddump_file_read(src_cpuiddump_path, set);
+    if (!*dumpfilep)
+      return -1;
+    goto check_set;
+  }
+
   dir = opendir(src_cpuiddump_path);
   if (!dir)
     return -1;
@@ -1322,18 +1454,23 @@ hwloc_x86_check_cpuiddump_input(const char *src_cpuiddump_path, hwloc_bitmap_t s
   }
   closedir(dir);
 
+ check_set:
   if (hwloc_bitmap_iszero(set)) {
-    fprintf(stderr, "Did not find any valid pu%%u entry in dumped cpuid directory `%s'\n",
+    fprintf(stderr, "Did not find any valid pu%%u entry in dumped cpuid `%s'\n",
 	    src_cpuiddump_path);
-    return -1;
   } else if (hwloc_bitmap_last(set) != hwloc_bitmap_weight(set) - 1) {
     /* The x86 backends enforces contigous set of PUs starting at 0 so far */
-    fprintf(stderr, "Found non-contigous pu%%u range in dumped cpuid directory `%s'\n",
+    fprintf(stderr, "Found non-contigous pu%%u range in dumped cpuid `%s'\n",
 	    src_cpuiddump_path);
-    return -1;
+  } else {
+    return 0;
   }
 
-  return 0;
+  if (*dumpfilep) {
+    cpuiddump_file_free(*dumpfilep);
+    *dumpfilep = NULL;
+  }
+  return -1;
 
 out_with_dir:
   closedir(dir);
@@ -1347,6 +1484,8 @@ hwloc_x86_backend_disable(struct hwloc_backend *backend)
   struct hwloc_x86_backend_data_s *data = backend->private_data;
   hwloc_bitmap_free(data->apicid_set);
   free(data->src_cpuiddump_path);
+  if (data->src_cpuiddump_file)
+    cpuiddump_file_free(data->src_cpuiddump_file);
   free(data);
 }
 
@@ -1379,16 +1518,17 @@ hwloc_x86_component_instantiate(struct hwloc_disc_component *component,
   data->apicid_set = hwloc_bitmap_alloc();
   data->apicid_unique = 1;
   data->src_cpuiddump_path = NULL;
+  data->src_cpuiddump_file = NULL;
 
   src_cpuiddump_path = getenv("HWLOC_CPUID_PATH");
   if (src_cpuiddump_path) {
     hwloc_bitmap_t set = hwloc_bitmap_alloc();
-    if (!hwloc_x86_check_cpuiddump_input(src_cpuiddump_path, set)) {
+    if (!hwloc_x86_check_cpuiddump_input(src_cpuiddump_path, set, &data->src_cpuiddump_file)) {
       backend->is_thissystem = 0;
       data->src_cpuiddump_path = strdup(src_cpuiddump_path);
       data->nbprocs = hwloc_bitmap_weight(set);
     } else {
-      fprintf(stderr, "Ignoring dumped cpuid directory.\n");
+      fprintf(stderr, "Ignoring dumped cpuid.\n");
     }
     hwloc_bitmap_free(set);
   }
@@ -1407,6 +1547,7 @@ static struct hwloc_disc_component hwloc_x86_disc_component = {
   HWLOC_DISC_COMPONENT_TYPE_GLOBAL,
   hwloc_x86_component_instantiate,
   45, /* between native and no_os */
+  0,
   NULL
 };
 
@@ -27,17 +27,24 @@ static void hwloc_libxml2_error_callback(void * ctx __hwloc_attribute_unused, co
 /* by default, do not cleanup to avoid issues with concurrent libxml users */
 static int hwloc_libxml2_needs_cleanup = 0;
 
+/* called by every import and export, possibly from concurrent threads */
 static void
 hwloc_libxml2_init_once(void)
 {
-  static int first = 1;
-  if (first) {
-    first = 0;
+  static int started = 0;
+  static int done = 0;
+  if (hwloc_atomic_load_int(&done))
+    return;
+  if (!hwloc_test_and_set_flag(&started)) {
     /* disable stderr warnings */
     xmlSetGenericErrorFunc(NULL, hwloc__xml_verbose() ? xmlGenericError : hwloc_libxml2_error_callback);
     /* enforce libxml2 cleanup ? */
     if (getenv("HWLOC_LIBXML_CLEANUP"))
       hwloc_libxml2_needs_cleanup = 1;
+    hwloc_atomic_store_int(&done, 1);
+  } else {
+    /* another thread is initializing, it only takes a few instructions */
+    while (!hwloc_atomic_load_int(&done));
   }
 }
 
@@ -18,13 +18,12 @@
 int
 hwloc__xml_verbose(void)
 {
-  static int first = 1;
-  static int verbose = 0;
-  if (first) {
+  static int _verbose = -1; /* not read from the environment yet */
+  int verbose = hwloc_atomic_load_int(&_verbose);
+  if (verbose == -1) {
     const char *env = getenv("HWLOC_XML_VERBOSE");
-    if (env)
-      verbose = atoi(env);
-    first = 0;
+    verbose = env ? atoi(env) : 0;
+    hwloc_atomic_store_int(&_verbose, verbose);
   }
   return verbose;
 }
@@ -32,13 +31,12 @@ hwloc__xml_verbose(void)
 static int
 hwloc_nolibxml_import(void)
 {
-  static int first = 1;
-  static int nolibxml = 0;
-  if (first) {
+  static int _nolibxml = -1; /* not read from the environment yet */
+  int nolibxml = hwloc_atomic_load_int(&_nolibxml);
+  if (nolibxml == -1) {
     const char *env = getenv("HWLOC_NO_LIBXML_IMPORT");
-    if (env)
-      nolibxml = atoi(env);
-    first = 0;
+    nolibxml = env ? atoi(env) : 0;
+    hwloc_atomic_store_int(&_nolibxml, nolibxml);
   }
   return nolibxml;
 }
@@ -46,13 +44,12 @@ hwloc_nolibxml_import(void)
 static int
 hwloc_nolibxml_export(void)
 {
-  static int first = 1;
-  static int nolibxml = 0;
-  if (first) {
+  static int _nolibxml = -1; /* not read from the environment yet */
+  int nolibxml = hwloc_atomic_load_int(&_nolibxml);
+  if (nolibxml == -1) {
     const char *env = getenv("HWLOC_NO_LIBXML_EXPORT");
-    if (env)
-      nolibxml = atoi(env);
-    first = 0;
+    nolibxml = env ? atoi(env) : 0;
+    hwloc_atomic_store_int(&_nolibxml, nolibxml);
   }
   return nolibxml;
 }
@@ -109,7 +106,7 @@ hwloc__xml_import_object_attr(struct hwloc_topology *topology, struct hwloc_obj
     obj->gp_index = strtoull(value, NULL, 10);
     if (!obj->gp_index && hwloc__xml_verbose())
       fprintf(stderr, "%s: unexpected zero gp_index, topology may be invalid\n", state->global->msgprefix);
-    if (obj->gp_index >= topology->next_gp_index)
+    if (topology && obj->gp_index >= topology->next_gp_index)
       topology->next_gp_index = obj->gp_index + 1;
   } else if (!strcmp(name, "cpuset")) {
     obj->cpuset = hwloc_bitmap_alloc();
@@ -939,9 +936,8 @@ hwloc__xml_import_object(hwloc_topology_t topology,
 	/* next should be before cur */
 	if (!childrengotignored) {
 	  static int reported = 0;
-	  if (!reported && !hwloc_hide_errors()) {
+	  if (!hwloc_hide_errors() && !hwloc_test_and_set_flag(&reported)) {
 	    hwloc__xml_import_report_outoforder(topology, next, cur);
-	    reported = 1;
 	  }
 	}
 	hwloc__reorder_children(obj);
@@ -1176,6 +1172,89 @@ hwloc__xml_import_v2distances(hwloc_topology_t topology,
   return -1;
 }
 
+/* import an object and its children that do not belong to any topology,
+ * such as the payload of structural diffs.
+ */
+static int
+hwloc__xml_import_detached_object(hwloc_obj_t parent, hwloc_obj_t *objp,
+				  hwloc__xml_import_state_t state)
+{
+  hwloc_obj_t obj, *pchild;
+
+  obj = malloc(sizeof(*obj));
+  if (!obj)
+    return -1;
+  memset(obj, 0, sizeof(*obj));
+  obj->attr = malloc(sizeof(*obj->attr));
+  if (!obj->attr) {
+    free(obj);
+    return -1;
+  }
+  memset(obj->attr, 0, sizeof(*obj->attr));
+  obj->type = HWLOC_OBJ_TYPE_NONE;
+  obj->os_index = (unsigned) -1;
+  obj->parent = parent;
+  /* link it now so that it gets freed by the caller on error */
+  *objp = obj;
+
+  while (1) {
+    char *attrname, *attrvalue;
+    if (state->global->next_attr(state, &attrname, &attrvalue) < 0)
+      break;
+    if (!strcmp(attrname, "type")) {
+      if (hwloc_type_sscanf(attrvalue, &obj->type, NULL, 0) < 0)
+	return -1;
+    } else {
+      /* type needed first */
+      if (obj->type == HWLOC_OBJ_TYPE_NONE)
+	return -1;
+      hwloc__xml_import_object_attr(NULL, obj, attrname, attrvalue, state);
+    }
+  }
+  if (obj->type == HWLOC_OBJ_TYPE_NONE)
+    return -1;
+
+  while (1) {
+    struct hwloc__xml_import_state_s childstate;
+    char *tag;
+    int ret;
+
+    ret = state->global->find_child(state, &childstate, &tag);
+    if (ret < 0)
+      return -1;
+    if (!ret)
+      break;
+
+    if (!strcmp(tag, "object")) {
+      hwloc_obj_t child = NULL;
+      ret = hwloc__xml_import_detached_object(obj, &child, &childstate);
+      if (child) {
+	if (child->type == HWLOC_OBJ_MISC)
+	  pchild = &obj->misc_first_child;
+	else if (hwloc_obj_type_is_io(child->type))
+	  pchild = &obj->io_first_child;
+	else
+	  pchild = &obj->first_child;
+	while (*pchild)
+	  pchild = &(*pchild)->next_sibling;
+	*pchild = child;
+      }
+    } else if (!strcmp(tag, "info")) {
+      ret = hwloc__xml_import_info(NULL, obj, &childstate);
+    } else if (!strcmp(tag, "page_type")) {
+      ret = hwloc__xml_import_pagetype(NULL, obj, &childstate);
+    } else
+      ret = -1;
+
+    if (ret < 0)
+      return ret;
+
+    state->global->close_child(&childstate);
+  }
+
+  return state->global->close_tag(state);
+}
+
 static int
 hwloc__xml_import_diff_one(hwloc__xml_import_state_t state,
 			   hwloc_topology_diff_t *firstdiffp,
@@ -1185,10 +1264,15 @@ hwloc__xml_import_diff_one(hwloc__xml_import_state_t state,
   char *obj_depth_s = NULL;
   char *obj_index_s = NULL;
   char *obj_attr_type_s = NULL;
-/* char *obj_attr_index_s = NULL; unused for now */
+  char *obj_attr_index_s = NULL;
   char *obj_attr_name_s = NULL;
   char *obj_attr_oldvalue_s = NULL;
   char *obj_attr_newvalue_s = NULL;
+  char *parent_depth_s = NULL;
+  char *old_parent_index_s = NULL;
+  char *new_parent_index_s = NULL;
+  char *position_s = NULL;
+  hwloc_obj_t subtree = NULL;
 
   while (1) {
     char *attrname, *attrvalue;
@@ -1203,13 +1287,21 @@ hwloc__xml_import_diff_one(hwloc__xml_import_state_t state,
     else if (!strcmp(attrname, "obj_attr_type"))
       obj_attr_type_s = attrvalue;
     else if (!strcmp(attrname, "obj_attr_index"))
-      { /* obj_attr_index_s = attrvalue; unused for now */ }
+      obj_attr_index_s = attrvalue;
     else if (!strcmp(attrname, "obj_attr_name"))
       obj_attr_name_s = attrvalue;
     else if (!strcmp(attrname, "obj_attr_oldvalue"))
       obj_attr_oldvalue_s = attrvalue;
     else if (!strcmp(attrname, "obj_attr_newvalue"))
       obj_attr_newvalue_s = attrvalue;
+    else if (!strcmp(attrname, "parent_depth"))
+      parent_depth_s = attrvalue;
+    else if (!strcmp(attrname, "old_parent_index"))
+      old_parent_index_s = attrvalue;
+    else if (!strcmp(attrname, "new_parent_index"))
+      new_parent_index_s = attrvalue;
+    else if (!strcmp(attrname, "position"))
+      position_s = attrvalue;
     else {
       if (hwloc__xml_verbose())
 	fprintf(stderr, "%s: ignoring unknown diff attribute %s\n",
@@ -1218,10 +1310,63 @@ hwloc__xml_import_diff_one(hwloc__xml_import_state_t state,
     }
   }
 
+  /* structural diffs contain the inserted or removed object */
+  while (1) {
+    struct hwloc__xml_import_state_s childstate;
+    char *tag;
+    int ret;
+
+    ret = state->global->find_child(state, &childstate, &tag);
+    if (ret < 0)
+      goto out_with_subtree;
+    if (!ret)
+      break;
+
+    if (!strcmp(tag, "object") && !subtree) {
+      ret = hwloc__xml_import_detached_object(NULL, &subtree, &childstate);
+    } else
+      ret = -1;
+
+    if (ret < 0)
+      goto out_with_subtree;
+
+    state->global->close_child(&childstate);
+  }
+
   if (type_s) {
     switch (atoi(type_s)) {
     default:
       break;
+    case HWLOC_TOPOLOGY_DIFF_OBJ_INSERT:
+    case HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE: {
+      hwloc_topology_diff_t diff;
+
+      if (!parent_depth_s || !old_parent_index_s || !new_parent_index_s || !position_s || !subtree) {
+	if (hwloc__xml_verbose())
+	  fprintf(stderr, "%s: missing mandatory obj subtree attributes\n",
+		  state->global->msgprefix);
+	break;
+      }
+
+      diff = malloc(sizeof(*diff));
+      if (!diff)
+	goto out_with_subtree;
+      diff->obj_subtree.type = atoi(type_s);
+      diff->obj_subtree.parent_depth = atoi(parent_depth_s);
+      diff->obj_subtree.old_parent_index = atoi(old_parent_index_s);
+      diff->obj_subtree.new_parent_index = atoi(new_parent_index_s);
+      diff->obj_subtree.position = atoi(position_s);
+      diff->obj_subtree.obj = subtree;
+      subtree = NULL;
+
+      if (*firstdiffp)
+	(*lastdiffp)->generic.next = diff;
+      else
+        *firstdiffp = diff;
+      *lastdiffp = diff;
+      diff->generic.next = NULL;
+      break;
+    }
     case HWLOC_TOPOLOGY_DIFF_OBJ_ATTR: {
       /* object attribute diff */
       hwloc_topology_diff_obj_attr_type_t obj_attr_type;
@@ -1252,10 +1397,18 @@ hwloc__xml_import_diff_one(hwloc__xml_import_state_t state,
 	break;
       }
 
+      /* mandatory attributes for obj_attr_set subtype */
+      if (obj_attr_type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET && !obj_attr_index_s) {
+	if (hwloc__xml_verbose())
+	  fprintf(stderr, "%s: missing mandatory obj attr set index attribute\n",
+		  state->global->msgprefix);
+	break;
+      }
+
       /* now we know we have everything we need */
       diff = malloc(sizeof(*diff));
       if (!diff)
-	return -1;
+	goto out_with_subtree;
       diff->obj_attr.type = HWLOC_TOPOLOGY_DIFF_OBJ_ATTR;
       diff->obj_attr.obj_depth = atoi(obj_depth_s);
       diff->obj_attr.obj_index = atoi(obj_index_s);
@@ -1274,6 +1427,13 @@ hwloc__xml_import_diff_one(hwloc__xml_import_state_t state,
 	diff->obj_attr.diff.string.oldvalue = strdup(obj_attr_oldvalue_s);
 	diff->obj_attr.diff.string.newvalue = strdup(obj_attr_newvalue_s);
 	break;
+      case HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET:
+	diff->obj_attr.diff.set.index = atoi(obj_attr_index_s);
+	diff->obj_attr.diff.set.oldvalue = hwloc_bitmap_alloc();
+	hwloc_bitmap_sscanf(diff->obj_attr.diff.set.oldvalue, obj_attr_oldvalue_s);
+	diff->obj_attr.diff.set.newvalue = hwloc_bitmap_alloc();
+	hwloc_bitmap_sscanf(diff->obj_attr.diff.set.newvalue, obj_attr_newvalue_s);
+	break;
       }
 
       if (*firstdiffp)
@@ -1286,7 +1446,14 @@ hwloc__xml_import_diff_one(hwloc__xml_import_state_t state,
     }
   }
 
+  if (subtree)
+    hwloc_free_object_and_children(subtree);
   return state->global->close_tag(state);
+
+ out_with_subtree:
+  if (subtree)
+    hwloc_free_object_and_children(subtree);
+  return -1;
 }
 
 int
@@ -1844,8 +2011,7 @@ hwloc__xml_export_object (hwloc__xml_export_state_t parentstate, hwloc_topology_
   if (v1export && !obj->parent) {
     /* only latency matrices covering the entire machine can be exported to v1 */
     struct hwloc_internal_distances_s *dist;
-    /* refresh distances since we need objects below */
-    hwloc_internal_distances_refresh(topology);
+    /* distances objs arrays are always valid in a loaded topology */
     for(dist = topology->first_dist; dist; dist = dist->next) {
       struct hwloc__xml_export_state_s childstate;
       unsigned nbobjs = dist->nbobjs;
@@ -1964,7 +2130,7 @@ hwloc__xml_export_diff(hwloc__xml_export_state_t parentstate, hwloc_topology_dif
 
     switch (diff->generic.type) {
     case HWLOC_TOPOLOGY_DIFF_OBJ_ATTR:
-      sprintf(tmp, "%d", diff->obj_attr.obj_depth);
+      sprintf(tmp, "%d", (int) diff->obj_attr.obj_depth);
       state.new_prop(&state, "obj_depth", tmp);
       sprintf(tmp, "%u", diff->obj_attr.obj_index);
       state.new_prop(&state, "obj_index", tmp);
@@ -1988,8 +2154,33 @@ hwloc__xml_export_diff(hwloc__xml_export_state_t parentstate, hwloc_topology_dif
 	state.new_prop(&state, "obj_attr_oldvalue", diff->obj_attr.diff.string.oldvalue);
 	state.new_prop(&state, "obj_attr_newvalue", diff->obj_attr.diff.string.newvalue);
 	break;
+      case HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET: {
+	char *setstring;
+	sprintf(tmp, "%u", (unsigned) diff->obj_attr.diff.set.index);
+	state.new_prop(&state, "obj_attr_index", tmp);
+	hwloc_bitmap_asprintf(&setstring, diff->obj_attr.diff.set.oldvalue);
+	state.new_prop(&state, "obj_attr_oldvalue", setstring);
+	free(setstring);
+	hwloc_bitmap_asprintf(&setstring, diff->obj_attr.diff.set.newvalue);
+	state.new_prop(&state, "obj_attr_newvalue", setstring);
+	free(setstring);
+	break;
+      }
       }
 
+      break;
+    case HWLOC_TOPOLOGY_DIFF_OBJ_INSERT:
+    case HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE:
+      sprintf(tmp, "%d", (int) diff->obj_subtree.parent_depth);
+      state.new_prop(&state, "parent_depth", tmp);
+      sprintf(tmp, "%u", diff->obj_subtree.old_parent_index);
+      state.new_prop(&state, "old_parent_index", tmp);
+      sprintf(tmp, "%u", diff->obj_subtree.new_parent_index);
+      state.new_prop(&state, "new_parent_index", tmp);
+      sprintf(tmp, "%u", diff->obj_subtree.position);
+      state.new_prop(&state, "position", tmp);
+      /* the subtree isn't part of any topology */
+      hwloc__xml_export_object(&state, NULL, diff->obj_subtree.obj, 0);
       break;
     default:
       assert(0);
@@ -2376,6 +2567,7 @@ static struct hwloc_disc_component hwloc_xml_disc_component = {
   ~0,
   hwloc_xml_component_instantiate,
   30,
+  0,
   NULL
 };
 
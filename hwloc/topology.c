@@ -24,6 +24,11 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <float.h>
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#elif defined HAVE_GETTIMEOFDAY
+#include <sys/time.h>
+#endif
 
 #include <hwloc.h>
 #include <private/private.h>
@@ -56,13 +61,13 @@ unsigned hwloc_get_api_version(void)
 
 int hwloc_hide_errors(void)
 {
-  static int hide = 0;
-  static int checked = 0;
-  if (!checked) {
+  /* -1 until the environment is read, so that concurrent callers never see a half-initialized value */
+  static int _hide = -1;
+  int hide = hwloc_atomic_load_int(&_hide);
+  if (hide == -1) {
     const char *envvar = getenv("HWLOC_HIDE_ERRORS");
-    if (envvar)
-      hide = atoi(envvar);
-    checked = 1;
+    hide = envvar ? atoi(envvar) : 0;
+    hwloc_atomic_store_int(&_hide, hide);
   }
   return hide;
 }
@@ -71,7 +76,7 @@ void hwloc_report_os_error(const char *msg, int line)
 {
     static int reported = 0;
 
-    if (!reported && !hwloc_hide_errors()) {
+    if (!hwloc_hide_errors() && !hwloc_test_and_set_flag(&reported)) {
         fprintf(stderr, "****************************************************************************\n");
         fprintf(stderr, "* hwloc %s has encountered what looks like an error from the operating system.\n", HWLOC_VERSION);
         fprintf(stderr, "*\n");
@@ -87,7 +92,6 @@ void hwloc_report_os_error(const char *msg, int line)
 	fprintf(stderr, "* along with any relevant topology information from your platform.\n");
 #endif
         fprintf(stderr, "****************************************************************************\n");
-        reported = 1;
     }
 }
 
@@ -676,6 +680,51 @@ hwloc__duplicate_objects(struct hwloc_topology *newtopology,
   hwloc_insert_object_by_parent(newtopology, newparent, newobj);
 }
 
+static int
+hwloc__duplicate_detached_siblings(struct hwloc_obj *newparent, hwloc_obj_t *pnew, struct hwloc_obj *src)
+{
+  for( ; src; src = src->next_sibling) {
+    hwloc_obj_t newobj = hwloc__duplicate_detached_objects(src);
+    if (!newobj)
+      return -1;
+    newobj->parent = newparent;
+    *pnew = newobj;
+    pnew = &newobj->next_sibling;
+  }
+  return 0;
+}
+
+/* Duplicate src and its children outside of any topology, keeping their gp_index.
+ * The result may be freed with hwloc_free_object_and_children().
+ */
+hwloc_obj_t
+hwloc__duplicate_detached_objects(struct hwloc_obj *src)
+{
+  hwloc_obj_t newobj;
+
+  newobj = malloc(sizeof(*newobj));
+  if (!newobj)
+    return NULL;
+  memset(newobj, 0, sizeof(*newobj));
+  newobj->attr = malloc(sizeof(*newobj->attr));
+  if (!newobj->attr) {
+    free(newobj);
+    return NULL;
+  }
+  hwloc__duplicate_object(newobj, src);
+  newobj->userdata = NULL;
+  newobj->depth = src->depth;
+
+  if (hwloc__duplicate_detached_siblings(newobj, &newobj->first_child, src->first_child) < 0
+      || hwloc__duplicate_detached_siblings(newobj, &newobj->io_first_child, src->io_first_child) < 0
+      || hwloc__duplicate_detached_siblings(newobj, &newobj->misc_first_child, src->misc_first_child) < 0) {
+    hwloc_free_object_and_children(newobj);
+    return NULL;
+  }
+
+  return newobj;
+}
+
 static void hwloc_propagate_symmetric_subtree(hwloc_topology_t topology, hwloc_obj_t root);
 static void propagate_total_memory(hwloc_obj_t obj);
 static void hwloc_set_group_depth(hwloc_topology_t topology);
@@ -731,6 +780,9 @@ hwloc_topology_dup(hwloc_topology_t *newp,
   if (hwloc_topology_reconnect(new, 0) < 0)
     goto out;
 
+  /* duplicated distances only have indexes, find the new objects */
+  hwloc_internal_distances_refresh(new);
+
 #ifndef HWLOC_DEBUG
   if (getenv("HWLOC_DEBUG_CHECK"))
 #endif
@@ -1127,10 +1179,9 @@ hwloc___insert_object_by_cpuset(struct hwloc_topology *topology, hwloc_obj_t cur
 	    && (obj->type == HWLOC_OBJ_PU || obj->type == HWLOC_OBJ_NUMANODE)
 	    && obj->os_index != child->os_index) {
 	  static int reported = 0;
-	  if (!reported && !hwloc_hide_errors()) {
+	  if (!hwloc_hide_errors() && !hwloc_test_and_set_flag(&reported)) {
 	    fprintf(stderr, "Cannot merge similar %s objects with different OS indexes %u and %u\n",
 		    hwloc_type_name(obj->type), child->os_index, obj->os_index);
-	    reported = 1;
 	  }
           return NULL;
 	}
@@ -1227,6 +1278,14 @@ hwloc__insert_object_by_cpuset(struct hwloc_topology *topology, hwloc_obj_t obj,
 
   /* Start at the top.  */
   result = hwloc___insert_object_by_cpuset(topology, topology->levels[0][0], obj, report_error);
+  if (topology->cur_discovery_stats) {
+    if (result == obj)
+      topology->cur_discovery_stats->nr_inserted++;
+    else if (result)
+      topology->cur_discovery_stats->nr_merged++;
+    else
+      topology->cur_discovery_stats->nr_dropped++;
+  }
   if (result != obj) {
     /* either failed to insert, or got merged, free the original object */
     hwloc_free_unlinked_object(obj);
@@ -1247,11 +1306,29 @@ hwloc_insert_object_by_cpuset(struct hwloc_topology *topology, hwloc_obj_t obj)
   return hwloc__insert_object_by_cpuset(topology, obj, hwloc_report_os_error);
 }
 
+/* count an object and the children that a backend may have attached before insertion (e.g. PCI bridges) */
+static unsigned long
+hwloc__count_subtree_objects(hwloc_obj_t obj)
+{
+  hwloc_obj_t child;
+  unsigned long count = 1;
+  for(child = obj->first_child; child; child = child->next_sibling)
+    count += hwloc__count_subtree_objects(child);
+  for(child = obj->io_first_child; child; child = child->next_sibling)
+    count += hwloc__count_subtree_objects(child);
+  for(child = obj->misc_first_child; child; child = child->next_sibling)
+    count += hwloc__count_subtree_objects(child);
+  return count;
+}
+
 void
 hwloc_insert_object_by_parent(struct hwloc_topology *topology, hwloc_obj_t parent, hwloc_obj_t obj)
 {
   hwloc_obj_t *current;
 
+  if (topology->cur_discovery_stats)
+    topology->cur_discovery_stats->nr_inserted += hwloc__count_subtree_objects(obj);
+
   if (obj->type == HWLOC_OBJ_MISC) {
     /* Append to the end of the Misc list */
     for (current = &parent->misc_first_child; *current; current = &(*current)->next_sibling);
@@ -2312,6 +2389,8 @@ hwloc_connect_io_misc_levels(hwloc_topology_t topology)
 
   free(topology->pcidev_level);
   topology->pcidev_level = NULL;
+  free(topology->pcidev_by_busid);
+  topology->pcidev_by_busid = NULL;
   topology->pcidev_nbobjects = 0;
   topology->first_pcidev = topology->last_pcidev = NULL;
 
@@ -2331,6 +2410,15 @@ hwloc_connect_io_misc_levels(hwloc_topology_t topology)
   topology->pcidev_nbobjects = hwloc_build_level_from_list(topology->first_pcidev, &topology->pcidev_level);
   topology->osdev_nbobjects = hwloc_build_level_from_list(topology->first_osdev, &topology->osdev_level);
   topology->misc_nbobjects = hwloc_build_level_from_list(topology->first_misc, &topology->misc_level);
+
+  /* sorted copy of the PCI level for hwloc_get_pcidev_by_busid() */
+  if (topology->pcidev_nbobjects) {
+    topology->pcidev_by_busid = malloc(topology->pcidev_nbobjects * sizeof(*topology->pcidev_by_busid));
+    if (topology->pcidev_by_busid) {
+      memcpy(topology->pcidev_by_busid, topology->pcidev_level, topology->pcidev_nbobjects * sizeof(*topology->pcidev_by_busid));
+      qsort(topology->pcidev_by_busid, topology->pcidev_nbobjects, sizeof(*topology->pcidev_by_busid), hwloc_pci_compare_busid_ptrs);
+    }
+  }
 }
 
 /*
@@ -2513,6 +2601,10 @@ hwloc_topology_reconnect(struct hwloc_topology *topology, unsigned long flags)
     errno = EINVAL;
     return -1;
   }
+
+  /* object sets may have changed even if no object was added or removed */
+  hwloc_topology_diff_invalidate_hashes(topology);
+
   if (!topology->modified)
     return 0;
 
@@ -2528,6 +2620,25 @@ hwloc_topology_reconnect(struct hwloc_topology *topology, unsigned long flags)
   return 0;
 }
 
+/* Reconnect a loaded topology after some objects were inserted or removed,
+ * and update what depends on the tree structure.
+ */
+int
+hwloc_topology_propagate_changes(struct hwloc_topology *topology)
+{
+  if (hwloc_topology_reconnect(topology, 0) < 0)
+    return -1;
+
+  /* some objects may have disappeared, we need to update distances objs arrays */
+  hwloc_internal_distances_invalidate_cached_objs(topology);
+  hwloc_internal_distances_refresh(topology);
+
+  hwloc_propagate_symmetric_subtree(topology, topology->levels[0][0]);
+  hwloc_set_group_depth(topology);
+  propagate_total_memory(topology->levels[0][0]);
+  return 0;
+}
+
 void hwloc_alloc_obj_cpusets(hwloc_obj_t obj)
 {
   if (!obj->cpuset)
@@ -2544,14 +2655,76 @@ void hwloc_alloc_obj_cpusets(hwloc_obj_t obj)
     obj->allowed_nodeset = hwloc_bitmap_alloc_full();
 }
 
+/* wall-clock time in microseconds, only used for computing durations */
+static unsigned long
+hwloc__discovery_time_us(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+  struct timespec ts;
+  if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+    return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+#elif defined HAVE_GETTIMEOFDAY
+  struct timeval tv;
+  if (!gettimeofday(&tv, NULL))
+    return tv.tv_sec * 1000000UL + tv.tv_usec;
+#endif
+  return 0;
+}
+
+/* call the discover() callback of a backend and record its statistics */
+static void
+hwloc__backend_discover(struct hwloc_topology *topology, struct hwloc_backend *backend)
+{
+  struct hwloc_topology_discovery_stats_s *stats = NULL;
+  unsigned long start;
+
+  if (topology->discovery_stats) {
+    stats = &topology->discovery_stats[topology->nr_discovery_stats++];
+    stats->name = backend->component->name;
+  }
+  topology->cur_discovery_stats = stats;
+
+  start = hwloc__discovery_time_us();
+  backend->discover(backend);
+  if (stats)
+    stats->time_us = hwloc__discovery_time_us() - start;
+
+  topology->cur_discovery_stats = NULL;
+}
+
+/* Forget the allowed sets exported by hwlocd, they describe the restrictions of the daemon */
+static void
+hwloc__daemon_reset_allowed_sets(hwloc_obj_t obj)
+{
+  hwloc_obj_t child;
+
+  if (obj->cpuset && obj->allowed_cpuset)
+    hwloc_bitmap_copy(obj->allowed_cpuset, obj->cpuset);
+  if (obj->nodeset && obj->allowed_nodeset)
+    hwloc_bitmap_copy(obj->allowed_nodeset, obj->nodeset);
+  for(child = obj->first_child; child; child = child->next_sibling)
+    hwloc__daemon_reset_allowed_sets(child);
+  /* No sets under I/O or Misc */
+}
+
 /* Main discovery loop */
 static int
 hwloc_discover(struct hwloc_topology *topology)
 {
   struct hwloc_backend *backend;
+  unsigned nr_backends = 0;
 
   topology->modified = 0; /* no need to reconnect yet */
 
+  /* allocate statistics for backends that have a discover() callback.
+   * if allocation fails, just don't record anything.
+   */
+  for(backend = topology->backends; backend; backend = backend->next)
+    if (backend->discover)
+      nr_backends++;
+  if (nr_backends)
+    topology->discovery_stats = calloc(nr_backends, sizeof(*topology->discovery_stats));
+
   /* discover() callbacks should use hwloc_insert to add objects initialized
    * through hwloc_alloc_setup_object.
    * For node levels, nodeset and memory must be initialized.
@@ -2598,7 +2771,7 @@ hwloc_discover(struct hwloc_topology *topology)
       goto next_cpubackend;
     if (!backend->discover)
       goto next_cpubackend;
-    backend->discover(backend);
+    hwloc__backend_discover(topology, backend);
     hwloc_debug_print_objects(0, topology->levels[0][0]);
 
 next_cpubackend:
@@ -2618,6 +2791,17 @@ next_cpubackend:
     return -1;
   }
 
+  if (topology->from_daemon) {
+    /* apply the restrictions of the target process instead of those of the daemon,
+     * as the native backend would have done */
+    hwloc_debug("%s", "\nReplace the allowed sets of the daemon with ours\n");
+    hwloc__daemon_reset_allowed_sets(topology->levels[0][0]);
+#ifdef HWLOC_LINUX_SYS
+    if (topology->is_thissystem)
+      hwloc_linux_restrict_allowed_resources(topology);
+#endif
+  }
+
   hwloc_debug("%s", "\nPropagate disallowed cpus down and up\n");
   hwloc_bitmap_and(topology->levels[0][0]->allowed_cpuset, topology->levels[0][0]->allowed_cpuset, topology->levels[0][0]->cpuset);
   propagate_unused_cpuset(topology->levels[0][0], NULL);
@@ -2699,7 +2883,7 @@ next_cpubackend:
       goto next_noncpubackend;
     if (!backend->discover)
       goto next_noncpubackend;
-    backend->discover(backend);
+    hwloc__backend_discover(topology, backend);
     hwloc_debug_print_objects(0, topology->levels[0][0]);
 
 next_noncpubackend:
@@ -2786,12 +2970,18 @@ hwloc_topology_setup_defaults(struct hwloc_topology *topology)
   /* NULLify other levels */
   topology->bridge_level = NULL;
   topology->pcidev_level = NULL;
+  topology->pcidev_by_busid = NULL;
   topology->osdev_level = NULL;
   topology->first_bridge = topology->last_bridge = NULL;
   topology->first_pcidev = topology->last_pcidev = NULL;
   topology->first_osdev = topology->last_osdev = NULL;
   topology->misc_level = NULL;
   topology->first_misc = topology->last_misc = NULL;
+  topology->diff_hashes = NULL;
+  topology->nr_diff_hashes = 0;
+  topology->discovery_stats = NULL;
+  topology->nr_discovery_stats = 0;
+  topology->cur_discovery_stats = NULL;
   /* sane values to type_depth */
   for (l = HWLOC_OBJ_SYSTEM; l < HWLOC_OBJ_MISC; l++)
     topology->type_depth[l] = HWLOC_TYPE_DEPTH_UNKNOWN;
@@ -3012,11 +3202,14 @@ hwloc_topology_clear (struct hwloc_topology *topology)
   /* no need to set to NULL after free() since callers will call setup_defaults() or just destroy the rest of the topology */
   unsigned l;
   hwloc_internal_distances_destroy(topology);
+  hwloc_topology_diff_invalidate_hashes(topology);
+  free(topology->discovery_stats);
   hwloc_free_object_and_children(topology->levels[0][0]);
   for (l=0; l<topology->nb_levels; l++)
     free(topology->levels[l]);
   free(topology->bridge_level);
   free(topology->pcidev_level);
+  free(topology->pcidev_by_busid);
   free(topology->osdev_level);
   free(topology->misc_level);
 }
@@ -3053,6 +3246,8 @@ hwloc_topology_load (struct hwloc_topology *topology)
   if (getenv("HWLOC_XML_USERDATA_NOT_DECODED"))
     topology->userdata_not_decoded = 1;
 
+  topology->from_daemon = 0;
+
   /* Ignore variables if HWLOC_COMPONENTS is set. It will be processed later */
   if (!getenv("HWLOC_COMPONENTS")) {
     /* Only apply variables if we have not changed the backend yet.
@@ -3094,6 +3289,29 @@ hwloc_topology_load (struct hwloc_topology *topology)
 					  -1, "xml",
 					  xmlpath_env, NULL, NULL);
     }
+    if (!topology->backends) {
+      const char *daemon_env = getenv("HWLOC_DAEMON_SOCKET");
+      if (daemon_env && *daemon_env) {
+	char *buffer;
+	int buflen;
+	if (!hwloc__daemon_get_xmlbuffer(daemon_env, &buffer, &buflen)) {
+	  /* the XML backend copies the buffer during instantiate */
+	  if (!hwloc_disc_component_force_enable(topology,
+						 1 /* env force */,
+						 -1, "xml",
+						 NULL, buffer, (void*)(uintptr_t)buflen)) {
+	    /* the daemon runs on this system, don't disable binding */
+	    topology->backends->is_thissystem = -1;
+	    topology->from_daemon = 1;
+	  }
+	  free(buffer);
+	} else {
+	  /* silently fallback to the normal discovery */
+	  hwloc_debug("Failed to get topology from daemon socket %s (%s), discovering locally\n",
+		      daemon_env, strerror(errno));
+	}
+      }
+    }
   }
 
   /* instantiate all possible other backends now */
@@ -3121,12 +3339,14 @@ hwloc_topology_load (struct hwloc_topology *topology)
 #endif
     hwloc_topology_check(topology);
 
-  /* Mark distances objs arrays as invalid since we may have removed objects
+  /* Refresh distances objs arrays since we may have removed objects
    * from the topology after adding the distances (remove_empty, etc).
    * It would be hard to actually verify whether it's needed.
-   * We'll refresh them if users ever actually look at distances.
+   * This is done now rather than when users look at distances
+   * so that queries never modify a loaded topology.
    */
   hwloc_internal_distances_invalidate_cached_objs(topology);
+  hwloc_internal_distances_refresh(topology);
 
   topology->is_loaded = 1;
   return 0;
@@ -3230,6 +3450,7 @@ hwloc_topology_restrict(struct hwloc_topology *topology, hwloc_const_cpuset_t cp
 
   /* some objects may have disappeared, we need to update distances objs arrays */
   hwloc_internal_distances_invalidate_cached_objs(topology);
+  hwloc_internal_distances_refresh(topology);
 
   hwloc_filter_levels_keep_structure(topology);
   hwloc_propagate_symmetric_subtree(topology, topology->levels[0][0]);
@@ -3261,6 +3482,23 @@ hwloc_topology_get_support(struct hwloc_topology * topology)
   return &topology->support;
 }
 
+int
+hwloc_topology_get_discovery_stats(struct hwloc_topology * topology,
+				   unsigned *nr, struct hwloc_topology_discovery_stats_s *stats)
+{
+  unsigned i;
+
+  if (!topology->is_loaded) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for(i=0; i<*nr && i<topology->nr_discovery_stats; i++)
+    stats[i] = topology->discovery_stats[i];
+  *nr = topology->nr_discovery_stats;
+  return 0;
+}
+
 void hwloc_topology_set_userdata(struct hwloc_topology * topology, const void *userdata)
 {
   topology->userdata = (void *) userdata;
@@ -119,6 +119,51 @@ unsigned hwloc_get_closest_objs (struct hwloc_topology *topology, struct hwloc_o
   return stored;
 }
 
+unsigned hwloc_get_io_closest_objs (struct hwloc_topology *topology, struct hwloc_obj *ioobj, hwloc_obj_type_t type,
+				    struct hwloc_obj **objs, unsigned max)
+{
+  struct hwloc_obj *parent, *nextparent, **level_objs;
+  int depth;
+  unsigned i, nbobjs;
+  unsigned stored = 0;
+
+  depth = hwloc_get_type_depth(topology, type);
+  if (depth < 0)
+    return 0;
+  nbobjs = topology->level_nbobjects[depth];
+  level_objs = topology->levels[depth];
+
+  parent = hwloc_get_non_io_ancestor_obj(topology, ioobj);
+  if (!parent)
+    return 0;
+
+  /* objects intersecting the I/O locality first */
+  for(i=0; i<nbobjs && stored<max; i++)
+    if (hwloc_bitmap_intersects(level_objs[i]->cpuset, parent->cpuset))
+      objs[stored++] = level_objs[i];
+
+  /* then those that intersect larger and larger ancestors */
+  while (stored < max) {
+    while (1) {
+      nextparent = parent->parent;
+      if (!nextparent)
+	goto out;
+      if (!hwloc_bitmap_isequal(parent->cpuset, nextparent->cpuset))
+	break;
+      parent = nextparent;
+    }
+
+    for(i=0; i<nbobjs && stored<max; i++)
+      if (hwloc_bitmap_intersects(level_objs[i]->cpuset, nextparent->cpuset)
+	  && !hwloc_bitmap_intersects(level_objs[i]->cpuset, parent->cpuset))
+	objs[stored++] = level_objs[i];
+    parent = nextparent;
+  }
+
+ out:
+  return stored;
+}
+
 static int
 hwloc__get_largest_objs_inside_cpuset (struct hwloc_obj *current, hwloc_const_bitmap_t set,
 				       struct hwloc_obj ***res, int *max)
@@ -175,6 +220,46 @@ hwloc_get_largest_objs_inside_cpuset (struct hwloc_topology *topology, hwloc_con
   return hwloc__get_largest_objs_inside_cpuset (current, set, &objs, &max);
 }
 
+hwloc_obj_t
+hwloc_get_pcidev_by_busid(struct hwloc_topology *topology,
+			  unsigned domain, unsigned bus, unsigned dev, unsigned func)
+{
+  hwloc_uint64_t key = hwloc_pci_busid_key(domain, bus, dev, func);
+  unsigned lo, hi;
+
+  if (domain > 0xffff || bus > 0xff || dev > 0xff || func > 0xff)
+    return NULL;
+
+  if (!topology->pcidev_by_busid) {
+    /* failed to allocate the sorted array, walk the level */
+    hwloc_obj_t obj = NULL;
+    while ((obj = hwloc_get_next_pcidev(topology, obj)) != NULL) {
+      if (obj->attr->pcidev.domain == domain
+	  && obj->attr->pcidev.bus == bus
+	  && obj->attr->pcidev.dev == dev
+	  && obj->attr->pcidev.func == func)
+	return obj;
+    }
+    return NULL;
+  }
+
+  lo = 0;
+  hi = topology->pcidev_nbobjects;
+  while (lo < hi) {
+    unsigned mid = (lo+hi)/2;
+    hwloc_obj_t obj = topology->pcidev_by_busid[mid];
+    hwloc_uint64_t midkey = hwloc_pci_busid_key(obj->attr->pcidev.domain, obj->attr->pcidev.bus,
+						obj->attr->pcidev.dev, obj->attr->pcidev.func);
+    if (midkey == key)
+      return obj;
+    if (midkey < key)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  return NULL;
+}
+
 const char *
 hwloc_type_name (hwloc_obj_type_t obj)
 {
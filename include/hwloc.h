@@ -90,7 +90,7 @@ extern "C" {
 HWLOC_DECLSPEC unsigned hwloc_get_api_version(void);
 
 /** \brief Current component and plugin ABI version (see hwloc/plugins.h) */
-#define HWLOC_COMPONENT_ABI 5
+#define HWLOC_COMPONENT_ABI 6
 
 /** @} */
 
@@ -1552,6 +1552,47 @@ HWLOC_DECLSPEC void *hwloc_alloc_membind(hwloc_topology_t topology, size_t len,
 static __hwloc_inline void *
 hwloc_alloc_membind_policy(hwloc_topology_t topology, size_t len, hwloc_const_bitmap_t set, hwloc_membind_policy_t policy, int flags) __hwloc_attribute_malloc;
 
+/** \brief Allocate some memory striped across the NUMA nodes of several objects
+ *
+ * The buffer is split into consecutive stripes of \p stripe_size bytes.
+ * Stripes are bound in a round-robin manner to the NUMA node(s) of the
+ * \p nr_objs objects given in the \p objs array, in this order.
+ * Contrary to ::HWLOC_MEMBIND_INTERLEAVE which interleaves individual pages
+ * among the nodes of a single set, this lets the caller choose the granularity
+ * (for instance 2MB for huge pages) and the order of targets.
+ * Any object with a non-empty nodeset may be given, for instance NUMA nodes,
+ * Packages or caches.
+ *
+ * If \p weights is not \c NULL, it must contain \p nr_objs integers.
+ * Object \p objs[i] then receives \p weights[i] consecutive stripes
+ * before moving to the next object. This may be used to spread bandwidth-bound
+ * data between different kinds of memory (e.g. 3 stripes on high-bandwidth
+ * memory for 1 stripe on DDR). Objects with a null weight are ignored.
+ * If \p weights is \c NULL, each object receives one stripe per round.
+ *
+ * \p stripe_size must be a multiple of the page size.
+ * The last stripe may be smaller if \p len is not a multiple of \p stripe_size.
+ *
+ * \p flags may only contain ::HWLOC_MEMBIND_STRICT and ::HWLOC_MEMBIND_NOCPUBIND.
+ * If ::HWLOC_MEMBIND_STRICT is given, the allocation fails if any stripe
+ * cannot be bound. Otherwise stripes that cannot be bound are left
+ * with the default policy.
+ *
+ * \return NULL with errno set to EINVAL if \p stripe_size is invalid,
+ * if an object does not have a nodeset, or if all weights are null.
+ * \return NULL with errno set to ENOSYS if the action is not supported
+ * and ::HWLOC_MEMBIND_STRICT is given
+ * \return NULL with errno set to EXDEV if the binding cannot be enforced
+ * and ::HWLOC_MEMBIND_STRICT is given
+ * \return NULL with errno set to ENOMEM if the memory allocation failed
+ * even before trying to bind.
+ *
+ * \note The allocated memory should be freed with hwloc_free().
+ */
+HWLOC_DECLSPEC void *hwloc_alloc_membind_striped(hwloc_topology_t topology, size_t len, size_t stripe_size,
+						 unsigned nr_objs, hwloc_obj_t *objs, const unsigned *weights,
+						 int flags) __hwloc_attribute_malloc;
+
 /** \brief Free memory that was previously allocated by hwloc_alloc()
  * or hwloc_alloc_membind().
  */
@@ -1862,6 +1903,51 @@ struct hwloc_topology_support {
  */
 HWLOC_DECLSPEC const struct hwloc_topology_support *hwloc_topology_get_support(hwloc_topology_t __hwloc_restrict topology);
 
+/** \brief Discovery statistics of a backend.
+ *
+ * Retrieved with hwloc_topology_get_discovery_stats().
+ */
+struct hwloc_topology_discovery_stats_s {
+  /** \brief Name of the discovery component of this backend (e.g. "linux", "x86", "pci"). */
+  const char *name;
+  /** \brief Wall-clock time spent in the discovery callback of this backend, in microseconds. */
+  unsigned long time_us;
+  /** \brief Number of objects inserted in the topology by this backend. */
+  unsigned long nr_inserted;
+  /** \brief Number of objects merged into identical objects that were already in the topology. */
+  unsigned long nr_merged;
+  /** \brief Number of objects dropped because they conflicted with the existing topology. */
+  unsigned long nr_dropped;
+};
+
+/** \brief Retrieve per-backend discovery statistics.
+ *
+ * Backends are listed in the order of their discovery callbacks:
+ * CPU and global backends first, then additional backends such as I/O.
+ * Backends without discovery callback are not listed.
+ *
+ * On input, \p nr points to the number of structures that may be stored in
+ * the \p stats array.
+ * On output, \p nr points to the number of backends that actually performed discovery,
+ * even if it's larger than the initial value of \p nr
+ * (only the first ones are stored in \p stats then).
+ * Hence the number of backends may be queried by passing \c 0 in \p *nr
+ * and \c NULL in \p stats.
+ *
+ * Objects that are removed by the core after discovery
+ * (because of type filters or because they are empty)
+ * are still counted as inserted by their backend.
+ *
+ * \p name strings remain valid until the topology is destroyed.
+ *
+ * Statistics are not exported to XML and not kept by hwloc_topology_dup().
+ *
+ * \return -1 with errno set to \c EINVAL if the topology is not loaded.
+ *
+ * \note These statistics are also reported by lstopo \--stats.
+ */
+HWLOC_DECLSPEC int hwloc_topology_get_discovery_stats(hwloc_topology_t topology, unsigned *nr, struct hwloc_topology_discovery_stats_s *stats);
+
 /** \brief Type filtering flags.
  *
  * By default, most objects are kept (::HWLOC_TYPE_FILTER_KEEP_ALL).
@@ -2150,6 +2236,9 @@ HWLOC_DECLSPEC int hwloc_obj_add_other_obj_sets(hwloc_obj_t dst, hwloc_obj_t src
 /* topology diffs */
 #include <hwloc/diff.h>
 
+/* memory pools */
+#include <hwloc/mempool.h>
+
 /* deprecated headers */
 #include <hwloc/deprecated.h>
 
@@ -37,14 +37,16 @@ extern "C" {
  * applying the precomputed difference to the reference topology.
  *
  * This interface targets very similar nodes.
- * Only very simple differences between topologies are actually
- * supported, for instance a change in the memory size, the name
- * of the object, or some info attribute.
- * More complex differences such as adding or removing objects cannot
- * be represented in the difference structures and therefore return
- * errors.
- *
- * It means that there is no need to apply the difference when
+ * Supported differences include a change in the memory size, the name
+ * of the object, some info attribute, or the CPU and node sets of objects.
+ * Entire subtrees may also be inserted or removed, for instance
+ * when a core is offline or a memory module is missing on some nodes.
+ * Other differences, such as a change in the type or in the
+ * type-specific attributes of an object, cannot be represented in
+ * the difference structures and therefore return errors.
+ *
+ * If the difference contains no insertion or removal and no set
+ * modification, there is no need to apply it when
  * looking at the tree organization (how many levels, how many
  * objects per level, what kind of objects, CPU and node sets, etc)
  * and when binding to objects.
@@ -73,9 +75,25 @@ typedef enum hwloc_topology_diff_obj_attr_type_e {
   /** \brief the value of an info attribute is modified.
    * The union is a hwloc_topology_diff_obj_attr_u::hwloc_topology_diff_obj_attr_string_s.
    */
-  HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_INFO
+  HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_INFO,
+
+  /** \brief One of the CPU or node sets of the object is modified.
+   * The union is a hwloc_topology_diff_obj_attr_u::hwloc_topology_diff_obj_attr_set_s.
+   */
+  HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET
 } hwloc_topology_diff_obj_attr_type_t;
 
+/** \brief Object set modified by a ::HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET difference.
+ */
+typedef enum hwloc_topology_diff_obj_set_e {
+  HWLOC_TOPOLOGY_DIFF_OBJ_SET_CPUSET,		/**< \brief The cpuset field of the object. */
+  HWLOC_TOPOLOGY_DIFF_OBJ_SET_COMPLETE_CPUSET,	/**< \brief The complete_cpuset field of the object. */
+  HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_CPUSET,	/**< \brief The allowed_cpuset field of the object. */
+  HWLOC_TOPOLOGY_DIFF_OBJ_SET_NODESET,		/**< \brief The nodeset field of the object. */
+  HWLOC_TOPOLOGY_DIFF_OBJ_SET_COMPLETE_NODESET,	/**< \brief The complete_nodeset field of the object. */
+  HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET	/**< \brief The allowed_nodeset field of the object. */
+} hwloc_topology_diff_obj_set_t;
+
 /** \brief One object attribute difference.
  */
 union hwloc_topology_diff_obj_attr_u {
@@ -101,6 +119,15 @@ union hwloc_topology_diff_obj_attr_u {
     char *oldvalue;
     char *newvalue;
   } string;
+
+  /** \brief CPU or node set modification */
+  struct hwloc_topology_diff_obj_attr_set_s {
+    /* used for storing cpusets and nodesets */
+    hwloc_topology_diff_obj_attr_type_t type;
+    hwloc_topology_diff_obj_set_t index; /* which set of the object is modified */
+    hwloc_bitmap_t oldvalue;
+    hwloc_bitmap_t newvalue;
+  } set;
 };
 
 
@@ -119,7 +146,17 @@ typedef enum hwloc_topology_diff_type_e {
    *
    * The union is a hwloc_topology_diff_obj_attr_u::hwloc_topology_diff_too_complex_s.
    */
-  HWLOC_TOPOLOGY_DIFF_TOO_COMPLEX
+  HWLOC_TOPOLOGY_DIFF_TOO_COMPLEX,
+
+  /** \brief An object and its children were inserted.
+   * The union is a hwloc_topology_diff_u::hwloc_topology_diff_obj_subtree_s.
+   */
+  HWLOC_TOPOLOGY_DIFF_OBJ_INSERT,
+
+  /** \brief An object and its children were removed.
+   * The union is a hwloc_topology_diff_u::hwloc_topology_diff_obj_subtree_s.
+   */
+  HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE
 } hwloc_topology_diff_type_t;
 
 /** \brief One element of a difference list between two topologies.
@@ -149,9 +186,49 @@ typedef union hwloc_topology_diff_u {
     unsigned obj_depth;
     unsigned obj_index;
   } too_complex;
+
+  /* An object subtree that was inserted or removed. */
+  struct hwloc_topology_diff_obj_subtree_s {
+    hwloc_topology_diff_type_t type; /* must be ::HWLOC_TOPOLOGY_DIFF_OBJ_INSERT or ::HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE */
+    union hwloc_topology_diff_u * next;
+    /* Depth of the parent object, identical in both topologies */
+    unsigned parent_depth;
+    /* Logical index of the parent object in the first and second topologies */
+    unsigned old_parent_index;
+    unsigned new_parent_index;
+    /* Position of the object among the children of the parent
+     * (in the normal, I/O or Misc list, depending on its type),
+     * in the second topology for insertions, in the first topology for removals.
+     */
+    unsigned position;
+    /* Copy of the inserted or removed object and its children,
+     * not attached to any topology.
+     */
+    hwloc_obj_t obj;
+  } obj_subtree;
 } * hwloc_topology_diff_t;
 
 
+/** \brief Flags to be given to hwloc_topology_diff_build().
+ */
+enum hwloc_topology_diff_build_flags_e {
+  /** \brief Skip identical subtrees by comparing hashes of their contents.
+   *
+   * A hash of each subtree (structure, attributes and sets) is computed
+   * on first use and cached in each topology, so that building many diffs
+   * against the same reference topology only walks subtrees that differ.
+   *
+   * Cached hashes are dropped when the topology is modified by hwloc,
+   * for instance by hwloc_topology_diff_apply(), hwloc_topology_restrict()
+   * or hwloc_topology_insert_misc_object().
+   * This flag must not be used if objects were modified directly by the
+   * application (including with hwloc_obj_add_info()) since hashes
+   * were computed.
+   * \hideinitializer
+   */
+  HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES = (1UL<<0)
+};
+
 /** \brief Compute the difference between 2 topologies.
  *
  * The difference is stored as a list of ::hwloc_topology_diff_t entries
@@ -159,9 +236,13 @@ typedef union hwloc_topology_diff_u {
  * It is computed by doing a depth-first traversal of both topology trees
  * simultaneously.
  *
+ * Children of both objects are matched by type, OS index and CPU set.
+ * Unmatched children are reported as inserted or removed subtrees.
+ *
  * If the difference between 2 objects is too complex to be represented
- * (for instance if some objects have different types, or different numbers
- * of children), a special diff entry of type ::HWLOC_TOPOLOGY_DIFF_TOO_COMPLEX
+ * (for instance if the root objects have different types, or if matching
+ * objects have different type-specific attributes or info names),
+ * a special diff entry of type ::HWLOC_TOPOLOGY_DIFF_TOO_COMPLEX
  * is queued.
  * The computation of the diff does not continue below these objects.
  * So each such diff entry means that the difference between two subtrees
@@ -177,7 +258,7 @@ typedef union hwloc_topology_diff_u {
  *
  * \return -1 on any other error.
  *
- * \note \p flags is currently not used. It should be 0.
+ * \p flags is an OR'ed set of ::hwloc_topology_diff_build_flags_e.
  *
  * \note The output diff has to be freed with hwloc_topology_diff_destroy().
  *
@@ -191,6 +272,48 @@ typedef union hwloc_topology_diff_u {
 */
 HWLOC_DECLSPEC int hwloc_topology_diff_build(hwloc_topology_t topology, hwloc_topology_t newtopology, unsigned long flags, hwloc_topology_diff_t *diff);
 
+/** \brief Flags to be given to hwloc_topology_fingerprint().
+ */
+enum hwloc_topology_fingerprint_flags_e {
+  /** \brief Include I/O objects (bridges, PCI and OS devices) and their attributes.
+   * \hideinitializer
+   */
+  HWLOC_TOPOLOGY_FINGERPRINT_FLAG_IO = (1UL<<0),
+
+  /** \brief Include object names, info attributes and Misc objects.
+   * \hideinitializer
+   */
+  HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS = (1UL<<1)
+};
+
+/** \brief Compute a fingerprint of a topology.
+ *
+ * Hash the structure of the topology, the type, subtype, OS index,
+ * CPU and NUMA node sets, memory and type-specific attributes
+ * of each object, in a single traversal, and store the result
+ * in \p fingerprint.
+ *
+ * Topologies of machines with identical hardware get the same fingerprint,
+ * so that they may be grouped without building a diff between each pair
+ * with hwloc_topology_diff_build().
+ * Different fingerprints mean that the topologies differ,
+ * while identical fingerprints only mean that they are very likely identical.
+ *
+ * Allowed CPU and NUMA node sets are ignored since they depend on
+ * administrative restrictions rather than on the hardware.
+ * Distances are ignored too.
+ *
+ * The fingerprint does not depend on the order of discovery or on the host
+ * where it is computed, it may be stored and compared across machines
+ * and hwloc runs.
+ *
+ * \p flags is an OR'ed set of ::hwloc_topology_fingerprint_flags_e.
+ *
+ * \return -1 with errno set to \c EINVAL if the topology is not loaded
+ * or if \p flags is invalid.
+ */
+HWLOC_DECLSPEC int hwloc_topology_fingerprint(hwloc_topology_t topology, unsigned long flags, hwloc_uint64_t *fingerprint);
+
 /** \brief Flags to be given to hwloc_topology_diff_apply().
  */
 enum hwloc_topology_diff_apply_flags_e {
@@ -210,6 +333,10 @@ enum hwloc_topology_diff_apply_flags_e {
  * If the difference cannot be applied entirely, all previous applied
  * elements are unapplied before returning.
  *
+ * Insertions and removals of subtrees are checked before anything
+ * is modified. When applying in reverse direction, they are applied
+ * before attribute differences since those are relative to the first topology.
+ *
  * \return 0 on success.
  *
  * \return -N if applying the difference failed while trying
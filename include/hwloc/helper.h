@@ -969,6 +969,57 @@ hwloc_get_non_io_ancestor_obj(hwloc_topology_t topology __hwloc_attribute_unused
   return obj;
 }
 
+/** \brief Get the bandwidth bottleneck between a PCI object and its host bridge.
+ *
+ * Return the lowest link speed (in GB/s) among the PCI device or bridge \p obj
+ * and all PCI bridges above it. This is the bandwidth that \p obj may
+ * actually achieve when talking to the host.
+ * If \p obj is an OS device, its PCI parent is used.
+ * Links whose speed is unknown are ignored.
+ *
+ * \return 0 if no link speed is known.
+ */
+static __hwloc_inline float
+hwloc_get_pci_path_linkspeed(hwloc_topology_t topology __hwloc_attribute_unused,
+			     hwloc_obj_t obj)
+{
+  float linkspeed = 0;
+  if (obj->type == HWLOC_OBJ_OS_DEVICE)
+    obj = obj->parent;
+  while (obj) {
+    float speed;
+    if (obj->type == HWLOC_OBJ_PCI_DEVICE)
+      speed = obj->attr->pcidev.linkspeed;
+    else if (obj->type == HWLOC_OBJ_BRIDGE
+	     && obj->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_PCI)
+      speed = obj->attr->bridge.upstream.pci.linkspeed;
+    else
+      break;
+    if (speed > 0 && (!linkspeed || speed < linkspeed))
+      linkspeed = speed;
+    obj = obj->parent;
+  }
+  return linkspeed;
+}
+
+/** \brief Find the objects of type \p type that are the closest to an I/O object.
+ *
+ * Report in \p objs up to \p max objects of type \p type sorted by
+ * their affinity with the I/O object \p ioobj.
+ * Objects intersecting the locality of \p ioobj (the CPU set of its
+ * first non-I/O ancestor, usually a NUMA node) come first,
+ * followed by objects that are farther and farther in the topology.
+ *
+ * For instance, the first cores returned for a NIC or NVMe device are the
+ * best candidates for running the threads that drive it.
+ *
+ * \return the number of objects returned in \p objs.
+ *
+ * \return 0 if \p type does not exist at a single depth in the topology
+ * or if it is an I/O or Misc type.
+ */
+HWLOC_DECLSPEC unsigned hwloc_get_io_closest_objs(hwloc_topology_t topology, hwloc_obj_t ioobj, hwloc_obj_type_t type, hwloc_obj_t * __hwloc_restrict objs, unsigned max);
+
 /** \brief Get the next PCI device in the system.
  *
  * \return the first PCI device if \p prev is \c NULL.
@@ -981,21 +1032,13 @@ hwloc_get_next_pcidev(hwloc_topology_t topology, hwloc_obj_t prev)
 
 /** \brief Find the PCI device object matching the PCI bus id
  * given domain, bus device and function PCI bus id.
+ *
+ * PCI devices are indexed by bus ID when the topology is loaded,
+ * hence this lookup doesn't need to traverse all of them.
  */
-static __hwloc_inline hwloc_obj_t
+HWLOC_DECLSPEC hwloc_obj_t
 hwloc_get_pcidev_by_busid(hwloc_topology_t topology,
-			  unsigned domain, unsigned bus, unsigned dev, unsigned func)
-{
-  hwloc_obj_t obj = NULL;
-  while ((obj = hwloc_get_next_pcidev(topology, obj)) != NULL) {
-    if (obj->attr->pcidev.domain == domain
-	&& obj->attr->pcidev.bus == bus
-	&& obj->attr->pcidev.dev == dev
-	&& obj->attr->pcidev.func == func)
-      return obj;
-  }
-  return NULL;
-}
+			  unsigned domain, unsigned bus, unsigned dev, unsigned func);
 
 /** \brief Find the PCI device object matching the PCI bus id
  * given as a string xxxx:yy:zz.t or yy:zz.t.
@@ -66,6 +66,50 @@ HWLOC_DECLSPEC int hwloc_linux_get_tid_cpubind(hwloc_topology_t topology, pid_t
  */
 HWLOC_DECLSPEC int hwloc_linux_get_tid_last_cpu_location(hwloc_topology_t topology, pid_t tid, hwloc_bitmap_t set);
 
+/** \brief Memory placement of a single mapping of a Linux process.
+ *
+ * Filled by hwloc_linux_get_proc_numa_maps() from one line of
+ * the /proc/<pid>/numa_maps file.
+ */
+struct hwloc_linux_numa_map_s {
+  unsigned long start;			/**< \brief Start address of the mapping. */
+  hwloc_membind_policy_t policy;	/**< \brief Memory binding policy requested for this mapping.
+					 * ::HWLOC_MEMBIND_DEFAULT if the process policy applies,
+					 * ::HWLOC_MEMBIND_MIXED if the kernel policy has no hwloc equivalent. */
+  int policy_flags;			/**< \brief ::HWLOC_MEMBIND_STRICT if the kernel policy is a strict binding, 0 otherwise. */
+  hwloc_nodeset_t policy_nodeset;	/**< \brief NUMA nodes given in the policy, empty if the policy does not specify any. */
+  unsigned long page_size;		/**< \brief Size of the pages of this mapping, in bytes. */
+  unsigned long nr_pages;		/**< \brief Total number of resident pages in this mapping. */
+  unsigned nr_node_pages;		/**< \brief Number of entries in \p node_pages. */
+  unsigned long *node_pages;		/**< \brief Number of resident pages on each NUMA node, indexed by node OS index. */
+  char *name;				/**< \brief Mapped file path, \c "heap", \c "stack", or \c NULL for anonymous memory. */
+};
+
+/** \brief Get the memory placement of all mappings of process \p pid
+ *
+ * Parse /proc/<pid>/numa_maps and store in \p *mapsp a newly allocated
+ * array of \p *nrp structures describing, for each mapping, the policy
+ * that was requested and the number of pages that are actually resident
+ * on each NUMA node.
+ * If \p pid is 0, the current process is used.
+ *
+ * This lets one compare the actual memory placement of another process
+ * with its binding without walking its address space page by page
+ * with hwloc_get_area_memlocation().
+ *
+ * The array must be released with hwloc_linux_free_proc_numa_maps().
+ *
+ * \p flags must be 0.
+ *
+ * \return -1 with errno set to \c ENOSYS if the kernel does not provide numa_maps
+ * (no NUMA support), \c ESRCH if the process does not exist,
+ * or \c EACCES if permissions are insufficient.
+ */
+HWLOC_DECLSPEC int hwloc_linux_get_proc_numa_maps(hwloc_topology_t topology, pid_t pid, struct hwloc_linux_numa_map_s **mapsp, unsigned *nrp, unsigned long flags);
+
+/** \brief Free an array returned by hwloc_linux_get_proc_numa_maps() */
+HWLOC_DECLSPEC void hwloc_linux_free_proc_numa_maps(struct hwloc_linux_numa_map_s *maps, unsigned nr);
+
 /** @} */
 
 
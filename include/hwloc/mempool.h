@@ -0,0 +1,163 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+/** \file
+ * \brief Pooled memory allocation on NUMA nodes.
+ */
+
+#ifndef HWLOC_MEMPOOL_H
+#define HWLOC_MEMPOOL_H
+
+#ifndef HWLOC_H
+#error Please include the main hwloc.h instead
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#elif 0
+}
+#endif
+
+
+/** \defgroup hwlocality_mempool Pooled memory allocation
+ *
+ * hwloc_alloc_membind() and hwloc_free() directly map to the operating
+ * system allocation and binding functions, which means that each of them
+ * usually costs one or several system calls.
+ * Applications that allocate and release many small or mid-sized buffers
+ * on specific NUMA nodes may use a memory pool instead.
+ *
+ * A pool obtains large chunks of memory from hwloc_alloc_membind()
+ * with the memory binding given at creation, and splits them into blocks
+ * whose size is a power of two. Released blocks are kept in the pool
+ * and reused by later allocations of the same size class.
+ * Once the pool is warm, allocating and releasing blocks does not involve
+ * any system call anymore.
+ * Allocations larger than ::HWLOC_MEMPOOL_MAX_BLOCK_SIZE bypass the pool
+ * and are directly passed to hwloc_alloc_membind() and hwloc_free().
+ *
+ * Pools are thread-safe. If ::HWLOC_MEMPOOL_FLAG_THREAD_CACHE is given
+ * at creation, each thread also keeps a small private cache of blocks
+ * so that most allocations and releases do not even take the pool lock.
+ *
+ * Memory is only returned to the operating system when the pool is destroyed.
+ *
+ * One pool is usually created for each NUMA node, for instance by passing
+ * the nodeset of a NUMA node object with ::HWLOC_MEMBIND_BYNODESET.
+ *
+ * @{
+ */
+
+/** \brief Handle to a memory pool. */
+typedef struct hwloc_mempool_s * hwloc_mempool_t;
+
+/** \brief Smallest block size (in bytes) returned by a memory pool.
+ *
+ * Smaller allocations are rounded up to this size.
+ * Blocks are always aligned on this size.
+ */
+#define HWLOC_MEMPOOL_MIN_BLOCK_SIZE 64
+
+/** \brief Largest block size (in bytes) served from the pool chunks.
+ *
+ * Larger allocations bypass the pool.
+ */
+#define HWLOC_MEMPOOL_MAX_BLOCK_SIZE (256*1024)
+
+/** \brief Flags for creating memory pools.
+ */
+enum hwloc_mempool_flags_e {
+  /** \brief Keep a cache of free blocks in each thread using the pool.
+   *
+   * Blocks cached by a thread are given back to the pool when the thread
+   * exits, or when the cache grows too large.
+   * This flag is ignored if thread-local storage is not supported.
+   * \hideinitializer
+   */
+  HWLOC_MEMPOOL_FLAG_THREAD_CACHE = (1UL<<0)
+};
+
+/** \brief Create a memory pool whose memory is bound to \p set with \p policy.
+ *
+ * \p set, \p policy and \p membind_flags are passed to hwloc_alloc_membind()
+ * whenever the pool needs a new chunk of memory.
+ * ::HWLOC_MEMBIND_STRICT is recommended so that the pool fails to grow
+ * instead of silently allocating unbound memory.
+ * ::HWLOC_MEMBIND_FIRSTTOUCH may be used to let the operating system
+ * place each page where it is first touched.
+ *
+ * \p chunk_size is the amount of memory that is requested from the operating
+ * system when the pool grows. If 0, a default of 2MB is used.
+ * It is rounded up to a multiple of ::HWLOC_MEMPOOL_MAX_BLOCK_SIZE.
+ *
+ * \p flags is a OR'ed set of ::hwloc_mempool_flags_e.
+ *
+ * \return NULL with errno set to EINVAL if some flags or the chunk size are invalid.
+ * \return NULL with errno set to ENOMEM if the pool structure could not be allocated.
+ *
+ * \note The topology must remain valid until the pool is destroyed.
+ */
+HWLOC_DECLSPEC hwloc_mempool_t hwloc_mempool_create(hwloc_topology_t topology,
+						    hwloc_const_bitmap_t set, hwloc_membind_policy_t policy, int membind_flags,
+						    size_t chunk_size, unsigned long flags);
+
+/** \brief Allocate \p len bytes from memory pool \p pool.
+ *
+ * \return NULL with errno set to ENOMEM if the pool could not grow,
+ * for instance because the binding could not be enforced while
+ * ::HWLOC_MEMBIND_STRICT was given at creation.
+ *
+ * \note The allocated memory should be freed with hwloc_mempool_free()
+ * with the same \p len.
+ */
+HWLOC_DECLSPEC void * hwloc_mempool_alloc(hwloc_mempool_t pool, size_t len) __hwloc_attribute_malloc;
+
+/** \brief Give memory previously allocated by hwloc_mempool_alloc() back to \p pool.
+ *
+ * \p len must be the length that was passed to hwloc_mempool_alloc().
+ */
+HWLOC_DECLSPEC int hwloc_mempool_free(hwloc_mempool_t pool, void *addr, size_t len);
+
+/** \brief Statistics about a memory pool.
+ *
+ * Counters are updated without any synchronization between threads,
+ * they may therefore be slightly outdated while other threads use the pool.
+ */
+struct hwloc_mempool_stats_s {
+  hwloc_uint64_t nr_chunks;		/**< \brief Number of chunks allocated from the operating system. */
+  hwloc_uint64_t chunk_bytes;		/**< \brief Total size of these chunks in bytes. */
+  hwloc_uint64_t nr_allocs;		/**< \brief Number of blocks allocated from the pool. */
+  hwloc_uint64_t nr_frees;		/**< \brief Number of blocks given back to the pool. */
+  hwloc_uint64_t nr_cache_hits;		/**< \brief Number of allocations served from a thread cache. */
+  hwloc_uint64_t nr_large_allocs;	/**< \brief Number of allocations that bypassed the pool because of their size. */
+  hwloc_uint64_t nr_large_frees;	/**< \brief Number of releases that bypassed the pool because of their size. */
+  hwloc_uint64_t nr_failed_allocs;	/**< \brief Number of allocations that failed. */
+};
+
+/** \brief Retrieve statistics about memory pool \p pool.
+ *
+ * \p flags must be 0 for now.
+ */
+HWLOC_DECLSPEC int hwloc_mempool_get_stats(hwloc_mempool_t pool, struct hwloc_mempool_stats_s *stats, unsigned long flags);
+
+/** \brief Destroy memory pool \p pool and release all its chunks to the operating system.
+ *
+ * All blocks allocated from the pool become invalid.
+ * Allocations that bypassed the pool because of their size are not released.
+ *
+ * No other thread may use the pool during or after this call.
+ */
+HWLOC_DECLSPEC void hwloc_mempool_destroy(hwloc_mempool_t pool);
+
+/** @} */
+
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+
+#endif /* HWLOC_MEMPOOL_H */
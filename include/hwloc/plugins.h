@@ -43,6 +43,9 @@ typedef enum hwloc_disc_component_type_e {
   HWLOC_DISC_COMPONENT_TYPE_MISC = (1<<2)
 } hwloc_disc_component_type_t;
 
+/** \brief Convert an object type into a bit for the objtypes field of struct hwloc_disc_component. */
+#define HWLOC_DISC_COMPONENT_OBJTYPE(type) (1UL << (type))
+
 /** \brief Discovery component structure
  *
  * This is the major kind of components, taking care of the discovery.
@@ -86,6 +89,19 @@ struct hwloc_disc_component {
    */
   unsigned priority;
 
+  /** \brief Types of objects that this component may add to the topology,
+   * as an OR'ed set of HWLOC_DISC_COMPONENT_OBJTYPE(::hwloc_obj_type_t).
+   *
+   * If all these types are filtered out with ::HWLOC_TYPE_FILTER_KEEP_NONE,
+   * the component is not instantiated during hwloc_topology_load().
+   * This is useful for I/O components whose instantiation is expensive
+   * while most topologies do not want their objects.
+   *
+   * 0 means that the component may add any type of object,
+   * hence it is always instantiated (usual value for CPU and GLOBAL components).
+   */
+  unsigned long objtypes;
+
   /** \private Used internally to list components by priority on topology->components
    * (the component structure is usually read-only,
    *  the core copies it before using this field for queueing)
@@ -206,6 +222,9 @@ struct hwloc_component {
    *
    * This optional callback is called after unregistering the component
    * from the hwloc core (before unloading the plugin).
+   * Components usually remain registered until the process exits
+   * (or until the hwloc library is unloaded), hence this callback
+   * may be called from the library destructor.
    *
    * \p flags is always 0 for now.
    *
@@ -474,6 +493,10 @@ HWLOC_DECLSPEC int hwloc_pci_setup_bridge_attr(hwloc_obj_t obj, const unsigned c
 /** \brief Insert a PCI object in the given PCI tree by looking at PCI bus IDs.
  *
  * If \p treep points to \c NULL, the new object is inserted there.
+ *
+ * The objects are only queued here. They are sorted by bus ID and organized
+ * into the actual PCI hierarchy at once by hwloc_pci_tree_attach_belowroot(),
+ * hence the tree should not be traversed before that.
  */
 HWLOC_DECLSPEC void hwloc_pci_tree_insert_by_busid(struct hwloc_obj **treep, struct hwloc_obj *obj);
 
@@ -494,6 +517,9 @@ HWLOC_DECLSPEC int hwloc_pci_tree_attach_belowroot(struct hwloc_topology *topolo
  *
  * If no exactly matching object is found, return the container bridge if any, or NULL.
  *
+ * Lookups use an index of PCI bus IDs built by hwloc_pci_tree_attach_belowroot()
+ * instead of walking the PCI hierarchy.
+ *
  * On failure, it may be possible to find the PCI locality (instead of the PCI device)
  * by calling hwloc_pci_find_busid_parent().
  *
@@ -133,6 +133,8 @@ extern "C" {
 #define hwloc_topology_membind_support HWLOC_NAME(topology_membind_support)
 #define hwloc_topology_support HWLOC_NAME(topology_support)
 #define hwloc_topology_get_support HWLOC_NAME(topology_get_support)
+#define hwloc_topology_discovery_stats_s HWLOC_NAME(topology_discovery_stats_s)
+#define hwloc_topology_get_discovery_stats HWLOC_NAME(topology_get_discovery_stats)
 
 #define hwloc_type_filter_e HWLOC_NAME(type_filter_e)
 #define HWLOC_TYPE_FILTER_KEEP_ALL HWLOC_NAME_CAPS(TYPE_FILTER_KEEP_ALL)
@@ -230,10 +232,13 @@ extern "C" {
 #define hwloc_get_area_membind HWLOC_NAME(get_area_membind)
 #define hwloc_get_area_memlocation HWLOC_NAME(get_area_memlocation)
 #define hwloc_alloc_membind HWLOC_NAME(alloc_membind)
+#define hwloc_alloc_membind_striped HWLOC_NAME(alloc_membind_striped)
 #define hwloc_alloc HWLOC_NAME(alloc)
 #define hwloc_free HWLOC_NAME(free)
 
 #define hwloc_get_non_io_ancestor_obj HWLOC_NAME(get_non_io_ancestor_obj)
+#define hwloc_get_pci_path_linkspeed HWLOC_NAME(get_pci_path_linkspeed)
+#define hwloc_get_io_closest_objs HWLOC_NAME(get_io_closest_objs)
 #define hwloc_get_next_pcidev HWLOC_NAME(get_next_pcidev)
 #define hwloc_get_pcidev_by_busid HWLOC_NAME(get_pcidev_by_busid)
 #define hwloc_get_pcidev_by_busidstring HWLOC_NAME(get_pcidev_by_busidstring)
@@ -392,20 +397,39 @@ extern "C" {
 #define HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SIZE HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_ATTR_SIZE)
 #define HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_NAME HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_ATTR_NAME)
 #define HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_INFO HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_ATTR_INFO)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_ATTR_SET)
+#define hwloc_topology_diff_obj_set_e HWLOC_NAME(topology_diff_obj_set_e)
+#define hwloc_topology_diff_obj_set_t HWLOC_NAME(topology_diff_obj_set_t)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_SET_CPUSET HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_SET_CPUSET)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_SET_COMPLETE_CPUSET HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_SET_COMPLETE_CPUSET)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_CPUSET HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_SET_ALLOWED_CPUSET)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_SET_NODESET HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_SET_NODESET)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_SET_COMPLETE_NODESET HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_SET_COMPLETE_NODESET)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET)
 #define hwloc_topology_diff_obj_attr_u HWLOC_NAME(topology_diff_obj_attr_u)
 #define hwloc_topology_diff_obj_attr_generic_s HWLOC_NAME(topology_diff_obj_attr_generic_s)
 #define hwloc_topology_diff_obj_attr_uint64_s HWLOC_NAME(topology_diff_obj_attr_uint64_s)
 #define hwloc_topology_diff_obj_attr_string_s HWLOC_NAME(topology_diff_obj_attr_string_s)
+#define hwloc_topology_diff_obj_attr_set_s HWLOC_NAME(topology_diff_obj_attr_set_s)
 #define hwloc_topology_diff_type_e HWLOC_NAME(topology_diff_type_e)
 #define hwloc_topology_diff_type_t HWLOC_NAME(topology_diff_type_t)
 #define HWLOC_TOPOLOGY_DIFF_OBJ_ATTR HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_ATTR)
 #define HWLOC_TOPOLOGY_DIFF_TOO_COMPLEX HWLOC_NAME_CAPS(TOPOLOGY_DIFF_TOO_COMPLEX)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_INSERT HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_INSERT)
+#define HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE HWLOC_NAME_CAPS(TOPOLOGY_DIFF_OBJ_REMOVE)
 #define hwloc_topology_diff_u HWLOC_NAME(topology_diff_u)
 #define hwloc_topology_diff_t HWLOC_NAME(topology_diff_t)
 #define hwloc_topology_diff_generic_s HWLOC_NAME(topology_diff_generic_s)
 #define hwloc_topology_diff_obj_attr_s HWLOC_NAME(topology_diff_obj_attr_s)
 #define hwloc_topology_diff_too_complex_s HWLOC_NAME(topology_diff_too_complex_s)
+#define hwloc_topology_diff_obj_subtree_s HWLOC_NAME(topology_diff_obj_subtree_s)
+#define hwloc_topology_diff_build_flags_e HWLOC_NAME(topology_diff_build_flags_e)
+#define HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES HWLOC_NAME_CAPS(TOPOLOGY_DIFF_BUILD_HASH_SUBTREES)
 #define hwloc_topology_diff_build HWLOC_NAME(topology_diff_build)
+#define hwloc_topology_fingerprint_flags_e HWLOC_NAME(topology_fingerprint_flags_e)
+#define HWLOC_TOPOLOGY_FINGERPRINT_FLAG_IO HWLOC_NAME_CAPS(TOPOLOGY_FINGERPRINT_FLAG_IO)
+#define HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS HWLOC_NAME_CAPS(TOPOLOGY_FINGERPRINT_FLAG_INFOS)
+#define hwloc_topology_fingerprint HWLOC_NAME(topology_fingerprint)
 #define hwloc_topology_diff_apply_flags_e HWLOC_NAME(topology_diff_apply_flags_e)
 #define HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE HWLOC_NAME_CAPS(TOPOLOGY_DIFF_APPLY_REVERSE)
 #define hwloc_topology_diff_apply HWLOC_NAME(topology_diff_apply)
@@ -415,6 +439,19 @@ extern "C" {
 #define hwloc_topology_diff_load_xmlbuffer HWLOC_NAME(topology_diff_load_xmlbuffer)
 #define hwloc_topology_diff_export_xmlbuffer HWLOC_NAME(topology_diff_export_xmlbuffer)
 
+/* mempool.h */
+
+#define hwloc_mempool_s HWLOC_NAME(mempool_s)
+#define hwloc_mempool_t HWLOC_NAME(mempool_t)
+#define hwloc_mempool_flags_e HWLOC_NAME(mempool_flags_e)
+#define HWLOC_MEMPOOL_FLAG_THREAD_CACHE HWLOC_NAME_CAPS(MEMPOOL_FLAG_THREAD_CACHE)
+#define hwloc_mempool_create HWLOC_NAME(mempool_create)
+#define hwloc_mempool_alloc HWLOC_NAME(mempool_alloc)
+#define hwloc_mempool_free HWLOC_NAME(mempool_free)
+#define hwloc_mempool_stats_s HWLOC_NAME(mempool_stats_s)
+#define hwloc_mempool_get_stats HWLOC_NAME(mempool_get_stats)
+#define hwloc_mempool_destroy HWLOC_NAME(mempool_destroy)
+
 /* glibc-sched.h */
 
 #define hwloc_cpuset_to_glibc_sched_affinity HWLOC_NAME(cpuset_to_glibc_sched_affinity)
@@ -437,6 +474,9 @@ extern "C" {
 #define hwloc_linux_set_tid_cpubind HWLOC_NAME(linux_set_tid_cpubind)
 #define hwloc_linux_get_tid_cpubind HWLOC_NAME(linux_get_tid_cpubind)
 #define hwloc_linux_get_tid_last_cpu_location HWLOC_NAME(linux_get_tid_last_cpu_location)
+#define hwloc_linux_numa_map_s HWLOC_NAME(linux_numa_map_s)
+#define hwloc_linux_get_proc_numa_maps HWLOC_NAME(linux_get_proc_numa_maps)
+#define hwloc_linux_free_proc_numa_maps HWLOC_NAME(linux_free_proc_numa_maps)
 
 /* openfabrics-verbs.h */
 
@@ -571,6 +611,10 @@ extern "C" {
 #define hwloc_cache_type_by_depth_type HWLOC_NAME(cache_type_by_depth_type)
 #define hwloc_obj_type_is_io HWLOC_NAME(obj_type_is_io)
 #define hwloc_obj_type_is_special HWLOC_NAME(obj_type_is_special)
+#define hwloc_pci_busid_key HWLOC_NAME(pci_busid_key)
+#define hwloc_test_and_set_flag HWLOC_NAME(test_and_set_flag)
+#define hwloc_atomic_load_int HWLOC_NAME(atomic_load_int)
+#define hwloc_atomic_store_int HWLOC_NAME(atomic_store_int)
 
 /* private/cpuid-x86.h */
 
@@ -633,6 +677,7 @@ extern "C" {
 #define hwloc_pci_discovery_exit HWLOC_NAME(pci_discovery_exit)
 #define hwloc_find_insert_io_parent_by_complete_cpuset HWLOC_NAME(hwloc_find_insert_io_parent_by_complete_cpuset)
 #define hwloc_pci_belowroot_apply_locality HWLOC_NAME(pci_belowroot_apply_locality)
+#define hwloc_pci_compare_busid_ptrs HWLOC_NAME(pci_compare_busid_ptrs)
 #define hwloc_pci_class_string HWLOC_NAME(pci_class_string)
 
 #define hwloc__add_info HWLOC_NAME(_add_info)
@@ -645,6 +690,7 @@ extern "C" {
 #define hwloc_set_binding_hooks HWLOC_NAME(set_binding_hooks)
 
 #define hwloc_set_linuxfs_hooks HWLOC_NAME(set_linuxfs_hooks)
+#define hwloc_linux_restrict_allowed_resources HWLOC_NAME(linux_restrict_allowed_resources)
 #define hwloc_set_bgq_hooks HWLOC_NAME(set_bgq_hooks)
 #define hwloc_set_solaris_hooks HWLOC_NAME(set_solaris_hooks)
 #define hwloc_set_aix_hooks HWLOC_NAME(set_aix_hooks)
@@ -663,6 +709,9 @@ extern "C" {
 #define hwloc_free_object_and_children HWLOC_NAME(free_object_and_children)
 #define hwloc_free_object_siblings_and_children HWLOC_NAME(free_object_siblings_and_children)
 #define hwloc__duplicate_objects HWLOC_NAME(_duplicate_objects)
+#define hwloc__duplicate_detached_objects HWLOC_NAME(_duplicate_detached_objects)
+#define hwloc_topology_propagate_changes HWLOC_NAME(topology_propagate_changes)
+#define hwloc_topology_diff_invalidate_hashes HWLOC_NAME(topology_diff_invalidate_hashes)
 
 #define hwloc_alloc_heap HWLOC_NAME(alloc_heap)
 #define hwloc_alloc_mmap HWLOC_NAME(alloc_mmap)
@@ -687,6 +736,7 @@ extern "C" {
 #define hwloc_obj_add_info_nodup HWLOC_NAME(obj_add_info_nodup)
 
 #define hwloc_progname HWLOC_NAME(progname)
+#define hwloc__daemon_get_xmlbuffer HWLOC_NAME(_daemon_get_xmlbuffer)
 
 #define hwloc_bitmap_compare_inclusion HWLOC_NAME(bitmap_compare_inclusion)
 
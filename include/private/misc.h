@@ -407,6 +407,56 @@ static __hwloc_inline int hwloc_obj_type_is_io (hwloc_obj_type_t type)
   return type >= HWLOC_OBJ_BRIDGE && type <= HWLOC_OBJ_OS_DEVICE;
 }
 
+/* Combine a PCI bus ID into an integer that sorts like domain, bus, device and function */
+static __hwloc_inline hwloc_uint64_t hwloc_pci_busid_key(unsigned domain, unsigned bus, unsigned dev, unsigned func)
+{
+  return ((hwloc_uint64_t) domain << 24) | (bus << 16) | (dev << 8) | func;
+}
+
+/* Set *flag to 1 and return its previous value, atomically when the compiler allows it.
+ * Used for process-wide "only once" flags (e.g. error reports)
+ * that may be modified by different threads loading or querying topologies.
+ */
+static __hwloc_inline int hwloc_test_and_set_flag(int *flag)
+{
+#if defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 1)))
+  return __sync_lock_test_and_set(flag, 1);
+#else
+  int old = *flag;
+  *flag = 1;
+  return old;
+#endif
+}
+
+/* Read or publish a process-wide value that is computed once by one thread
+ * and read by others (e.g. cached environment variables or kernel mask sizes).
+ * The store orders previous writes before the value, the load orders later reads after it.
+ */
+static __hwloc_inline int hwloc_atomic_load_int(const int *p)
+{
+#ifdef __ATOMIC_ACQUIRE
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 1)))
+  int value = *(const volatile int *) p;
+  __sync_synchronize();
+  return value;
+#else
+  return *(const volatile int *) p;
+#endif
+}
+
+static __hwloc_inline void hwloc_atomic_store_int(int *p, int value)
+{
+#ifdef __ATOMIC_RELEASE
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+#elif defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 1)))
+  __sync_synchronize();
+  *(volatile int *) p = value;
+#else
+  *(volatile int *) p = value;
+#endif
+}
+
 #ifdef HWLOC_WIN_SYS
 #  ifndef HAVE_SSIZE_T
 typedef SSIZE_T ssize_t;
@@ -49,6 +49,7 @@ struct hwloc_topology {
   enum hwloc_type_filter_e type_filter[HWLOC_OBJ_TYPE_MAX];
   int is_thissystem;
   int is_loaded;
+  int from_daemon;                                      /* set if the topology is being imported from hwlocd */
   int modified;                                         /* >0 if objects were added/removed recently, which means a reconnect is needed */
   hwloc_pid_t pid;                                      /* Process ID the topology is view from, 0 for self */
   void *userdata;
@@ -59,6 +60,7 @@ struct hwloc_topology {
   struct hwloc_obj *first_bridge, *last_bridge;
   unsigned pcidev_nbobjects;
   struct hwloc_obj **pcidev_level;
+  struct hwloc_obj **pcidev_by_busid;                   /* pcidev_level sorted by bus ID */
   struct hwloc_obj *first_pcidev, *last_pcidev;
   unsigned osdev_nbobjects;
   struct hwloc_obj **osdev_level;
@@ -79,6 +81,16 @@ struct hwloc_topology {
     hwloc_bitmap_t cpuset;
   } * pci_forced_locality;
 
+  /* PCI objects added below root during discovery, sorted by bus ID,
+   * and bridges with a PCI downstream bus, sorted by domain and secondary bus,
+   * for hwloc_pci_belowroot_find_by_busid()
+   */
+  struct hwloc_obj **pci_busid_index;
+  unsigned pci_busid_index_nr;
+  struct hwloc_obj **pci_bridge_index;
+  unsigned pci_bridge_index_nr;
+  int pci_busid_index_failed; /* set if indexes couldn't be allocated, lookups must walk the tree */
+
   struct hwloc_binding_hooks {
     int (*set_thisproc_cpubind)(hwloc_topology_t topology, hwloc_const_cpuset_t set, int flags);
     int (*get_thisproc_cpubind)(hwloc_topology_t topology, hwloc_cpuset_t set, int flags);
@@ -134,6 +146,10 @@ struct hwloc_topology {
     struct hwloc_internal_distances_s *prev, *next;
   } *first_dist, *last_dist;
 
+  /* subtree hashes for hwloc_topology_diff_build(), indexed by gp_index, 0 if not computed yet */
+  uint64_t *diff_hashes;
+  uint64_t nr_diff_hashes;
+
   int grouping;
   int grouping_verbose;
   unsigned grouping_nbaccuracies;
@@ -143,6 +159,12 @@ struct hwloc_topology {
   /* list of enabled backends. */
   struct hwloc_backend * backends;
   unsigned backend_excludes;
+
+  /* per-backend statistics filled by hwloc_discover() */
+  struct hwloc_topology_discovery_stats_s *discovery_stats;
+  unsigned nr_discovery_stats;
+  /* statistics of the backend currently discovering, NULL outside of discovery callbacks */
+  struct hwloc_topology_discovery_stats_s *cur_discovery_stats;
 };
 
 extern void hwloc_alloc_obj_cpusets(hwloc_obj_t obj);
@@ -159,6 +181,9 @@ extern void hwloc__reorder_children(hwloc_obj_t parent);
 extern void hwloc_topology_setup_defaults(struct hwloc_topology *topology);
 extern void hwloc_topology_clear(struct hwloc_topology *topology);
 
+/* drop cached subtree hashes after objects were modified */
+extern void hwloc_topology_diff_invalidate_hashes(struct hwloc_topology *topology);
+
 extern void hwloc_pci_discovery_init(struct hwloc_topology *topology);
 extern void hwloc_pci_discovery_exit(struct hwloc_topology *topology);
 
@@ -175,6 +200,9 @@ extern hwloc_obj_t hwloc_find_insert_io_parent_by_complete_cpuset(struct hwloc_t
  */
 extern int hwloc_pci_belowroot_apply_locality(struct hwloc_topology *topology);
 
+/* qsort() callback for arrays of PCI objects, ordered by bus ID */
+extern int hwloc_pci_compare_busid_ptrs(const void *a, const void *b);
+
 HWLOC_DECLSPEC extern const char * hwloc_pci_class_string(unsigned short class_id);
 
 extern void hwloc__add_info(struct hwloc_obj_info_s **infosp, unsigned *countp, const char *name, const char *value);
@@ -189,6 +217,8 @@ extern void hwloc_set_binding_hooks(struct hwloc_topology *topology);
 
 #if defined(HWLOC_LINUX_SYS)
 extern void hwloc_set_linuxfs_hooks(struct hwloc_binding_hooks *binding_hooks, struct hwloc_topology_support *support);
+/* remove what the cgroup/cpuset of the target process does not allow from the root allowed sets */
+extern void hwloc_linux_restrict_allowed_resources(struct hwloc_topology *topology);
 #endif /* HWLOC_LINUX_SYS */
 
 #if defined(HWLOC_BGQ_SYS)
@@ -245,6 +275,12 @@ extern void hwloc_free_object_siblings_and_children(hwloc_obj_t obj);
 /* Duplicate src and its children under newparent in newtopology */
 extern void hwloc__duplicate_objects(struct hwloc_topology *newtopology, struct hwloc_obj *newparent, struct hwloc_obj *src);
 
+/* Duplicate src and its children outside of any topology */
+extern hwloc_obj_t hwloc__duplicate_detached_objects(struct hwloc_obj *src);
+
+/* Reconnect levels and update derived attributes after objects were inserted or removed in a loaded topology */
+extern int hwloc_topology_propagate_changes(struct hwloc_topology *topology);
+
 /* This can be used for the alloc field to get allocated data that can be freed by free() */
 void *hwloc_alloc_heap(hwloc_topology_t topology, size_t len);
 
@@ -361,6 +397,12 @@ extern void hwloc_obj_add_info_nodup(hwloc_obj_t obj, const char *name, const ch
  */
 extern char * hwloc_progname(struct hwloc_topology *topology);
 
+/* Fetch the XML export of the topology served by hwlocd on the given Unix socket path.
+ * The buffer is NUL-terminated, *buflenp includes the terminating NUL.
+ * The buffer must be freed by the caller.
+ */
+extern int hwloc__daemon_get_xmlbuffer(const char *path, char **bufferp, int *buflenp);
+
 #define HWLOC_BITMAP_EQUAL 0       /* Bitmaps are equal */
 #define HWLOC_BITMAP_INCLUDED 1    /* First bitmap included in second */
 #define HWLOC_BITMAP_CONTAINS 2    /* First bitmap contains second */
@@ -20,6 +20,37 @@
 #include <hwloc.h>
 
 static UT_icd topos_icd = {sizeof(hwloc_topology_t), NULL, NULL, NULL};
+static UT_icd fingerprints_icd = {sizeof(hwloc_uint64_t), NULL, NULL, NULL};
+
+/* Check that two topologies only differ by names, info attributes and
+ * allowed sets, i.e. what a fingerprint without flags does not cover */
+static int netloc_hwloc_same_hardware(hwloc_topology_t topo1, hwloc_topology_t topo2)
+{
+    hwloc_topology_diff_t diff = NULL, cur;
+    int same;
+
+    if (hwloc_topology_diff_build(topo1, topo2, 0, &diff))
+        same = 0;
+    else {
+        same = 1;
+        for (cur = diff; cur; cur = cur->generic.next) {
+            union hwloc_topology_diff_obj_attr_u *attr = &cur->obj_attr.diff;
+            if (cur->generic.type != HWLOC_TOPOLOGY_DIFF_OBJ_ATTR)
+                same = 0;
+            else if (attr->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET)
+                same = attr->set.index == HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_CPUSET
+                    || attr->set.index == HWLOC_TOPOLOGY_DIFF_OBJ_SET_ALLOWED_NODESET;
+            else
+                same = attr->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_NAME
+                    || attr->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_INFO;
+            if (!same)
+                break;
+        }
+    }
+    if (diff)
+        hwloc_topology_diff_destroy(diff);
+    return same;
+}
 
 int netloc_topology_read_hwloc(netloc_topology_t *topology, int num_nodes,
         netloc_node_t **node_list)
@@ -56,6 +87,13 @@ int netloc_topology_read_hwloc(netloc_topology_t *topology, int num_nodes,
     UT_array *hwloc_topo_names = topology->topos;
     UT_array *hwloc_topos;
     utarray_new(hwloc_topos, &topos_icd);
+    UT_array *hwloc_fingerprints;
+    utarray_new(hwloc_fingerprints, &fingerprints_icd);
+    /* Names whose topology turned out identical to an earlier one */
+    UT_array *hwloc_alias_names;
+    utarray_new(hwloc_alias_names, &ut_str_icd);
+    UT_array *hwloc_alias_idx;
+    utarray_new(hwloc_alias_idx, &ut_int_icd);
 
     int num_diffs = 0;
 
@@ -106,10 +144,16 @@ int netloc_topology_read_hwloc(netloc_topology_t *topology, int num_nodes,
                 strcmp(*(char **)utarray_eltptr(hwloc_topo_names, t), refname)) {
             t++;
         }
+        if (t == utarray_len(hwloc_topo_names)) {
+            for (int a = 0; a < utarray_len(hwloc_alias_names); a++) {
+                if (!strcmp(*(char **)utarray_eltptr(hwloc_alias_names, a), refname)) {
+                    t = *(int *)utarray_eltptr(hwloc_alias_idx, a);
+                    break;
+                }
+            }
+        }
         /* Topology not found */
         if (t == utarray_len(hwloc_topo_names)) {
-            utarray_push_back(hwloc_topo_names, &refname);
-
             /* Read the hwloc topology */
             hwloc_topology_t topology;
             hwloc_topology_init(&topology);
@@ -121,7 +165,10 @@ int netloc_topology_read_hwloc(netloc_topology_t *topology, int num_nodes,
             free(hwloc_ref_path);
             if (ret == -1) {
                 void *null = NULL;
+                hwloc_uint64_t zero = 0;
+                utarray_push_back(hwloc_topo_names, &refname);
                 utarray_push_back(hwloc_topos, &null);
+                utarray_push_back(hwloc_fingerprints, &zero);
                 fprintf(stdout, "Warning: no topology for %s\n", refname);
                 hwloc_topology_destroy(topology);
                 free(refname); free(hwloc_file);
@@ -148,7 +195,29 @@ int netloc_topology_read_hwloc(netloc_topology_t *topology, int num_nodes,
                 free(refname); free(hwloc_file);
                 goto ERROR;
             }
-            utarray_push_back(hwloc_topos, &topology);
+
+            /* Share the topology of identical nodes that were not compressed together.
+             * The fingerprint only selects candidates, a diff confirms the match. */
+            hwloc_uint64_t fingerprint;
+            hwloc_topology_fingerprint(topology, 0, &fingerprint);
+            int f;
+            for (f = 0; f < utarray_len(hwloc_fingerprints); f++) {
+                hwloc_topology_t other = *(hwloc_topology_t *)utarray_eltptr(hwloc_topos, f);
+                if (other &&
+                        *(hwloc_uint64_t *)utarray_eltptr(hwloc_fingerprints, f) == fingerprint &&
+                        netloc_hwloc_same_hardware(other, topology))
+                    break;
+            }
+            if (f < utarray_len(hwloc_fingerprints)) {
+                hwloc_topology_destroy(topology);
+                utarray_push_back(hwloc_alias_names, &refname);
+                utarray_push_back(hwloc_alias_idx, &f);
+                t = f;
+            } else {
+                utarray_push_back(hwloc_topo_names, &refname);
+                utarray_push_back(hwloc_topos, &topology);
+                utarray_push_back(hwloc_fingerprints, &fingerprint);
+            }
         }
         free(refname);
         free(hwloc_file);
@@ -171,6 +240,9 @@ int netloc_topology_read_hwloc(netloc_topology_t *topology, int num_nodes,
     ret = NETLOC_SUCCESS;
 
 ERROR:
+    utarray_free(hwloc_fingerprints);
+    utarray_free(hwloc_alias_names);
+    utarray_free(hwloc_alias_idx);
     if (all) {
         free(node_list);
     }
@@ -0,0 +1,117 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <private/autogen/config.h>
+#include <hwloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/* check that stripes are bound to the expected objects, in the expected order */
+
+#define NR_STRIPES 16
+#define MAX_OBJS 16
+
+static void
+check(hwloc_topology_t topology, size_t pagesize)
+{
+  const struct hwloc_topology_support *support = hwloc_topology_get_support(topology);
+  hwloc_obj_t objs[MAX_OBJS];
+  unsigned weights[MAX_OBJS];
+  unsigned nr, i, j, stripe;
+  hwloc_bitmap_t set = hwloc_bitmap_alloc();
+  size_t stripe_size = 2*pagesize;
+  size_t len = NR_STRIPES*stripe_size - pagesize; /* last stripe is smaller */
+  char *buffer;
+
+  nr = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_NUMANODE);
+  if (nr > MAX_OBJS)
+    nr = MAX_OBJS;
+  for(i=0; i<nr; i++) {
+    /* reverse order, weight 2 for the first one, 1 for others */
+    objs[i] = hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, nr-1-i);
+    weights[i] = i ? 1 : 2;
+  }
+
+  /* invalid arguments */
+  buffer = hwloc_alloc_membind_striped(topology, len, stripe_size, 0, objs, NULL, 0);
+  assert(!buffer && errno == EINVAL);
+  buffer = hwloc_alloc_membind_striped(topology, len, pagesize+1, nr, objs, NULL, 0);
+  assert(!buffer && errno == EINVAL);
+  buffer = hwloc_alloc_membind_striped(topology, len, stripe_size, nr, objs, NULL, HWLOC_MEMBIND_MIGRATE);
+  assert(!buffer && errno == EINVAL);
+  {
+    unsigned zeroes[MAX_OBJS];
+    memset(zeroes, 0, sizeof(zeroes));
+    buffer = hwloc_alloc_membind_striped(topology, len, stripe_size, nr, objs, zeroes, 0);
+    assert(!buffer && errno == EINVAL);
+  }
+
+  buffer = hwloc_alloc_membind_striped(topology, len, stripe_size, nr, objs, weights, 0);
+  assert(buffer);
+  memset(buffer, 0, len);
+
+  if (support->membind->get_area_memlocation && hwloc_topology_is_thissystem(topology)) {
+    i = 0;
+    j = 0;
+    for(stripe=0; stripe<NR_STRIPES; stripe++) {
+      size_t stripe_len = stripe == NR_STRIPES-1 ? stripe_size - pagesize : stripe_size;
+      int err = hwloc_get_area_memlocation(topology, buffer + stripe*stripe_size, stripe_len, set, HWLOC_MEMBIND_BYNODESET);
+      if (err < 0 && errno == ENOSYS)
+	break;
+      assert(!err);
+      printf("stripe #%u expected on node L#%u, allocated on nodeset 0x%lx\n",
+	     stripe, objs[i]->logical_index, hwloc_bitmap_to_ulong(set));
+      assert(hwloc_bitmap_isincluded(set, objs[i]->nodeset));
+      if (++j == weights[i]) {
+	i = (i+1) % nr;
+	j = 0;
+      }
+    }
+  }
+
+  hwloc_free(topology, buffer, len);
+  hwloc_bitmap_free(set);
+}
+
+int main(void)
+{
+  hwloc_topology_t topology;
+  size_t pagesize;
+  int err;
+
+#if HAVE_DECL__SC_PAGE_SIZE
+  pagesize = sysconf(_SC_PAGE_SIZE);
+#elif HAVE_DECL__SC_PAGESIZE
+  pagesize = sysconf(_SC_PAGESIZE);
+#else
+  pagesize = 4096;
+#endif
+
+  /* the local machine */
+  err = hwloc_topology_init(&topology);
+  assert(!err);
+  err = hwloc_topology_load(topology);
+  assert(!err);
+  check(topology, pagesize);
+  hwloc_topology_destroy(topology);
+
+  /* a fake machine with 4 nodes, memory is never actually bound */
+  err = hwloc_topology_init(&topology);
+  assert(!err);
+  err = hwloc_topology_set_synthetic(topology, "node:4 core:2 pu:1");
+  assert(!err);
+  err = hwloc_topology_load(topology);
+  assert(!err);
+  check(topology, pagesize);
+  hwloc_topology_destroy(topology);
+
+  return 0;
+}
@@ -66,6 +66,9 @@ int main(void)
   char env[64];
   int xmlbufok = 0, xmlfileok = 0, xmlfilefd;
   const char *orig_backend_name;
+  struct hwloc_topology_discovery_stats_s stats[2];
+  unsigned nrstats;
+  int err;
 
   putenv("HWLOC_LIBXML_CLEANUP=1");
 
@@ -131,10 +134,28 @@ int main(void)
   printf("switching to synthetic and loading...\n");
   hwloc_topology_init(&topology2);
   hwloc_topology_set_synthetic(topology2, "machine:2 node:3 l3i:2 pu:4");
+  nrstats = 1;
+  err = hwloc_topology_get_discovery_stats(topology2, &nrstats, stats);
+  assert(err == -1 && errno == EINVAL);
   hwloc_topology_load(topology2);
   assert_backend_name(topology2, "Synthetic");
   assert_foo_bar(topology2, 0);
   assert(hwloc_get_nbobjs_by_type(topology2, HWLOC_OBJ_PU) == 2*3*2*4);
+  /* only the synthetic backend discovers, its objects are all inserted by cpuset,
+   * except instruction caches that are filtered out by default.
+   */
+  nrstats = 0;
+  err = hwloc_topology_get_discovery_stats(topology2, &nrstats, NULL);
+  assert(!err);
+  assert(nrstats == 1);
+  nrstats = 2;
+  err = hwloc_topology_get_discovery_stats(topology2, &nrstats, stats);
+  assert(!err);
+  assert(nrstats == 1);
+  assert(!strcmp(stats[0].name, "synthetic"));
+  assert(stats[0].nr_inserted == 2 + 2*3 + 2*3*2*4);
+  assert(!stats[0].nr_merged);
+  assert(!stats[0].nr_dropped);
   hwloc_topology_check(topology2);
   assert(!hwloc_topology_is_thissystem(topology2));
   hwloc_topology_destroy(topology2);
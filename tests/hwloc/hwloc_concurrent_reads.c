@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <hwloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* check that many threads may query the same loaded topology concurrently
+ * and always get the same answers as a single thread.
+ */
+
+#define NR_THREADS 8
+#define NR_LOOPS 50
+#define NR_NODES 4
+
+static hwloc_topology_t topology;
+static char *refxml;
+static int refxmllen;
+static unsigned nrpus;
+
+static void
+check_queries(void)
+{
+  struct hwloc_distances_s *distances[2];
+  hwloc_bitmap_t set;
+  hwloc_obj_t obj;
+  char *xml;
+  int xmllen;
+  unsigned nr, i, j;
+  int err;
+
+  /* distances were imported from XML with indexes only, their objects must be ready */
+  nr = 2;
+  err = hwloc_distances_get_by_type(topology, HWLOC_OBJ_NUMANODE, &nr, distances, 0, 0);
+  assert(!err);
+  assert(nr == 1);
+  assert(distances[0]->nbobjs == NR_NODES);
+  for(i=0; i<NR_NODES; i++) {
+    assert(distances[0]->objs[i] == hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, i));
+    for(j=0; j<NR_NODES; j++)
+      assert(distances[0]->values[i*NR_NODES+j] == (i == j ? 10 : 20 + i + j));
+  }
+  hwloc_distances_release(topology, distances[0]);
+
+  /* traversal and conversions */
+  set = hwloc_bitmap_alloc();
+  assert(set);
+  assert((unsigned) hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_PU) == nrpus);
+  obj = NULL;
+  i = 0;
+  while ((obj = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_PU, obj)) != NULL) {
+    assert(obj->logical_index == i);
+    assert(hwloc_get_pu_obj_by_os_index(topology, obj->os_index) == obj);
+    hwloc_cpuset_to_nodeset(topology, obj->cpuset, set);
+    assert(hwloc_bitmap_weight(set) == 1);
+    assert(hwloc_get_ancestor_obj_by_type(topology, HWLOC_OBJ_NUMANODE, obj)->os_index == (unsigned) hwloc_bitmap_first(set));
+    i++;
+  }
+  assert(i == nrpus);
+  hwloc_bitmap_free(set);
+
+  /* export must not depend on other threads */
+  err = hwloc_topology_export_xmlbuffer(topology, &xml, &xmllen, 0);
+  assert(!err);
+  assert(xmllen == refxmllen);
+  assert(!memcmp(xml, refxml, xmllen));
+  hwloc_free_xmlbuffer(topology, xml);
+}
+
+#ifdef hwloc_thread_t
+static void *
+thread_func(void *arg __hwloc_attribute_unused)
+{
+  unsigned i;
+  for(i=0; i<NR_LOOPS; i++)
+    check_queries();
+  return NULL;
+}
+#endif
+
+int main(void)
+{
+  hwloc_topology_t synthetic;
+  hwloc_obj_t objs[NR_NODES];
+  hwloc_uint64_t values[NR_NODES*NR_NODES];
+  char *xml;
+  int xmllen;
+  unsigned i, j;
+  int err;
+
+  /* build a synthetic topology with a NUMA distance matrix and export it */
+  err = hwloc_topology_init(&synthetic);
+  assert(!err);
+  err = hwloc_topology_set_synthetic(synthetic, "node:4 core:4 pu:2");
+  assert(!err);
+  err = hwloc_topology_load(synthetic);
+  assert(!err);
+  for(i=0; i<NR_NODES; i++) {
+    objs[i] = hwloc_get_obj_by_type(synthetic, HWLOC_OBJ_NUMANODE, i);
+    for(j=0; j<NR_NODES; j++)
+      values[i*NR_NODES+j] = i == j ? 10 : 20 + i + j;
+  }
+  err = hwloc_distances_add(synthetic, NR_NODES, objs, values,
+			    HWLOC_DISTANCES_KIND_MEANS_LATENCY|HWLOC_DISTANCES_KIND_FROM_USER,
+			    HWLOC_DISTANCES_FLAG_GROUP);
+  assert(!err);
+  err = hwloc_topology_export_xmlbuffer(synthetic, &xml, &xmllen, 0);
+  assert(!err);
+
+  /* reload it so that distances only have indexes until the load completes */
+  err = hwloc_topology_init(&topology);
+  assert(!err);
+  err = hwloc_topology_set_xmlbuffer(topology, xml, xmllen);
+  assert(!err);
+  err = hwloc_topology_load(topology);
+  assert(!err);
+  hwloc_free_xmlbuffer(synthetic, xml);
+  hwloc_topology_destroy(synthetic);
+  nrpus = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_PU);
+  assert(nrpus == NR_NODES*4*2);
+
+  err = hwloc_topology_export_xmlbuffer(topology, &refxml, &refxmllen, 0);
+  assert(!err);
+
+#ifdef hwloc_thread_t
+  {
+    pthread_t threads[NR_THREADS];
+    for(i=0; i<NR_THREADS; i++) {
+      err = pthread_create(&threads[i], NULL, thread_func, NULL);
+      assert(!err);
+    }
+    for(i=0; i<NR_THREADS; i++) {
+      err = pthread_join(threads[i], NULL);
+      assert(!err);
+    }
+  }
+#endif
+  check_queries();
+
+  hwloc_free_xmlbuffer(topology, refxml);
+  hwloc_topology_destroy(topology);
+  return 0;
+}
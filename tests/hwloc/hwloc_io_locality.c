@@ -0,0 +1,114 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <hwloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+/* check the PCI link speed bottleneck and the ranking of cores by I/O affinity */
+
+#define SETS(cpuset, nodeset) \
+  "cpuset=\"" cpuset "\" complete_cpuset=\"" cpuset "\" allowed_cpuset=\"" cpuset "\" " \
+  "nodeset=\"" nodeset "\" complete_nodeset=\"" nodeset "\" allowed_nodeset=\"" nodeset "\""
+
+static const char *xml =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<!DOCTYPE topology SYSTEM \"hwloc.dtd\">\n"
+  "<topology>\n"
+  " <object type=\"Machine\" os_index=\"0\" " SETS("0x0000000f", "0x00000003") ">\n"
+  "  <object type=\"NUMANode\" os_index=\"0\" " SETS("0x00000003", "0x00000001") ">\n"
+  "   <object type=\"Core\" os_index=\"0\" " SETS("0x00000001", "0x00000001") ">\n"
+  "    <object type=\"PU\" os_index=\"0\" " SETS("0x00000001", "0x00000001") "/>\n"
+  "   </object>\n"
+  "   <object type=\"Core\" os_index=\"1\" " SETS("0x00000002", "0x00000001") ">\n"
+  "    <object type=\"PU\" os_index=\"1\" " SETS("0x00000002", "0x00000001") "/>\n"
+  "   </object>\n"
+  "  </object>\n"
+  "  <object type=\"NUMANode\" os_index=\"1\" " SETS("0x0000000c", "0x00000002") ">\n"
+  "   <object type=\"Core\" os_index=\"2\" " SETS("0x00000004", "0x00000002") ">\n"
+  "    <object type=\"PU\" os_index=\"2\" " SETS("0x00000004", "0x00000002") "/>\n"
+  "   </object>\n"
+  "   <object type=\"Core\" os_index=\"3\" " SETS("0x00000008", "0x00000002") ">\n"
+  "    <object type=\"PU\" os_index=\"3\" " SETS("0x00000008", "0x00000002") "/>\n"
+  "   </object>\n"
+  "   <object type=\"Bridge\" bridge_type=\"0-1\" depth=\"0\" bridge_pci=\"0000:[00-0f]\">\n"
+  "    <object type=\"Bridge\" bridge_type=\"1-1\" depth=\"1\" bridge_pci=\"0000:[04-04]\" pci_busid=\"0000:00:01.0\" pci_type=\"0604 [8086:3408] [0000:0000] 13\" pci_link_speed=\"2.000000\">\n"
+  "     <object type=\"PCIDev\" pci_busid=\"0000:04:00.0\" pci_type=\"0200 [8086:10c9] [0000:0000] 01\" pci_link_speed=\"8.000000\">\n"
+  "      <object type=\"OSDev\" name=\"eth0\" osdev_type=\"2\"/>\n"
+  "     </object>\n"
+  "    </object>\n"
+  "    <object type=\"PCIDev\" pci_busid=\"0000:00:02.0\" pci_type=\"0108 [144d:a804] [0000:0000] 00\" pci_link_speed=\"4.000000\"/>\n"
+  "    <object type=\"PCIDev\" pci_busid=\"0000:00:03.0\" pci_type=\"0300 [102b:0522] [0000:0000] 00\"/>\n"
+  "   </object>\n"
+  "  </object>\n"
+  " </object>\n"
+  "</topology>\n";
+
+int main(void)
+{
+  hwloc_topology_t topology;
+  hwloc_obj_t eth, nic, nvme, vga, pu, cores[4];
+  unsigned nr;
+  int err;
+
+  err = hwloc_topology_init(&topology);
+  assert(!err);
+  err = hwloc_topology_set_io_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+  assert(!err);
+  err = hwloc_topology_set_xmlbuffer(topology, xml, (int) strlen(xml)+1);
+  assert(!err);
+  err = hwloc_topology_load(topology);
+  assert(!err);
+
+  nic = hwloc_get_pcidev_by_busid(topology, 0, 4, 0, 0);
+  assert(nic);
+  nvme = hwloc_get_pcidev_by_busid(topology, 0, 0, 2, 0);
+  assert(nvme);
+  vga = hwloc_get_pcidev_by_busid(topology, 0, 0, 3, 0);
+  assert(vga);
+  eth = hwloc_get_next_osdev(topology, NULL);
+  assert(eth);
+  assert(!strcmp(eth->name, "eth0"));
+
+  /* the NIC is limited by its parent bridge, the NVMe device is directly below the hostbridge */
+  assert(hwloc_get_pci_path_linkspeed(topology, nic) == 2.f);
+  assert(hwloc_get_pci_path_linkspeed(topology, eth) == 2.f);
+  assert(hwloc_get_pci_path_linkspeed(topology, nic->parent) == 2.f);
+  assert(hwloc_get_pci_path_linkspeed(topology, nvme) == 4.f);
+  assert(hwloc_get_pci_path_linkspeed(topology, vga) == 0.f);
+
+  /* cores of the local NUMA node come first */
+  nr = hwloc_get_io_closest_objs(topology, eth, HWLOC_OBJ_CORE, cores, 4);
+  assert(nr == 4);
+  assert(cores[0]->os_index == 2);
+  assert(cores[1]->os_index == 3);
+  assert(cores[2]->os_index == 0);
+  assert(cores[3]->os_index == 1);
+  nr = hwloc_get_io_closest_objs(topology, nvme, HWLOC_OBJ_CORE, cores, 1);
+  assert(nr == 1);
+  assert(cores[0]->os_index == 2);
+  nr = hwloc_get_io_closest_objs(topology, nvme, HWLOC_OBJ_NUMANODE, cores, 4);
+  assert(nr == 2);
+  assert(cores[0]->os_index == 1);
+  assert(cores[1]->os_index == 0);
+
+  /* I/O and missing types cannot be ranked */
+  nr = hwloc_get_io_closest_objs(topology, nic, HWLOC_OBJ_PCI_DEVICE, cores, 4);
+  assert(!nr);
+  nr = hwloc_get_io_closest_objs(topology, nic, HWLOC_OBJ_PACKAGE, cores, 4);
+  assert(!nr);
+
+  /* a normal object is its own locality */
+  pu = hwloc_get_pu_obj_by_os_index(topology, 1);
+  assert(pu);
+  nr = hwloc_get_io_closest_objs(topology, pu, HWLOC_OBJ_CORE, cores, 4);
+  assert(nr == 4);
+  assert(cores[0]->os_index == 1);
+  assert(cores[1]->os_index == 0);
+
+  hwloc_topology_destroy(topology);
+  return 0;
+}
@@ -50,7 +50,12 @@ int main(void)
     assert(obj->type == HWLOC_OBJ_PCI_DEVICE);
     printf(" Found PCI device class %04x vendor %04x model %04x\n",
 	   obj->attr->pcidev.class_id, obj->attr->pcidev.vendor_id, obj->attr->pcidev.device_id);
+    /* lookups by busid must find the same object */
+    assert(hwloc_get_pcidev_by_busid(topology, obj->attr->pcidev.domain, obj->attr->pcidev.bus,
+				     obj->attr->pcidev.dev, obj->attr->pcidev.func) == obj);
   }
+  assert(!hwloc_get_pcidev_by_busid(topology, 0xffff, 0xff, 0x1f, 0x7));
+  assert(!hwloc_get_pcidev_by_busid(topology, 0x10000, 0, 0, 0));
 
   printf("Found %d OS devices\n", hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_OS_DEVICE));
   obj = NULL;
@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <hwloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* check that memory pools reuse blocks instead of allocating new chunks */
+
+#define NR_BUFFERS 1024
+#define NR_THREADS 4
+
+static hwloc_topology_t topology;
+static hwloc_mempool_t pool;
+
+static void
+alloc_free_many(void)
+{
+  void *buffers[NR_BUFFERS];
+  size_t lens[NR_BUFFERS];
+  unsigned i;
+
+  for(i=0; i<NR_BUFFERS; i++) {
+    lens[i] = 1 + (i * 97) % 4096;
+    buffers[i] = hwloc_mempool_alloc(pool, lens[i]);
+    assert(buffers[i]);
+    /* blocks must be aligned and must not overlap */
+    assert(!((unsigned long) buffers[i] % HWLOC_MEMPOOL_MIN_BLOCK_SIZE));
+    memset(buffers[i], i & 0xff, lens[i]);
+  }
+  for(i=0; i<NR_BUFFERS; i++) {
+    assert(((unsigned char *) buffers[i])[0] == (i & 0xff));
+    assert(((unsigned char *) buffers[i])[lens[i]-1] == (i & 0xff));
+    hwloc_mempool_free(pool, buffers[i], lens[i]);
+  }
+}
+
+#ifdef hwloc_thread_t
+static void *
+thread_func(void *arg __hwloc_attribute_unused)
+{
+  unsigned i;
+  for(i=0; i<10; i++)
+    alloc_free_many();
+  return NULL;
+}
+#endif
+
+int main(void)
+{
+  struct hwloc_mempool_stats_s stats;
+  hwloc_obj_t node;
+  void *large;
+  unsigned i;
+  int err;
+
+  err = hwloc_topology_init(&topology);
+  assert(!err);
+  err = hwloc_topology_load(topology);
+  assert(!err);
+
+  node = hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, 0);
+  assert(node);
+
+  /* invalid flags */
+  pool = hwloc_mempool_create(topology, node->nodeset, HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_BYNODESET, 0, ~0UL);
+  assert(!pool);
+
+  /* single pool without thread caches */
+  pool = hwloc_mempool_create(topology, node->nodeset, HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_BYNODESET, 0, 0);
+  assert(pool);
+  for(i=0; i<10; i++)
+    alloc_free_many();
+  err = hwloc_mempool_get_stats(pool, &stats, 0);
+  assert(!err);
+  printf("%llu chunks (%llu bytes) for %llu allocs and %llu frees\n",
+	 (unsigned long long) stats.nr_chunks, (unsigned long long) stats.chunk_bytes,
+	 (unsigned long long) stats.nr_allocs, (unsigned long long) stats.nr_frees);
+  assert(stats.nr_allocs == 10*NR_BUFFERS);
+  assert(stats.nr_frees == 10*NR_BUFFERS);
+  assert(stats.nr_cache_hits == 0);
+  /* 1024 buffers of at most 4kB fit in 2 chunks of 2MB, and are reused after the first round */
+  assert(stats.nr_chunks <= 2);
+
+  /* large allocations bypass the pool */
+  large = hwloc_mempool_alloc(pool, 4*HWLOC_MEMPOOL_MAX_BLOCK_SIZE);
+  assert(large);
+  memset(large, 0, 4*HWLOC_MEMPOOL_MAX_BLOCK_SIZE);
+  hwloc_mempool_free(pool, large, 4*HWLOC_MEMPOOL_MAX_BLOCK_SIZE);
+  err = hwloc_mempool_get_stats(pool, &stats, 0);
+  assert(!err);
+  assert(stats.nr_large_allocs == 1);
+  assert(stats.nr_large_frees == 1);
+  assert(stats.nr_chunks <= 2);
+  hwloc_mempool_destroy(pool);
+
+  /* pool with thread caches used by several threads */
+  pool = hwloc_mempool_create(topology, node->nodeset, HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_BYNODESET, 0, HWLOC_MEMPOOL_FLAG_THREAD_CACHE);
+  assert(pool);
+#ifdef hwloc_thread_t
+  {
+    pthread_t threads[NR_THREADS];
+    for(i=0; i<NR_THREADS; i++) {
+      err = pthread_create(&threads[i], NULL, thread_func, NULL);
+      assert(!err);
+    }
+    for(i=0; i<NR_THREADS; i++) {
+      err = pthread_join(threads[i], NULL);
+      assert(!err);
+    }
+  }
+#endif
+  alloc_free_many();
+  alloc_free_many();
+  err = hwloc_mempool_get_stats(pool, &stats, 0);
+  assert(!err);
+  printf("%llu chunks (%llu bytes) for %llu allocs (%llu from thread caches) and %llu frees\n",
+	 (unsigned long long) stats.nr_chunks, (unsigned long long) stats.chunk_bytes,
+	 (unsigned long long) stats.nr_allocs, (unsigned long long) stats.nr_cache_hits,
+	 (unsigned long long) stats.nr_frees);
+  assert(stats.nr_allocs == stats.nr_frees);
+  assert(stats.nr_failed_allocs == 0);
+  hwloc_mempool_destroy(pool);
+
+  hwloc_topology_destroy(topology);
+  return 0;
+}
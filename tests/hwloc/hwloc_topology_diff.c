@@ -1,5 +1,5 @@
 /*
- * Copyright © 2013-2015 Inria.  All rights reserved.
+ * Copyright © 2013-2016 Inria.  All rights reserved.
  * See COPYING in top-level directory.
  */
 
@@ -9,15 +9,19 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
 
 int main(void)
 {
   hwloc_topology_t topo1, topo2, topo3;
-  hwloc_topology_diff_t diff, diff2, tmpdiff;
+  hwloc_topology_diff_t diff, diff2, tmpdiff, tmpdiff2;
   hwloc_obj_t obj;
+  hwloc_bitmap_t cpuset;
   char *xmlbuffer;
   int xmlbuflen;
   char *refname;
+  hwloc_uint64_t fp1, fp2;
+  unsigned i;
   int err;
 
   putenv("HWLOC_LIBXML_CLEANUP=1");
@@ -190,5 +194,192 @@ int main(void)
   hwloc_topology_destroy(topo2);
   hwloc_topology_destroy(topo1);
 
+  printf("load synthetic topo1 and duplicate it into topo2\n");
+  hwloc_topology_init(&topo1);
+  hwloc_topology_set_synthetic(topo1, "pack:2 core:2 pu:2");
+  hwloc_topology_set_type_filter(topo1, HWLOC_OBJ_MISC, HWLOC_TYPE_FILTER_KEEP_ALL);
+  hwloc_topology_load(topo1);
+  hwloc_topology_dup(&topo2, topo1);
+
+  printf("remove the second core of topo2 and add a Misc object\n");
+  cpuset = hwloc_bitmap_dup(hwloc_topology_get_topology_cpuset(topo2));
+  hwloc_bitmap_clr_range(cpuset, 2, 3);
+  err = hwloc_topology_restrict(topo2, cpuset, 0);
+  assert(!err);
+  hwloc_bitmap_free(cpuset);
+  obj = hwloc_get_obj_by_type(topo2, HWLOC_OBJ_CORE, 2);
+  assert(obj);
+  obj = hwloc_topology_insert_misc_object(topo2, obj, "Foo");
+  assert(obj);
+
+  printf("check that topo2 is properly diff'ed from topo1\n");
+  err = hwloc_topology_diff_build(topo1, topo2, 0, &diff);
+  assert(err == 0);
+  assert(diff);
+  for(tmpdiff = diff; tmpdiff; tmpdiff = tmpdiff->generic.next)
+    if (tmpdiff->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_REMOVE) {
+      assert(tmpdiff->obj_subtree.obj->type == HWLOC_OBJ_CORE);
+      assert(tmpdiff->obj_subtree.position == 1);
+    } else if (tmpdiff->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_INSERT) {
+      assert(tmpdiff->obj_subtree.obj->type == HWLOC_OBJ_MISC);
+      assert(tmpdiff->obj_subtree.position == 0);
+    } else {
+      assert(tmpdiff->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR);
+      assert(tmpdiff->obj_attr.diff.generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR_SET);
+    }
+
+  printf("check that subtree hashes give the same diff\n");
+  for(i=0; i<2; i++) {
+    /* second iteration uses cached hashes */
+    err = hwloc_topology_diff_build(topo1, topo2, HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES, &diff2);
+    assert(err == 0);
+    for(tmpdiff = diff, tmpdiff2 = diff2;
+        tmpdiff && tmpdiff2;
+        tmpdiff = tmpdiff->generic.next, tmpdiff2 = tmpdiff2->generic.next)
+      assert(tmpdiff->generic.type == tmpdiff2->generic.type);
+    assert(!tmpdiff && !tmpdiff2);
+    hwloc_topology_diff_destroy(diff2);
+  }
+
+  printf("apply the diff to new duplicate topo3 of topo1\n");
+  hwloc_topology_dup(&topo3, topo1);
+  err = hwloc_topology_diff_build(topo1, topo3, HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES, &diff2);
+  assert(err == 0);
+  assert(!diff2);
+  err = hwloc_topology_diff_apply(topo3, diff, 0);
+  assert(!err);
+  assert(hwloc_get_nbobjs_by_type(topo3, HWLOC_OBJ_CORE) == 3);
+  printf("check that hashes were updated by the diff application\n");
+  err = hwloc_topology_diff_build(topo2, topo3, HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES, &diff2);
+  assert(err == 0);
+  assert(!diff2);
+  err = hwloc_topology_diff_build(topo1, topo3, HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES, &diff2);
+  assert(err == 0);
+  assert(diff2);
+  hwloc_topology_diff_destroy(diff2);
+  assert(hwloc_get_nbobjs_by_type(topo3, HWLOC_OBJ_MISC) == 1);
+  printf("check that topo2 and topo3 are identical\n");
+  err = hwloc_topology_diff_build(topo2, topo3, 0, &diff2);
+  assert(err == 0);
+  assert(!diff2);
+
+  printf("check that the diff cannot be applied twice\n");
+  err = hwloc_topology_diff_apply(topo3, diff, 0);
+  assert(err < 0);
+
+  printf("apply the reverse diff to topo2\n");
+  err = hwloc_topology_diff_apply(topo2, diff, HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE);
+  assert(!err);
+  printf("check that topo2 and topo1 are identical\n");
+  err = hwloc_topology_diff_build(topo1, topo2, 0, &diff2);
+  assert(err == 0);
+  assert(!diff2);
+
+  printf("exporting and reloading structural diff from XML buffer\n");
+  err = hwloc_topology_diff_export_xmlbuffer(diff, NULL, &xmlbuffer, &xmlbuflen);
+  assert(!err);
+  hwloc_topology_diff_destroy(diff);
+  err = hwloc_topology_diff_load_xmlbuffer(xmlbuffer, xmlbuflen, &diff, &refname);
+  assert(!err);
+  assert(diff);
+  hwloc_free_xmlbuffer(topo1, xmlbuffer);
+
+  printf("reapplying to topo2\n");
+  err = hwloc_topology_diff_apply(topo2, diff, 0);
+  assert(!err);
+  printf("check that topo2 and topo3 are again identical\n");
+  err = hwloc_topology_diff_build(topo2, topo3, 0, &diff2);
+  assert(err == 0);
+  assert(!diff2);
+  hwloc_topology_diff_destroy(diff);
+
+  printf("check that fingerprints match diffs\n");
+  err = hwloc_topology_fingerprint(topo1, ~0UL, &fp1);
+  assert(err < 0);
+  assert(errno == EINVAL);
+  err = hwloc_topology_fingerprint(topo2, HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS, &fp1);
+  assert(!err);
+  err = hwloc_topology_fingerprint(topo3, HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS, &fp2);
+  assert(!err);
+  assert(fp1 == fp2);
+  err = hwloc_topology_fingerprint(topo1, HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS, &fp2);
+  assert(!err);
+  assert(fp1 != fp2);
+
+  printf("check that infos are only part of fingerprints when requested\n");
+  hwloc_topology_destroy(topo3);
+  hwloc_topology_dup(&topo3, topo1);
+  hwloc_obj_add_info(hwloc_get_root_obj(topo3), "Foo", "Bar");
+  hwloc_topology_fingerprint(topo1, 0, &fp1);
+  hwloc_topology_fingerprint(topo3, 0, &fp2);
+  assert(fp1 == fp2);
+  hwloc_topology_fingerprint(topo1, HWLOC_TOPOLOGY_FINGERPRINT_FLAG_IO, &fp1);
+  hwloc_topology_fingerprint(topo3, HWLOC_TOPOLOGY_FINGERPRINT_FLAG_IO, &fp2);
+  assert(fp1 == fp2);
+  hwloc_topology_fingerprint(topo1, HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS, &fp1);
+  hwloc_topology_fingerprint(topo3, HWLOC_TOPOLOGY_FINGERPRINT_FLAG_INFOS, &fp2);
+  assert(fp1 != fp2);
+
+  hwloc_topology_destroy(topo3);
+  hwloc_topology_destroy(topo2);
+  hwloc_topology_destroy(topo1);
+
+  printf("load synthetic topo1 with an info attribute in its second core\n");
+  hwloc_topology_init(&topo1);
+  hwloc_topology_set_synthetic(topo1, "pack:2 core:2 pu:2");
+  hwloc_topology_load(topo1);
+  obj = hwloc_get_obj_by_type(topo1, HWLOC_OBJ_CORE, 1);
+  hwloc_obj_add_info(obj, "Foo", "Old");
+
+  printf("change the info attribute of the second core in topo3\n");
+  hwloc_topology_dup(&topo3, topo1);
+  obj = hwloc_get_obj_by_type(topo3, HWLOC_OBJ_CORE, 1);
+  for(i=0; i<obj->infos_count; i++)
+    if (!strcmp(obj->infos[i].name, "Foo")) {
+      free(obj->infos[i].value);
+      obj->infos[i].value = strdup("New");
+    }
+  err = hwloc_topology_diff_build(topo1, topo3, 0, &diff2);
+  assert(err == 0);
+  assert(diff2);
+  assert(diff2->generic.type == HWLOC_TOPOLOGY_DIFF_OBJ_ATTR);
+  assert(!diff2->generic.next);
+  hwloc_topology_destroy(topo3);
+
+  printf("remove the second core in topo2\n");
+  hwloc_topology_dup(&topo2, topo1);
+  cpuset = hwloc_bitmap_dup(hwloc_topology_get_topology_cpuset(topo2));
+  hwloc_bitmap_clr_range(cpuset, 2, 3);
+  err = hwloc_topology_restrict(topo2, cpuset, 0);
+  assert(!err);
+  hwloc_bitmap_free(cpuset);
+  err = hwloc_topology_diff_build(topo1, topo2, 0, &diff);
+  assert(err == 0);
+  assert(diff);
+
+  printf("append the attribute change inside the removed core to the structural diff\n");
+  for(tmpdiff = diff; tmpdiff->generic.next; tmpdiff = tmpdiff->generic.next);
+  tmpdiff->generic.next = diff2;
+
+  printf("check that the diff applies to a duplicate topo3 of topo1 and gives topo2\n");
+  hwloc_topology_dup(&topo3, topo1);
+  err = hwloc_topology_diff_apply(topo3, diff, 0);
+  assert(!err);
+  err = hwloc_topology_diff_build(topo2, topo3, 0, &diff2);
+  assert(err == 0);
+  assert(!diff2);
+
+  printf("check that the reverse diff applies to topo2 and gives topo1\n");
+  err = hwloc_topology_diff_apply(topo2, diff, HWLOC_TOPOLOGY_DIFF_APPLY_REVERSE);
+  assert(!err);
+  err = hwloc_topology_diff_build(topo1, topo2, 0, &diff2);
+  assert(err == 0);
+  assert(!diff2);
+  hwloc_topology_diff_destroy(diff);
+
+  hwloc_topology_destroy(topo3);
+  hwloc_topology_destroy(topo2);
+  hwloc_topology_destroy(topo1);
+
   return 0;
 }
@@ -0,0 +1,114 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <private/autogen/config.h>
+#include <hwloc.h>
+#include <hwloc/linux.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+/* check that the numa_maps of the current process reports bound buffers on the right node,
+ * and that mapped file paths containing spaces are parsed entirely
+ */
+
+int main(void)
+{
+  hwloc_topology_t topology;
+  struct hwloc_linux_numa_map_s *maps, *map = NULL, *filemap = NULL;
+  hwloc_bitmap_t set;
+  hwloc_membind_policy_t policy;
+  hwloc_obj_t node;
+  size_t pagesize = sysconf(_SC_PAGESIZE);
+  size_t len = 64*pagesize;
+  unsigned nr, i;
+  char *buffer, *filebuffer;
+  char filename[] = "/tmp/hwloc numa maps XXXXXX";
+  int bound;
+  int fd;
+  int err;
+
+  err = hwloc_topology_init(&topology);
+  assert(!err);
+  err = hwloc_topology_load(topology);
+  assert(!err);
+
+  err = hwloc_linux_get_proc_numa_maps(topology, 0, &maps, &nr, ~0UL);
+  assert(err == -1 && errno == EINVAL);
+  err = hwloc_linux_get_proc_numa_maps(topology, INT_MAX, &maps, &nr, 0);
+  assert(err == -1 && (errno == ESRCH || errno == ENOSYS));
+
+  fd = mkstemp(filename);
+  assert(fd >= 0);
+  err = ftruncate(fd, pagesize);
+  assert(!err);
+  filebuffer = mmap(NULL, pagesize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  assert(filebuffer != MAP_FAILED);
+  filebuffer[0] = 1;
+
+  node = hwloc_get_obj_by_type(topology, HWLOC_OBJ_NUMANODE, hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_NUMANODE)-1);
+  assert(node);
+  buffer = hwloc_alloc_membind(topology, len, node->nodeset, HWLOC_MEMBIND_BIND, HWLOC_MEMBIND_BYNODESET);
+  assert(buffer);
+  memset(buffer, 0, len);
+
+  /* check whether the buffer was actually bound */
+  set = hwloc_bitmap_alloc();
+  err = hwloc_get_area_membind(topology, buffer, len, set, &policy, HWLOC_MEMBIND_BYNODESET);
+  bound = !err && policy == HWLOC_MEMBIND_BIND && hwloc_bitmap_isequal(set, node->nodeset);
+  hwloc_bitmap_free(set);
+
+  err = hwloc_linux_get_proc_numa_maps(topology, 0, &maps, &nr, 0);
+  if (err < 0) {
+    assert(errno == ENOSYS);
+    printf("numa_maps not supported\n");
+    goto out;
+  }
+  assert(nr > 0);
+
+  /* find the last mapping that starts before the buffer */
+  for(i=0; i<nr; i++) {
+    assert(maps[i].page_size);
+    if (maps[i].start <= (unsigned long) buffer)
+      map = &maps[i];
+  }
+  assert(map);
+  printf("buffer %p found in mapping 0x%lx with %lu pages\n", buffer, map->start, map->nr_pages);
+  assert(map->nr_pages * map->page_size >= len);
+
+  /* the mapped file path is reported entirely despite its spaces */
+  for(i=0; i<nr; i++)
+    if (maps[i].start == (unsigned long) filebuffer)
+      filemap = &maps[i];
+  assert(filemap);
+  assert(filemap->name);
+  printf("file mapping 0x%lx named \"%s\" with %lu pages\n", filemap->start, filemap->name, filemap->nr_pages);
+  assert(!strcmp(filemap->name, filename));
+  assert(filemap->nr_pages == 1);
+
+  if (bound) {
+    /* a bound buffer gets its own mapping */
+    assert(map->start == (unsigned long) buffer);
+    assert(map->policy == HWLOC_MEMBIND_BIND);
+    assert(hwloc_bitmap_isequal(map->policy_nodeset, node->nodeset));
+    assert(node->os_index < map->nr_node_pages);
+    assert(map->node_pages[node->os_index] == map->nr_pages);
+  }
+
+  hwloc_linux_free_proc_numa_maps(maps, nr);
+
+ out:
+  munmap(filebuffer, pagesize);
+  close(fd);
+  unlink(filename);
+  hwloc_free(topology, buffer, len);
+  hwloc_topology_destroy(topology);
+  return 0;
+}
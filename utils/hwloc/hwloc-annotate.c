@@ -16,6 +16,7 @@
 void usage(const char *callname __hwloc_attribute_unused, FILE *where)
 {
 	fprintf(where, "Usage: hwloc-annotate [options] <input.xml> <output.xml> <location> <annotation>\n");
+	fprintf(where, "       hwloc-annotate [options] --batch <file> <input.xml> <output.xml>\n");
 	fprintf(where, "  <location> may be:\n");
 	fprintf(where, "    all, root, <type>:<logicalindex>, <type>:all\n");
 	fprintf(where, "  <annotation> may be:\n");
@@ -28,6 +29,7 @@ void usage(const char *callname __hwloc_attribute_unused, FILE *where)
 	fprintf(where, "  --ri\tReplace or remove existing infos with same name (annotation must be info)\n");
 	fprintf(where, "  --cu\tClear existing userdata\n");
 	fprintf(where, "  --cd\tClear existing distances\n");
+	fprintf(where, "  --batch <file>\tApply one <location> <annotation> per line of <file>\n");
 }
 
 static char *infoname = NULL, *infovalue = NULL;
@@ -41,21 +43,28 @@ static int replaceinfos = 0;
 static int clearuserdata = 0;
 static int cleardistances = 0;
 
+/* gp_index of objects whose infos and userdata were already cleared,
+ * so that several annotations of the same object in batch mode don't clear each other */
+static hwloc_bitmap_t cleared = NULL;
+
 static void apply(hwloc_topology_t topology, hwloc_obj_t obj)
 {
 	unsigned i,j;
-	if (clearinfos) {
-		/* this may be considered dangerous, applications should not modify objects directly */
-		for(i=0; i<obj->infos_count; i++) {
-			free(obj->infos[i].name);
-			free(obj->infos[i].value);
+	if ((clearinfos || clearuserdata) && !hwloc_bitmap_isset(cleared, (unsigned) obj->gp_index)) {
+		hwloc_bitmap_set(cleared, (unsigned) obj->gp_index);
+		if (clearinfos) {
+			/* this may be considered dangerous, applications should not modify objects directly */
+			for(i=0; i<obj->infos_count; i++) {
+				free(obj->infos[i].name);
+				free(obj->infos[i].value);
+			}
+			free(obj->infos);
+			obj->infos = NULL;
+			obj->infos_count = 0;
+		}
+		if (clearuserdata) {
+			hwloc_utils_userdata_free(obj);
 		}
-		free(obj->infos);
-		obj->infos = NULL;
-		obj->infos_count = 0;
-	}
-	if (clearuserdata) {
-		hwloc_utils_userdata_free(obj);
 	}
 	if (infoname) {
 		if (replaceinfos) {
@@ -113,7 +122,146 @@ hwloc_calc_get_obj_cb(void *_data,
 	*(hwloc_obj_t*)_data = obj;
 }
 
-static void
+/* PCI and OS devices sorted by busid and name, built on first use */
+static hwloc_obj_t *pcidevs = NULL, *osdevs = NULL;
+static unsigned nr_pcidevs = 0, nr_osdevs = 0;
+
+static int compare_pcidevs(const void *_a, const void *_b)
+{
+	const struct hwloc_pcidev_attr_s *a = &(*(const hwloc_obj_t *) _a)->attr->pcidev;
+	const struct hwloc_pcidev_attr_s *b = &(*(const hwloc_obj_t *) _b)->attr->pcidev;
+	if (a->domain != b->domain)
+		return a->domain < b->domain ? -1 : 1;
+	if (a->bus != b->bus)
+		return a->bus < b->bus ? -1 : 1;
+	if (a->dev != b->dev)
+		return a->dev < b->dev ? -1 : 1;
+	if (a->func != b->func)
+		return a->func < b->func ? -1 : 1;
+	return 0;
+}
+
+static int compare_osdevs(const void *_a, const void *_b)
+{
+	return strcmp((*(const hwloc_obj_t *) _a)->name, (*(const hwloc_obj_t *) _b)->name);
+}
+
+static hwloc_obj_t *
+build_index(hwloc_topology_t topology, hwloc_obj_type_t type, unsigned *nrp,
+	    int (*compar)(const void *, const void *))
+{
+	hwloc_obj_t *objs, obj = NULL;
+	unsigned nr = 0;
+	int n = hwloc_get_nbobjs_by_type(topology, type);
+	objs = malloc((n > 0 ? n : 1) * sizeof(*objs));
+	if (!objs)
+		return NULL;
+	while ((obj = hwloc_get_next_obj_by_type(topology, type, obj)) != NULL)
+		if (type != HWLOC_OBJ_OS_DEVICE || obj->name)
+			objs[nr++] = obj;
+	qsort(objs, nr, sizeof(*objs), compar);
+	*nrp = nr;
+	return objs;
+}
+
+/* find the single object designated by <type>:<index>, pci=<busid> or os=<name>
+ * using topology levels and sorted indexes,
+ * returns NULL if the location is anything more complex.
+ */
+static hwloc_obj_t
+lookup_location(hwloc_topology_t topology, const char *location)
+{
+	char typestring[20+1];
+	size_t typelen;
+	int depth;
+
+	typelen = strspn(location, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789");
+	if (!typelen || typelen >= sizeof(typestring))
+		return NULL;
+	memcpy(typestring, location, typelen);
+	typestring[typelen] = '\0';
+
+	if (location[typelen] == '=') {
+		struct hwloc_obj key_obj, *key = &key_obj, **found;
+		union hwloc_obj_attr_u key_attr;
+		hwloc_obj_type_t type;
+		if (hwloc_type_sscanf(typestring, &type, NULL, 0) < 0)
+			return NULL;
+
+		if (type == HWLOC_OBJ_PCI_DEVICE) {
+			unsigned domain = 0, bus, dev, func;
+			if (sscanf(location+typelen+1, "%x:%x.%x", &bus, &dev, &func) != 3
+			    && sscanf(location+typelen+1, "%x:%x:%x.%x", &domain, &bus, &dev, &func) != 4)
+				return NULL;
+			if (!pcidevs)
+				pcidevs = build_index(topology, HWLOC_OBJ_PCI_DEVICE, &nr_pcidevs, compare_pcidevs);
+			if (!pcidevs)
+				return NULL;
+			key_obj.attr = &key_attr;
+			key_attr.pcidev.domain = domain;
+			key_attr.pcidev.bus = bus;
+			key_attr.pcidev.dev = dev;
+			key_attr.pcidev.func = func;
+			found = bsearch(&key, pcidevs, nr_pcidevs, sizeof(*pcidevs), compare_pcidevs);
+			return found ? *found : NULL;
+
+		} else if (type == HWLOC_OBJ_OS_DEVICE) {
+			if (!osdevs)
+				osdevs = build_index(topology, HWLOC_OBJ_OS_DEVICE, &nr_osdevs, compare_osdevs);
+			if (!osdevs)
+				return NULL;
+			key_obj.name = (char *) location+typelen+1;
+			found = bsearch(&key, osdevs, nr_osdevs, sizeof(*osdevs), compare_osdevs);
+			return found ? *found : NULL;
+		}
+		return NULL;
+
+	} else if (location[typelen] == ':') {
+		const char *indexstring = location+typelen+1;
+		char *end;
+		unsigned long idx;
+		if (!isdigit(*indexstring))
+			return NULL;
+		idx = strtoul(indexstring, &end, 10);
+		if (*end)
+			return NULL;
+		if (hwloc_type_sscanf_as_depth(typestring, NULL, topology, &depth) < 0 || depth < 0)
+			return NULL;
+		return hwloc_get_obj_by_depth(topology, depth, idx);
+	}
+
+	return NULL;
+}
+
+static int
+apply_location(hwloc_topology_t topology, unsigned topodepth, const char *location)
+{
+	hwloc_obj_t obj;
+	size_t typelen;
+
+	if (!strcmp(location, "all")) {
+		apply_recursive(topology, hwloc_get_root_obj(topology));
+		return 0;
+	} else if (!strcmp(location, "root")) {
+		apply(topology, hwloc_get_root_obj(topology));
+		return 0;
+	}
+
+	obj = lookup_location(topology, location);
+	if (obj) {
+		apply(topology, obj);
+		return 0;
+	}
+
+	typelen = strspn(location, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789");
+	if (typelen && (location[typelen] == ':' || location[typelen] == '=' || location[typelen] == '['))
+		return hwloc_calc_process_type_arg(topology, topodepth, location, typelen, 1,
+						   hwloc_calc_process_arg_info_cb, topology,
+						   0);
+	return -1;
+}
+
+static int
 add_distances(hwloc_topology_t topology, unsigned topodepth)
 {
 	unsigned long kind = 0;
@@ -123,12 +271,12 @@ add_distances(hwloc_topology_t topology, unsigned topodepth)
 	FILE *file;
 	char line[64];
 	unsigned i, x, y, z;
-	int err;
+	int err, ret = -1;
 
 	file = fopen(distancesfilename, "r");
 	if (!file) {
 		fprintf(stderr, "Failed to open distances file %s\n", distancesfilename);
-		return;
+		return -1;
 	}
 
 	if (!fgets(line, sizeof(line), file)) {
@@ -163,11 +311,14 @@ add_distances(hwloc_topology_t topology, unsigned topodepth)
 		if (typelen && line[typelen] == ':') {
 			size_t length = strspn(line+typelen+1, "0123456789");
 			line[typelen+1+length] = '\0';
-			err = hwloc_calc_process_type_arg(topology, topodepth, line, typelen, 1,
-							  hwloc_calc_get_obj_cb, &obj,
-							  0);
-			if (err < 0)
-				goto out;
+			obj = lookup_location(topology, line);
+			if (!obj) {
+				err = hwloc_calc_process_type_arg(topology, topodepth, line, typelen, 1,
+								  hwloc_calc_get_obj_cb, &obj,
+								  0);
+				if (err < 0)
+					goto out;
+			}
 		} else {
 			fprintf(stderr, "Cannot parse object #%u line\n", i);
 			goto out;
@@ -220,18 +371,126 @@ add_distances(hwloc_topology_t topology, unsigned topodepth)
 		fprintf(stderr, "Failed to add distances\n");
 		goto out;
 	}
+	ret = 0;
 
 out:
 	free(objs);
 	free(values);
 	fclose(file);
-	return;
+	return ret;
+}
+
+/* return the next space-separated token of *linep, or NULL */
+static char *
+next_token(char **linep)
+{
+	char *token = *linep + strspn(*linep, " \t");
+	size_t len = strcspn(token, " \t");
+	if (!len)
+		return NULL;
+	*linep = token + len;
+	if (**linep)
+		*(*linep)++ = '\0';
+	return token;
+}
+
+static int
+apply_batch(hwloc_topology_t topology, unsigned topodepth, const char *filename)
+{
+	FILE *file;
+	char line[4096];
+	unsigned linenr = 0;
+	int ret = 0;
+
+	if (!strcmp(filename, "-"))
+		file = stdin;
+	else
+		file = fopen(filename, "r");
+	if (!file) {
+		fprintf(stderr, "Failed to open batch file %s\n", filename);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		char *current = line, *location, *annotation, *rest;
+		size_t len = strlen(line);
+		linenr++;
+
+		if (len && line[len-1] == '\n')
+			line[--len] = '\0';
+		else if (len == sizeof(line)-1) {
+			fprintf(stderr, "Line %u of %s is too long\n", linenr, filename);
+			ret = -1;
+			break;
+		}
+
+		location = next_token(&current);
+		if (!location || *location == '#')
+			continue;
+		annotation = next_token(&current);
+		if (!annotation) {
+			fprintf(stderr, "Missing annotation at line %u of %s\n", linenr, filename);
+			ret = -1;
+			continue;
+		}
+
+		infoname = infovalue = miscname = distancesfilename = NULL;
+		distancesflags = 0;
+		if (!strcmp(annotation, "info")) {
+			infoname = next_token(&current);
+			rest = current + strspn(current, " \t");
+			infovalue = *rest ? rest : NULL;
+			if (!infoname || (!replaceinfos && !infovalue)) {
+				fprintf(stderr, "Missing info name or value at line %u of %s\n", linenr, filename);
+				ret = -1;
+				continue;
+			}
+		} else if (!strcmp(annotation, "misc")) {
+			rest = current + strspn(current, " \t");
+			if (!*rest) {
+				fprintf(stderr, "Missing misc name at line %u of %s\n", linenr, filename);
+				ret = -1;
+				continue;
+			}
+			miscname = rest;
+		} else if (!strcmp(annotation, "distances")) {
+			char *flags;
+			distancesfilename = next_token(&current);
+			if (!distancesfilename) {
+				fprintf(stderr, "Missing distances filename at line %u of %s\n", linenr, filename);
+				ret = -1;
+				continue;
+			}
+			flags = next_token(&current);
+			if (flags)
+				distancesflags = strtoul(flags, NULL, 0);
+			if (add_distances(topology, topodepth) < 0) {
+				fprintf(stderr, "Failed to add distances from %s at line %u of %s\n", distancesfilename, linenr, filename);
+				ret = -1;
+			}
+			continue;
+		} else if (strcmp(annotation, "none")) {
+			fprintf(stderr, "Unrecognized annotation type %s at line %u of %s\n", annotation, linenr, filename);
+			ret = -1;
+			continue;
+		}
+
+		if (apply_location(topology, topodepth, location) < 0) {
+			fprintf(stderr, "Failed to find location %s at line %u of %s\n", location, linenr, filename);
+			ret = -1;
+		}
+	}
+
+	if (file != stdin)
+		fclose(file);
+	return ret;
 }
 
 int main(int argc, char *argv[])
 {
 	hwloc_topology_t topology;
-	char *callname, *input, *output, *location;
+	char *callname, *input, *output, *location = NULL;
+	char *batchfilename = NULL;
 	unsigned topodepth;
 	int err;
 
@@ -253,7 +512,15 @@ int main(int argc, char *argv[])
 			clearuserdata = 1;
 		else if (!strcmp(argv[0], "--cd"))
 			cleardistances = 1;
-		else {
+		else if (!strcmp(argv[0], "--batch")) {
+			if (argc < 2) {
+				usage(callname, stderr);
+				exit(EXIT_FAILURE);
+			}
+			batchfilename = argv[1];
+			argc--;
+			argv++;
+		} else {
 			fprintf(stderr, "Unrecognized options: %s\n", argv[0]);
 			usage(callname, stderr);
 			exit(EXIT_FAILURE);
@@ -262,6 +529,16 @@ int main(int argc, char *argv[])
 		argv++;
 	}
 
+	if (batchfilename) {
+		if (argc != 2) {
+			usage(callname, stderr);
+			exit(EXIT_FAILURE);
+		}
+		input = argv[0];
+		output = argv[1];
+		goto load;
+	}
+
 	if (argc < 3) {
 		usage(callname, stderr);
 		exit(EXIT_FAILURE);
@@ -314,6 +591,8 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+ load:
+	cleared = hwloc_bitmap_alloc();
 	hwloc_topology_init(&topology);
 	hwloc_topology_set_all_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
 	hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM);
@@ -333,31 +612,31 @@ int main(int argc, char *argv[])
 		hwloc_distances_remove(topology);
 	}
 
-	if (distancesfilename) {
+	if (batchfilename) {
+		err = apply_batch(topology, topodepth, batchfilename);
+		if (err < 0)
+			goto out;
+	} else if (distancesfilename) {
 		add_distances(topology, topodepth);
-	} else if (!strcmp(location, "all")) {
-		apply_recursive(topology, hwloc_get_root_obj(topology));
-	} else if (!strcmp(location, "root")) {
-		apply(topology, hwloc_get_root_obj(topology));
 	} else {
-		size_t typelen;
-		typelen = strspn(location, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789");
-		if (typelen && (location[typelen] == ':' || location[typelen] == '=' || location[typelen] == '[')) {
-			err = hwloc_calc_process_type_arg(topology, topodepth, location, typelen, 1,
-							  hwloc_calc_process_arg_info_cb, topology,
-							  0);
-		}
+		apply_location(topology, topodepth, location);
 	}
 
 	err = hwloc_topology_export_xml(topology, output, 0);
 	if (err < 0)
 		goto out;
 
+	free(pcidevs);
+	free(osdevs);
+	hwloc_bitmap_free(cleared);
 	hwloc_utils_userdata_free_recursive(hwloc_get_root_obj(topology));
 	hwloc_topology_destroy(topology);
 	exit(EXIT_SUCCESS);
 
 out:
+	free(pcidevs);
+	free(osdevs);
+	hwloc_bitmap_free(cleared);
 	hwloc_utils_userdata_free_recursive(hwloc_get_root_obj(topology));
 	hwloc_topology_destroy(topology);
 	exit(EXIT_FAILURE);
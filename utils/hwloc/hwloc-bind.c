@@ -60,6 +60,50 @@ void usage(const char *name, FILE *where)
   fprintf(where, "  --version      Report version and exit\n");
 }
 
+/* load the topology from the cache given in the environment if any,
+ * and fallback to discovering the machine if the cache cannot be used.
+ */
+static void
+load_topology(hwloc_topology_t *topologyp, unsigned long flags, int verbose)
+{
+  const char *cache = getenv("HWLOC_BIND_XMLFILE");
+  hwloc_topology_t topology;
+
+  if (cache && *cache) {
+    hwloc_topology_init(&topology);
+    hwloc_topology_set_all_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+    /* the cache describes this machine, keep binding support */
+    hwloc_topology_set_flags(topology, flags | HWLOC_TOPOLOGY_FLAG_IS_THISSYSTEM);
+    if (!hwloc_topology_set_xml(topology, cache)
+	&& !hwloc_topology_load(topology)) {
+      *topologyp = topology;
+      return;
+    }
+    if (verbose >= 0)
+      fprintf(stderr, "Failed to load cached topology from %s, discovering the machine instead\n", cache);
+    hwloc_topology_destroy(topology);
+  }
+
+  hwloc_topology_init(&topology);
+  hwloc_topology_set_all_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+  hwloc_topology_set_flags(topology, flags);
+  hwloc_topology_load(topology);
+  *topologyp = topology;
+}
+
+/* number of processors configured in the system, or 0 if unknown */
+static int
+hwloc_bind_nbprocessors(void)
+{
+  long n = -1;
+#if HAVE_DECL__SC_NPROCESSORS_CONF
+  n = sysconf(_SC_NPROCESSORS_CONF);
+#elif HAVE_DECL__SC_NPROC_CONF
+  n = sysconf(_SC_NPROC_CONF);
+#endif
+  return n > 0 ? (int) n : 0;
+}
+
 int main(int argc, char *argv[])
 {
   hwloc_topology_t topology;
@@ -101,10 +145,7 @@ int main(int argc, char *argv[])
 #define LOADED() (loaded)
 #define ENSURE_LOADED() do { \
   if (!loaded) { \
-    hwloc_topology_init(&topology); \
-    hwloc_topology_set_all_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL); \
-    hwloc_topology_set_flags(topology, flags); \
-    hwloc_topology_load(topology); \
+    load_topology(&topology, flags, verbose); \
     depth = hwloc_topology_get_depth(topology); \
     loaded = 1; \
   } \
@@ -254,6 +295,20 @@ int main(int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
+    if (!loaded && working_on_cpubind && !use_nodeset) {
+      /* numeric cpusets don't need the topology,
+       * delay the discovery in case all locations are like this.
+       */
+      hwloc_bitmap_t newset = hwloc_bitmap_alloc();
+      if (!hwloc_calc_parse_bitmap(argv[0], newset)) {
+	hwloc_calc_append_set(cpubind_set, newset, HWLOC_CALC_APPEND_ADD, verbose);
+	hwloc_bitmap_free(newset);
+	got_cpubind = 1;
+	goto next;
+      }
+      hwloc_bitmap_free(newset);
+    }
+
     ENSURE_LOADED();
     ret = hwloc_calc_process_arg(topology, depth, argv[0], logical,
 				 working_on_cpubind ? cpubind_set : membind_set,
@@ -275,6 +330,25 @@ int main(int argc, char *argv[])
     argv += opt+1;
   }
 
+  if (!loaded && got_cpubind && !got_membind && !get_binding && !get_last_cpu_location && !flags
+      && hwloc_bitmap_last(cpubind_set) >= 0
+      && hwloc_bitmap_last(cpubind_set) < hwloc_bind_nbprocessors()) {
+    /* only numeric cpusets within the existing processors were given,
+     * no need to discover the machine, a flat topology covering the set is enough for binding.
+     * topology flags such as --whole-system need the actual topology.
+     */
+    char synthetic[32];
+    if (verbose > 0)
+      fprintf(stderr, "only numeric cpusets given, not discovering the topology\n");
+    snprintf(synthetic, sizeof(synthetic), "pu:%d", hwloc_bitmap_last(cpubind_set)+1);
+    hwloc_topology_init(&topology);
+    hwloc_topology_set_synthetic(topology, synthetic);
+    hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_IS_THISSYSTEM);
+    hwloc_topology_load(topology);
+    depth = hwloc_topology_get_depth(topology);
+    loaded = 1;
+  }
+
   ENSURE_LOADED();
 
   if (pid_number > 0 && tid_number > 0) {
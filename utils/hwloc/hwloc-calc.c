@@ -47,6 +47,9 @@ void usage(const char *callname __hwloc_attribute_unused, FILE *where)
   fprintf(where, "  --restrict <cpuset>       Restrict the topology to processors listed in <cpuset>\n");
   fprintf(where, "  --whole-system            Do not consider administration limitations\n");
   hwloc_utils_input_format_usage(where, 10);
+  fprintf(where, "Batch options:\n");
+  fprintf(where, "  --batch                   Read one location per line from stdin and report\n"
+		 "                            exactly one result line for each, flushed immediately\n");
   fprintf(where, "Miscellaneous options:\n");
   fprintf(where, "  -q --quiet                Hide non-fatal error messages\n");
   fprintf(where, "  -v --verbose              Show verbose messages\n");
@@ -63,6 +66,7 @@ static int *hierdepth = NULL;
 static int showobjs = 0;
 static int singlify = 0;
 static int taskset = 0;
+static int batch = 0;
 
 static void
 hwloc_calc_hierarch_output(hwloc_topology_t topology, const char *prefix, const char *sep, hwloc_obj_t root, hwloc_bitmap_t set, int level)
@@ -102,28 +106,55 @@ hwloc_calc_output(hwloc_topology_t topology, const char *sep, hwloc_bitmap_t set
 
   if (showobjs) {
     hwloc_bitmap_t remaining = hwloc_bitmap_dup(set);
+    /* batch mode builds the whole line first so that it never reports a partial result */
+    char *output = NULL;
+    size_t outlen = 0, outsize = 0;
     int first = 1;
     if (!sep)
       sep = " ";
     while (!hwloc_bitmap_iszero(remaining)) {
       char type[64];
+      char item[80];
       unsigned idx;
       hwloc_obj_t obj = hwloc_get_first_largest_obj_inside_cpuset(topology, remaining);
       if (!obj) {
         hwloc_bitmap_free(remaining);
+        free(output);
         fprintf(stderr, "No object included in this cpuset\n");
         return EXIT_FAILURE;
       }
       hwloc_obj_type_snprintf(type, sizeof(type), obj, 1);
       idx = logicalo ? obj->logical_index : obj->os_index;
       if (idx == (unsigned) -1)
-        printf("%s%s", first ? (const char *) "" : sep, type);
+        snprintf(item, sizeof(item), "%s", type);
       else
-        printf("%s%s:%u", first ? (const char *) "" : sep, type, idx);
+        snprintf(item, sizeof(item), "%s:%u", type, idx);
+      if (batch) {
+        size_t needed = outlen + strlen(sep) + strlen(item) + 1;
+        if (needed > outsize) {
+          char *tmp;
+          outsize = needed > 2*outsize ? needed : 2*outsize;
+          tmp = realloc(output, outsize);
+          if (!tmp) {
+            hwloc_bitmap_free(remaining);
+            free(output);
+            fprintf(stderr, "Failed to allocate output buffer\n");
+            return EXIT_FAILURE;
+          }
+          output = tmp;
+        }
+        outlen += sprintf(output + outlen, "%s%s", first ? (const char *) "" : sep, item);
+      } else {
+        printf("%s%s", first ? (const char *) "" : sep, item);
+      }
       hwloc_bitmap_andnot(remaining, remaining, obj->cpuset);
       first = 0;
     }
-    printf("\n");
+    if (batch)
+      printf("%s\n", output ? output : "");
+    else
+      printf("\n");
+    free(output);
     hwloc_bitmap_free(remaining);
   } else if (numberofdepth != -1) {
     unsigned nb = 0;
@@ -370,6 +401,10 @@ int main(int argc, char *argv[])
 	taskset = 1;
 	goto next;
       }
+      if (!strcmp(argv[0], "--batch")) {
+	batch = 1;
+	goto next;
+      }
       if (hwloc_utils_lookup_input_option(argv, argc, &opt,
 					  &input, &input_format,
 					  callname)) {
@@ -429,6 +464,13 @@ int main(int argc, char *argv[])
     }
   }
 
+  if (batch && cmdline_args) {
+    fprintf(stderr, "Locations cannot be given on the command-line with --batch\n");
+    usage(callname, stderr);
+    ret = EXIT_FAILURE;
+    goto out;
+  }
+
   if (cmdline_args) {
     /* process command-line arguments */
     ret = hwloc_calc_output(topology, outsep, set);
@@ -441,6 +483,7 @@ int main(int argc, char *argv[])
 
     while (1) {
       char *current, *tmpline;
+      int invalid;
 
       /* stop if line is empty */
       if (!fgets(line, (int)len, stdin))
@@ -467,15 +510,29 @@ int main(int argc, char *argv[])
       /* parse now that we got everything */
       current = line;
       hwloc_bitmap_zero(set);
+      invalid = 0;
       while (1) {
-	char *token = strtok(current, " \n");
+	char *token = strtok(current, " \t\n");
 	if (!token)
 	  break;
 	current = NULL;
-	if (hwloc_calc_process_arg(topology, depth, token, logicali, set, 0, 0, verbose) < 0)
+	if (hwloc_calc_process_arg(topology, depth, token, logicali, set, 0, 0, verbose) < 0) {
+	  if (batch) {
+	    fprintf(stderr, "invalid location %s\n", token);
+	    invalid = 1;
+	    break;
+	  }
 	  fprintf(stderr, "ignored unrecognized argument %s\n", token);
+	}
       }
-      hwloc_calc_output(topology, outsep, set);
+      if (invalid)
+	/* report an empty line rather than a partial result */
+	printf("\n");
+      else if (hwloc_calc_output(topology, outsep, set) != EXIT_SUCCESS && batch)
+	printf("\n");
+      if (batch)
+	/* the caller may be waiting for this result before sending the next line */
+	fflush(stdout);
     }
     free(line);
   }
@@ -507,6 +507,57 @@ hwloc_calc_process_arg_cpuset_cb(void *_data, hwloc_obj_t obj, int verbose)
 			HWLOC_CALC_APPEND_ADD, verbose);
 }
 
+/* parse a cpuset (or nodeset) string as given in locations.
+ * returns -1 if arg isn't such a string, the topology isn't needed.
+ */
+static __hwloc_inline int
+hwloc_calc_parse_bitmap(const char *arg, hwloc_bitmap_t set)
+{
+  const char *tmp = arg;
+  int taskset = ( strchr(tmp, ',') == NULL );
+
+  /* check the infinite prefix */
+  if (hwloc_strncasecmp(tmp, "0xf...f,", 7+!taskset) == 0) {
+    tmp += 7+!taskset;
+    if (0 == *tmp)
+      return -1;
+  }
+
+  if (taskset) {
+    /* check that the remaining is 0x followed by a huge hexadecimal number */
+    if (hwloc_strncasecmp(tmp, "0x", 2) != 0)
+      return -1;
+    tmp += 2;
+    if (0 == *tmp)
+      return -1;
+    if (strlen(tmp) != strspn(tmp, "0123456789abcdefABCDEF"))
+      return -1;
+
+  } else {
+    /* check that the remaining is a comma-separated list of hexadecimal integer with 0x as an optional prefix */
+    while (1) {
+      const char *next = strchr(tmp, ',');
+      size_t len;
+      if (hwloc_strncasecmp(tmp, "0x", 2) == 0) {
+	tmp += 2;
+	if (',' == *tmp || 0 == *tmp)
+	  return -1;
+      }
+      len = next ? (size_t) (next-tmp) : strlen(tmp);
+      if (len != strspn(tmp, "0123456789abcdefABCDEF"))
+	return -1;
+      if (!next)
+	break;
+      tmp = next+1;
+    }
+  }
+
+  if (taskset)
+    return hwloc_bitmap_taskset_sscanf(set, arg);
+  else
+    return hwloc_bitmap_sscanf(set, arg);
+}
+
 static __hwloc_inline int
 hwloc_calc_process_arg(hwloc_topology_t topology, unsigned topodepth,
 		       const char *arg, int logical, hwloc_bitmap_t set,
@@ -548,63 +599,12 @@ hwloc_calc_process_arg(hwloc_topology_t topology, unsigned topodepth,
 
   } else {
     /* try to match a cpuset */
-    char *tmp = (char*) arg;
-    hwloc_bitmap_t newset;
-    int taskset = ( strchr(tmp, ',') == NULL );
-
-    /* check the infinite prefix */
-    if (hwloc_strncasecmp(tmp, "0xf...f,", 7+!taskset) == 0) {
-      tmp += 7+!taskset;
-      if (0 == *tmp) {
-        err = -1;
-        goto out;
-      }
-    }
-
-    if (taskset) {
-      /* check that the remaining is 0x followed by a huge hexadecimal number */
-      if (hwloc_strncasecmp(tmp, "0x", 2) != 0) {
-        err = -1;
-        goto out;
-      }
-      tmp += 2;
-      if (0 == *tmp) {
-        err = -1;
-        goto out;
-      }
-      if (strlen(tmp) != strspn(tmp, "0123456789abcdefABCDEF")) {
-        err = -1;
-        goto out;
-      }
-
-    } else {
-      /* check that the remaining is a comma-separated list of hexadecimal integer with 0x as an optional prefix */
-      while (1) {
-	char *next = strchr(tmp, ',');
-	size_t len;
-        if (hwloc_strncasecmp(tmp, "0x", 2) == 0) {
-	  tmp += 2;
-	  if (',' == *tmp || 0 == *tmp) {
-	    err = -1;
-	    goto out;
-	  }
-	}
-	len = next ? (size_t) (next-tmp) : strlen(tmp);
-	if (len != strspn(tmp, "0123456789abcdefABCDEF")) {
-	  err = -1;
-	  goto out;
-	}
-	if (!next)
-	  break;
-	tmp = next+1;
-      }
+    hwloc_bitmap_t newset = hwloc_bitmap_alloc();
+    err = hwloc_calc_parse_bitmap(arg, newset);
+    if (err < 0) {
+      hwloc_bitmap_free(newset);
+      goto out;
     }
-
-    newset = hwloc_bitmap_alloc();
-    if (taskset)
-      hwloc_bitmap_taskset_sscanf(newset, arg);
-    else
-      hwloc_bitmap_sscanf(newset, arg);
     if (nodeset_output && !nodeset_input) {
       hwloc_bitmap_t newnset = hwloc_bitmap_alloc();
       hwloc_cpuset_to_nodeset(topology, newset, newnset);
@@ -0,0 +1,848 @@
+/*
+ * Copyright © 2013-2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <private/autogen/config.h>
+#include <hwloc.h>
+#include <hwloc/diff.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD_T
+#include <pthread.h>
+#endif
+
+#ifdef HWLOC_WIN_SYS
+#include <io.h>
+#ifndef W_OK
+#define W_OK 02
+#endif
+#endif
+
+#include "misc.h"
+
+static int verbose = 0;
+static unsigned nr_jobs = 1;
+
+void usage(const char *callname, FILE *where)
+{
+  fprintf(where, "Usage: %s [options] <inputdir> <outputdir>\n", callname);
+  fprintf(where, "  Compress topologies from <inputdir> into <outputdir>\n");
+  fprintf(where, "Options:\n");
+  fprintf(where, "  -R --reverse     Uncompress instead of compressing\n");
+  fprintf(where, "  -j --jobs <n>    Process up to <n> topologies in parallel\n");
+  fprintf(where, "  -v --verbose     Display verbose messages\n");
+  fprintf(where, "  --version        Report version and exit\n");
+}
+
+/***************************
+ * Helpers
+ */
+
+static char *
+build_path(const char *dir, const char *name, const char *suffix)
+{
+  size_t len = strlen(dir) + strlen(name) + strlen(suffix) + 2;
+  char *path = malloc(len);
+  if (path)
+    snprintf(path, len, "%s/%s%s", dir, name, suffix);
+  return path;
+}
+
+static int
+file_exists(const char *dir, const char *name, const char *suffix)
+{
+  struct stat st;
+  char *path = build_path(dir, name, suffix);
+  int ret;
+  if (!path)
+    return 0;
+  ret = !stat(path, &st) && S_ISREG(st.st_mode);
+  free(path);
+  return ret;
+}
+
+static int
+copy_file(const char *srcdir, const char *dstdir, const char *name, const char *suffix)
+{
+  char *srcpath = build_path(srcdir, name, suffix);
+  char *dstpath = build_path(dstdir, name, suffix);
+  FILE *src = NULL, *dst = NULL;
+  char buffer[4096];
+  size_t len;
+  int err = -1;
+
+  if (!srcpath || !dstpath)
+    goto out;
+  src = fopen(srcpath, "r");
+  if (!src)
+    goto out;
+  dst = fopen(dstpath, "w");
+  if (!dst)
+    goto out;
+  while ((len = fread(buffer, 1, sizeof(buffer), src)) > 0)
+    if (fwrite(buffer, 1, len, dst) != len)
+      goto out;
+  err = ferror(src) ? -1 : 0;
+
+ out:
+  if (dst && fclose(dst))
+    err = -1;
+  if (src)
+    fclose(src);
+  free(srcpath);
+  free(dstpath);
+  return err;
+}
+
+static int
+compare_names(const void *_a, const void *_b)
+{
+  const char * const *a = _a, * const *b = _b;
+  return strcmp(*a, *b);
+}
+
+/* return the sorted list of entries of a directory whose name ends with ".xml" */
+static int
+list_xml_files(const char *dir, char ***namesp, unsigned *nrp)
+{
+  struct dirent *dirent;
+  char **names = NULL;
+  unsigned nr = 0, allocated = 0;
+  DIR *d;
+
+  d = opendir(dir);
+  if (!d)
+    return -1;
+
+  while ((dirent = readdir(d)) != NULL) {
+    size_t len = strlen(dirent->d_name);
+    if (len < 4 || strcmp(dirent->d_name + len - 4, ".xml")) {
+      if (verbose && dirent->d_name[0] != '.')
+	printf("Ignoring non-XML file %s\n", dirent->d_name);
+      continue;
+    }
+    if (nr == allocated) {
+      char **tmp = realloc(names, (allocated ? 2*allocated : 32) * sizeof(*names));
+      if (!tmp)
+	goto out_with_names;
+      names = tmp;
+      allocated = allocated ? 2*allocated : 32;
+    }
+    names[nr] = strdup(dirent->d_name);
+    if (!names[nr])
+      goto out_with_names;
+    nr++;
+  }
+  closedir(d);
+
+  if (nr)
+    qsort(names, nr, sizeof(*names), compare_names);
+  *namesp = names;
+  *nrp = nr;
+  return 0;
+
+ out_with_names:
+  while (nr)
+    free(names[--nr]);
+  free(names);
+  closedir(d);
+  return -1;
+}
+
+/* remove ".xml" and ".diff.xml" suffixes in place, return 1 if the file was a diff */
+static int
+strip_xml_suffix(char *name)
+{
+  size_t len = strlen(name) - 4;
+  name[len] = '\0';
+  if (len >= 5 && !strcmp(name + len - 5, ".diff")) {
+    name[len - 5] = '\0';
+    return 1;
+  }
+  return 0;
+}
+
+static hwloc_topology_t
+load_topology(const char *dir, const char *name, const char *suffix)
+{
+  hwloc_topology_t topology;
+  char *path;
+  int err;
+
+  path = build_path(dir, name, suffix);
+  if (!path)
+    return NULL;
+  if (hwloc_topology_init(&topology) < 0) {
+    free(path);
+    return NULL;
+  }
+  hwloc_topology_set_flags(topology, HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM);
+  hwloc_topology_set_all_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+  err = hwloc_topology_set_xml(topology, path);
+  if (!err)
+    err = hwloc_topology_load(topology);
+  free(path);
+  if (err < 0) {
+    hwloc_topology_destroy(topology);
+    return NULL;
+  }
+  return topology;
+}
+
+/***************************
+ * Parallel jobs
+ */
+
+typedef void (*job_fn_t)(void *data, unsigned idx);
+
+#ifdef HAVE_PTHREAD_T
+struct jobs_s {
+  job_fn_t fn;
+  void *data;
+  unsigned nr;
+  unsigned next;
+  pthread_mutex_t lock;
+};
+
+static void *
+jobs_worker(void *_jobs)
+{
+  struct jobs_s *jobs = _jobs;
+  for(;;) {
+    unsigned idx;
+    pthread_mutex_lock(&jobs->lock);
+    idx = jobs->next++;
+    pthread_mutex_unlock(&jobs->lock);
+    if (idx >= jobs->nr)
+      break;
+    jobs->fn(jobs->data, idx);
+  }
+  return NULL;
+}
+#endif
+
+/* run fn(data, i) for all i in [0:nr[, in up to nr_jobs threads */
+static void
+run_jobs(job_fn_t fn, void *data, unsigned nr)
+{
+  unsigned i;
+
+#ifdef HAVE_PTHREAD_T
+  if (nr_jobs > 1 && nr > 1) {
+    unsigned nr_threads = nr_jobs < nr ? nr_jobs : nr;
+    pthread_t *threads = malloc(nr_threads * sizeof(*threads));
+    if (threads) {
+      struct jobs_s jobs;
+      unsigned created = 0;
+      jobs.fn = fn;
+      jobs.data = data;
+      jobs.nr = nr;
+      jobs.next = 0;
+      pthread_mutex_init(&jobs.lock, NULL);
+      /* the main thread is one of the workers */
+      for(i=1; i<nr_threads; i++)
+	if (!pthread_create(&threads[created], NULL, jobs_worker, &jobs))
+	  created++;
+      jobs_worker(&jobs);
+      for(i=0; i<created; i++)
+	pthread_join(threads[i], NULL);
+      pthread_mutex_destroy(&jobs.lock);
+      free(threads);
+      return;
+    }
+  }
+#endif
+
+  for(i=0; i<nr; i++)
+    fn(data, i);
+}
+
+/***************************
+ * Compression
+ */
+
+struct compress_ref_s {
+  char *filename; /* name of the reference file, stored as refname in diffs */
+  hwloc_topology_t topology;
+  hwloc_uint64_t key;
+};
+
+struct compress_input_s {
+  char *name;
+  hwloc_topology_t topology; /* kept when a speculative batch must be retried */
+  hwloc_uint64_t key;
+  off_t filesize;
+  /* result of the last attempt */
+  int compressed;
+  unsigned ref;
+  char *xmlbuffer;
+};
+
+struct compress_state_s {
+  const char *inputdir;
+  struct compress_ref_s *refs;
+  unsigned nr_refs;
+  struct compress_input_s **batch;
+};
+
+/* references with the same fingerprint are tried first */
+static hwloc_uint64_t
+topology_key(hwloc_topology_t topology)
+{
+  hwloc_uint64_t key = 0;
+  hwloc_topology_fingerprint(topology, 0, &key);
+  return key;
+}
+
+/* diffing a topology with itself computes and caches all its subtree hashes
+ * and refreshes its distances, so that the concurrent diffs built against it
+ * later only read it.
+ */
+static void
+prepare_reference(hwloc_topology_t topology)
+{
+  hwloc_topology_diff_t diff;
+  if (hwloc_topology_diff_build(topology, topology, HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES, &diff) >= 0)
+    hwloc_topology_diff_destroy(diff);
+}
+
+static int
+add_reference(struct compress_state_s *state, const char *filename, hwloc_topology_t topology)
+{
+  struct compress_ref_s *tmp;
+
+  tmp = realloc(state->refs, (state->nr_refs+1) * sizeof(*state->refs));
+  if (!tmp)
+    return -1;
+  state->refs = tmp;
+  tmp = &state->refs[state->nr_refs];
+  tmp->filename = strdup(filename);
+  if (!tmp->filename)
+    return -1;
+  prepare_reference(topology);
+  tmp->topology = topology;
+  tmp->key = topology_key(topology);
+  state->nr_refs++;
+  return 0;
+}
+
+static int
+try_reference(struct compress_ref_s *ref, struct compress_input_s *input)
+{
+  hwloc_topology_diff_t diff;
+  char *xmlbuffer;
+  int buflen;
+  int err;
+
+  err = hwloc_topology_diff_build(ref->topology, input->topology, HWLOC_TOPOLOGY_DIFF_BUILD_HASH_SUBTREES, &diff);
+  if (err < 0)
+    return 0;
+  if (err > 0) {
+    /* too complex */
+    hwloc_topology_diff_destroy(diff);
+    return 0;
+  }
+
+  err = hwloc_topology_diff_export_xmlbuffer(diff, ref->filename, &xmlbuffer, &buflen);
+  hwloc_topology_diff_destroy(diff);
+  if (err < 0)
+    return 0;
+
+  if ((off_t) buflen > input->filesize) {
+    /* not worth it */
+    hwloc_free_xmlbuffer(input->topology, xmlbuffer);
+    return 0;
+  }
+
+  input->xmlbuffer = xmlbuffer;
+  return 1;
+}
+
+static void
+compress_job(void *_state, unsigned idx)
+{
+  struct compress_state_s *state = _state;
+  struct compress_input_s *input = state->batch[idx];
+  unsigned pass, i;
+
+  input->compressed = 0;
+
+  if (!input->topology) {
+    struct stat st;
+    char *path = build_path(state->inputdir, input->name, ".xml");
+    if (!path || stat(path, &st) < 0) {
+      free(path);
+      return;
+    }
+    free(path);
+    input->filesize = st.st_size;
+    input->topology = load_topology(state->inputdir, input->name, ".xml");
+    if (!input->topology)
+      return;
+    input->key = topology_key(input->topology);
+  }
+
+  /* references with the same fingerprint first, then the others, in name order */
+  for(pass=0; pass<2; pass++)
+    for(i=0; i<state->nr_refs; i++) {
+      struct compress_ref_s *ref = &state->refs[i];
+      if ((ref->key == input->key) != !pass)
+	continue;
+      if (try_reference(ref, input)) {
+	input->compressed = 1;
+	input->ref = i;
+	return;
+      }
+    }
+}
+
+static int
+write_diff(const char *outputdir, struct compress_input_s *input)
+{
+  char *path = build_path(outputdir, input->name, ".diff.xml");
+  size_t len = strlen(input->xmlbuffer);
+  FILE *file;
+  int err = -1;
+
+  if (!path)
+    return -1;
+  file = fopen(path, "w");
+  if (file) {
+    err = fwrite(input->xmlbuffer, 1, len, file) == len ? 0 : -1;
+    if (fclose(file))
+      err = -1;
+  }
+  free(path);
+  return err;
+}
+
+static int
+compress_dir(const char *inputdir, const char *outputdir)
+{
+  struct compress_state_s state;
+  struct compress_input_s *inputs, **pending;
+  char **names, **outnames;
+  unsigned nr_names, nr_outnames, nr_pending = 0, pos, i;
+  unsigned alreadycompressed = 0, alreadynoncompressed = 0;
+  unsigned newlycompressed = 0, newlynoncompressed = 0;
+  int ret = EXIT_FAILURE;
+
+  if (list_xml_files(outputdir, &outnames, &nr_outnames) < 0) {
+    fprintf(stderr, "Cannot open output directory %s\n", outputdir);
+    return EXIT_FAILURE;
+  }
+  if (list_xml_files(inputdir, &names, &nr_names) < 0) {
+    fprintf(stderr, "Cannot open input directory %s\n", inputdir);
+    goto out_with_outnames;
+  }
+
+  state.inputdir = inputdir;
+  state.refs = NULL;
+  state.nr_refs = 0;
+
+  inputs = calloc(nr_names, sizeof(*inputs));
+  pending = malloc(nr_names * sizeof(*pending));
+  if (nr_names && (!inputs || !pending))
+    goto out_with_names;
+
+  /* non-compressed topologies of the output directory are the initial references */
+  for(i=0; i<nr_outnames; i++) {
+    hwloc_topology_t topology;
+    char *name = outnames[i];
+    if (strip_xml_suffix(name) || file_exists(outputdir, name, ".diff.xml"))
+      continue;
+    topology = load_topology(outputdir, name, ".xml");
+    if (!topology)
+      continue;
+    strcat(name, ".xml");
+    if (add_reference(&state, name, topology) < 0)
+      hwloc_topology_destroy(topology);
+  }
+
+  for(i=0; i<nr_names; i++) {
+    char *name = names[i];
+    name[strlen(name)-4] = '\0';
+    if (file_exists(outputdir, name, ".xml")) {
+      if (verbose)
+	printf("%s already non-compressed, skipping\n", name);
+      alreadynoncompressed++;
+      continue;
+    }
+    if (file_exists(outputdir, name, ".diff.xml")) {
+      if (verbose)
+	printf("%s already compressed, skipping\n", name);
+      alreadycompressed++;
+      continue;
+    }
+    inputs[i].name = name;
+    pending[nr_pending++] = &inputs[i];
+  }
+
+  /* Inputs are processed in speculative batches against the current references.
+   * Results are committed in order until an input cannot be compressed.
+   * It becomes a new reference, and the following inputs of the batch are retried.
+   */
+  pos = 0;
+  while (pos < nr_pending) {
+    unsigned nr = nr_pending - pos;
+    if (nr > nr_jobs)
+      nr = nr_jobs;
+    state.batch = &pending[pos];
+    run_jobs(compress_job, &state, nr);
+
+    for(i=0; i<nr; i++) {
+      struct compress_input_s *input = state.batch[i];
+      unsigned j;
+      size_t namelen;
+      char *filename;
+      int err;
+
+      if (input->compressed) {
+	if (write_diff(outputdir, input) < 0) {
+	  fprintf(stderr, "Failed to write %s/%s.diff.xml\n", outputdir, input->name);
+	  goto out_with_inputs;
+	}
+	printf("Compressed %s on top of %.*s\n", input->name,
+	       (int) strlen(state.refs[input->ref].filename) - 4, state.refs[input->ref].filename);
+	newlycompressed++;
+	hwloc_free_xmlbuffer(input->topology, input->xmlbuffer);
+	input->xmlbuffer = NULL;
+	hwloc_topology_destroy(input->topology);
+	input->topology = NULL;
+	continue;
+      }
+
+      printf("Could not compress %s, keeping non-compressed\n", input->name);
+      newlynoncompressed++;
+      if (copy_file(inputdir, outputdir, input->name, ".xml") < 0) {
+	fprintf(stderr, "Failed to copy %s/%s.xml\n", inputdir, input->name);
+	goto out_with_inputs;
+      }
+      if (!input->topology)
+	/* failed to load, cannot be a reference */
+	continue;
+
+      namelen = strlen(input->name);
+      filename = malloc(namelen + 5);
+      if (!filename)
+	goto out_with_inputs;
+      memcpy(filename, input->name, namelen);
+      strcpy(filename + namelen, ".xml");
+      err = add_reference(&state, filename, input->topology);
+      free(filename);
+      if (err < 0)
+	goto out_with_inputs;
+      input->topology = NULL;
+
+      /* the next results of this batch didn't know about this new reference, retry them */
+      for(j=i+1; j<nr; j++) {
+	input = state.batch[j];
+	if (input->compressed) {
+	  hwloc_free_xmlbuffer(input->topology, input->xmlbuffer);
+	  input->xmlbuffer = NULL;
+	}
+      }
+      i++;
+      break;
+    }
+    pos += i;
+  }
+
+  printf("Compressed %u new topologies (%u were already compressed)\n", newlycompressed, alreadycompressed);
+  printf("Kept %u new topologies non-compressed (%u were already non-compressed)\n", newlynoncompressed, alreadynoncompressed);
+  ret = EXIT_SUCCESS;
+
+ out_with_inputs:
+  for(i=0; i<nr_names; i++) {
+    if (inputs[i].xmlbuffer)
+      hwloc_free_xmlbuffer(inputs[i].topology, inputs[i].xmlbuffer);
+    if (inputs[i].topology)
+      hwloc_topology_destroy(inputs[i].topology);
+  }
+  for(i=0; i<state.nr_refs; i++) {
+    free(state.refs[i].filename);
+    hwloc_topology_destroy(state.refs[i].topology);
+  }
+  free(state.refs);
+ out_with_names:
+  free(inputs);
+  free(pending);
+  for(i=0; i<nr_names; i++)
+    free(names[i]);
+  free(names);
+ out_with_outnames:
+  for(i=0; i<nr_outnames; i++)
+    free(outnames[i]);
+  free(outnames);
+  return ret;
+}
+
+/***************************
+ * Uncompression
+ */
+
+struct uncompress_entry_s {
+  char *name;
+  int isdiff;
+  hwloc_topology_diff_t diff;
+  char *refname;
+  unsigned ref;
+  int failed;
+};
+
+struct uncompress_ref_s {
+  char *filename;
+  hwloc_topology_t topology;
+};
+
+struct uncompress_state_s {
+  const char *inputdir;
+  const char *outputdir;
+  struct uncompress_entry_s **entries;
+  struct uncompress_ref_s *refs;
+};
+
+static void
+load_diff_job(void *_state, unsigned idx)
+{
+  struct uncompress_state_s *state = _state;
+  struct uncompress_entry_s *entry = state->entries[idx];
+  char *path = build_path(state->inputdir, entry->name, ".diff.xml");
+  if (!path || hwloc_topology_diff_load_xml(path, &entry->diff, &entry->refname) < 0) {
+    entry->diff = NULL;
+    entry->refname = NULL;
+    entry->failed = 1;
+  }
+  free(path);
+}
+
+static void
+load_ref_job(void *_state, unsigned idx)
+{
+  struct uncompress_state_s *state = _state;
+  struct uncompress_ref_s *ref = &state->refs[idx];
+  /* references are non-compressed files of the compressed directory,
+   * they may also have been uncompressed in the output directory already.
+   */
+  ref->topology = load_topology(state->inputdir, ref->filename, "");
+  if (!ref->topology)
+    ref->topology = load_topology(state->outputdir, ref->filename, "");
+}
+
+static void
+patch_job(void *_state, unsigned idx)
+{
+  struct uncompress_state_s *state = _state;
+  struct uncompress_entry_s *entry = state->entries[idx];
+  hwloc_topology_t reftopology, topology;
+  char *path;
+
+  if (entry->failed)
+    return;
+  entry->failed = 1;
+
+  reftopology = state->refs[entry->ref].topology;
+  if (!reftopology || hwloc_topology_dup(&topology, reftopology) < 0)
+    return;
+  if (hwloc_topology_diff_apply(topology, entry->diff, 0) < 0)
+    goto out;
+  path = build_path(state->outputdir, entry->name, ".xml");
+  if (path && !hwloc_topology_export_xml(topology, path, 0))
+    entry->failed = 0;
+  free(path);
+ out:
+  hwloc_topology_destroy(topology);
+}
+
+static int
+uncompress_dir(const char *inputdir, const char *outputdir)
+{
+  struct uncompress_state_s state;
+  struct uncompress_entry_s *entries;
+  char **names;
+  unsigned nr_names, nr_diffs = 0, nr_refs = 0, i, j;
+  unsigned newlyuncompressed = 0, newlynoncompressed = 0, alreadyuncompressed = 0;
+  int ret = EXIT_FAILURE;
+
+  if (access(outputdir, W_OK) < 0) {
+    fprintf(stderr, "Cannot enter output directory %s\n", outputdir);
+    return EXIT_FAILURE;
+  }
+  if (list_xml_files(inputdir, &names, &nr_names) < 0) {
+    fprintf(stderr, "Cannot open input directory %s\n", inputdir);
+    return EXIT_FAILURE;
+  }
+
+  state.inputdir = inputdir;
+  state.outputdir = outputdir;
+  state.refs = NULL;
+  entries = calloc(nr_names, sizeof(*entries));
+  state.entries = malloc(nr_names * sizeof(*state.entries));
+  if (nr_names && (!entries || !state.entries))
+    goto out;
+
+  for(i=0; i<nr_names; i++) {
+    entries[i].name = names[i];
+    entries[i].isdiff = strip_xml_suffix(names[i]);
+    if (file_exists(outputdir, names[i], ".xml")) {
+      if (verbose)
+	printf("%s already uncompressed, skipping\n", names[i]);
+      alreadyuncompressed++;
+      entries[i].name = NULL;
+      continue;
+    }
+    if (entries[i].isdiff)
+      state.entries[nr_diffs++] = &entries[i];
+  }
+
+  /* load all diffs, then the references they need, then patch */
+  run_jobs(load_diff_job, &state, nr_diffs);
+
+  state.refs = malloc(nr_diffs * sizeof(*state.refs));
+  if (nr_diffs && !state.refs)
+    goto out;
+  for(i=0; i<nr_diffs; i++) {
+    struct uncompress_entry_s *entry = state.entries[i];
+    if (entry->failed)
+      continue;
+    for(j=0; j<nr_refs; j++)
+      if (!strcmp(state.refs[j].filename, entry->refname))
+	break;
+    if (j == nr_refs) {
+      state.refs[nr_refs].filename = entry->refname;
+      state.refs[nr_refs].topology = NULL;
+      nr_refs++;
+    }
+    entry->ref = j;
+  }
+  run_jobs(load_ref_job, &state, nr_refs);
+
+  run_jobs(patch_job, &state, nr_diffs);
+
+  ret = EXIT_SUCCESS;
+  for(i=0; i<nr_names; i++) {
+    struct uncompress_entry_s *entry = &entries[i];
+    if (!entry->name)
+      continue;
+    if (!entry->isdiff) {
+      if (copy_file(inputdir, outputdir, entry->name, ".xml") < 0) {
+	fprintf(stderr, "Failed to copy %s/%s.xml\n", inputdir, entry->name);
+	ret = EXIT_FAILURE;
+	continue;
+      }
+      printf("Copied %s, wasn't compressed\n", entry->name);
+      newlynoncompressed++;
+    } else if (entry->failed) {
+      fprintf(stderr, "Failed to uncompress %s/%s.diff.xml\n", inputdir, entry->name);
+      ret = EXIT_FAILURE;
+    } else {
+      printf("Uncompressed %s\n", entry->name);
+      newlyuncompressed++;
+    }
+  }
+
+  printf("Uncompressed %u new topologies, copied %u non-compressed topologies (%u were already uncompressed)\n",
+	 newlyuncompressed, newlynoncompressed, alreadyuncompressed);
+
+ out:
+  for(i=0; i<nr_refs; i++)
+    if (state.refs[i].topology)
+      hwloc_topology_destroy(state.refs[i].topology);
+  free(state.refs);
+  for(i=0; i<nr_diffs; i++) {
+    if (state.entries[i]->diff)
+      hwloc_topology_diff_destroy(state.entries[i]->diff);
+    free(state.entries[i]->refname);
+  }
+  free(state.entries);
+  free(entries);
+  for(i=0; i<nr_names; i++)
+    free(names[i]);
+  free(names);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  char *callname;
+  int reverse = 0;
+  long n;
+
+  callname = strrchr(argv[0], '/');
+  if (!callname)
+    callname = argv[0];
+  else
+    callname++;
+  /* skip argv[0], handle options */
+  argc--;
+  argv++;
+
+  hwloc_utils_check_api_version(callname);
+
+#if defined(HAVE_PTHREAD_T) && defined(_SC_NPROCESSORS_ONLN)
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+    nr_jobs = (unsigned) n;
+#endif
+
+  while (argc > 2) {
+    int opt = 0;
+    if (!strcmp(argv[0], "-R") || !strcmp(argv[0], "--reverse")) {
+      reverse = 1;
+    } else if (!strcmp(argv[0], "-v") || !strcmp(argv[0], "--verbose")) {
+      verbose = 1;
+    } else if (!strcmp(argv[0], "-j") || !strcmp(argv[0], "--jobs")) {
+      char *end;
+      n = strtol(argv[1], &end, 10);
+      if (*end || n <= 0) {
+	fprintf(stderr, "Invalid number of jobs %s\n", argv[1]);
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      nr_jobs = (unsigned) n;
+      opt = 1;
+    } else if (!strcmp(argv[0], "-h") || !strcmp(argv[0], "--help")) {
+      usage(callname, stdout);
+      exit(EXIT_SUCCESS);
+    } else if (!strcmp(argv[0], "--version")) {
+      printf("%s %s\n", callname, HWLOC_VERSION);
+      exit(EXIT_SUCCESS);
+    } else {
+      fprintf(stderr, "Unrecognized option: %s\n", argv[0]);
+      usage(callname, stderr);
+      exit(EXIT_FAILURE);
+    }
+    argc -= opt+1;
+    argv += opt+1;
+  }
+
+  if (argc == 1 && (!strcmp(argv[0], "-h") || !strcmp(argv[0], "--help"))) {
+    usage(callname, stdout);
+    exit(EXIT_SUCCESS);
+  }
+  if (argc == 1 && !strcmp(argv[0], "--version")) {
+    printf("%s %s\n", callname, HWLOC_VERSION);
+    exit(EXIT_SUCCESS);
+  }
+  if (argc != 2) {
+    usage(callname, stderr);
+    exit(EXIT_FAILURE);
+  }
+
+#ifndef HAVE_PTHREAD_T
+  /* batches would be processed sequentially, don't speculate */
+  nr_jobs = 1;
+#endif
+
+  if (reverse)
+    return uncompress_dir(argv[0], argv[1]);
+  else
+    return compress_dir(argv[0], argv[1]);
+}
@@ -14,28 +14,302 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#include <time.h>
 
 void usage(const char *callname __hwloc_attribute_unused, FILE *where)
 {
-  fprintf(where, "Usage: hwloc-distrib [options] number\n");
+  fprintf(where, "Usage: hwloc-distrib [options] [number]\n");
   fprintf(where, "Distribution options:\n");
+  fprintf(where, "  --weights <file> Read one weight per task in <file>, heavier tasks get more PUs\n");
   fprintf(where, "  --ignore <type>  Ignore objects of the given type\n");
   fprintf(where, "  --from <type>    Distribute starting from objects of the given type\n");
   fprintf(where, "  --to <type>      Distribute down to objects of the given type\n");
   fprintf(where, "  --at <type>      Distribute among objects of the given type\n");
   fprintf(where, "  --reverse        Distribute by starting from last objects\n");
+  fprintf(where, "  --interleave     Give consecutive tasks to different top-level objects\n");
   fprintf(where, "Input topology options:\n");
   fprintf(where, "  --restrict <set> Restrict the topology to processors listed in <set>\n");
+#ifdef HWLOC_LINUX_SYS
+  fprintf(where, "  --busy <percent> Ignore processors currently busy above <percent>\n");
+#endif
   fprintf(where, "  --whole-system   Do not consider administration limitations\n");
   hwloc_utils_input_format_usage(where, 0);
   fprintf(where, "Formatting options:\n");
   fprintf(where, "  --single         Singlify each output to a single CPU\n");
   fprintf(where, "  --taskset        Show taskset-specific cpuset strings\n");
+  fprintf(where, "  --rankfile       Show a MPI rankfile with PU physical indexes\n");
+  fprintf(where, "  --host <name>    Use <name> as the hostname in the rankfile\n");
   fprintf(where, "Miscellaneous options:\n");
   fprintf(where, "  -v --verbose     Show verbose messages\n");
   fprintf(where, "  --version        Report version and exit\n");
 }
 
+/* read one positive weight per line, ignoring empty lines and comments */
+static unsigned *
+read_weights(const char *filename, unsigned *nr)
+{
+  FILE *file;
+  char line[64];
+  unsigned *weights = NULL;
+  unsigned allocated = 0, n = 0;
+  unsigned linenr = 0;
+
+  if (!strcmp(filename, "-"))
+    file = stdin;
+  else
+    file = fopen(filename, "r");
+  if (!file) {
+    fprintf(stderr, "Failed to open weights file %s (%s)\n", filename, strerror(errno));
+    return NULL;
+  }
+
+  while (fgets(line, sizeof(line), file)) {
+    char *tmp = line, *end;
+    unsigned long weight;
+    linenr++;
+    while (*tmp == ' ' || *tmp == '\t')
+      tmp++;
+    if (*tmp == '\n' || *tmp == '#' || *tmp == '\0')
+      continue;
+    weight = strtoul(tmp, &end, 10);
+    while (*end == ' ' || *end == '\t' || *end == '\n')
+      end++;
+    if (end == tmp || *end != '\0' || !weight || weight > UINT_MAX) {
+      fprintf(stderr, "Invalid weight at line %u of %s, must be a positive integer\n", linenr, filename);
+      goto out_with_weights;
+    }
+    if (n == allocated) {
+      unsigned *tmpw;
+      allocated = allocated ? allocated*2 : 256;
+      tmpw = realloc(weights, allocated * sizeof(*weights));
+      if (!tmpw)
+	goto out_with_weights;
+      weights = tmpw;
+    }
+    weights[n++] = (unsigned) weight;
+  }
+
+  if (file != stdin)
+    fclose(file);
+  *nr = n;
+  return weights;
+
+ out_with_weights:
+  free(weights);
+  if (file != stdin)
+    fclose(file);
+  return NULL;
+}
+
+/* Same as hwloc_distrib() except that task i has weight weights[i]
+ * and starts at starts[i] in the sum of weights.
+ * Each object receives the tasks starting in its share of the weights.
+ * With all weights equal to 1, this is exactly hwloc_distrib().
+ */
+static void
+distrib_weighted(hwloc_obj_t *roots, unsigned n_roots,
+		 hwloc_bitmap_t *set,
+		 const hwloc_uint64_t *starts, const unsigned *weights, unsigned n,
+		 unsigned until, unsigned long flags)
+{
+  hwloc_uint64_t lo, span;
+  unsigned i;
+  unsigned tot_weight;
+  unsigned given, givenweight;
+
+  if (!n)
+    return;
+  lo = starts[0];
+  span = starts[n-1] + weights[n-1] - lo;
+
+  tot_weight = 0;
+  for (i = 0; i < n_roots; i++)
+    tot_weight += hwloc_bitmap_weight(roots[i]->cpuset);
+
+  for (i = 0, given = 0, givenweight = 0; i < n_roots; i++) {
+    unsigned chunk, weight, end;
+    hwloc_obj_t root = roots[flags & HWLOC_DISTRIB_FLAG_REVERSE ? n_roots-1-i : i];
+    hwloc_cpuset_t cpuset = root->cpuset;
+    weight = hwloc_bitmap_weight(cpuset);
+    if (!weight)
+      continue;
+    /* Give to root the tasks starting in its share of the weights. */
+    for(end = given;
+	end < n && (starts[end] - lo) * tot_weight < span * (givenweight + weight);
+	end++);
+    chunk = end - given;
+    if (!root->arity || chunk <= 1 || root->depth >= until) {
+      /* We can't split any more, put everything there.  */
+      if (chunk) {
+	unsigned j;
+	for (j = 0; j < chunk; j++)
+	  set[given+j] = hwloc_bitmap_dup(cpuset);
+      } else {
+	/* We got no task, merge our cpuset to the previous one
+	 * (the first task always starts in the first share).
+	 */
+	assert(given);
+	hwloc_bitmap_or(set[given-1], set[given-1], cpuset);
+      }
+    } else {
+      /* Still more to distribute, recurse into children */
+      distrib_weighted(root->children, root->arity, set+given, starts+given, weights+given, chunk, until, flags);
+    }
+    given += chunk;
+    givenweight += weight;
+  }
+}
+
+/* Reorder sets so that consecutive tasks go to different objects at the first
+ * level where roots are split, by dealing tasks of each object in turn.
+ */
+static void
+interleave_sets(hwloc_topology_t topology, hwloc_obj_t *roots, unsigned n_roots,
+		hwloc_bitmap_t *set, unsigned n)
+{
+  unsigned depth, topodepth = hwloc_topology_get_depth(topology);
+  unsigned nbobjs, nbgroups, i, j, done;
+  unsigned *group_of_obj, *group_first, *group_count, *group_next, *task_group;
+  hwloc_bitmap_t *orig;
+
+  /* find the first level where roots are split */
+  depth = roots[0]->depth;
+  if (n_roots == 1)
+    while (depth < topodepth-1 && hwloc_get_nbobjs_by_depth(topology, depth) == 1)
+      depth++;
+  if (hwloc_get_nbobjs_by_depth(topology, depth) == 1)
+    return;
+
+  nbobjs = hwloc_get_nbobjs_by_depth(topology, depth);
+  group_of_obj = malloc(nbobjs * sizeof(*group_of_obj));
+  group_first = malloc(nbobjs * sizeof(*group_first));
+  group_count = calloc(nbobjs, sizeof(*group_count));
+  group_next = malloc(nbobjs * sizeof(*group_next));
+  task_group = malloc(n * sizeof(*task_group));
+  orig = malloc(n * sizeof(*orig));
+  if (!group_of_obj || !group_first || !group_count || !group_next || !task_group || !orig)
+    goto out;
+  for(i = 0; i < nbobjs; i++)
+    group_of_obj[i] = (unsigned) -1;
+
+  /* number groups by order of appearance, so that --reverse is preserved */
+  nbgroups = 0;
+  for(i = 0; i < n; i++) {
+    /* sets may be larger than a single object, use the object of their first PU */
+    hwloc_obj_t pu = hwloc_get_pu_obj_by_os_index(topology, hwloc_bitmap_first(set[i]));
+    hwloc_obj_t obj = hwloc_get_ancestor_obj_by_depth(topology, depth, pu);
+    unsigned group;
+    if (group_of_obj[obj->logical_index] == (unsigned) -1)
+      group_of_obj[obj->logical_index] = nbgroups++;
+    group = group_of_obj[obj->logical_index];
+    task_group[i] = group;
+    group_count[group]++;
+  }
+
+  /* tasks of each group are contiguous in a bucket-sorted copy */
+  for(i = 0, j = 0; i < nbgroups; i++) {
+    group_first[i] = group_next[i] = j;
+    j += group_count[i];
+  }
+  for(i = 0; i < n; i++)
+    orig[group_next[task_group[i]]++] = set[i];
+
+  /* deal one task of each group in turn */
+  for(i = 0; i < nbgroups; i++)
+    group_next[i] = group_first[i];
+  for(done = 0; done < n; )
+    for(i = 0; i < nbgroups; i++)
+      if (group_next[i] < group_first[i] + group_count[i])
+	set[done++] = orig[group_next[i]++];
+
+ out:
+  free(group_of_obj);
+  free(group_first);
+  free(group_count);
+  free(group_next);
+  free(task_group);
+  free(orig);
+}
+
+#ifdef HWLOC_LINUX_SYS
+struct cpu_times_s {
+  unsigned long long total, idle;
+};
+
+/* read per-processor times from /proc/stat, indexed by physical index */
+static struct cpu_times_s *
+read_cpu_times(unsigned *nr)
+{
+  FILE *file;
+  char line[512];
+  struct cpu_times_s *times = NULL;
+  unsigned allocated = 0, max = 0;
+
+  file = fopen("/proc/stat", "r");
+  if (!file)
+    return NULL;
+  while (fgets(line, sizeof(line), file)) {
+    unsigned long long user, nice, system, idle, iowait = 0, irq = 0, softirq = 0, steal = 0;
+    unsigned cpu;
+    if (strncmp(line, "cpu", 3) || line[3] < '0' || line[3] > '9')
+      continue;
+    if (sscanf(line+3, "%u %llu %llu %llu %llu %llu %llu %llu %llu",
+	       &cpu, &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) < 5)
+      continue;
+    if (cpu >= allocated) {
+      unsigned newallocated = allocated ? allocated : 64;
+      struct cpu_times_s *tmp;
+      while (cpu >= newallocated)
+	newallocated *= 2;
+      tmp = realloc(times, newallocated * sizeof(*times));
+      if (!tmp)
+	break;
+      memset(tmp + allocated, 0, (newallocated - allocated) * sizeof(*times));
+      times = tmp;
+      allocated = newallocated;
+    }
+    times[cpu].total = user + nice + system + idle + iowait + irq + softirq + steal;
+    times[cpu].idle = idle + iowait;
+    if (cpu >= max)
+      max = cpu+1;
+  }
+  fclose(file);
+  *nr = max;
+  return times;
+}
+
+/* sample processor usage during a short delay and mark those above threshold */
+static int
+get_busy_pus(hwloc_bitmap_t busy, unsigned threshold)
+{
+  struct cpu_times_s *before, *after;
+  unsigned nr_before, nr_after, i;
+  struct timespec delay = { 0, 200000000 };
+
+  before = read_cpu_times(&nr_before);
+  if (!before)
+    return -1;
+  nanosleep(&delay, NULL);
+  after = read_cpu_times(&nr_after);
+  if (!after) {
+    free(before);
+    return -1;
+  }
+
+  hwloc_bitmap_zero(busy);
+  for(i = 0; i < nr_before && i < nr_after; i++) {
+    unsigned long long total = after[i].total - before[i].total;
+    unsigned long long idle = after[i].idle - before[i].idle;
+    if (total && (total - idle) * 100 > total * threshold)
+      hwloc_bitmap_set(busy, i);
+  }
+
+  free(before);
+  free(after);
+  return 0;
+}
+#endif /* HWLOC_LINUX_SYS */
+
 int main(int argc, char *argv[])
 {
   long n = -1;
@@ -47,6 +321,14 @@ int main(int argc, char *argv[])
   int verbose = 0;
   char *restrictstring = NULL;
   const char *from_type = NULL, *to_type = NULL;
+  const char *weightsfile = NULL;
+  unsigned *weights = NULL;
+  int interleave = 0;
+  int rankfile = 0;
+  const char *hostname = NULL;
+#ifdef HWLOC_LINUX_SYS
+  int busy_threshold = -1;
+#endif
   hwloc_topology_t topology;
   unsigned long flags = 0;
   unsigned long dflags = 0;
@@ -149,6 +431,50 @@ int main(int argc, char *argv[])
 	dflags |= HWLOC_DISTRIB_FLAG_REVERSE;
 	goto next;
       }
+      else if (!strcmp (argv[0], "--interleave")) {
+	interleave = 1;
+	goto next;
+      }
+      else if (!strcmp (argv[0], "--weights")) {
+	if (argc < 2) {
+	  usage(callname, stdout);
+	  exit(EXIT_FAILURE);
+	}
+	weightsfile = argv[1];
+	argc--;
+	argv++;
+	goto next;
+      }
+      else if (!strcmp (argv[0], "--rankfile")) {
+	rankfile = 1;
+	goto next;
+      }
+      else if (!strcmp (argv[0], "--host")) {
+	if (argc < 2) {
+	  usage(callname, stdout);
+	  exit(EXIT_FAILURE);
+	}
+	hostname = argv[1];
+	argc--;
+	argv++;
+	goto next;
+      }
+#ifdef HWLOC_LINUX_SYS
+      else if (!strcmp (argv[0], "--busy")) {
+	if (argc < 2) {
+	  usage(callname, stdout);
+	  exit(EXIT_FAILURE);
+	}
+	busy_threshold = atoi(argv[1]);
+	if (busy_threshold < 0 || busy_threshold > 100) {
+	  fprintf(stderr, "Invalid busy threshold %s, must be a percentage\n", argv[1]);
+	  exit(EXIT_FAILURE);
+	}
+	argc--;
+	argv++;
+	goto next;
+      }
+#endif
       else if (!strcmp (argv[0], "--restrict")) {
 	if (argc < 2) {
 	  usage (callname, stdout);
@@ -181,22 +507,53 @@ int main(int argc, char *argv[])
     argv++;
   }
 
+  if (weightsfile) {
+    unsigned nr_weights;
+    weights = read_weights(weightsfile, &nr_weights);
+    if (!weights)
+      return EXIT_FAILURE;
+    if (n == -1) {
+      n = nr_weights;
+    } else if (n != (long) nr_weights) {
+      fprintf(stderr, "%ld tasks requested but %u weights given\n", n, nr_weights);
+      return EXIT_FAILURE;
+    }
+  }
+
   if (n == -1) {
     fprintf(stderr,"need a number\n");
     usage(callname, stderr);
     return EXIT_FAILURE;
   }
+  if (n <= 0 || n > INT_MAX) {
+    fprintf(stderr, "invalid number %ld\n", n);
+    return EXIT_FAILURE;
+  }
 
   if (verbose)
     fprintf(stderr, "distributing %ld\n", n);
 
   {
-    unsigned i;
+    long i;
     int from_depth, to_depth;
     unsigned chunks;
     hwloc_bitmap_t *cpuset;
+    hwloc_uint64_t *starts;
+    char host[256];
 
     cpuset = malloc(n * sizeof(hwloc_bitmap_t));
+    starts = malloc(n * sizeof(*starts));
+    if (!weights)
+      weights = malloc(n * sizeof(*weights));
+    if (!cpuset || !starts || !weights) {
+      fprintf(stderr, "Failed to allocate %ld tasks\n", n);
+      return EXIT_FAILURE;
+    }
+    for(i = 0; i < n; i++) {
+      if (!weightsfile)
+	weights[i] = 1;
+      starts[i] = i ? starts[i-1] + weights[i-1] : 0;
+    }
 
     if (input) {
       err = hwloc_utils_enable_input_format(topology, input, &input_format, verbose, callname);
@@ -218,34 +575,80 @@ int main(int argc, char *argv[])
       free(restrictstring);
     }
 
+#ifdef HWLOC_LINUX_SYS
+    if (busy_threshold >= 0) {
+      hwloc_bitmap_t busy, idleset;
+      if (!hwloc_topology_is_thissystem(topology)) {
+	fprintf(stderr, "--busy requires the topology of the local machine\n");
+	return EXIT_FAILURE;
+      }
+      busy = hwloc_bitmap_alloc();
+      if (get_busy_pus(busy, busy_threshold) < 0) {
+	perror("Reading processor usage");
+	return EXIT_FAILURE;
+      }
+      if (verbose) {
+	char *str;
+	hwloc_bitmap_asprintf(&str, busy);
+	fprintf(stderr, "ignoring busy processors %s\n", str);
+	free(str);
+      }
+      idleset = hwloc_bitmap_dup(hwloc_topology_get_topology_cpuset(topology));
+      hwloc_bitmap_andnot(idleset, idleset, busy);
+      if (hwloc_bitmap_iszero(idleset)) {
+	fprintf(stderr, "All processors are busy\n");
+	return EXIT_FAILURE;
+      }
+      err = hwloc_topology_restrict(topology, idleset, 0);
+      if (err) {
+	perror("Restricting the topology to idle processors");
+	return EXIT_FAILURE;
+      }
+      hwloc_bitmap_free(idleset);
+      hwloc_bitmap_free(busy);
+    }
+#endif
+
     from_depth = 0;
     if (from_type) {
-      if (hwloc_type_sscanf_as_depth(argv[1], NULL, topology, &from_depth) < 0 || from_depth < 0) {
-	fprintf(stderr, "Unsupported or unavailable type `%s' passed to --from, ignoring.\n", argv[1]);
+      if (hwloc_type_sscanf_as_depth(from_type, NULL, topology, &from_depth) < 0 || from_depth < 0) {
+	fprintf(stderr, "Unsupported or unavailable type `%s' passed to --from, ignoring.\n", from_type);
 	return EXIT_FAILURE;
       }
     }
 
     to_depth = INT_MAX;
     if (to_type) {
-      if (hwloc_type_sscanf_as_depth(argv[1], NULL, topology, &to_depth) < 0 || to_depth < 0) {
-	fprintf(stderr, "Unsupported or unavailable type `%s' passed to --to, ignoring.\n", argv[1]);
+      if (hwloc_type_sscanf_as_depth(to_type, NULL, topology, &to_depth) < 0 || to_depth < 0) {
+	fprintf(stderr, "Unsupported or unavailable type `%s' passed to --to, ignoring.\n", to_type);
 	return EXIT_FAILURE;
       }
     }
 
+    if (rankfile && !hostname) {
+#ifdef HAVE_UNISTD_H
+      if (!gethostname(host, sizeof(host))) {
+	host[sizeof(host)-1] = '\0';
+	hostname = host;
+      } else
+#endif
+	hostname = "localhost";
+    }
+
     chunks =  hwloc_get_nbobjs_by_depth(topology, from_depth);
     {
       hwloc_obj_t *roots;
 
       roots = malloc(chunks * sizeof(hwloc_obj_t));
 
-      for (i = 0; i < chunks; i++)
+      for (i = 0; i < (long) chunks; i++)
         roots[i] = hwloc_get_obj_by_depth(topology, from_depth, i);
 
-      hwloc_distrib(topology, roots, chunks, cpuset, n, to_depth, dflags);
+      distrib_weighted(roots, chunks, cpuset, starts, weights, n, to_depth, dflags);
+      if (interleave)
+	interleave_sets(topology, roots, chunks, cpuset, n);
 
-      for (i = 0; (long) i < n; i++) {
+      for (i = 0; i < n; i++) {
 	char *str = NULL;
 	if (singlify) {
 	  if (dflags & HWLOC_DISTRIB_FLAG_REVERSE) {
@@ -255,11 +658,16 @@ int main(int argc, char *argv[])
 	    hwloc_bitmap_singlify(cpuset[i]);
 	  }
 	}
-	if (taskset)
-	  hwloc_bitmap_taskset_asprintf(&str, cpuset[i]);
-	else
-	  hwloc_bitmap_asprintf(&str, cpuset[i]);
-	printf("%s\n", str);
+	if (rankfile) {
+	  hwloc_bitmap_list_asprintf(&str, cpuset[i]);
+	  printf("rank %ld=%s slot=%s\n", i, hostname, str);
+	} else {
+	  if (taskset)
+	    hwloc_bitmap_taskset_asprintf(&str, cpuset[i]);
+	  else
+	    hwloc_bitmap_asprintf(&str, cpuset[i]);
+	  printf("%s\n", str);
+	}
 	free(str);
 	hwloc_bitmap_free(cpuset[i]);
       }
@@ -268,6 +676,8 @@ int main(int argc, char *argv[])
     }
 
    free(cpuset);
+   free(starts);
+   free(weights);
   }
 
   hwloc_topology_destroy(topology);
@@ -12,6 +12,9 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#ifdef HAVE_PTHREAD_T
+#include <pthread.h>
+#endif
 
 #include <private/cpuid-x86.h>
 
@@ -28,8 +31,24 @@
 #endif
 #endif
 
-static void dump_one_cpuid(FILE *output, unsigned *regs, unsigned inregmask)
+struct cpuid_entry {
+  unsigned inmask;
+  unsigned in[4];
+  unsigned out[4];
+};
+
+/* all entries gathered on a single PU */
+struct cpuid_dump {
+  hwloc_obj_t pu;
+  unsigned highest_cpuid, highest_ext_cpuid;
+  unsigned nr, allocated;
+  struct cpuid_entry *entries;
+  int failed;
+};
+
+static void dump_one_cpuid(struct cpuid_dump *dump, unsigned *regs, unsigned inregmask)
 {
+  struct cpuid_entry *entry;
   unsigned i;
 
   /* clear unused inputs */
@@ -37,76 +56,67 @@ static void dump_one_cpuid(FILE *output, unsigned *regs, unsigned inregmask)
     if (!(inregmask & (1<<i)))
       regs[i] = 0;
 
-  fprintf(output, "%x %x %x %x %x", inregmask, regs[0], regs[1], regs[2], regs[3]);
+  if (dump->nr == dump->allocated) {
+    unsigned allocated = dump->allocated ? 2*dump->allocated : 64;
+    struct cpuid_entry *tmp = realloc(dump->entries, allocated * sizeof(*tmp));
+    if (!tmp) {
+      dump->failed = 1;
+      hwloc_x86_cpuid(&regs[0], &regs[1], &regs[2], &regs[3]);
+      return;
+    }
+    dump->entries = tmp;
+    dump->allocated = allocated;
+  }
+  entry = &dump->entries[dump->nr++];
+  entry->inmask = inregmask;
+  memcpy(entry->in, regs, sizeof(entry->in));
   hwloc_x86_cpuid(&regs[0], &regs[1], &regs[2], &regs[3]);
-  fprintf(output, " => %x %x %x %x\n", regs[0], regs[1], regs[2], regs[3]);
+  memcpy(entry->out, regs, sizeof(entry->out));
 }
 
-static int dump_one_proc(hwloc_topology_t topo, hwloc_obj_t pu, const char *path)
+/* gather all leaves on the current PU, the caller is responsible for binding */
+static void dump_one_proc(struct cpuid_dump *dump)
 {
-  unsigned regs[4];
+  unsigned regs[4] = { 0, 0, 0, 0 };
   unsigned highest_cpuid, highest_ext_cpuid;
   unsigned i;
-  FILE *output;
-  int err;
-
-  err = hwloc_set_cpubind(topo, pu->cpuset, HWLOC_CPUBIND_PROCESS);
-  if (err < 0) {
-    err = hwloc_set_cpubind(topo, pu->cpuset, HWLOC_CPUBIND_THREAD);
-    if (err < 0) {
-      fprintf(stderr, "Cannot bind to PU P#%u\n", pu->os_index);
-      return -1;
-    }
-  }
-
-  if (path) {
-    output = fopen(path, "w");
-    if (!output) {
-      fprintf(stderr, "Cannot open file '%s' for writing: %s\n", path, strerror(errno));
-      return -1;
-    }
-    printf("Gathering CPUID of PU P#%u in path %s ...\n", pu->os_index, path);
-  } else {
-    output = stdout;
-    printf("Gathering CPUID of PU P#%u on stdout ...\n", pu->os_index);
-  }
-
-  fprintf(output, "# mask e[abcd]x => e[abcd]x\n");
 
-  regs[0] = 0;
   hwloc_x86_cpuid(&regs[0], &regs[1], &regs[2], &regs[3]);
   highest_cpuid = regs[0];
   regs[0] = 0x80000000;
+  regs[1] = regs[2] = regs[3] = 0;
   hwloc_x86_cpuid(&regs[0], &regs[1], &regs[2], &regs[3]);
   highest_ext_cpuid = regs[0];
+  dump->highest_cpuid = highest_cpuid;
+  dump->highest_ext_cpuid = highest_ext_cpuid;
 
   /* 0x0 = Highest cpuid + Vendor string */
   regs[0] = 0x0;
-  dump_one_cpuid(output, regs, 0x1);
+  dump_one_cpuid(dump, regs, 0x1);
 
   /* 0x1 = Family, Model, Stepping, Topology, Features */
   if (highest_cpuid >= 0x1) {
     regs[0] = 0x1;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x2 = Cache + TLB on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0x2) {
     regs[0] = 0x2;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x3 = Processor serial number on Intel P3, reserved otherwise ; Reserved on AMD */
   if (highest_cpuid >= 0x3) {
     regs[0] = 0x3;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x4 = Caches on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0x4) {
     for(i=0; ; i++) {
       regs[0] = 0x4; regs[2] = i;
-      dump_one_cpuid(output, regs, 0x5);
+      dump_one_cpuid(dump, regs, 0x5);
       if (!(regs[0] & 0x1f))
 	break;
     }
@@ -115,44 +125,44 @@ static int dump_one_proc(hwloc_topology_t topo, hwloc_obj_t pu, const char *path
   /* 0x5 = Monitor/mwait */
   if (highest_cpuid >= 0x5) {
     regs[0] = 0x5;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x6 = Thermal and Power management */
   if (highest_cpuid >= 0x6) {
     regs[0] = 0x6;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x7 = Extended features */
   if (highest_cpuid >= 0x7) {
     unsigned max;
     regs[0] = 0x7; regs[2] = 0;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
     max = regs[0];
     for(i=1; i<=max; i++) {
       regs[0] = 0x7; regs[2] = i;
-      dump_one_cpuid(output, regs, 0x5);
+      dump_one_cpuid(dump, regs, 0x5);
     }
   }
 
   /* 0x9 = DCA on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0x9) {
     regs[0] = 0x9;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0xa = Perf monitoring on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0xa) {
     regs[0] = 0xa;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0xb = Extended topology on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0xb) {
     for(i=0; ; i++) {
       regs[0] = 0xb; regs[2] = i;
-      dump_one_cpuid(output, regs, 0x5);
+      dump_one_cpuid(dump, regs, 0x5);
       if (!regs[0] && !regs[1])
 	break;
     }
@@ -163,23 +173,23 @@ static int dump_one_proc(hwloc_topology_t topo, hwloc_obj_t pu, const char *path
     unsigned xcr0_l, xcr0_h, ia32xss_l, ia32xss_h;
 
     regs[0] = 0xd; regs[2] = 0;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
     xcr0_l = regs[0]; xcr0_h = regs[3];
 
     regs[0] = 0xd; regs[2] = 1;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
     ia32xss_l = regs[2]; ia32xss_h = regs[3];
 
     for(i=2; i<32; i++) {
       if ((xcr0_l | ia32xss_l) & (1<<i)) {
 	regs[0] = 0xd; regs[2] = i;
-	dump_one_cpuid(output, regs, 0x5);
+	dump_one_cpuid(dump, regs, 0x5);
       }
     }
     for(i=0; i<32; i++) {
       if ((xcr0_h | ia32xss_h) & (1<<i)) {
 	regs[0] = 0xd; regs[2] = i+32;
-	dump_one_cpuid(output, regs, 0x5);
+	dump_one_cpuid(dump, regs, 0x5);
       }
     }
   }
@@ -187,121 +197,114 @@ static int dump_one_proc(hwloc_topology_t topo, hwloc_obj_t pu, const char *path
   /* 0xf = Platform/L3 QoS enumeration on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0xf) {
     regs[0] = 0xf; regs[2] = 0;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
     regs[0] = 0xf; regs[2] = 1;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
   }
 
   /* 0x10 = Platform/L3 QoS enforcement enumeration on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0x10) {
     regs[0] = 0x10; regs[2] = 0;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
     regs[0] = 0x10; regs[2] = 1;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
   }
 
   /* 0x14 = Processor trace enumeration on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0x14) {
     regs[0] = 0x14; regs[2] = 0;
-    dump_one_cpuid(output, regs, 0x5);
+    dump_one_cpuid(dump, regs, 0x5);
   }
 
   /* 0x15 = Timestamp counter/core crystal clock on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0x15) {
     regs[0] = 0x15;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x16 = Processor frequency on Intel ; Reserved on AMD */
   if (highest_cpuid >= 0x16) {
     regs[0] = 0x16;
-    dump_one_cpuid(output, regs, 0x1);
-  }
-
-  if (highest_cpuid > 0x16) {
-    static int reported = 0;
-    if (!reported)
-      fprintf(stderr, "WARNING: Processor supports new CPUID leaves upto 0x%x\n", highest_cpuid);
-    reported = 1;
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x80000000 = Largest extended cpuid */
   regs[0] = 0x80000000;
-  dump_one_cpuid(output, regs, 0x1);
+  dump_one_cpuid(dump, regs, 0x1);
 
   /* 0x80000001 = Extended processor signature and features */
   if (highest_ext_cpuid >= 0x80000001) {
     regs[0] = 0x80000001;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x80000002-4 = Processor name string */
   if (highest_ext_cpuid >= 0x80000002) {
     regs[0] = 0x80000002;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
   if (highest_ext_cpuid >= 0x80000003) {
     regs[0] = 0x80000003;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
   if (highest_ext_cpuid >= 0x80000004) {
     regs[0] = 0x80000004;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x80000005 = L1 and TLB on AMD ; Reserved on Intel */
   if (highest_ext_cpuid >= 0x80000005) {
     regs[0] = 0x80000005;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x80000006 = L2, L3 and TLB on AMD ; L2 and reserved on Intel */
   if (highest_ext_cpuid >= 0x80000006) {
     regs[0] = 0x80000006;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x80000007 = Advanced power management on AMD ; Almost reserved on Intel */
   if (highest_ext_cpuid >= 0x80000007) {
     regs[0] = 0x80000007;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x80000008 = Long mode and topology on AMD ; Long mode on Intel */
   if (highest_ext_cpuid >= 0x80000008) {
     regs[0] = 0x80000008;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x8000000a = SVM on AMD ; Reserved on Intel */
   if (highest_ext_cpuid >= 0x8000000a) {
     regs[0] = 0x8000000a;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x80000019 = TLB1G + Perf optim identifiers on AMD ; Reserved on Intel */
   if (highest_ext_cpuid >= 0x80000019) {
     regs[0] = 0x80000019;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x8000001b = IBS on AMD ; Reserved on Intel */
   if (highest_ext_cpuid >= 0x8000001b) {
     regs[0] = 0x8000001b;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x8000001c = Profiling on AMD ; Reserved on Intel */
   if (highest_ext_cpuid >= 0x8000001c) {
     regs[0] = 0x8000001c;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
   }
 
   /* 0x8000001d = Cache properties on AMD ; Reserved on Intel */
   if (highest_ext_cpuid >= 0x8000001d) {
     for(i=0; ; i++) {
       regs[0] = 0x8000001d; regs[2] = i;
-      dump_one_cpuid(output, regs, 0x5);
+      dump_one_cpuid(dump, regs, 0x5);
       if (!(regs[0] & 0x1f))
 	break;
     }
@@ -310,28 +313,245 @@ static int dump_one_proc(hwloc_topology_t topo, hwloc_obj_t pu, const char *path
   /* 0x8000001e = Topoext on AMD ; Reserved on Intel */
   if (highest_ext_cpuid >= 0x8000001e) {
     regs[0] = 0x8000001e;
-    dump_one_cpuid(output, regs, 0x1);
+    dump_one_cpuid(dump, regs, 0x1);
+  }
+}
+
+/***************************
+ * Collection
+ */
+
+static int bind_to_pu(hwloc_topology_t topo, hwloc_obj_t pu, int flags)
+{
+  int err = hwloc_set_cpubind(topo, pu->cpuset, flags);
+  if (err < 0 && flags == HWLOC_CPUBIND_PROCESS)
+    err = hwloc_set_cpubind(topo, pu->cpuset, HWLOC_CPUBIND_THREAD);
+  if (err < 0)
+    fprintf(stderr, "Cannot bind to PU P#%u\n", pu->os_index);
+  return err;
+}
+
+#ifdef HAVE_PTHREAD_T
+struct gather_group {
+  hwloc_topology_t topo;
+  struct cpuid_dump *dumps;
+  unsigned nr;
+};
+
+/* each thread stays pinned on the PUs of its group, one after the other */
+static void *gather_group_thread(void *_group)
+{
+  struct gather_group *group = _group;
+  unsigned i;
+  for(i=0; i<group->nr; i++) {
+    struct cpuid_dump *dump = &group->dumps[i];
+    if (bind_to_pu(group->topo, dump->pu, HWLOC_CPUBIND_THREAD) < 0)
+      dump->failed = 1;
+    else
+      dump_one_proc(dump);
+  }
+  return NULL;
+}
+#endif
+
+/* gather all dumps with nr_groups threads, each working on consecutive PUs */
+static void gather_all(hwloc_topology_t topo, struct cpuid_dump *dumps, unsigned nr, unsigned nr_groups)
+{
+  unsigned i;
+
+  if (nr_groups > nr)
+    nr_groups = nr;
+
+#ifdef HAVE_PTHREAD_T
+  if (nr_groups > 1) {
+    struct gather_group *groups = malloc(nr_groups * sizeof(*groups));
+    pthread_t *threads = malloc(nr_groups * sizeof(*threads));
+    int *created = calloc(nr_groups, sizeof(*created));
+    if (groups && threads && created) {
+      for(i=0; i<nr_groups; i++) {
+	unsigned first = i*nr/nr_groups, next = (i+1)*nr/nr_groups;
+	groups[i].topo = topo;
+	groups[i].dumps = &dumps[first];
+	groups[i].nr = next - first;
+	created[i] = !pthread_create(&threads[i], NULL, gather_group_thread, &groups[i]);
+      }
+      for(i=0; i<nr_groups; i++) {
+	if (created[i])
+	  pthread_join(threads[i], NULL);
+	else
+	  /* gather this group in the main thread instead */
+	  gather_group_thread(&groups[i]);
+      }
+      free(groups);
+      free(threads);
+      free(created);
+      return;
+    }
+    free(groups);
+    free(threads);
+    free(created);
   }
+#endif
 
-  if (highest_ext_cpuid > 0x8000001e) {
-    static int reported = 0;
-    if (!reported)
-      fprintf(stderr, "WARNING: Processor supports new extended CPUID leaves upto 0x%x\n", highest_ext_cpuid);
-    reported = 1;
+  for(i=0; i<nr; i++) {
+    if (bind_to_pu(topo, dumps[i].pu, HWLOC_CPUBIND_PROCESS) < 0)
+      dumps[i].failed = 1;
+    else
+      dump_one_proc(&dumps[i]);
   }
+}
+
+static void report_new_leaves(struct cpuid_dump *dumps, unsigned nr)
+{
+  unsigned highest_cpuid = 0, highest_ext_cpuid = 0;
+  unsigned i;
+  for(i=0; i<nr; i++) {
+    if (dumps[i].highest_cpuid > highest_cpuid)
+      highest_cpuid = dumps[i].highest_cpuid;
+    if (dumps[i].highest_ext_cpuid > highest_ext_cpuid)
+      highest_ext_cpuid = dumps[i].highest_ext_cpuid;
+  }
+  if (highest_cpuid > 0x16)
+    fprintf(stderr, "WARNING: Processor supports new CPUID leaves upto 0x%x\n", highest_cpuid);
+  if (highest_ext_cpuid > 0x8000001e)
+    fprintf(stderr, "WARNING: Processor supports new extended CPUID leaves upto 0x%x\n", highest_ext_cpuid);
+}
+
+/***************************
+ * Output
+ */
+
+static void write_entry(FILE *output, struct cpuid_entry *entry)
+{
+  fprintf(output, "%x %x %x %x %x => %x %x %x %x\n",
+	  entry->inmask, entry->in[0], entry->in[1], entry->in[2], entry->in[3],
+	  entry->out[0], entry->out[1], entry->out[2], entry->out[3]);
+}
+
+static int write_pu_file(struct cpuid_dump *dump, const char *path)
+{
+  FILE *output;
+  unsigned i;
+
+  if (path) {
+    output = fopen(path, "w");
+    if (!output) {
+      fprintf(stderr, "Cannot open file '%s' for writing: %s\n", path, strerror(errno));
+      return -1;
+    }
+    printf("Gathered CPUID of PU P#%u in path %s\n", dump->pu->os_index, path);
+  } else {
+    output = stdout;
+    printf("Gathered CPUID of PU P#%u on stdout\n", dump->pu->os_index);
+  }
+
+  fprintf(output, "# mask e[abcd]x => e[abcd]x\n");
+  for(i=0; i<dump->nr; i++)
+    write_entry(output, &dump->entries[i]);
 
   if (path)
     fclose(output);
   return 0;
 }
 
+struct file_entry {
+  struct cpuid_entry *entry;
+  unsigned dump; /* index of the first dump containing this entry, once merged */
+  unsigned pos; /* position in that dump */
+  hwloc_bitmap_t pus;
+};
+
+static int compare_entries_by_value(const void *_a, const void *_b)
+{
+  const struct file_entry *a = _a, *b = _b;
+  int diff = memcmp(a->entry, b->entry, sizeof(*a->entry));
+  if (diff)
+    return diff;
+  return a->dump < b->dump ? -1 : a->dump > b->dump ? 1 : 0;
+}
+
+static int compare_entries_by_position(const void *_a, const void *_b)
+{
+  const struct file_entry *a = _a, *b = _b;
+  if (a->dump != b->dump)
+    return a->dump < b->dump ? -1 : 1;
+  return a->pos < b->pos ? -1 : a->pos > b->pos ? 1 : 0;
+}
+
+/* write all dumps in a single file, identical entries are only written once,
+ * prefixed with the list of PUs where they were gathered.
+ */
+static int write_single_file(struct cpuid_dump *dumps, unsigned nr, const char *path)
+{
+  struct file_entry *entries;
+  unsigned nr_entries = 0, nr_merged, i, j;
+  FILE *output;
+  int err = 0;
+
+  for(i=0; i<nr; i++)
+    nr_entries += dumps[i].nr;
+  entries = malloc(nr_entries * sizeof(*entries));
+  if (!entries)
+    return -1;
+  for(i=0, nr_entries=0; i<nr; i++)
+    for(j=0; j<dumps[i].nr; j++) {
+      entries[nr_entries].entry = &dumps[i].entries[j];
+      entries[nr_entries].dump = i;
+      entries[nr_entries].pos = j;
+      entries[nr_entries].pus = NULL;
+      nr_entries++;
+    }
+
+  /* merge identical entries into the first one, then restore the gathering order */
+  qsort(entries, nr_entries, sizeof(*entries), compare_entries_by_value);
+  for(i=0, nr_merged=0; i<nr_entries; i = j) {
+    hwloc_bitmap_t pus = hwloc_bitmap_alloc();
+    for(j=i; j<nr_entries && !memcmp(entries[i].entry, entries[j].entry, sizeof(*entries[i].entry)); j++)
+      hwloc_bitmap_set(pus, dumps[entries[j].dump].pu->os_index);
+    entries[nr_merged] = entries[i];
+    entries[nr_merged].pus = pus;
+    nr_merged++;
+  }
+  qsort(entries, nr_merged, sizeof(*entries), compare_entries_by_position);
+
+  output = fopen(path, "w");
+  if (!output) {
+    fprintf(stderr, "Cannot open file '%s' for writing: %s\n", path, strerror(errno));
+    err = -1;
+  } else {
+    fprintf(output, "Architecture: x86\n");
+    fprintf(output, "# pus mask e[abcd]x => e[abcd]x\n");
+    for(i=0; i<nr_merged; i++) {
+      char *list;
+      if (hwloc_bitmap_list_asprintf(&list, entries[i].pus) < 0) {
+	err = -1;
+	break;
+      }
+      fprintf(output, "%s ", list);
+      write_entry(output, entries[i].entry);
+      free(list);
+    }
+    if (fclose(output))
+      err = -1;
+    if (!err)
+      printf("Gathered CPUID of %u PUs in file %s (%u lines instead of %u)\n", nr, path, nr_merged, nr_entries);
+  }
+
+  for(i=0; i<nr_merged; i++)
+    hwloc_bitmap_free(entries[i].pus);
+  free(entries);
+  return err;
+}
+
 void usage(const char *callname, FILE *where)
 {
   fprintf(where, "Usage : %s [ options ] ... [ outdir ]\n", callname);
   fprintf(where, "  outdir is an optional output directory instead of cpuid/\n");
   fprintf(where, "Options:\n");
-  fprintf(where, "  -c <n>     Only gather for logical processor with logical index <n>\n");
-  fprintf(where, "  -h --help  Show this usage\n");
+  fprintf(where, "  -c <n>         Only gather for logical processor with logical index <n>\n");
+  fprintf(where, "  -f <file>      Gather all processors in a single compact file instead of a directory\n");
+  fprintf(where, "  -j <n>         Gather with <n> threads, each bound to a group of processors\n");
+  fprintf(where, "  -h --help      Show this usage\n");
 }
 
 int main(int argc, const char * const argv[])
@@ -340,9 +560,13 @@ int main(int argc, const char * const argv[])
   hwloc_obj_t pu;
   const char *basedir;
   const char *callname;
-  char *path;
+  const char *singlefile = NULL;
+  struct cpuid_dump *dumps = NULL;
+  unsigned nr_dumps, nr_groups = 0;
+  char *path = NULL;
   size_t pathlen;
   unsigned idx = (unsigned) -1;
+  unsigned i;
   int err;
   int ret = EXIT_SUCCESS;
 
@@ -362,6 +586,14 @@ int main(int argc, const char * const argv[])
       idx = atoi(argv[1]);
       argc -= 2;
       argv += 2;
+    } else if (argc >= 2 && !strcmp(argv[0], "-f")) {
+      singlefile = argv[1];
+      argc -= 2;
+      argv += 2;
+    } else if (argc >= 2 && !strcmp(argv[0], "-j")) {
+      nr_groups = atoi(argv[1]);
+      argc -= 2;
+      argv += 2;
     } else {
       usage(callname, stderr);
       if (strcmp(argv[0], "-h") && strcmp(argv[0], "--help"))
@@ -380,19 +612,29 @@ int main(int argc, const char * const argv[])
   if (!hwloc_topology_is_thissystem(topo)) {
     fprintf(stderr, "%s must run on the current system topology, while this topology doesn't come from this system.\n", callname);
     ret = EXIT_FAILURE;
-    goto out;
+    goto out_with_topo;
   }
 
-  if (!strcmp(basedir, "-")) {
-    printf("Gathering on stdout ...\n");
-    if (idx == (unsigned) -1) {
-      fprintf(stderr, "Cannot gather multiple PUs on stdout.\n");
+  if (idx != (unsigned) -1) {
+    /* a single PU */
+    pu = hwloc_get_pu_obj_by_os_index(topo, idx);
+    if (!pu) {
+      fprintf(stderr, "Cannot find PU P#%u\n", idx);
       ret = EXIT_FAILURE;
-      goto out;
+      goto out_with_topo;
     }
-    path = NULL;
-    pathlen = 0;
+    nr_dumps = 1;
   } else {
+    if (!strcmp(basedir, "-") && !singlefile) {
+      fprintf(stderr, "Cannot gather multiple PUs on stdout.\n");
+      ret = EXIT_FAILURE;
+      goto out_with_topo;
+    }
+    pu = NULL;
+    nr_dumps = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_PU);
+  }
+
+  if (!singlefile && strcmp(basedir, "-")) {
     err = mkdir(basedir, S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH);
     if (err < 0) {
       if (access(basedir, X_OK|W_OK) < 0) {
@@ -401,41 +643,68 @@ int main(int argc, const char * const argv[])
 	goto out_with_topo;
       }
     }
-    printf("Gathering in directory %s ...\n", basedir);
-
-    pathlen = strlen(basedir) + 20; /* for '/pu%u' or '/hwloc-cpuid-info' */
-    path = malloc(pathlen);
   }
 
-  if (idx == (unsigned) -1) {
-    FILE *file;
-    pu = NULL;
-    while ((pu = hwloc_get_next_obj_by_type(topo, HWLOC_OBJ_PU, pu)) != NULL) {
-      idx = pu->os_index;
-      if (path)
-	snprintf(path, pathlen, "%s/pu%u", basedir, idx);
-      dump_one_proc(topo, pu, path);
+  dumps = calloc(nr_dumps, sizeof(*dumps));
+  if (!dumps) {
+    ret = EXIT_FAILURE;
+    goto out_with_topo;
+  }
+  if (pu)
+    dumps[0].pu = pu;
+  else
+    for(i=0; i<nr_dumps; i++)
+      dumps[i].pu = hwloc_get_obj_by_type(topo, HWLOC_OBJ_PU, i);
+
+  /* one thread per core by default, each gathers the PUs of its core */
+  if (!nr_groups) {
+    int nr_cores = hwloc_get_nbobjs_by_type(topo, HWLOC_OBJ_CORE);
+    nr_groups = nr_cores > 0 ? (unsigned) nr_cores : nr_dumps;
+  }
+  printf("Gathering CPUID of %u PUs with %u threads ...\n", nr_dumps, nr_groups < nr_dumps ? nr_groups : nr_dumps);
+  gather_all(topo, dumps, nr_dumps, nr_groups);
+  report_new_leaves(dumps, nr_dumps);
+
+  for(i=0; i<nr_dumps; i++)
+    if (dumps[i].failed) {
+      fprintf(stderr, "Failed to gather CPUID of PU P#%u\n", dumps[i].pu->os_index);
+      ret = EXIT_FAILURE;
+      goto out_with_dumps;
     }
 
-    snprintf(path, pathlen, "%s/hwloc-cpuid-info", basedir);
-    file = fopen(path, "w");
-    if (file) {
-      fprintf(file, "Architecture: x86\n");
-      fclose(file);
-      printf("Summary written to %s\n", path);
-    } else {
-      fprintf(stderr, "Failed to open summary file '%s' for writing: %s\n", path, strerror(errno));
-    }
+  if (singlefile) {
+    if (write_single_file(dumps, nr_dumps, singlefile) < 0)
+      ret = EXIT_FAILURE;
+
+  } else if (!strcmp(basedir, "-")) {
+    write_pu_file(&dumps[0], NULL);
+
   } else {
-    pu = hwloc_get_pu_obj_by_os_index(topo, idx);
-    if (!pu) {
-      fprintf(stderr, "Cannot find PU P#%u\n", idx);
+    FILE *file;
+
+    pathlen = strlen(basedir) + 20; /* for '/pu%u' or '/hwloc-cpuid-info' */
+    path = malloc(pathlen);
+    if (!path) {
       ret = EXIT_FAILURE;
-      goto out_with_path;
-    } else {
-      if (path)
-        snprintf(path, pathlen, "%s/pu%u", basedir, idx);
-      dump_one_proc(topo, pu, path);
+      goto out_with_dumps;
+    }
+
+    for(i=0; i<nr_dumps; i++) {
+      snprintf(path, pathlen, "%s/pu%u", basedir, dumps[i].pu->os_index);
+      if (write_pu_file(&dumps[i], path) < 0)
+	ret = EXIT_FAILURE;
+    }
+
+    if (idx == (unsigned) -1) {
+      snprintf(path, pathlen, "%s/hwloc-cpuid-info", basedir);
+      file = fopen(path, "w");
+      if (file) {
+	fprintf(file, "Architecture: x86\n");
+	fclose(file);
+	printf("Summary written to %s\n", path);
+      } else {
+	fprintf(stderr, "Failed to open summary file '%s' for writing: %s\n", path, strerror(errno));
+      }
     }
   }
 
@@ -443,7 +712,10 @@ int main(int argc, const char * const argv[])
 	 "WARNING: Do not post these files on a public list or website unless you\n"
 	 "WARNING: are sure that no information about this platform is sensitive.\n");
 
- out_with_path:
+ out_with_dumps:
+  for(i=0; i<nr_dumps; i++)
+    free(dumps[i].entries);
+  free(dumps);
   free(path);
  out_with_topo:
   hwloc_topology_destroy(topo);
@@ -0,0 +1,805 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <private/autogen/config.h>
+#include <hwloc.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef hwloc_thread_t
+#include <pthread.h>
+#endif
+
+#include "misc.h"
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/* files are read in parallel by batches, and written to the archive in between */
+#define GATHER_BATCH 256
+/* same limit as the kernel when following symlinks */
+#define GATHER_MAX_SYMLINKS 40
+
+static int verbose = 0;
+static unsigned nr_jobs = 1;
+static const char *fsroot = NULL; /* gather from this directory instead of / */
+
+void usage(const char *callname, FILE *where)
+{
+  fprintf(where, "Usage: %s [options] <savepath>\n", callname);
+  fprintf(where, "  Saves the Linux files (/sys, /proc, ...) that hwloc reads during discovery\n");
+  fprintf(where, "  under <savepath>.tar.bz2, for later use with HWLOC_FSROOT\n");
+  fprintf(where, "Options:\n");
+  fprintf(where, "  --io             Also gather the files read during I/O discovery\n");
+  fprintf(where, "  --fsroot <dir>   Gather from the files under <dir> instead of the local system\n");
+  fprintf(where, "  -j --jobs <n>    Read up to <n> files in parallel\n");
+  fprintf(where, "  -v --verbose     Display verbose messages\n");
+  fprintf(where, "  --version        Report version and exit\n");
+}
+
+/***************************
+ * Parallel jobs
+ */
+
+typedef void (*job_fn_t)(void *data, unsigned idx);
+
+struct jobs_s {
+  job_fn_t fn;
+  void *data;
+  unsigned nr;
+  unsigned next;
+#ifdef hwloc_thread_t
+  pthread_mutex_t lock;
+#endif
+};
+
+#ifdef hwloc_thread_t
+static void *
+jobs_worker(void *_jobs)
+{
+  struct jobs_s *jobs = _jobs;
+  for(;;) {
+    unsigned idx;
+    pthread_mutex_lock(&jobs->lock);
+    idx = jobs->next++;
+    pthread_mutex_unlock(&jobs->lock);
+    if (idx >= jobs->nr)
+      break;
+    jobs->fn(jobs->data, idx);
+  }
+  return NULL;
+}
+#endif
+
+/* run fn(data, i) for all i in [0:nr[, in up to nr_jobs threads */
+static void
+run_jobs(job_fn_t fn, void *data, unsigned nr)
+{
+  struct jobs_s jobs;
+  unsigned i;
+
+  jobs.fn = fn;
+  jobs.data = data;
+  jobs.nr = nr;
+  jobs.next = 0;
+
+#ifdef hwloc_thread_t
+  if (nr_jobs > 1 && nr > 1) {
+    unsigned nr_threads = nr_jobs < nr ? nr_jobs : nr;
+    pthread_t *threads = malloc(nr_threads * sizeof(*threads));
+    if (threads) {
+      unsigned created = 0;
+      pthread_mutex_init(&jobs.lock, NULL);
+      /* the main thread is one of the workers */
+      for(i=1; i<nr_threads; i++)
+	if (!pthread_create(&threads[created], NULL, jobs_worker, &jobs))
+	  created++;
+      jobs_worker(&jobs);
+      for(i=0; i<created; i++)
+	pthread_join(threads[i], NULL);
+      pthread_mutex_destroy(&jobs.lock);
+      free(threads);
+      return;
+    }
+  }
+#endif
+
+  for(i=0; i<nr; i++)
+    fn(data, i);
+}
+
+/***************************
+ * List of entries to save
+ */
+
+/* path of an entry on this system, prefixed with the --fsroot directory if any */
+static const char *
+system_path(const char *path, char *buf, size_t size)
+{
+  if (!fsroot)
+    return path;
+  if ((size_t) snprintf(buf, size, "%s%s", fsroot, path) >= size)
+    return NULL;
+  return buf;
+}
+
+#define ENTRY_FILE '0'
+#define ENTRY_SYMLINK '2'
+#define ENTRY_DIR '5'
+
+struct gather_entry_s {
+  char *path; /* absolute path on this system, or under --fsroot */
+  char type; /* ENTRY_* */
+  char *target; /* symlink target */
+  /* file contents, filled by read_job() */
+  char *data;
+  size_t len;
+  int failed;
+};
+
+struct gather_s {
+  struct gather_entry_s *entries;
+  unsigned nr, allocated;
+};
+
+static int
+add_entry(struct gather_s *gather, const char *path, char type, const char *target)
+{
+  struct gather_entry_s *entry;
+
+  if (gather->nr == gather->allocated) {
+    unsigned allocated = gather->allocated ? 2*gather->allocated : 256;
+    struct gather_entry_s *tmp = realloc(gather->entries, allocated * sizeof(*tmp));
+    if (!tmp)
+      return -1;
+    gather->entries = tmp;
+    gather->allocated = allocated;
+  }
+  entry = &gather->entries[gather->nr];
+  memset(entry, 0, sizeof(*entry));
+  entry->path = strdup(path);
+  entry->type = type;
+  entry->target = target ? strdup(target) : NULL;
+  if (!entry->path || (target && !entry->target)) {
+    free(entry->path);
+    free(entry->target);
+    return -1;
+  }
+  gather->nr++;
+  return 0;
+}
+
+/* remove the last component of path (of length *lenp) */
+static void
+strip_last_component(char *path, size_t *lenp)
+{
+  size_t len = *lenp;
+  while (len && path[len-1] != '/')
+    len--;
+  if (len)
+    len--;
+  path[len] = '\0';
+  *lenp = len;
+}
+
+/* add a directory and the names it contains, so that the backend
+ * enumerates the same subdirectories and symlinks.
+ * Regular files are only saved if they were accessed.
+ */
+static void
+add_dir_names(struct gather_s *gather, const char *path)
+{
+  char child[PATH_MAX], sysbuf[PATH_MAX];
+  const char *syspath;
+  struct dirent *dirent;
+  struct stat st;
+  DIR *dir;
+
+  syspath = system_path(path, sysbuf, sizeof(sysbuf));
+  if (!syspath)
+    return;
+  dir = opendir(syspath);
+  if (!dir)
+    return;
+  while ((dirent = readdir(dir)) != NULL) {
+    if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, ".."))
+      continue;
+    if ((size_t) snprintf(child, sizeof(child), "%s/%s", path, dirent->d_name) >= sizeof(child))
+      continue;
+    syspath = system_path(child, sysbuf, sizeof(sysbuf));
+    if (!syspath || lstat(syspath, &st) < 0)
+      continue;
+    if (S_ISDIR(st.st_mode)) {
+      add_entry(gather, child, ENTRY_DIR, NULL);
+    } else if (S_ISLNK(st.st_mode)) {
+      char target[PATH_MAX];
+      ssize_t len = readlink(syspath, target, sizeof(target)-1);
+      if (len < 0)
+	continue;
+      target[len] = '\0';
+      add_entry(gather, child, ENTRY_SYMLINK, target);
+    }
+  }
+  closedir(dir);
+}
+
+/* walk the path one component at a time, saving each directory and symlink
+ * on the way so that the path can be resolved the same way inside the archive.
+ */
+static void
+add_path(struct gather_s *gather, const char *path)
+{
+  char cur[PATH_MAX], todo[PATH_MAX], tmp[2*PATH_MAX], sysbuf[PATH_MAX];
+  const char *p, *syspath;
+  size_t curlen = 0;
+  unsigned nr_symlinks = 0;
+  struct stat st;
+
+  if (strlen(path) >= sizeof(todo))
+    return;
+  strcpy(todo, path);
+  p = todo;
+  cur[0] = '\0';
+
+  while (*p) {
+    const char *end;
+    size_t len;
+
+    while (*p == '/')
+      p++;
+    if (!*p)
+      break;
+    end = strchr(p, '/');
+    len = end ? (size_t) (end - p) : strlen(p);
+
+    if (len == 1 && p[0] == '.') {
+      p += len;
+      continue;
+    }
+    if (len == 2 && p[0] == '.' && p[1] == '.') {
+      strip_last_component(cur, &curlen);
+      p += len;
+      continue;
+    }
+
+    if (curlen + 1 + len >= sizeof(cur))
+      return;
+    cur[curlen++] = '/';
+    memcpy(cur+curlen, p, len);
+    curlen += len;
+    cur[curlen] = '\0';
+    p += len;
+
+    syspath = system_path(cur, sysbuf, sizeof(sysbuf));
+    if (!syspath || lstat(syspath, &st) < 0)
+      return;
+
+    if (S_ISLNK(st.st_mode)) {
+      char target[PATH_MAX];
+      ssize_t tlen = readlink(syspath, target, sizeof(target)-1);
+      if (tlen < 0)
+	return;
+      target[tlen] = '\0';
+      add_entry(gather, cur, ENTRY_SYMLINK, target);
+      if (++nr_symlinks > GATHER_MAX_SYMLINKS)
+	return;
+      /* continue with the target followed by the remaining components */
+      if ((size_t) snprintf(tmp, sizeof(tmp), "%s%s", target, p) >= sizeof(todo))
+	return;
+      strcpy(todo, tmp);
+      p = todo;
+      if (target[0] == '/') {
+	curlen = 0;
+	cur[0] = '\0';
+      } else {
+	strip_last_component(cur, &curlen);
+      }
+      continue;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+      add_entry(gather, cur, ENTRY_DIR, NULL);
+    } else if (S_ISREG(st.st_mode) && !*p) {
+      add_entry(gather, cur, ENTRY_FILE, NULL);
+      return;
+    } else {
+      return;
+    }
+  }
+
+  /* the path is a directory, it may have been enumerated */
+  if (curlen)
+    add_dir_names(gather, cur);
+}
+
+static int
+compare_entries(const void *_a, const void *_b)
+{
+  const struct gather_entry_s *a = _a, *b = _b;
+  return strcmp(a->path, b->path);
+}
+
+/* sort by path so that directories come before their contents, and remove duplicates */
+static void
+sort_entries(struct gather_s *gather)
+{
+  unsigned i, j;
+
+  if (!gather->nr)
+    return;
+  qsort(gather->entries, gather->nr, sizeof(*gather->entries), compare_entries);
+  for(i=1, j=0; i<gather->nr; i++) {
+    if (!strcmp(gather->entries[i].path, gather->entries[j].path)) {
+      free(gather->entries[i].path);
+      free(gather->entries[i].target);
+    } else {
+      gather->entries[++j] = gather->entries[i];
+    }
+  }
+  gather->nr = j+1;
+}
+
+static int
+read_accessed_files(struct gather_s *gather, const char *filename)
+{
+  char line[PATH_MAX];
+  FILE *file;
+
+  file = fopen(filename, "r");
+  if (!file)
+    return -1;
+  while (fgets(line, sizeof(line), file)) {
+    size_t len = strlen(line);
+    if (len && line[len-1] == '\n')
+      line[--len] = '\0';
+    if (line[0] != '/')
+      continue;
+    add_path(gather, line);
+  }
+  fclose(file);
+  return 0;
+}
+
+/***************************
+ * Reading files
+ */
+
+/* /proc and /sys files often report a wrong size, read until EOF */
+static int
+read_whole_file(const char *path, char **datap, size_t *lenp)
+{
+  size_t allocated = 4096, len = 0;
+  char *data;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  data = malloc(allocated);
+  if (!data) {
+    close(fd);
+    return -1;
+  }
+  for(;;) {
+    ssize_t ret;
+    if (len == allocated) {
+      char *tmp = realloc(data, 2*allocated);
+      if (!tmp)
+	goto failed;
+      data = tmp;
+      allocated *= 2;
+    }
+    ret = read(fd, data+len, allocated-len);
+    if (ret < 0) {
+      if (errno == EINTR)
+	continue;
+      goto failed;
+    }
+    if (!ret)
+      break;
+    len += ret;
+  }
+  close(fd);
+  *datap = data;
+  *lenp = len;
+  return 0;
+
+ failed:
+  free(data);
+  close(fd);
+  return -1;
+}
+
+static void
+read_job(void *_entries, unsigned idx)
+{
+  struct gather_entry_s *entry = &((struct gather_entry_s *) _entries)[idx];
+  char sysbuf[PATH_MAX];
+  const char *syspath;
+  if (entry->type != ENTRY_FILE)
+    return;
+  syspath = system_path(entry->path, sysbuf, sizeof(sysbuf));
+  if (!syspath || read_whole_file(syspath, &entry->data, &entry->len) < 0)
+    entry->failed = 1;
+}
+
+/***************************
+ * Tar archive
+ */
+
+struct tar_s {
+  FILE *output;
+  const char *basename;
+  unsigned long mtime;
+};
+
+static void
+tar_octal(char *field, size_t size, unsigned long long value)
+{
+  snprintf(field, size, "%0*llo", (int) size-1, value);
+}
+
+static int
+tar_write_padded(struct tar_s *tar, const char *data, size_t len)
+{
+  static const char zeros[512];
+  if (len && fwrite(data, 1, len, tar->output) != len)
+    return -1;
+  if ((len % 512) && fwrite(zeros, 1, 512 - (len % 512), tar->output) != 512 - (len % 512))
+    return -1;
+  return 0;
+}
+
+static int
+tar_write_header(struct tar_s *tar, const char *name, char type, unsigned long long size, const char *linkname)
+{
+  char header[512];
+  unsigned checksum = 0;
+  unsigned i;
+
+  memset(header, 0, sizeof(header));
+  strncpy(header, name, 100);
+  tar_octal(header+100, 8, type == ENTRY_DIR ? 0755 : type == ENTRY_SYMLINK ? 0777 : 0644);
+  tar_octal(header+108, 8, 0);
+  tar_octal(header+116, 8, 0);
+  tar_octal(header+124, 12, size);
+  tar_octal(header+136, 12, tar->mtime);
+  header[156] = type;
+  if (linkname)
+    strncpy(header+157, linkname, 100);
+  memcpy(header+257, "ustar  ", 8);
+  strcpy(header+265, "root");
+  strcpy(header+297, "root");
+
+  memset(header+148, ' ', 8);
+  for(i=0; i<sizeof(header); i++)
+    checksum += (unsigned char) header[i];
+  snprintf(header+148, 8, "%06o", checksum);
+
+  return tar_write_padded(tar, header, sizeof(header));
+}
+
+/* names and targets longer than the header fields are stored in GNU LongLink records */
+static int
+tar_write_entry(struct tar_s *tar, const char *path, char type, const char *data, size_t len, const char *target)
+{
+  char name[PATH_MAX+256];
+  size_t namelen;
+
+  namelen = (size_t) snprintf(name, sizeof(name), "%s%s%s", tar->basename, path, type == ENTRY_DIR ? "/" : "");
+  if (namelen >= sizeof(name))
+    return -1;
+
+  if (namelen >= 100
+      && (tar_write_header(tar, "././@LongLink", 'L', namelen+1, NULL) < 0
+	  || tar_write_padded(tar, name, namelen+1) < 0))
+    return -1;
+  if (target && strlen(target) >= 100
+      && (tar_write_header(tar, "././@LongLink", 'K', strlen(target)+1, NULL) < 0
+	  || tar_write_padded(tar, target, strlen(target)+1) < 0))
+    return -1;
+
+  if (tar_write_header(tar, name, type, len, target) < 0)
+    return -1;
+  return tar_write_padded(tar, data, len);
+}
+
+static int
+tar_finish(struct tar_s *tar)
+{
+  static const char zeros[1024];
+  return fwrite(zeros, 1, sizeof(zeros), tar->output) == sizeof(zeros) ? 0 : -1;
+}
+
+/* compress the archive on the fly by writing it into bzip2 */
+static FILE *
+open_bzip2(const char *filename, pid_t *pidp)
+{
+  int pipefd[2];
+  int outfd;
+  pid_t pid;
+  FILE *output;
+
+  outfd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if (outfd < 0)
+    return NULL;
+  if (pipe(pipefd) < 0) {
+    close(outfd);
+    return NULL;
+  }
+  pid = fork();
+  if (pid < 0) {
+    close(pipefd[0]);
+    close(pipefd[1]);
+    close(outfd);
+    return NULL;
+  }
+  if (!pid) {
+    dup2(pipefd[0], 0);
+    dup2(outfd, 1);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    close(outfd);
+    execlp("bzip2", "bzip2", "-c", NULL);
+    fprintf(stderr, "Failed to execute bzip2 (%s)\n", strerror(errno));
+    _exit(EXIT_FAILURE);
+  }
+  close(pipefd[0]);
+  close(outfd);
+  output = fdopen(pipefd[1], "w");
+  if (!output) {
+    close(pipefd[1]);
+    waitpid(pid, NULL, 0);
+    return NULL;
+  }
+  *pidp = pid;
+  return output;
+}
+
+static int
+write_archive(struct gather_s *gather, const char *filename, const char *basename,
+	      const char *nofile_info)
+{
+  struct tar_s tar;
+  pid_t pid;
+  unsigned i, j, saved = 0;
+  int status;
+  int err = 0;
+
+  tar.output = open_bzip2(filename, &pid);
+  if (!tar.output) {
+    fprintf(stderr, "Failed to create %s (%s)\n", filename, strerror(errno));
+    return -1;
+  }
+  tar.basename = basename;
+  tar.mtime = (unsigned long) time(NULL);
+
+  if (tar_write_entry(&tar, "", ENTRY_DIR, NULL, 0, NULL) < 0)
+    err = -1;
+
+  for(i=0; !err && i<gather->nr; i += GATHER_BATCH) {
+    unsigned nr = gather->nr - i < GATHER_BATCH ? gather->nr - i : GATHER_BATCH;
+    run_jobs(read_job, &gather->entries[i], nr);
+    for(j=i; j<i+nr; j++) {
+      struct gather_entry_s *entry = &gather->entries[j];
+      if (!err) {
+	if (entry->type == ENTRY_FILE && entry->failed) {
+	  if (verbose)
+	    fprintf(stderr, "Could not read %s\n", entry->path);
+	} else {
+	  err = tar_write_entry(&tar, entry->path, entry->type, entry->data, entry->len, entry->target);
+	  saved++;
+	}
+      }
+      free(entry->data);
+      entry->data = NULL;
+    }
+  }
+
+  if (!err) {
+    /* what the backend cannot read from files, see HWLOC_DUMP_NOFILE_INFO */
+    char *data;
+    size_t len;
+    if (!read_whole_file(nofile_info, &data, &len)) {
+      if (!gather->nr || strcmp(gather->entries[0].path, "/proc"))
+	err = tar_write_entry(&tar, "/proc", ENTRY_DIR, NULL, 0, NULL);
+      if (!err)
+	err = tar_write_entry(&tar, "/proc/hwloc-nofile-info", ENTRY_FILE, data, len, NULL);
+      free(data);
+    }
+  }
+
+  if (!err)
+    err = tar_finish(&tar);
+  if (fclose(tar.output))
+    err = -1;
+  if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+    err = -1;
+
+  if (err < 0)
+    fprintf(stderr, "Failed to write %s\n", filename);
+  else if (verbose)
+    printf("Saved %u entries\n", saved);
+  return err;
+}
+
+/***************************
+ * Main
+ */
+
+static int
+discover(int io)
+{
+  hwloc_topology_t topology;
+  int err;
+
+  err = hwloc_topology_init(&topology);
+  if (err < 0)
+    return -1;
+  /* instruction caches are ignored by default, their files would not be read */
+  hwloc_topology_set_icache_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+  if (io)
+    hwloc_topology_set_io_types_filter(topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+  err = hwloc_topology_load(topology);
+  hwloc_topology_destroy(topology);
+  return err;
+}
+
+int main(int argc, char *argv[])
+{
+  char tmpdir[] = "/tmp/hwloc-gather-fsrootXXXXXX";
+  char accessed[sizeof(tmpdir)+16], nofile_info[sizeof(tmpdir)+16];
+  struct gather_s gather;
+  char *callname, *savepath, *basename, *filename;
+  int io = 0;
+  int ret = EXIT_FAILURE;
+  unsigned i;
+  long n;
+
+  callname = strrchr(argv[0], '/');
+  if (!callname)
+    callname = argv[0];
+  else
+    callname++;
+  /* skip argv[0], handle options */
+  argc--;
+  argv++;
+
+  hwloc_utils_check_api_version(callname);
+
+#if defined(hwloc_thread_t) && defined(_SC_NPROCESSORS_ONLN)
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n > 0)
+    nr_jobs = (unsigned) n;
+#endif
+
+  while (argc >= 1 && argv[0][0] == '-') {
+    int opt = 0;
+    if (!strcmp(argv[0], "--io")) {
+      io = 1;
+    } else if (!strcmp(argv[0], "--fsroot")) {
+      if (argc < 2) {
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      fsroot = argv[1];
+      opt = 1;
+    } else if (!strcmp(argv[0], "-v") || !strcmp(argv[0], "--verbose")) {
+      verbose = 1;
+    } else if (!strcmp(argv[0], "-j") || !strcmp(argv[0], "--jobs")) {
+      char *end;
+      if (argc < 2) {
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      n = strtol(argv[1], &end, 10);
+      if (*end || n <= 0) {
+	fprintf(stderr, "Invalid number of jobs %s\n", argv[1]);
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      nr_jobs = (unsigned) n;
+      opt = 1;
+    } else if (!strcmp(argv[0], "-h") || !strcmp(argv[0], "--help")) {
+      usage(callname, stdout);
+      exit(EXIT_SUCCESS);
+    } else if (!strcmp(argv[0], "--version")) {
+      printf("%s %s\n", callname, HWLOC_VERSION);
+      exit(EXIT_SUCCESS);
+    } else {
+      fprintf(stderr, "Unrecognized option: %s\n", argv[0]);
+      usage(callname, stderr);
+      exit(EXIT_FAILURE);
+    }
+    argc -= opt+1;
+    argv += opt+1;
+  }
+
+  if (argc != 1 || !*argv[0]) {
+    usage(callname, stderr);
+    exit(EXIT_FAILURE);
+  }
+  savepath = argv[0];
+  basename = strrchr(savepath, '/');
+  basename = basename ? basename+1 : savepath;
+  if (!*basename) {
+    fprintf(stderr, "Invalid save path %s\n", savepath);
+    exit(EXIT_FAILURE);
+  }
+  filename = malloc(strlen(savepath) + 9);
+  if (!filename)
+    exit(EXIT_FAILURE);
+  sprintf(filename, "%s.tar.bz2", savepath);
+
+  if (!mkdtemp(tmpdir)) {
+    fprintf(stderr, "Failed to create temporary directory (%s)\n", strerror(errno));
+    free(filename);
+    exit(EXIT_FAILURE);
+  }
+  sprintf(accessed, "%s/accessed", tmpdir);
+  sprintf(nofile_info, "%s/nofile-info", tmpdir);
+
+  /* discover the topology and record what the Linux backend reads */
+  unsetenv("HWLOC_XMLFILE");
+  unsetenv("HWLOC_SYNTHETIC");
+  if (fsroot) {
+    /* the nofile info is gathered from the fsroot like other files, if it exists */
+    setenv("HWLOC_FSROOT", fsroot, 1);
+    unsetenv("HWLOC_THISSYSTEM");
+  } else {
+    unsetenv("HWLOC_FSROOT");
+    setenv("HWLOC_THISSYSTEM", "1", 1);
+    setenv("HWLOC_DUMP_NOFILE_INFO", nofile_info, 1);
+  }
+  if (io)
+    /* make sure PCI is discovered by the linuxio backend from sysfs */
+    setenv("HWLOC_COMPONENTS", "-pci", 1);
+  setenv("HWLOC_DUMP_ACCESSED_FILES", accessed, 1);
+  if (discover(io) < 0) {
+    fprintf(stderr, "Failed to discover the topology (%s)\n", strerror(errno));
+    goto out;
+  }
+  unsetenv("HWLOC_DUMP_ACCESSED_FILES");
+  unsetenv("HWLOC_DUMP_NOFILE_INFO");
+
+  memset(&gather, 0, sizeof(gather));
+  if (read_accessed_files(&gather, accessed) < 0) {
+    fprintf(stderr, "No file was accessed during discovery, is the Linux backend enabled?\n");
+    goto out;
+  }
+  sort_entries(&gather);
+
+  if (!write_archive(&gather, filename, basename, nofile_info)) {
+    printf("Topology files gathered in %s\n", filename);
+    printf("\n");
+    printf("WARNING: Do not post these files on a public list or website unless you\n");
+    printf("WARNING: are sure that no information about this platform is sensitive.\n");
+    ret = EXIT_SUCCESS;
+  }
+
+  for(i=0; i<gather.nr; i++) {
+    free(gather.entries[i].path);
+    free(gather.entries[i].target);
+  }
+  free(gather.entries);
+
+ out:
+  unlink(accessed);
+  unlink(nofile_info);
+  rmdir(tmpdir);
+  free(filename);
+  return ret;
+}
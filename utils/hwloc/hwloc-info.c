@@ -25,6 +25,7 @@ static int logical = 1;
 static int show_ancestors = 0;
 static int show_ancestor_depth = HWLOC_TYPE_DEPTH_UNKNOWN;
 static int show_index_prefix = 0;
+static int json_output = 0;
 static int current_obj;
 
 void usage(const char *name, FILE *where)
@@ -39,6 +40,8 @@ void usage(const char *name, FILE *where)
   fprintf (where, "  --ancestors           Display the chain of ancestor objects up to the root\n");
   fprintf (where, "  --ancestor <type>     Only display the ancestor of the given type\n");
   fprintf (where, "  -n                    Prefix each line with the index of the considered object\n");
+  fprintf (where, "  --json                Report one JSON object per line, all objects and distances\n"
+		  "                        in topology mode\n");
   fprintf (where, "Object filtering options:\n");
   fprintf (where, "  --restrict <cpuset>   Restrict the topology to processors listed in <cpuset>\n");
   fprintf (where, "  --restrict binding    Restrict the topology to the current process binding\n");
@@ -191,6 +194,249 @@ hwloc_info_show_obj(hwloc_obj_t obj, const char *type, const char *prefix, int v
   }
 }
 
+/* JSON output is written directly to stdout, only bitmaps need a (reused) buffer */
+static char *json_setbuf = NULL;
+static int json_setbuflen = 0;
+
+static void
+json_string(const char *s)
+{
+  putchar('"');
+  for(; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\') {
+      putchar('\\');
+      putchar(c);
+    } else if (c < 0x20)
+      printf("\\u%04x", c);
+    else
+      putchar(c);
+  }
+  putchar('"');
+}
+
+static void
+json_set(const char *name, hwloc_const_bitmap_t set)
+{
+  int len = hwloc_bitmap_snprintf(json_setbuf, json_setbuflen, set);
+  if (len >= json_setbuflen) {
+    char *tmp = realloc(json_setbuf, len+1);
+    if (!tmp)
+      return;
+    json_setbuf = tmp;
+    json_setbuflen = len+1;
+    hwloc_bitmap_snprintf(json_setbuf, json_setbuflen, set);
+  }
+  printf(",\"%s\":\"%s\"", name, json_setbuf);
+}
+
+static void
+json_pcidev_attr(struct hwloc_pcidev_attr_s *pcidev)
+{
+  printf("\"busid\":\"%04x:%02x:%02x.%01x\",\"class_id\":%u,\"vendor_id\":%u,\"device_id\":%u,"
+	 "\"subvendor_id\":%u,\"subdevice_id\":%u,\"revision\":%u,\"linkspeed\":%f",
+	 pcidev->domain, pcidev->bus, pcidev->dev, pcidev->func, pcidev->class_id,
+	 pcidev->vendor_id, pcidev->device_id, pcidev->subvendor_id, pcidev->subdevice_id,
+	 pcidev->revision, pcidev->linkspeed);
+}
+
+static void
+hwloc_info_show_obj_json(hwloc_obj_t obj)
+{
+  char type[128];
+  unsigned i;
+
+  printf("{\"object\":{\"type\":\"%s\"", hwloc_type_name(obj->type));
+  hwloc_obj_type_snprintf(type, sizeof(type), obj, 1);
+  printf(",\"full_type\":");
+  json_string(type);
+  if (obj->subtype) {
+    printf(",\"subtype\":");
+    json_string(obj->subtype);
+  }
+  printf(",\"logical_index\":%u", obj->logical_index);
+  if (obj->os_index != (unsigned) -1)
+    printf(",\"os_index\":%u", obj->os_index);
+  printf(",\"gp_index\":%llu", (unsigned long long) obj->gp_index);
+  if (obj->parent)
+    printf(",\"parent\":%llu", (unsigned long long) obj->parent->gp_index);
+  if (obj->name) {
+    printf(",\"name\":");
+    json_string(obj->name);
+  }
+  if (obj->depth != (unsigned) -1)
+    printf(",\"depth\":%d", (int) obj->depth);
+  printf(",\"sibling_rank\":%u,\"children\":%u,\"io_children\":%u,\"misc_children\":%u",
+	 obj->sibling_rank, obj->arity, obj->io_arity, obj->misc_arity);
+  if (obj->memory.local_memory)
+    printf(",\"local_memory\":%llu", (unsigned long long) obj->memory.local_memory);
+  if (obj->memory.total_memory)
+    printf(",\"total_memory\":%llu", (unsigned long long) obj->memory.total_memory);
+  if (obj->memory.page_types_len) {
+    printf(",\"page_types\":[");
+    for(i=0; i<obj->memory.page_types_len; i++)
+      printf("%s{\"size\":%llu,\"count\":%llu}", i ? "," : "",
+	     (unsigned long long) obj->memory.page_types[i].size,
+	     (unsigned long long) obj->memory.page_types[i].count);
+    printf("]");
+  }
+
+  if (obj->cpuset)
+    json_set("cpuset", obj->cpuset);
+  if (obj->complete_cpuset)
+    json_set("complete_cpuset", obj->complete_cpuset);
+  if (obj->allowed_cpuset)
+    json_set("allowed_cpuset", obj->allowed_cpuset);
+  if (obj->nodeset)
+    json_set("nodeset", obj->nodeset);
+  if (obj->complete_nodeset)
+    json_set("complete_nodeset", obj->complete_nodeset);
+  if (obj->allowed_nodeset)
+    json_set("allowed_nodeset", obj->allowed_nodeset);
+
+  switch (obj->type) {
+  case HWLOC_OBJ_L1CACHE:
+  case HWLOC_OBJ_L2CACHE:
+  case HWLOC_OBJ_L3CACHE:
+  case HWLOC_OBJ_L4CACHE:
+  case HWLOC_OBJ_L5CACHE:
+  case HWLOC_OBJ_L1ICACHE:
+  case HWLOC_OBJ_L2ICACHE:
+  case HWLOC_OBJ_L3ICACHE:
+    printf(",\"attr\":{\"depth\":%u,\"type\":\"%s\",\"size\":%llu,\"linesize\":%u,\"associativity\":%d}",
+	   obj->attr->cache.depth,
+	   obj->attr->cache.type == HWLOC_OBJ_CACHE_DATA ? "Data"
+	   : obj->attr->cache.type == HWLOC_OBJ_CACHE_INSTRUCTION ? "Instruction" : "Unified",
+	   (unsigned long long) obj->attr->cache.size, obj->attr->cache.linesize,
+	   obj->attr->cache.associativity);
+    break;
+  case HWLOC_OBJ_GROUP:
+    printf(",\"attr\":{\"depth\":%u}", obj->attr->group.depth);
+    break;
+  case HWLOC_OBJ_BRIDGE:
+    printf(",\"attr\":{\"upstream_type\":\"%s\"",
+	   obj->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_HOST ? "Host" : "PCI");
+    if (obj->attr->bridge.upstream_type == HWLOC_OBJ_BRIDGE_PCI) {
+      printf(",");
+      json_pcidev_attr(&obj->attr->bridge.upstream.pci);
+    }
+    if (obj->attr->bridge.downstream_type == HWLOC_OBJ_BRIDGE_PCI)
+      printf(",\"downstream_type\":\"PCI\",\"secondary_bus\":%u,\"subordinate_bus\":%u",
+	     obj->attr->bridge.downstream.pci.secondary_bus,
+	     obj->attr->bridge.downstream.pci.subordinate_bus);
+    printf("}");
+    break;
+  case HWLOC_OBJ_PCI_DEVICE:
+    printf(",\"attr\":{");
+    json_pcidev_attr(&obj->attr->pcidev);
+    printf("}");
+    break;
+  case HWLOC_OBJ_OS_DEVICE:
+    printf(",\"attr\":{\"osdev_type\":%u}", (unsigned) obj->attr->osdev.type);
+    break;
+  default:
+    break;
+  }
+
+  printf(",\"symmetric_subtree\":%u", obj->symmetric_subtree);
+
+  printf(",\"infos\":[");
+  for(i=0; i<obj->infos_count; i++) {
+    printf("%s{\"name\":", i ? "," : "");
+    json_string(obj->infos[i].name);
+    printf(",\"value\":");
+    json_string(obj->infos[i].value);
+    printf("}");
+  }
+  printf("]}}\n");
+}
+
+static void
+hwloc_info_show_tree_json(hwloc_obj_t obj)
+{
+  hwloc_obj_t child;
+  hwloc_info_show_obj_json(obj);
+  for(child = obj->first_child; child; child = child->next_sibling)
+    hwloc_info_show_tree_json(child);
+  for(child = obj->io_first_child; child; child = child->next_sibling)
+    hwloc_info_show_tree_json(child);
+  for(child = obj->misc_first_child; child; child = child->next_sibling)
+    hwloc_info_show_tree_json(child);
+}
+
+static void
+hwloc_info_show_distances_json(hwloc_topology_t topology)
+{
+  struct hwloc_distances_s **distances;
+  unsigned nr = 0, i, j;
+  int err;
+
+  err = hwloc_distances_get(topology, &nr, NULL, 0, 0);
+  if (err < 0 || !nr)
+    return;
+  distances = malloc(nr * sizeof(*distances));
+  if (!distances)
+    return;
+  err = hwloc_distances_get(topology, &nr, distances, 0, 0);
+  if (err < 0) {
+    free(distances);
+    return;
+  }
+
+  for(i=0; i<nr; i++) {
+    struct hwloc_distances_s *dist = distances[i];
+    printf("{\"distances\":{\"kind\":%lu,\"objs\":[", dist->kind);
+    for(j=0; j<dist->nbobjs; j++)
+      printf("%s%llu", j ? "," : "", (unsigned long long) dist->objs[j]->gp_index);
+    printf("],\"values\":[");
+    for(j=0; j<dist->nbobjs*dist->nbobjs; j++)
+      printf("%s%llu", j ? "," : "", (unsigned long long) dist->values[j]);
+    printf("]}}\n");
+    hwloc_distances_release(topology, dist);
+  }
+  free(distances);
+}
+
+static void
+hwloc_info_show_support_json(hwloc_topology_t topology)
+{
+  const struct hwloc_topology_support *support = hwloc_topology_get_support(topology);
+  const char *sep = "";
+#define DO(x,y) do { printf("%s\"" #x ":" #y "\":%u", sep, (unsigned char) support->x->y); sep = ","; } while (0)
+  printf("{\"support\":{");
+  DO(discovery, pu);
+
+  DO(cpubind, set_thisproc_cpubind);
+  DO(cpubind, get_thisproc_cpubind);
+  DO(cpubind, set_proc_cpubind);
+  DO(cpubind, get_proc_cpubind);
+  DO(cpubind, set_thisthread_cpubind);
+  DO(cpubind, get_thisthread_cpubind);
+  DO(cpubind, set_thread_cpubind);
+  DO(cpubind, get_thread_cpubind);
+  DO(cpubind, get_thisproc_last_cpu_location);
+  DO(cpubind, get_proc_last_cpu_location);
+  DO(cpubind, get_thisthread_last_cpu_location);
+
+  DO(membind, set_thisproc_membind);
+  DO(membind, get_thisproc_membind);
+  DO(membind, set_proc_membind);
+  DO(membind, get_proc_membind);
+  DO(membind, set_thisthread_membind);
+  DO(membind, get_thisthread_membind);
+  DO(membind, set_area_membind);
+  DO(membind, get_area_membind);
+  DO(membind, alloc_membind);
+  DO(membind, firsttouch_membind);
+  DO(membind, bind_membind);
+  DO(membind, interleave_membind);
+  DO(membind, nexttouch_membind);
+  DO(membind, migrate_membind);
+  DO(membind, get_area_memlocation);
+  printf("}}\n");
+#undef DO
+}
+
 static void
 hwloc_calc_process_arg_info_cb(void *_data __hwloc_attribute_unused,
 			       hwloc_obj_t obj,
@@ -199,6 +445,23 @@ hwloc_calc_process_arg_info_cb(void *_data __hwloc_attribute_unused,
   char prefix[32];
   char objs[128];
 
+  if (json_output) {
+    hwloc_obj_t parent = obj;
+    if (show_ancestors) {
+      for(; parent; parent = parent->parent)
+	hwloc_info_show_obj_json(parent);
+    } else if (show_ancestor_depth != HWLOC_TYPE_DEPTH_UNKNOWN) {
+      while (parent && parent->depth != (unsigned) show_ancestor_depth)
+	parent = parent->parent;
+      if (parent)
+	hwloc_info_show_obj_json(parent);
+    } else {
+      hwloc_info_show_obj_json(obj);
+    }
+    current_obj++;
+    return;
+  }
+
   prefix[0] = '\0';
   if (show_index_prefix)
     snprintf(prefix, sizeof(prefix), "%u: ", current_obj);
@@ -308,6 +571,8 @@ main (int argc, char *argv[])
       }
       else if (!strcmp (argv[0], "-n"))
 	show_index_prefix = 1;
+      else if (!strcmp (argv[0], "--json"))
+	json_output = 1;
       else if (!strcmp (argv[0], "--ancestors"))
 	show_ancestors = 1;
       else if (!strcmp (argv[0], "--ancestor")) {
@@ -476,7 +741,15 @@ main (int argc, char *argv[])
       mode = HWLOC_INFO_MODE_TOPOLOGY;
   }
 
-  if (mode == HWLOC_INFO_MODE_TOPOLOGY) {
+  if (json_output && mode == HWLOC_INFO_MODE_TOPOLOGY) {
+    hwloc_info_show_tree_json(hwloc_get_root_obj(topology));
+    hwloc_info_show_distances_json(topology);
+    hwloc_info_show_support_json(topology);
+
+  } else if (json_output && mode == HWLOC_INFO_MODE_SUPPORT) {
+    hwloc_info_show_support_json(topology);
+
+  } else if (mode == HWLOC_INFO_MODE_TOPOLOGY) {
     hwloc_lstopo_show_summary(stdout, topology);
 
   } else if (mode == HWLOC_INFO_MODE_SUPPORT) {
@@ -531,6 +804,7 @@ main (int argc, char *argv[])
 
   } else assert(0);
 
+  free(json_setbuf);
   hwloc_topology_destroy (topology);
 
   return EXIT_SUCCESS;
@@ -0,0 +1,297 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <private/autogen/config.h>
+#include <hwloc.h>
+#include <hwloc/linux.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "misc.h"
+
+static int logical = 1;
+static int show_summary = 0;
+static int only_misplaced = 0;
+
+void usage(const char *name, FILE *where)
+{
+  fprintf (where, "Usage: %s [ options ] [ <pid> ... ]\n", name);
+  fprintf (where, "Options:\n");
+  fprintf (where, "  -a               Audit all processes\n");
+  fprintf (where, "  -l --logical     Use logical object indexes (default)\n");
+  fprintf (where, "  -p --physical    Use physical object indexes\n");
+  fprintf (where, "  -s --summary     Show one line per process instead of one line per mapping\n");
+  fprintf (where, "  --misplaced      Only show mappings with pages outside of their expected nodes\n");
+  fprintf (where, "  --whole-system   Do not consider administration limitations\n");
+}
+
+static const char *
+policy_name(hwloc_membind_policy_t policy, int flags)
+{
+  switch (policy) {
+  case HWLOC_MEMBIND_DEFAULT: return "default";
+  case HWLOC_MEMBIND_FIRSTTOUCH: return "firsttouch";
+  case HWLOC_MEMBIND_BIND: return flags & HWLOC_MEMBIND_STRICT ? "bind-strict" : "bind";
+  case HWLOC_MEMBIND_INTERLEAVE: return "interleave";
+  default: return "mixed";
+  }
+}
+
+static void
+print_nodeset(hwloc_topology_t topology, hwloc_const_nodeset_t nodeset)
+{
+  hwloc_obj_t node = NULL;
+  int first = 1;
+  while ((node = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_NUMANODE, node)) != NULL) {
+    if (!hwloc_bitmap_isset(nodeset, node->os_index))
+      continue;
+    printf("%s%u", first ? "" : ",", logical ? node->logical_index : node->os_index);
+    first = 0;
+  }
+}
+
+/* print "<idx>=<count>" for each node with some pages */
+static void
+print_node_pages(hwloc_topology_t topology, const unsigned long *node_pages, unsigned nr_node_pages)
+{
+  hwloc_obj_t node = NULL;
+  int first = 1;
+  while ((node = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_NUMANODE, node)) != NULL) {
+    if (node->os_index >= nr_node_pages || !node_pages[node->os_index])
+      continue;
+    printf("%s%u=%lu", first ? "" : ",", logical ? node->logical_index : node->os_index, node_pages[node->os_index]);
+    first = 0;
+  }
+  if (first)
+    printf("-");
+}
+
+/* pages outside of the nodes where the mapping is expected:
+ * the policy nodes if any, the nodes near the process binding otherwise.
+ */
+static unsigned long
+count_misplaced(const struct hwloc_linux_numa_map_s *map, hwloc_const_nodeset_t localnodeset)
+{
+  hwloc_const_nodeset_t expected = localnodeset;
+  unsigned long misplaced = 0;
+  unsigned i;
+
+  if ((map->policy == HWLOC_MEMBIND_BIND || map->policy == HWLOC_MEMBIND_INTERLEAVE)
+      && !hwloc_bitmap_iszero(map->policy_nodeset))
+    expected = map->policy_nodeset;
+
+  for(i=0; i<map->nr_node_pages; i++)
+    if (!hwloc_bitmap_isset(expected, i))
+      misplaced += map->node_pages[i];
+  return misplaced;
+}
+
+static void
+read_cmdline(long pid_number, char *name, size_t namelen)
+{
+  char path[64];
+  ssize_t n;
+  int file;
+
+  name[0] = '\0';
+  snprintf(path, sizeof(path), "/proc/%ld/cmdline", pid_number);
+  file = open(path, O_RDONLY);
+  if (file < 0)
+    return;
+  n = read(file, name, namelen - 1);
+  close(file);
+  name[n > 0 ? n : 0] = '\0';
+}
+
+static int
+audit_process(hwloc_topology_t topology, long pid_number, int quiet)
+{
+  struct hwloc_linux_numa_map_s *maps;
+  hwloc_bitmap_t cpuset, localnodeset;
+  unsigned long *total_kB = NULL;
+  unsigned long misplaced_kB = 0;
+  unsigned nr_total = 0;
+  unsigned nr, i;
+  char name[64];
+  hwloc_pid_t pid = hwloc_pid_from_number(pid_number, 0);
+
+  if (hwloc_linux_get_proc_numa_maps(topology, pid, &maps, &nr, 0) < 0) {
+    if (!quiet)
+      fprintf(stderr, "Failed to read memory placement of process %ld (%s)\n", pid_number, strerror(errno));
+    return -1;
+  }
+
+  read_cmdline(pid_number, name, sizeof(name));
+  if (!name[0] && quiet) {
+    /* ignore kernel threads */
+    hwloc_linux_free_proc_numa_maps(maps, nr);
+    return 0;
+  }
+
+  /* nodes near the process binding, where pages are expected without explicit policy */
+  cpuset = hwloc_bitmap_alloc();
+  localnodeset = hwloc_bitmap_alloc();
+  if (hwloc_get_proc_cpubind(topology, pid, cpuset, 0) < 0)
+    hwloc_bitmap_copy(cpuset, hwloc_topology_get_topology_cpuset(topology));
+  hwloc_cpuset_to_nodeset(topology, cpuset, localnodeset);
+
+  for(i=0; i<nr; i++) {
+    struct hwloc_linux_numa_map_s *map = &maps[i];
+    unsigned long misplaced;
+    unsigned j;
+
+    if (!map->nr_pages)
+      continue;
+    misplaced = count_misplaced(map, localnodeset);
+
+    if (show_summary) {
+      if (map->nr_node_pages > nr_total) {
+	unsigned long *tmp = realloc(total_kB, map->nr_node_pages * sizeof(*total_kB));
+	if (!tmp)
+	  continue;
+	memset(tmp + nr_total, 0, (map->nr_node_pages - nr_total) * sizeof(*tmp));
+	total_kB = tmp;
+	nr_total = map->nr_node_pages;
+      }
+      for(j=0; j<map->nr_node_pages; j++)
+	total_kB[j] += map->node_pages[j] * (map->page_size >> 10);
+      misplaced_kB += misplaced * (map->page_size >> 10);
+      continue;
+    }
+
+    if (only_misplaced && !misplaced)
+      continue;
+
+    printf("%ld\t0x%lx\t%s", pid_number, map->start, policy_name(map->policy, map->policy_flags));
+    if (!hwloc_bitmap_iszero(map->policy_nodeset)) {
+      printf(":");
+      print_nodeset(topology, map->policy_nodeset);
+    }
+    printf("\t%lukB\t", map->page_size >> 10);
+    print_node_pages(topology, map->node_pages, map->nr_node_pages);
+    printf("\t%lu\t%s\n", misplaced, map->name ? map->name : "");
+  }
+
+  if (show_summary && (!only_misplaced || misplaced_kB)) {
+    printf("%ld\t", pid_number);
+    print_nodeset(topology, localnodeset);
+    printf("\t");
+    print_node_pages(topology, total_kB, nr_total);
+    printf("\t%lu\t%s\n", misplaced_kB, name);
+  }
+
+  free(total_kB);
+  hwloc_bitmap_free(localnodeset);
+  hwloc_bitmap_free(cpuset);
+  hwloc_linux_free_proc_numa_maps(maps, nr);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  hwloc_topology_t topology;
+  unsigned long flags = 0;
+  int audit_all = 0;
+  long *pids = NULL;
+  unsigned nr_pids = 0;
+  char *callname;
+  char *end;
+  int err = EXIT_FAILURE;
+  int opt;
+
+  callname = strrchr(argv[0], '/');
+  if (!callname)
+    callname = argv[0];
+  else
+    callname++;
+  /* skip argv[0], handle options */
+  argc--;
+  argv++;
+
+  hwloc_utils_check_api_version(callname);
+
+  pids = malloc((argc+1) * sizeof(*pids));
+  if (!pids)
+    goto out;
+
+  while (argc >= 1) {
+    opt = 0;
+    if (!strcmp(argv[0], "-a"))
+      audit_all = 1;
+    else if (!strcmp(argv[0], "-l") || !strcmp(argv[0], "--logical")) {
+      logical = 1;
+    } else if (!strcmp(argv[0], "-p") || !strcmp(argv[0], "--physical")) {
+      logical = 0;
+    } else if (!strcmp(argv[0], "-s") || !strcmp(argv[0], "--summary")) {
+      show_summary = 1;
+    } else if (!strcmp(argv[0], "--misplaced")) {
+      only_misplaced = 1;
+    } else if (!strcmp (argv[0], "--whole-system")) {
+      flags |= HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM;
+    } else if (!strcmp(argv[0], "-h") || !strcmp(argv[0], "--help")) {
+      usage(callname, stdout);
+      err = EXIT_SUCCESS;
+      goto out;
+    } else {
+      long pid_number = strtol(argv[0], &end, 10);
+      if (*end || pid_number <= 0) {
+	fprintf (stderr, "Unrecognized option: %s\n", argv[0]);
+	usage (callname, stderr);
+	goto out;
+      }
+      pids[nr_pids++] = pid_number;
+    }
+    argc -= opt+1;
+    argv += opt+1;
+  }
+
+  if (!audit_all && !nr_pids) {
+    usage(callname, stderr);
+    goto out;
+  }
+
+  if (hwloc_topology_init(&topology))
+    goto out;
+  hwloc_topology_set_flags(topology, flags);
+  if (hwloc_topology_load(topology))
+    goto out_with_topology;
+
+  err = EXIT_SUCCESS;
+
+  if (audit_all) {
+    struct dirent *dirent;
+    DIR *dir = opendir("/proc");
+    if (!dir) {
+      err = EXIT_FAILURE;
+      goto out_with_topology;
+    }
+    while ((dirent = readdir(dir))) {
+      long pid_number = strtol(dirent->d_name, &end, 10);
+      if (*end)
+	/* Not a number */
+	continue;
+      /* processes may exit or be inaccessible, ignore them */
+      audit_process(topology, pid_number, 1);
+    }
+    closedir(dir);
+  } else {
+    unsigned i;
+    for(i=0; i<nr_pids; i++)
+      if (audit_process(topology, pids[i], 0) < 0)
+	err = EXIT_FAILURE;
+  }
+
+ out_with_topology:
+  hwloc_topology_destroy(topology);
+ out:
+  free(pids);
+  return err;
+}
@@ -18,11 +18,22 @@
 #include <dirent.h>
 #endif
 #include <fcntl.h>
+#include <time.h>
+#ifdef hwloc_thread_t
+#include <pthread.h>
+#endif
 
 #include "misc.h"
 
 static int show_cpuset = 0;
 static int logical = 1;
+static int show_all = 0;
+static int show_threads = 0;
+static int get_last_cpu_location = 0;
+static unsigned nr_jobs = 1;
+static int json_output = 0;
+static double watch_interval = 0.;
+static int summary = 0;
 
 void usage(const char *name, FILE *where)
 {
@@ -35,10 +46,45 @@ void usage(const char *name, FILE *where)
   fprintf (where, "  -t --threads     Show threads\n");
   fprintf (where, "  -e --get-last-cpu-location\n");
   fprintf (where, "                   Retrieve the last processors where the tasks ran\n");
+  fprintf (where, "  -j --jobs <n>    Scan up to <n> ranges of processes in parallel\n");
   fprintf (where, "  --pid-cmd <cmd>  Append the output of <cmd> <pid> to each PID line\n");
+  fprintf (where, "  --watch <secs>   Rescan every <secs> seconds and only report changes\n");
+  fprintf (where, "  --json           Report one JSON object per process\n");
+  fprintf (where, "  --summary        Report the number of bound and running tasks per object\n");
   fprintf (where, "  --whole-system   Do not consider administration limitations\n");
 }
 
+static void print_cpuset(hwloc_bitmap_t cpuset)
+{
+  char *cpuset_str = NULL;
+  hwloc_bitmap_asprintf(&cpuset_str, cpuset);
+  printf("%s", cpuset_str);
+  free(cpuset_str);
+}
+
+static void print_objects(hwloc_topology_t topology, hwloc_bitmap_t cpuset)
+{
+  hwloc_bitmap_t remaining = hwloc_bitmap_dup(cpuset);
+  int first = 1;
+  while (!hwloc_bitmap_iszero(remaining)) {
+    char type[64];
+    unsigned idx;
+    hwloc_obj_t obj = hwloc_get_first_largest_obj_inside_cpuset(topology, remaining);
+    /* don't show a cache if there's something equivalent and nicer */
+    while (hwloc_obj_type_is_cache(obj->type) && obj->arity == 1)
+      obj = obj->first_child;
+    hwloc_obj_type_snprintf(type, sizeof(type), obj, 1);
+    idx = logical ? obj->logical_index : obj->os_index;
+    if (idx == (unsigned) -1)
+      printf("%s%s", first ? "" : " ", type);
+    else
+      printf("%s%s:%u", first ? "" : " ", type, idx);
+    hwloc_bitmap_andnot(remaining, remaining, obj->cpuset);
+    first = 0;
+  }
+  hwloc_bitmap_free(remaining);
+}
+
 static void print_task(hwloc_topology_t topology,
 		       long pid_number, const char *name, hwloc_bitmap_t cpuset,
 		       char *pidoutput,
@@ -46,48 +92,1008 @@ static void print_task(hwloc_topology_t topology,
 {
   printf("%s%ld\t", thread ? " " : "", pid_number);
 
-  if (show_cpuset) {
-    char *cpuset_str = NULL;
-    hwloc_bitmap_asprintf(&cpuset_str, cpuset);
-    printf("%s", cpuset_str);
-    free(cpuset_str);
+  if (show_cpuset)
+    print_cpuset(cpuset);
+  else
+    print_objects(topology, cpuset);
+
+  printf("\t\t%s%s%s\n", name, pidoutput ? "\t" : "", pidoutput ? pidoutput : "");
+}
+
+static void print_json_string(const char *string)
+{
+  const unsigned char *c;
+  putchar('"');
+  for(c = (const unsigned char *) string; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      printf("\\%c", *c);
+    else if (*c < 0x20)
+      printf("\\u%04x", *c);
+    else
+      putchar(*c);
+  }
+  putchar('"');
+}
+
+static void print_json_binding(hwloc_topology_t topology, hwloc_bitmap_t cpuset)
+{
+  printf("\"cpuset\": \"");
+  print_cpuset(cpuset);
+  /* object names never contain characters that need escaping */
+  printf("\", \"objects\": \"");
+  print_objects(topology, cpuset);
+  printf("\"");
+}
+
+/***************************
+ * Scanning /proc
+ *
+ * Processes are read from /proc in batches of ranges of consecutive entries.
+ * The ranges of a batch may be scanned in parallel, then the batch is
+ * reported in order and its slots (including cpusets and thread arrays)
+ * are reused for the next one.
+ */
+
+/* number of processes scanned by each job */
+#define HWLOC_PS_RANGE 64
+/* number of ranges per job in each batch */
+#define HWLOC_PS_RANGES_PER_JOB 4
+
+struct hwloc_ps_thread_s {
+  long tid;
+  hwloc_bitmap_t cpuset;
+  hwloc_bitmap_t last_cpuset; /* last CPU location, only allocated for --summary */
+};
+
+struct hwloc_ps_process_s {
+  long pid_number;
+  char name[64];
+  hwloc_bitmap_t cpuset;
+  hwloc_bitmap_t last_cpuset; /* last CPU location, only allocated for --summary */
+  int show; /* set when the process should be reported */
+  int scanned; /* set when the binding could be read, even if the process should not be reported */
+  /* threads, only filled with -t for multithreaded processes */
+  unsigned nr_threads;
+  unsigned threads_allocated; /* number of threads whose cpuset was allocated */
+  struct hwloc_ps_thread_s *threads;
+};
+
+struct hwloc_ps_scan_s {
+  hwloc_topology_t topology;
+  hwloc_const_bitmap_t topocpuset;
+  char *procpath; /* /proc, or the proc directory of HWLOC_FSROOT */
+  int fsroot; /* bindings are read from procpath files since the topology is not this system */
+  int procfd; /* procpath directory for openat, or -1 */
+  int report_unshown; /* also report scanned processes that should not be shown */
+  unsigned nr_procs; /* number of valid slots in the current batch */
+  unsigned procs_allocated;
+  struct hwloc_ps_process_s *procs;
+};
+
+#ifdef HWLOC_LINUX_SYS
+/* open a file or directory relative to the proc directory */
+static int
+hwloc_ps_open(struct hwloc_ps_scan_s *scan, const char *relpath, int flags)
+{
+  char *path;
+  int fd;
+
+#ifdef HAVE_OPENAT
+  if (scan->procfd >= 0)
+    return openat(scan->procfd, relpath, flags);
+#endif
+  path = malloc(strlen(scan->procpath)+1+strlen(relpath)+1);
+  if (!path)
+    return -1;
+  sprintf(path, "%s/%s", scan->procpath, relpath);
+  fd = open(path, flags);
+  free(path);
+  return fd;
+}
+
+static DIR *
+hwloc_ps_opendir(struct hwloc_ps_scan_s *scan, const char *relpath)
+{
+#ifdef HAVE_OPENAT
+  if (scan->procfd >= 0) {
+    DIR *dir;
+    int fd = hwloc_ps_open(scan, relpath, O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+      return NULL;
+    dir = fdopendir(fd);
+    if (!dir)
+      close(fd);
+    return dir;
+  }
+#endif
+  {
+    char *path;
+    DIR *dir;
+    path = malloc(strlen(scan->procpath)+1+strlen(relpath)+1);
+    if (!path)
+      return NULL;
+    sprintf(path, "%s/%s", scan->procpath, relpath);
+    dir = opendir(path);
+    free(path);
+    return dir;
+  }
+}
+
+/* read the binding (Cpus_allowed_list in status) or the last CPU location
+ * (39th field of stat) of a task from the proc directory of HWLOC_FSROOT.
+ * taskpath is <pid> or <pid>/task/<tid>.
+ */
+static int
+hwloc_ps_read_fsroot_cpuset(struct hwloc_ps_scan_s *scan, const char *taskpath, int last, hwloc_bitmap_t cpuset)
+{
+  char path[64];
+  char buffer[4096];
+  char *tmp, *end;
+  ssize_t n;
+  int file;
+  int i;
+
+  snprintf(path, sizeof(path), "%s/%s", taskpath, last ? "stat" : "status");
+  file = hwloc_ps_open(scan, path, O_RDONLY);
+  if (file < 0)
+    return -1;
+  n = read(file, buffer, sizeof(buffer) - 1);
+  close(file);
+  if (n <= 0)
+    return -1;
+  buffer[n] = '\0';
+
+  if (last) {
+    /* the command name may contain parentheses, skip to the last one, then to the 39th field */
+    tmp = strrchr(buffer, ')');
+    if (!tmp)
+      return -1;
+    tmp += 2;
+    for(i=0; i<36; i++) {
+      tmp = strchr(tmp, ' ');
+      if (!tmp)
+	return -1;
+      tmp++;
+    }
+    if (sscanf(tmp, "%d ", &i) != 1 || i < 0)
+      return -1;
+    hwloc_bitmap_only(cpuset, i);
+    return 0;
+  }
+
+  tmp = strstr(buffer, "\nCpus_allowed_list:");
+  if (!tmp)
+    return -1;
+  tmp += strlen("\nCpus_allowed_list:");
+  tmp += strspn(tmp, " \t");
+  end = strchr(tmp, '\n');
+  if (end)
+    *end = '\0';
+  return hwloc_bitmap_list_sscanf(cpuset, tmp);
+}
+
+static int
+hwloc_ps_get_tid_cpuset(struct hwloc_ps_scan_s *scan, long pid, long tid, int last, hwloc_bitmap_t cpuset)
+{
+  if (scan->fsroot) {
+    char taskpath[48];
+    snprintf(taskpath, sizeof(taskpath), "%ld/task/%ld", pid, tid);
+    return hwloc_ps_read_fsroot_cpuset(scan, taskpath, last, cpuset);
+  }
+  if (last)
+    return hwloc_linux_get_tid_last_cpu_location(scan->topology, tid, cpuset);
+  return hwloc_linux_get_tid_cpubind(scan->topology, tid, cpuset);
+}
+
+/* read the bindings of all threads of a process in a single pass over its task directory.
+ * returns the number of bound threads.
+ */
+static unsigned
+hwloc_ps_read_threads(struct hwloc_ps_scan_s *scan, struct hwloc_ps_process_s *proc)
+{
+  struct dirent *taskdirent;
+  char path[32];
+  DIR *taskdir;
+  unsigned nr_entries = 0, boundthreads = 0;
+
+  proc->nr_threads = 0;
+
+  snprintf(path, sizeof(path), "%ld/task", proc->pid_number);
+  taskdir = hwloc_ps_opendir(scan, path);
+  if (!taskdir)
+    return 0;
+
+  while ((taskdirent = readdir(taskdir))) {
+    struct hwloc_ps_thread_s *thread;
+    char *end;
+    long tid;
+    int err;
+
+    tid = strtol(taskdirent->d_name, &end, 10);
+    if (*end)
+      /* Not a number */
+      continue;
+    nr_entries++;
+
+    if (proc->nr_threads == proc->threads_allocated) {
+      /* grow the array, existing cpusets are kept for reuse by next processes */
+      unsigned new_allocated = proc->threads_allocated ? 2*proc->threads_allocated : 16;
+      struct hwloc_ps_thread_s *tmp = realloc(proc->threads, new_allocated * sizeof(*tmp));
+      if (!tmp)
+	break;
+      proc->threads = tmp;
+      for( ; proc->threads_allocated < new_allocated; proc->threads_allocated++) {
+	tmp[proc->threads_allocated].cpuset = hwloc_bitmap_alloc();
+	tmp[proc->threads_allocated].last_cpuset = summary ? hwloc_bitmap_alloc() : NULL;
+	if (!tmp[proc->threads_allocated].cpuset
+	    || (summary && !tmp[proc->threads_allocated].last_cpuset)) {
+	  hwloc_bitmap_free(tmp[proc->threads_allocated].cpuset);
+	  hwloc_bitmap_free(tmp[proc->threads_allocated].last_cpuset);
+	  break;
+	}
+      }
+      if (proc->nr_threads == proc->threads_allocated)
+	break;
+    }
+
+    thread = &proc->threads[proc->nr_threads];
+    err = hwloc_ps_get_tid_cpuset(scan, proc->pid_number, tid, get_last_cpu_location, thread->cpuset);
+    if (err)
+      continue;
+    hwloc_bitmap_and(thread->cpuset, thread->cpuset, scan->topocpuset);
+    if (summary && hwloc_ps_get_tid_cpuset(scan, proc->pid_number, tid, 1, thread->last_cpuset))
+      hwloc_bitmap_zero(thread->last_cpuset);
+    thread->tid = tid;
+    proc->nr_threads++;
+
+    if (hwloc_bitmap_iszero(thread->cpuset))
+      continue;
+    if (hwloc_bitmap_isequal(thread->cpuset, scan->topocpuset) && !show_all)
+      continue;
+    boundthreads++;
+  }
+  closedir(taskdir);
+
+  if (nr_entries <= 1)
+    /* only report threads of multithreaded processes */
+    proc->nr_threads = 0;
+  return boundthreads;
+}
+#endif /* HWLOC_LINUX_SYS */
+
+static int
+hwloc_ps_get_proc_cpuset(struct hwloc_ps_scan_s *scan, long pid_number, int last, hwloc_bitmap_t cpuset)
+{
+  hwloc_pid_t pid;
+
+#ifdef HWLOC_LINUX_SYS
+  if (scan->fsroot) {
+    char taskpath[24];
+    snprintf(taskpath, sizeof(taskpath), "%ld", pid_number);
+    return hwloc_ps_read_fsroot_cpuset(scan, taskpath, last, cpuset);
+  }
+#endif
+
+  pid = hwloc_pid_from_number(pid_number, 0);
+  if (last)
+    return hwloc_get_proc_last_cpu_location(scan->topology, pid, cpuset, 0);
+  return hwloc_get_proc_cpubind(scan->topology, pid, cpuset, 0);
+}
+
+/* fill a process slot whose pid_number is already set */
+static void
+hwloc_ps_read_process(struct hwloc_ps_scan_s *scan, struct hwloc_ps_process_s *proc)
+{
+  unsigned boundthreads = 0;
+
+  proc->show = 0;
+  proc->scanned = 0;
+  proc->nr_threads = 0;
+  proc->name[0] = '\0';
+
+#ifdef HWLOC_LINUX_SYS
+  {
+    char path[32];
+    int file;
+    ssize_t n;
+
+    snprintf(path, sizeof(path), "%ld/cmdline", proc->pid_number);
+    file = hwloc_ps_open(scan, path, O_RDONLY);
+    if (file >= 0) {
+      n = read(file, proc->name, sizeof(proc->name) - 1);
+      close(file);
+
+      if (n <= 0)
+	/* Ignore kernel threads and errors */
+	return;
+
+      proc->name[n] = 0;
+    }
+  }
+
+  if (show_threads)
+    /* check if some threads must be displayed */
+    boundthreads = hwloc_ps_read_threads(scan, proc);
+#endif /* HWLOC_LINUX_SYS */
+
+  if (hwloc_ps_get_proc_cpuset(scan, proc->pid_number, get_last_cpu_location, proc->cpuset))
+    return;
+
+  hwloc_bitmap_and(proc->cpuset, proc->cpuset, scan->topocpuset);
+  if (hwloc_bitmap_iszero(proc->cpuset))
+    return;
+
+  if (summary && hwloc_ps_get_proc_cpuset(scan, proc->pid_number, 1, proc->last_cpuset))
+    hwloc_bitmap_zero(proc->last_cpuset);
+
+  proc->scanned = 1;
+
+  /* don't report the process if it isn't bound and if no threads are bound and if not showing all */
+  if (hwloc_bitmap_isequal(proc->cpuset, scan->topocpuset) && (!proc->nr_threads || !boundthreads) && !show_all)
+    return;
+
+  proc->show = 1;
+}
+
+typedef void (*hwloc_ps_report_fn_t)(struct hwloc_ps_scan_s *scan, struct hwloc_ps_process_s *proc, void *data);
+
+struct hwloc_ps_jobs_s {
+  struct hwloc_ps_scan_s *scan;
+  unsigned nr_ranges;
+  unsigned next;
+#ifdef hwloc_thread_t
+  pthread_mutex_t lock;
+#endif
+};
+
+static void
+hwloc_ps_scan_range(struct hwloc_ps_scan_s *scan, unsigned range)
+{
+  unsigned i, end = (range+1) * HWLOC_PS_RANGE;
+  if (end > scan->nr_procs)
+    end = scan->nr_procs;
+  for(i = range * HWLOC_PS_RANGE; i < end; i++)
+    hwloc_ps_read_process(scan, &scan->procs[i]);
+}
+
+#ifdef hwloc_thread_t
+static void *
+hwloc_ps_jobs_worker(void *_jobs)
+{
+  struct hwloc_ps_jobs_s *jobs = _jobs;
+  for(;;) {
+    unsigned range;
+    pthread_mutex_lock(&jobs->lock);
+    range = jobs->next++;
+    pthread_mutex_unlock(&jobs->lock);
+    if (range >= jobs->nr_ranges)
+      break;
+    hwloc_ps_scan_range(jobs->scan, range);
+  }
+  return NULL;
+}
+#endif
+
+/* scan all ranges of the current batch, in up to nr_jobs threads */
+static void
+hwloc_ps_scan_batch(struct hwloc_ps_scan_s *scan)
+{
+  struct hwloc_ps_jobs_s jobs;
+  unsigned i;
+
+  jobs.scan = scan;
+  jobs.nr_ranges = (scan->nr_procs + HWLOC_PS_RANGE - 1) / HWLOC_PS_RANGE;
+  jobs.next = 0;
+
+#ifdef hwloc_thread_t
+  if (nr_jobs > 1 && jobs.nr_ranges > 1) {
+    unsigned nr_threads = nr_jobs < jobs.nr_ranges ? nr_jobs : jobs.nr_ranges;
+    pthread_t *threads = malloc(nr_threads * sizeof(*threads));
+    if (threads) {
+      unsigned created = 0;
+      pthread_mutex_init(&jobs.lock, NULL);
+      /* the main thread is one of the workers */
+      for(i=1; i<nr_threads; i++)
+	if (!pthread_create(&threads[created], NULL, hwloc_ps_jobs_worker, &jobs))
+	  created++;
+      hwloc_ps_jobs_worker(&jobs);
+      for(i=0; i<created; i++)
+	pthread_join(threads[i], NULL);
+      pthread_mutex_destroy(&jobs.lock);
+      free(threads);
+      return;
+    }
+  }
+#endif
+
+  for(i=0; i<jobs.nr_ranges; i++)
+    hwloc_ps_scan_range(scan, i);
+}
+
+static void
+hwloc_ps_report_batch(struct hwloc_ps_scan_s *scan, hwloc_ps_report_fn_t report, void *data)
+{
+  unsigned i;
+  for(i=0; i<scan->nr_procs; i++)
+    if (scan->procs[i].show || (scan->report_unshown && scan->procs[i].scanned))
+      report(scan, &scan->procs[i], data);
+}
+
+/* fsroot is the HWLOC_FSROOT where processes should be read from, or NULL for this system */
+static int
+hwloc_ps_scan_init(struct hwloc_ps_scan_s *scan, hwloc_topology_t topology, const char *fsroot)
+{
+  unsigned i;
+
+  scan->topology = topology;
+  scan->topocpuset = hwloc_topology_get_topology_cpuset(topology);
+  scan->fsroot = fsroot != NULL;
+  scan->procfd = -1;
+  scan->report_unshown = 0;
+  scan->nr_procs = 0;
+  scan->procs_allocated = 0;
+  if (fsroot) {
+    scan->procpath = malloc(strlen(fsroot)+6);
+    if (scan->procpath)
+      sprintf(scan->procpath, "%s/proc", fsroot);
   } else {
-    hwloc_bitmap_t remaining = hwloc_bitmap_dup(cpuset);
-    int first = 1;
-    while (!hwloc_bitmap_iszero(remaining)) {
+    scan->procpath = strdup("/proc");
+  }
+  scan->procs = calloc(nr_jobs * HWLOC_PS_RANGES_PER_JOB * HWLOC_PS_RANGE, sizeof(*scan->procs));
+  if (!scan->procpath || !scan->procs)
+    return -1;
+  for(i=0; i<nr_jobs * HWLOC_PS_RANGES_PER_JOB * HWLOC_PS_RANGE; i++) {
+    scan->procs[i].cpuset = hwloc_bitmap_alloc();
+    if (summary)
+      scan->procs[i].last_cpuset = hwloc_bitmap_alloc();
+    scan->procs_allocated++;
+    if (!scan->procs[i].cpuset || (summary && !scan->procs[i].last_cpuset))
+      return -1;
+  }
+
+#if defined HWLOC_LINUX_SYS && defined HAVE_OPENAT
+  scan->procfd = open(scan->procpath, O_RDONLY | O_DIRECTORY);
+#endif
+  return 0;
+}
+
+static void
+hwloc_ps_scan_destroy(struct hwloc_ps_scan_s *scan)
+{
+  unsigned i, j;
+  for(i=0; i<scan->procs_allocated; i++) {
+    struct hwloc_ps_process_s *proc = &scan->procs[i];
+    for(j=0; j<proc->threads_allocated; j++) {
+      hwloc_bitmap_free(proc->threads[j].cpuset);
+      hwloc_bitmap_free(proc->threads[j].last_cpuset);
+    }
+    free(proc->threads);
+    hwloc_bitmap_free(proc->cpuset);
+    hwloc_bitmap_free(proc->last_cpuset);
+  }
+  free(scan->procs);
+  free(scan->procpath);
+  if (scan->procfd >= 0)
+    close(scan->procfd);
+}
+
+/* scan all processes and call report() in PID directory order for those that must be shown */
+static int
+hwloc_ps_scan_processes(struct hwloc_ps_scan_s *scan, hwloc_ps_report_fn_t report, void *data)
+{
+  struct dirent *dirent;
+  DIR *dir;
+
+  dir = opendir(scan->procpath);
+  if (!dir)
+    return -1;
+
+  scan->nr_procs = 0;
+  while ((dirent = readdir(dir))) {
+    long pid_number;
+    char *end;
+
+    pid_number = strtol(dirent->d_name, &end, 10);
+    if (*end)
+      /* Not a number */
+      continue;
+
+    scan->procs[scan->nr_procs++].pid_number = pid_number;
+    if (scan->nr_procs == scan->procs_allocated) {
+      hwloc_ps_scan_batch(scan);
+      hwloc_ps_report_batch(scan, report, data);
+      scan->nr_procs = 0;
+    }
+  }
+  if (scan->nr_procs) {
+    hwloc_ps_scan_batch(scan);
+    hwloc_ps_report_batch(scan, report, data);
+    scan->nr_procs = 0;
+  }
+
+  closedir(dir);
+  return 0;
+}
+
+/***************************
+ * Reporting
+ */
+
+static void
+print_process(struct hwloc_ps_scan_s *scan, struct hwloc_ps_process_s *proc, void *data)
+{
+  const char *pidcmd = data;
+  char pidoutput[1024];
+  unsigned i;
+
+  pidoutput[0] = '\0';
+  if (pidcmd) {
+    char *cmd, *end;
+    FILE *file;
+    cmd = malloc(strlen(pidcmd)+1+20+1);
+    sprintf(cmd, "%s %ld", pidcmd, proc->pid_number);
+    file = popen(cmd, "r");
+    if (file) {
+      if (fgets(pidoutput, sizeof(pidoutput), file)) {
+	end = strchr(pidoutput, '\n');
+	if (end)
+	  *end = '\0';
+      }
+      pclose(file);
+    }
+    free(cmd);
+  }
+
+  if (json_output) {
+    printf("{");
+    if (watch_interval)
+      printf("\"time\": %ld, ", (long) time(NULL));
+    printf("\"pid\": %ld, \"name\": ", proc->pid_number);
+    print_json_string(proc->name);
+    printf(", ");
+    print_json_binding(scan->topology, proc->cpuset);
+    if (pidoutput[0] != '\0') {
+      printf(", \"pidcmd\": ");
+      print_json_string(pidoutput);
+    }
+    if (proc->nr_threads) {
+      printf(", \"threads\": [");
+      for(i=0; i<proc->nr_threads; i++) {
+	printf("%s{\"tid\": %ld, ", i ? ", " : "", proc->threads[i].tid);
+	print_json_binding(scan->topology, proc->threads[i].cpuset);
+	printf("}");
+      }
+      printf("]");
+    }
+    printf("}\n");
+    return;
+  }
+
+  /* print the process */
+  print_task(scan->topology, proc->pid_number, proc->name, proc->cpuset, pidoutput[0] == '\0' ? NULL : pidoutput, 0);
+  /* print each tid we found */
+  for(i=0; i<proc->nr_threads; i++)
+    print_task(scan->topology, proc->threads[i].tid, "", proc->threads[i].cpuset, NULL, 1);
+}
+
+/***************************
+ * Watching changes
+ *
+ * The cpusets of processes and threads reported by the previous scan are
+ * kept in a hash table indexed by pid and tid. The current scan fills another
+ * table and only reports processes whose own binding, or the binding of one
+ * of its threads, changed. Tables are swapped after each scan, their cpusets
+ * are kept allocated for reuse.
+ */
+
+struct hwloc_ps_watch_entry_s {
+  long pid;
+  long tid; /* -1 for the process itself */
+  unsigned nr_threads; /* for the process itself */
+  int used;
+  hwloc_bitmap_t cpuset;
+};
+
+struct hwloc_ps_watch_table_s {
+  unsigned size; /* power of 2 */
+  unsigned count;
+  struct hwloc_ps_watch_entry_s *entries;
+};
+
+struct hwloc_ps_watch_s {
+  struct hwloc_ps_watch_table_s tables[2];
+  unsigned current; /* table being filled by the current scan */
+  const char *pidcmd;
+};
+
+static unsigned
+hwloc_ps_watch_hash(long pid, long tid, unsigned size)
+{
+  unsigned long key = (unsigned long) pid * 2654435761UL + (unsigned long) tid;
+  return (unsigned) ((key ^ (key >> 16)) & (size-1));
+}
+
+static struct hwloc_ps_watch_entry_s *
+hwloc_ps_watch_find(struct hwloc_ps_watch_table_s *table, long pid, long tid)
+{
+  unsigned i;
+  if (!table->size)
+    return NULL;
+  for(i = hwloc_ps_watch_hash(pid, tid, table->size); table->entries[i].used; i = (i+1) & (table->size-1))
+    if (table->entries[i].pid == pid && table->entries[i].tid == tid)
+      return &table->entries[i];
+  return NULL;
+}
+
+static int
+hwloc_ps_watch_grow(struct hwloc_ps_watch_table_s *table)
+{
+  unsigned new_size = table->size ? 2*table->size : 1024;
+  struct hwloc_ps_watch_entry_s *new_entries;
+  unsigned i, j;
+
+  new_entries = calloc(new_size, sizeof(*new_entries));
+  if (!new_entries)
+    return -1;
+  for(i=0; i<table->size; i++) {
+    struct hwloc_ps_watch_entry_s *entry = &table->entries[i];
+    if (entry->used) {
+      for(j = hwloc_ps_watch_hash(entry->pid, entry->tid, new_size); new_entries[j].used; j = (j+1) & (new_size-1));
+      new_entries[j] = *entry;
+    } else {
+      hwloc_bitmap_free(entry->cpuset);
+    }
+  }
+  free(table->entries);
+  table->entries = new_entries;
+  table->size = new_size;
+  return 0;
+}
+
+static struct hwloc_ps_watch_entry_s *
+hwloc_ps_watch_insert(struct hwloc_ps_watch_table_s *table, long pid, long tid, hwloc_const_bitmap_t cpuset)
+{
+  struct hwloc_ps_watch_entry_s *entry;
+  unsigned i;
+
+  if (2*(table->count+1) > table->size)
+    if (hwloc_ps_watch_grow(table) < 0)
+      return NULL;
+
+  for(i = hwloc_ps_watch_hash(pid, tid, table->size); table->entries[i].used; i = (i+1) & (table->size-1));
+  entry = &table->entries[i];
+  if (!entry->cpuset) {
+    entry->cpuset = hwloc_bitmap_alloc();
+    if (!entry->cpuset)
+      return NULL;
+  }
+  hwloc_bitmap_copy(entry->cpuset, cpuset);
+  entry->pid = pid;
+  entry->tid = tid;
+  entry->nr_threads = 0;
+  entry->used = 1;
+  table->count++;
+  return entry;
+}
+
+static void
+hwloc_ps_watch_clear(struct hwloc_ps_watch_table_s *table)
+{
+  unsigned i;
+  for(i=0; i<table->size; i++)
+    table->entries[i].used = 0;
+  table->count = 0;
+}
+
+static void
+hwloc_ps_watch_destroy(struct hwloc_ps_watch_s *watch)
+{
+  unsigned i, j;
+  for(i=0; i<2; i++) {
+    for(j=0; j<watch->tables[i].size; j++)
+      hwloc_bitmap_free(watch->tables[i].entries[j].cpuset);
+    free(watch->tables[i].entries);
+  }
+}
+
+/* record the binding of a process or thread, and return 1 if it changed since the previous scan */
+static int
+hwloc_ps_watch_update(struct hwloc_ps_watch_s *watch, long pid, long tid, hwloc_const_bitmap_t cpuset, unsigned nr_threads)
+{
+  struct hwloc_ps_watch_entry_s *old, *new;
+
+  new = hwloc_ps_watch_insert(&watch->tables[watch->current], pid, tid, cpuset);
+  if (new)
+    new->nr_threads = nr_threads;
+  old = hwloc_ps_watch_find(&watch->tables[!watch->current], pid, tid);
+  return !old || old->nr_threads != nr_threads || !hwloc_bitmap_isequal(old->cpuset, cpuset);
+}
+
+static void
+watch_process(struct hwloc_ps_scan_s *scan, struct hwloc_ps_process_s *proc, void *data)
+{
+  struct hwloc_ps_watch_s *watch = data;
+  int changed;
+  unsigned i;
+
+  if (!proc->show) {
+    /* not recorded, but report processes that were shown by the previous scan and are not bound anymore */
+    if (hwloc_ps_watch_find(&watch->tables[!watch->current], proc->pid_number, -1))
+      print_process(scan, proc, (void *) watch->pidcmd);
+    return;
+  }
+
+  changed = hwloc_ps_watch_update(watch, proc->pid_number, -1, proc->cpuset, proc->nr_threads);
+  for(i=0; i<proc->nr_threads; i++)
+    changed |= hwloc_ps_watch_update(watch, proc->pid_number, proc->threads[i].tid, proc->threads[i].cpuset, 0);
+
+  if (changed)
+    print_process(scan, proc, (void *) watch->pidcmd);
+}
+
+static int
+hwloc_ps_watch_processes(struct hwloc_ps_scan_s *scan, const char *pidcmd)
+{
+  struct hwloc_ps_watch_s watch;
+  struct timespec delay;
+  unsigned scans = 0;
+  char *env;
+  int err;
+
+  /* only for testing, stop after the given number of scans */
+  env = getenv("HWLOC_PS_WATCH_SCANS");
+  if (env)
+    scans = atoi(env);
+
+  memset(&watch, 0, sizeof(watch));
+  watch.pidcmd = pidcmd;
+  /* unbound processes are needed for reporting processes whose binding was reset */
+  scan->report_unshown = 1;
+
+  delay.tv_sec = (time_t) watch_interval;
+  delay.tv_nsec = (long) ((watch_interval - (double) delay.tv_sec) * 1000000000.);
+
+  while (1) {
+    err = hwloc_ps_scan_processes(scan, watch_process, &watch);
+    if (err < 0)
+      break;
+    fflush(stdout);
+
+    /* the current state becomes the previous one */
+    watch.current = !watch.current;
+    hwloc_ps_watch_clear(&watch.tables[watch.current]);
+
+    if (scans && !--scans)
+      break;
+    nanosleep(&delay, NULL);
+  }
+
+  hwloc_ps_watch_destroy(&watch);
+  return err;
+}
+
+/***************************
+ * Summary of bound and running tasks per object
+ *
+ * Each task (process, or thread of multithreaded processes with -t) is
+ * counted as bound in all objects containing its binding (unless it is not
+ * bound at all), and as running in all objects containing one of the PUs
+ * where it last ran.
+ */
+
+struct hwloc_ps_summary_s {
+  hwloc_topology_t topology;
+  unsigned depth;
+  /* per-depth arrays indexed by logical index, NULL for depths that are not summarized */
+  unsigned **bound;
+  unsigned **running;
+  unsigned **stamp; /* last task counted as running in each object */
+  unsigned task;
+  hwloc_obj_t *pus; /* PU objects indexed by os_index */
+  unsigned nr_pus;
+};
+
+static int
+hwloc_ps_summary_type(hwloc_obj_type_t type)
+{
+  return type == HWLOC_OBJ_NUMANODE
+    || type == HWLOC_OBJ_PACKAGE
+    || type == HWLOC_OBJ_L3CACHE
+    || type == HWLOC_OBJ_CORE;
+}
+
+static int
+hwloc_ps_summary_init(struct hwloc_ps_summary_s *sum, hwloc_topology_t topology)
+{
+  hwloc_obj_t pu;
+  int last;
+  unsigned i;
+
+  memset(sum, 0, sizeof(*sum));
+  sum->topology = topology;
+  sum->depth = hwloc_topology_get_depth(topology);
+  sum->bound = calloc(sum->depth, sizeof(*sum->bound));
+  sum->running = calloc(sum->depth, sizeof(*sum->running));
+  sum->stamp = calloc(sum->depth, sizeof(*sum->stamp));
+  if (!sum->bound || !sum->running || !sum->stamp)
+    return -1;
+
+  for(i=0; i<sum->depth; i++) {
+    unsigned nbobjs = hwloc_get_nbobjs_by_depth(topology, i);
+    if (!nbobjs || !hwloc_ps_summary_type(hwloc_get_depth_type(topology, i)))
+      continue;
+    sum->bound[i] = calloc(nbobjs, sizeof(unsigned));
+    sum->running[i] = calloc(nbobjs, sizeof(unsigned));
+    sum->stamp[i] = calloc(nbobjs, sizeof(unsigned));
+    if (!sum->bound[i] || !sum->running[i] || !sum->stamp[i])
+      return -1;
+  }
+
+  last = hwloc_bitmap_last(hwloc_topology_get_topology_cpuset(topology));
+  sum->nr_pus = last + 1;
+  sum->pus = calloc(sum->nr_pus, sizeof(*sum->pus));
+  if (!sum->pus)
+    return -1;
+  pu = NULL;
+  while ((pu = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_PU, pu)) != NULL)
+    if (pu->os_index < sum->nr_pus)
+      sum->pus[pu->os_index] = pu;
+  return 0;
+}
+
+static void
+hwloc_ps_summary_reset(struct hwloc_ps_summary_s *sum)
+{
+  unsigned i;
+  for(i=0; i<sum->depth; i++) {
+    unsigned nbobjs = hwloc_get_nbobjs_by_depth(sum->topology, i);
+    if (!sum->bound[i])
+      continue;
+    memset(sum->bound[i], 0, nbobjs * sizeof(unsigned));
+    memset(sum->running[i], 0, nbobjs * sizeof(unsigned));
+    memset(sum->stamp[i], 0, nbobjs * sizeof(unsigned));
+  }
+  sum->task = 0;
+}
+
+static void
+hwloc_ps_summary_destroy(struct hwloc_ps_summary_s *sum)
+{
+  unsigned i;
+  for(i=0; i<sum->depth; i++) {
+    if (sum->bound)
+      free(sum->bound[i]);
+    if (sum->running)
+      free(sum->running[i]);
+    if (sum->stamp)
+      free(sum->stamp[i]);
+  }
+  free(sum->bound);
+  free(sum->running);
+  free(sum->stamp);
+  free(sum->pus);
+}
+
+static void
+hwloc_ps_summary_add_task(struct hwloc_ps_summary_s *sum, hwloc_const_bitmap_t topocpuset,
+			  hwloc_const_bitmap_t cpuset, hwloc_const_bitmap_t last_cpuset)
+{
+  hwloc_obj_t obj;
+  unsigned pu;
+
+  sum->task++;
+
+  if (!hwloc_bitmap_iszero(cpuset) && !hwloc_bitmap_isequal(cpuset, topocpuset))
+    for(obj = hwloc_get_obj_covering_cpuset(sum->topology, cpuset); obj; obj = obj->parent)
+      if (sum->bound[obj->depth])
+	sum->bound[obj->depth][obj->logical_index]++;
+
+  hwloc_bitmap_foreach_begin(pu, last_cpuset) {
+    if (pu >= sum->nr_pus)
+      break;
+    /* stop at the first ancestor where this task was already counted */
+    for(obj = sum->pus[pu]; obj; obj = obj->parent)
+      if (sum->running[obj->depth]) {
+	if (sum->stamp[obj->depth][obj->logical_index] == sum->task)
+	  break;
+	sum->stamp[obj->depth][obj->logical_index] = sum->task;
+	sum->running[obj->depth][obj->logical_index]++;
+      }
+  } hwloc_bitmap_foreach_end();
+}
+
+static void
+summarize_process(struct hwloc_ps_scan_s *scan, struct hwloc_ps_process_s *proc, void *data)
+{
+  struct hwloc_ps_summary_s *sum = data;
+  unsigned i;
+
+  if (proc->nr_threads)
+    for(i=0; i<proc->nr_threads; i++)
+      hwloc_ps_summary_add_task(sum, scan->topocpuset, proc->threads[i].cpuset, proc->threads[i].last_cpuset);
+  else
+    hwloc_ps_summary_add_task(sum, scan->topocpuset, proc->cpuset, proc->last_cpuset);
+}
+
+static void
+hwloc_ps_summary_print(struct hwloc_ps_summary_s *sum)
+{
+  unsigned i, j;
+
+  for(i=0; i<sum->depth; i++) {
+    unsigned nbobjs = hwloc_get_nbobjs_by_depth(sum->topology, i);
+    if (!sum->bound[i])
+      continue;
+    for(j=0; j<nbobjs; j++) {
+      hwloc_obj_t obj = hwloc_get_obj_by_depth(sum->topology, i, j);
+      unsigned idx = logical ? obj->logical_index : obj->os_index;
+      unsigned nbpus = hwloc_bitmap_weight(obj->cpuset);
       char type[64];
-      unsigned idx;
-      hwloc_obj_t obj = hwloc_get_first_largest_obj_inside_cpuset(topology, remaining);
-      /* don't show a cache if there's something equivalent and nicer */
-      while (hwloc_obj_type_is_cache(obj->type) && obj->arity == 1)
-	obj = obj->first_child;
+
       hwloc_obj_type_snprintf(type, sizeof(type), obj, 1);
-      idx = logical ? obj->logical_index : obj->os_index;
-      if (idx == (unsigned) -1)
-        printf("%s%s", first ? "" : " ", type);
-      else
-        printf("%s%s:%u", first ? "" : " ", type, idx);
-      hwloc_bitmap_andnot(remaining, remaining, obj->cpuset);
-      first = 0;
+      if (json_output) {
+	printf("{");
+	if (watch_interval)
+	  printf("\"time\": %ld, ", (long) time(NULL));
+	printf("\"type\": \"%s\", ", type);
+	if (idx != (unsigned) -1)
+	  printf("\"index\": %u, ", idx);
+	printf("\"pus\": %u, \"bound\": %u, \"running\": %u}\n",
+	       nbpus, sum->bound[i][j], sum->running[i][j]);
+      } else {
+	if (idx == (unsigned) -1)
+	  printf("%s", type);
+	else
+	  printf("%s:%u", type, idx);
+	printf("\tPUs %u\tbound %u\trunning %u%s\n",
+	       nbpus, sum->bound[i][j], sum->running[i][j],
+	       sum->bound[i][j] > nbpus ? "\toversubscribed" : "");
+      }
     }
-    hwloc_bitmap_free(remaining);
   }
+}
 
-  printf("\t\t%s%s%s\n", name, pidoutput ? "\t" : "", pidoutput ? pidoutput : "");
+static int
+hwloc_ps_summarize_processes(struct hwloc_ps_scan_s *scan)
+{
+  struct hwloc_ps_summary_s sum;
+  struct timespec delay;
+  int err;
+
+  err = hwloc_ps_summary_init(&sum, scan->topology);
+  if (err < 0)
+    goto out;
+
+  delay.tv_sec = (time_t) watch_interval;
+  delay.tv_nsec = (long) ((watch_interval - (double) delay.tv_sec) * 1000000000.);
+
+  while (1) {
+    err = hwloc_ps_scan_processes(scan, summarize_process, &sum);
+    if (err < 0)
+      break;
+    hwloc_ps_summary_print(&sum);
+    if (!watch_interval)
+      break;
+    /* separate successive summaries */
+    if (!json_output)
+      printf("\n");
+    fflush(stdout);
+    hwloc_ps_summary_reset(&sum);
+    nanosleep(&delay, NULL);
+  }
+
+ out:
+  hwloc_ps_summary_destroy(&sum);
+  return err;
 }
 
 int main(int argc, char *argv[])
 {
   const struct hwloc_topology_support *support;
   hwloc_topology_t topology;
-  hwloc_const_bitmap_t topocpuset;
-  hwloc_bitmap_t cpuset;
+  struct hwloc_ps_scan_s scan;
   unsigned long flags = 0;
-  DIR *dir;
-  struct dirent *dirent;
-  int show_all = 0;
-  int show_threads = 0;
-  int get_last_cpu_location = 0;
+  const char *fsroot = NULL;
   char *callname;
   char *pidcmd = NULL;
   int err;
@@ -122,6 +1128,21 @@ int main(int argc, char *argv[])
 #else
       fprintf (stderr, "Listing threads is currently only supported on Linux\n");
 #endif
+    } else if (!strcmp(argv[0], "-j") || !strcmp(argv[0], "--jobs")) {
+      char *end;
+      long n;
+      if (argc < 2) {
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      n = strtol(argv[1], &end, 10);
+      if (*end || n <= 0) {
+	fprintf(stderr, "Invalid number of jobs %s\n", argv[1]);
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      nr_jobs = (unsigned) n;
+      opt = 1;
     } else if (!strcmp (argv[0], "--whole-system")) {
       flags |= HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM;
     } else if (!strcmp (argv[0], "--pid-cmd")) {
@@ -131,6 +1152,23 @@ int main(int argc, char *argv[])
       }
       pidcmd = argv[1];
       opt = 1;
+    } else if (!strcmp (argv[0], "--watch")) {
+      char *end;
+      if (argc < 2) {
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      watch_interval = strtod(argv[1], &end);
+      if (*end || !(watch_interval > 0.)) {
+	fprintf(stderr, "Invalid watch interval %s\n", argv[1]);
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      opt = 1;
+    } else if (!strcmp (argv[0], "--json")) {
+      json_output = 1;
+    } else if (!strcmp (argv[0], "--summary")) {
+      summary = 1;
     } else {
       fprintf (stderr, "Unrecognized option: %s\n", argv[0]);
       usage (callname, stderr);
@@ -140,6 +1178,16 @@ int main(int argc, char *argv[])
     argv += opt+1;
   }
 
+#ifndef hwloc_thread_t
+  nr_jobs = 1;
+#endif
+
+  if (summary) {
+    /* count all tasks, with both their binding and last CPU location */
+    show_all = 1;
+    get_last_cpu_location = 0;
+  }
+
   err = hwloc_topology_init(&topology);
   if (err)
     goto out;
@@ -150,186 +1198,42 @@ int main(int argc, char *argv[])
   if (err)
     goto out_with_topology;
 
-  support = hwloc_topology_get_support(topology);
-
-  if (get_last_cpu_location) {
-    if (!support->cpubind->get_proc_last_cpu_location)
-      goto out_with_topology;
-  } else {
-    if (!support->cpubind->get_proc_cpubind)
-      goto out_with_topology;
-  }
-
-  topocpuset = hwloc_topology_get_topology_cpuset(topology);
-
-  dir  = opendir("/proc");
-  if (!dir)
-    goto out_with_topology;
-
-  cpuset = hwloc_bitmap_alloc();
-  if (!cpuset)
-    goto out_with_dir;
-
-  while ((dirent = readdir(dir))) {
-    long pid_number;
-    hwloc_pid_t pid;
-    char pidoutput[1024];
-    char *end;
-    char name[64] = "";
-    /* management of threads */
-    unsigned boundthreads = 0, i;
-    long *tids = NULL; /* NULL if process is not threaded */
-    hwloc_bitmap_t *tidcpusets = NULL;
-
-    pid_number = strtol(dirent->d_name, &end, 10);
-    if (*end)
-      /* Not a number */
-      continue;
-
-    pid = hwloc_pid_from_number(pid_number, 0);
-
 #ifdef HWLOC_LINUX_SYS
-    {
-      unsigned pathlen = 6 + strlen(dirent->d_name) + 1 + 7 + 1;
-      char *path;
-      int file;
-      ssize_t n;
-
-      path = malloc(pathlen);
-      snprintf(path, pathlen, "/proc/%s/cmdline", dirent->d_name);
-      file = open(path, O_RDONLY);
-      free(path);
-
-      if (file >= 0) {
-        n = read(file, name, sizeof(name) - 1);
-        close(file);
-
-        if (n <= 0)
-          /* Ignore kernel threads and errors */
-          continue;
-
-        name[n] = 0;
-      }
-    }
-#endif /* HWLOC_LINUX_SYS */
+  /* when the topology comes from another Linux filesystem root, read its processes too */
+  fsroot = getenv("HWLOC_FSROOT");
+  if (fsroot && hwloc_topology_is_thissystem(topology))
+    fsroot = NULL;
+#endif
 
-    if (show_threads) {
-#ifdef HWLOC_LINUX_SYS
-      /* check if some threads must be displayed */
-      unsigned pathlen = 6 + strlen(dirent->d_name) + 1 + 4 + 1;
-      char *path;
-      DIR *taskdir;
-
-      path = malloc(pathlen);
-      snprintf(path, pathlen, "/proc/%s/task", dirent->d_name);
-      taskdir = opendir(path);
-      if (taskdir) {
-	struct dirent *taskdirent;
-	long tid;
-	unsigned n = 0;
-	/* count threads */
-	while ((taskdirent = readdir(taskdir))) {
-	  tid = strtol(taskdirent->d_name, &end, 10);
-	  if (*end)
-	    /* Not a number */
-	    continue;
-	  n++;
-	}
-	if (n > 1) {
-	  /* if there's more than one thread, see if some are bound */
-	  tids = malloc(n * sizeof(*tids));
-	  tidcpusets = calloc(n+1, sizeof(*tidcpusets));
-	  if (tids && tidcpusets) {
-	    /* reread the directory but gather info now */
-	    rewinddir(taskdir);
-	    i = 0;
-	    while ((taskdirent = readdir(taskdir))) {
-	      tid = strtol(taskdirent->d_name, &end, 10);
-	      if (*end)
-		/* Not a number */
-		continue;
-	      if (get_last_cpu_location) {
-		if (hwloc_linux_get_tid_last_cpu_location(topology, tid, cpuset))
-		  continue;
-	      } else {
-		if (hwloc_linux_get_tid_cpubind(topology, tid, cpuset))
-		  continue;
-	      }
-	      hwloc_bitmap_and(cpuset, cpuset, topocpuset);
-	      tids[i] = tid;
-	      tidcpusets[i] = hwloc_bitmap_dup(cpuset);
-	      i++;
-	      if (hwloc_bitmap_iszero(cpuset))
-		continue;
-	      if (hwloc_bitmap_isequal(cpuset, topocpuset) && !show_all)
-		continue;
-	      boundthreads++;
-	    }
-	  } else {
-	    /* failed to alloc, behave as if there were no threads */
-	    free(tids); tids = NULL;
-	    free(tidcpusets); tidcpusets = NULL;
-	  }
-	}
-	closedir(taskdir);
-      }
-      free(path);
-#endif /* HWLOC_LINUX_SYS */
-    }
+  support = hwloc_topology_get_support(topology);
 
+  /* bindings are read from files under HWLOC_FSROOT, no need for binding support */
+  if (!fsroot) {
     if (get_last_cpu_location) {
-      if (hwloc_get_proc_last_cpu_location(topology, pid, cpuset, 0))
-	continue;
+      if (!support->cpubind->get_proc_last_cpu_location)
+	goto out_with_topology;
     } else {
-      if (hwloc_get_proc_cpubind(topology, pid, cpuset, 0))
-	continue;
-    }
-
-    hwloc_bitmap_and(cpuset, cpuset, topocpuset);
-    if (hwloc_bitmap_iszero(cpuset))
-      continue;
-
-    /* don't print anything if the process isn't bound and if no threads are bound and if not showing all */
-    if (hwloc_bitmap_isequal(cpuset, topocpuset) && (!tids || !boundthreads) && !show_all)
-      continue;
-
-    pidoutput[0] = '\0';
-    if (pidcmd) {
-      char *cmd;
-      FILE *file;
-      cmd = malloc(strlen(pidcmd)+1+5+2+1);
-      sprintf(cmd, "%s %u", pidcmd, pid);
-      file = popen(cmd, "r");
-      if (file) {
-	if (fgets(pidoutput, sizeof(pidoutput), file)) {
-	  end = strchr(pidoutput, '\n');
-	  if (end)
-	    *end = '\0';
-	}
-	pclose(file);
-      }
-      free(cmd);
+      if (!support->cpubind->get_proc_cpubind)
+	goto out_with_topology;
     }
-
-    /* print the process */
-    print_task(topology, pid_number, name, cpuset, pidoutput[0] == '\0' ? NULL : pidoutput, 0);
-    if (tids)
-      /* print each tid we found (it's tidcpuset isn't NULL anymore) */
-      for(i=0; tidcpusets[i] != NULL; i++) {
-	print_task(topology, tids[i], "", tidcpusets[i], NULL, 1);
-	hwloc_bitmap_free(tidcpusets[i]);
-      }
-
-    /* free threads stuff */
-    free(tidcpusets);
-    free(tids);
   }
 
-  err = 0;
-  hwloc_bitmap_free(cpuset);
+  err = hwloc_ps_scan_init(&scan, topology, fsroot);
+  if (err)
+    goto out_with_scan;
 
- out_with_dir:
-  closedir(dir);
+  if (summary)
+    err = hwloc_ps_summarize_processes(&scan);
+  else if (watch_interval)
+    err = hwloc_ps_watch_processes(&scan, pidcmd);
+  else
+    err = hwloc_ps_scan_processes(&scan, print_process, pidcmd);
+  if (err)
+    /* /proc is missing, nothing to report */
+    err = 0;
+
+ out_with_scan:
+  hwloc_ps_scan_destroy(&scan);
  out_with_topology:
   hwloc_topology_destroy(topology);
  out:
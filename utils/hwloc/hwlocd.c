@@ -0,0 +1,693 @@
+/*
+ * Copyright © 2016 Inria.  All rights reserved.
+ * See COPYING in top-level directory.
+ */
+
+#include <private/autogen/config.h>
+#include <hwloc.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "misc.h"
+#include "hwloc-calc.h"
+
+/* maximal number of simultaneously connected clients */
+#define HWLOCD_MAX_CLIENTS 64
+/* maximal length of a request line */
+#define HWLOCD_LINE_MAX 4096
+
+/* whether the credentials of clients may be checked before reporting the binding of a process */
+#if defined(HWLOC_LINUX_SYS) && defined(SO_PEERCRED)
+#define HWLOCD_HAVE_PEERCRED 1
+#endif
+
+static int verbose = 0;
+static mode_t socket_mode = 0600;
+static volatile sig_atomic_t reload_requested = 0;
+static volatile sig_atomic_t exit_requested = 0;
+
+void usage(const char *callname, FILE *where)
+{
+  fprintf(where, "Usage: %s [options] [<socket path>]\n", callname);
+  fprintf(where, "  Keeps the topology loaded and serves it to clients over a Unix socket\n");
+  fprintf(where, "  The socket path defaults to the HWLOC_DAEMON_SOCKET environment variable\n");
+  fprintf(where, "Options:\n");
+  fprintf(where, "  --whole-system   Do not consider administration limitations\n");
+  fprintf(where, "  --watch <n>      Check for CPU and NUMA node changes every <n> seconds\n");
+  fprintf(where, "                   (5 by default, 0 to disable)\n");
+  fprintf(where, "  --mode <mode>    Set the permissions of the socket (octal, 0600 by default)\n");
+  fprintf(where, "Input topology options:\n");
+  fprintf(where, "  --input <XML file>\n");
+  fprintf(where, "  -i <XML file>    Read topology from XML file <path>\n");
+  fprintf(where, "  --input <directory>\n");
+  fprintf(where, "  -i <directory>   Read topology from chroot containing the /proc and /sys\n");
+  fprintf(where, "                   of another system\n");
+  fprintf(where, "  --input \"n:2 2\"\n");
+  fprintf(where, "  -i \"n:2 2\"       Simulate a fake hierarchy, here with 2 NUMA nodes of 2\n");
+  fprintf(where, "                   processors\n");
+  fprintf(where, "  --input-format <format>\n");
+  fprintf(where, "  --if <format>    Enforce input format among ");
+  hwloc_utils_input_format_usage(where, 0);
+  fprintf(where, "Miscellaneous options:\n");
+  fprintf(where, "  -v --verbose     Show the handled requests\n");
+  fprintf(where, "  --version        Report version and exit\n");
+}
+
+/***************************
+ * Topology management
+ */
+
+struct hwlocd_topology_s {
+  hwloc_topology_t topology;
+  unsigned depth;
+  /* the XML export sent to clients, without its terminating NUL */
+  char *xmlbuffer;
+  int xmllen;
+};
+
+static char *input = NULL;
+static enum hwloc_utils_input_format input_format = HWLOC_UTILS_INPUT_DEFAULT;
+static unsigned long flags = 0;
+
+/* load a new topology, only replace the current one on success */
+static int
+hwlocd_load(struct hwlocd_topology_s *current, const char *callname)
+{
+  struct hwlocd_topology_s new;
+  int buflen;
+
+  hwloc_topology_init(&new.topology);
+  /* keep everything, clients apply their own filters when importing the XML */
+  hwloc_topology_set_all_types_filter(new.topology, HWLOC_TYPE_FILTER_KEEP_ALL);
+  hwloc_topology_set_flags(new.topology, flags);
+  if (input) {
+    int err = hwloc_utils_enable_input_format(new.topology, input, &input_format, verbose, callname);
+    if (err)
+      goto out_with_topology;
+  }
+  if (hwloc_topology_load(new.topology) < 0) {
+    fprintf(stderr, "Failed to load the topology (%s)\n", strerror(errno));
+    goto out_with_topology;
+  }
+  if (hwloc_topology_export_xmlbuffer(new.topology, &new.xmlbuffer, &buflen, 0) < 0) {
+    fprintf(stderr, "Failed to export the topology to XML (%s)\n", strerror(errno));
+    goto out_with_topology;
+  }
+  new.xmllen = buflen-1;
+  new.depth = hwloc_topology_get_depth(new.topology);
+
+  if (current->topology) {
+    hwloc_free_xmlbuffer(current->topology, current->xmlbuffer);
+    hwloc_topology_destroy(current->topology);
+  }
+  *current = new;
+  if (verbose)
+    printf("Loaded topology with %d PUs (%d bytes of XML)\n",
+	   hwloc_get_nbobjs_by_type(new.topology, HWLOC_OBJ_PU), new.xmllen);
+  return 0;
+
+ out_with_topology:
+  hwloc_topology_destroy(new.topology);
+  return -1;
+}
+
+/* the online CPUs and NUMA nodes change on hotplug, reload when they do */
+static const char *watched_files[] = {
+  "/sys/devices/system/cpu/online",
+  "/sys/devices/system/node/online"
+};
+#define HWLOCD_NR_WATCHED (sizeof(watched_files)/sizeof(*watched_files))
+
+static int
+hwlocd_watch(char (*contents)[256])
+{
+  int changed = 0;
+  unsigned i;
+
+  for(i = 0; i < HWLOCD_NR_WATCHED; i++) {
+    char buffer[256];
+    ssize_t ret = -1;
+    int fd = open(watched_files[i], O_RDONLY);
+    if (fd >= 0) {
+      ret = read(fd, buffer, sizeof(buffer)-1);
+      close(fd);
+    }
+    buffer[ret > 0 ? ret : 0] = '\0';
+    if (strcmp(buffer, contents[i])) {
+      strcpy(contents[i], buffer);
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+/* monotonic time in milliseconds, only used for scheduling hotplug checks */
+static unsigned long
+hwlocd_now_ms(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+  struct timespec ts;
+  if (!clock_gettime(CLOCK_MONOTONIC, &ts))
+    return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+#elif defined HAVE_GETTIMEOFDAY
+  struct timeval tv;
+  if (!gettimeofday(&tv, NULL))
+    return tv.tv_sec * 1000UL + tv.tv_usec / 1000;
+#endif
+  return time(NULL) * 1000UL;
+}
+
+/***************************
+ * Requests
+ */
+
+struct hwlocd_client_s {
+  int fd;
+  size_t len;
+  char line[HWLOCD_LINE_MAX];
+};
+
+static int
+hwlocd_write(int fd, const char *buffer, size_t len)
+{
+  while (len) {
+    ssize_t ret = write(fd, buffer, len);
+    if (ret < 0) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    buffer += ret;
+    len -= ret;
+  }
+  return 0;
+}
+
+static int
+hwlocd_reply(int fd, const char *payload, size_t len)
+{
+  char header[32];
+  snprintf(header, sizeof(header), "OK %lu\n", (unsigned long) len);
+  if (hwlocd_write(fd, header, strlen(header)) < 0)
+    return -1;
+  return hwlocd_write(fd, payload, len);
+}
+
+static int
+hwlocd_error(int fd, const char *message)
+{
+  char buffer[HWLOCD_LINE_MAX];
+  snprintf(buffer, sizeof(buffer), "ERR %s\n", message);
+  return hwlocd_write(fd, buffer, strlen(buffer));
+}
+
+static int
+hwlocd_reply_set(int fd, hwloc_const_bitmap_t set)
+{
+  char *string;
+  int err;
+  if (hwloc_bitmap_asprintf(&string, set) < 0)
+    return hwlocd_error(fd, "out of memory");
+  err = hwlocd_reply(fd, string, strlen(string));
+  free(string);
+  return err;
+}
+
+static int
+hwlocd_reply_distances(int fd, struct hwlocd_topology_s *topo)
+{
+  struct hwloc_distances_s *dist[64];
+  unsigned nr = sizeof(dist)/sizeof(*dist);
+  char *buffer = NULL;
+  size_t len = 0, size = 0;
+  unsigned i, j, k;
+  int err;
+
+  if (hwloc_distances_get(topo->topology, &nr, dist, 0, 0) < 0)
+    return hwlocd_error(fd, strerror(errno));
+  if (nr > sizeof(dist)/sizeof(*dist))
+    nr = sizeof(dist)/sizeof(*dist);
+
+  for(i = 0; i < nr; i++) {
+    unsigned n = dist[i]->nbobjs;
+    /* header line, objects line, and one line per object, with up to 21 chars per value */
+    size_t needed = 64 + n * 32 + n * n * 21;
+    if (len + needed > size) {
+      char *tmp;
+      size = len + needed;
+      tmp = realloc(buffer, size);
+      if (!tmp)
+	break;
+      buffer = tmp;
+    }
+    len += sprintf(buffer+len, "%u %s kind=%lu\n",
+		   n, hwloc_type_name(dist[i]->objs[0]->type), dist[i]->kind);
+    for(j = 0; j < n; j++)
+      len += sprintf(buffer+len, "%s%u", j ? " " : "", dist[i]->objs[j]->logical_index);
+    buffer[len++] = '\n';
+    for(j = 0; j < n; j++) {
+      for(k = 0; k < n; k++)
+	len += sprintf(buffer+len, "%s%llu", k ? " " : "", (unsigned long long) dist[i]->values[j*n+k]);
+      buffer[len++] = '\n';
+    }
+  }
+
+  err = hwlocd_reply(fd, buffer ? buffer : "", len);
+  for(i = 0; i < nr; i++)
+    hwloc_distances_release(topo->topology, dist[i]);
+  free(buffer);
+  return err;
+}
+
+/* convert the given locations into a cpuset or nodeset */
+static int
+hwlocd_reply_locations(int fd, struct hwlocd_topology_s *topo, char *locations, int nodeset_output)
+{
+  hwloc_bitmap_t set = hwloc_bitmap_alloc();
+  char *token, *saveptr;
+  int err;
+
+  for(token = strtok_r(locations, " ", &saveptr);
+      token;
+      token = strtok_r(NULL, " ", &saveptr)) {
+    if (hwloc_calc_process_arg(topo->topology, topo->depth, token, 1 /* logical */, set,
+			       0, nodeset_output, -1 /* quiet */) < 0) {
+      char message[HWLOCD_LINE_MAX];
+      snprintf(message, sizeof(message), "invalid location %s", token);
+      hwloc_bitmap_free(set);
+      return hwlocd_error(fd, message);
+    }
+  }
+  err = hwlocd_reply_set(fd, set);
+  hwloc_bitmap_free(set);
+  return err;
+}
+
+static int
+hwlocd_reply_cpubind(int fd, struct hwlocd_topology_s *topo, const char *arg)
+{
+  hwloc_bitmap_t set;
+  char *end;
+  long pid;
+  int err;
+
+  pid = strtol(arg, &end, 10);
+  if (!*arg || *end || pid <= 0)
+    return hwlocd_error(fd, "invalid pid");
+
+#ifdef HWLOCD_HAVE_PEERCRED
+  /* when the socket is shared with other users, only root may query their processes */
+  {
+    struct ucred cred;
+    socklen_t credlen = sizeof(cred);
+    char procpath[32];
+    struct stat st;
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) < 0)
+      return hwlocd_error(fd, strerror(errno));
+    snprintf(procpath, sizeof(procpath), "/proc/%ld", pid);
+    if (stat(procpath, &st) < 0)
+      return hwlocd_error(fd, strerror(errno));
+    if (cred.uid && cred.uid != st.st_uid)
+      return hwlocd_error(fd, strerror(EPERM));
+  }
+#else
+  /* clients cannot be checked, only the owner of a private socket may query processes */
+  if (socket_mode & 0077)
+    return hwlocd_error(fd, "cpubind is not supported on shared sockets on this system");
+#endif
+
+  set = hwloc_bitmap_alloc();
+  if (hwloc_get_proc_cpubind(topo->topology, (hwloc_pid_t) pid, set, 0) < 0)
+    err = hwlocd_error(fd, strerror(errno));
+  else
+    err = hwlocd_reply_set(fd, set);
+  hwloc_bitmap_free(set);
+  return err;
+}
+
+static int
+hwlocd_handle_request(int fd, struct hwlocd_topology_s *topo, char *line)
+{
+  char *arg;
+
+  if (verbose)
+    printf("Request on fd %d: %s\n", fd, line);
+
+  arg = strchr(line, ' ');
+  if (arg) {
+    *arg = '\0';
+    arg++;
+    while (*arg == ' ')
+      arg++;
+  } else {
+    arg = line + strlen(line);
+  }
+
+  if (!strcmp(line, "xml"))
+    return hwlocd_reply(fd, topo->xmlbuffer, topo->xmllen);
+  else if (!strcmp(line, "cpuset"))
+    return hwlocd_reply_locations(fd, topo, arg, 0);
+  else if (!strcmp(line, "nodeset"))
+    return hwlocd_reply_locations(fd, topo, arg, 1);
+  else if (!strcmp(line, "cpubind"))
+    return hwlocd_reply_cpubind(fd, topo, arg);
+  else if (!strcmp(line, "distances"))
+    return hwlocd_reply_distances(fd, topo);
+  else
+    return hwlocd_error(fd, "unknown request");
+}
+
+/* process the complete lines received by a client, return -1 if it must be disconnected */
+static int
+hwlocd_handle_client(struct hwlocd_client_s *client, struct hwlocd_topology_s *topo)
+{
+  ssize_t ret;
+  char *eol;
+
+  ret = read(client->fd, client->line + client->len, sizeof(client->line) - 1 - client->len);
+  if (ret < 0 && errno == EINTR)
+    return 0;
+  if (ret <= 0)
+    return -1;
+  client->len += ret;
+  client->line[client->len] = '\0';
+
+  while ((eol = strchr(client->line, '\n')) != NULL) {
+    size_t consumed = eol + 1 - client->line;
+    *eol = '\0';
+    if (eol > client->line && eol[-1] == '\r')
+      eol[-1] = '\0';
+    if (*client->line && hwlocd_handle_request(client->fd, topo, client->line) < 0)
+      return -1;
+    memmove(client->line, client->line + consumed, client->len - consumed + 1);
+    client->len -= consumed;
+  }
+
+  if (client->len == sizeof(client->line) - 1) {
+    hwlocd_error(client->fd, "request too long");
+    return -1;
+  }
+  return 0;
+}
+
+/***************************
+ * Main loop
+ */
+
+static void
+hwlocd_signal_handler(int sig)
+{
+  if (sig == SIGHUP)
+    reload_requested = 1;
+  else
+    exit_requested = 1;
+}
+
+static int
+hwlocd_listen(const char *path)
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  mode_t oldmask;
+  int fd, err;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path %s is too long\n", path);
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  /* remove a stale socket from a previous instance, but nothing else */
+  if (!lstat(path, &st) && S_ISSOCK(st.st_mode))
+    unlink(path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    fprintf(stderr, "Failed to create socket (%s)\n", strerror(errno));
+    return -1;
+  }
+  /* never let the socket be more accessible than requested, even briefly */
+  oldmask = umask(~socket_mode & 0777);
+  err = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+  umask(oldmask);
+  if (err < 0) {
+    fprintf(stderr, "Failed to bind socket %s (%s)\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  /* the umask may only remove permissions, set the exact mode */
+  if (chmod(path, socket_mode) < 0) {
+    fprintf(stderr, "Failed to change the mode of socket %s (%s)\n", path, strerror(errno));
+    close(fd);
+    unlink(path);
+    return -1;
+  }
+  if (listen(fd, 16) < 0) {
+    fprintf(stderr, "Failed to listen on socket %s (%s)\n", path, strerror(errno));
+    close(fd);
+    unlink(path);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char *argv[])
+{
+  struct hwlocd_topology_s topo;
+  struct hwlocd_client_s *clients[HWLOCD_MAX_CLIENTS];
+  struct pollfd fds[HWLOCD_MAX_CLIENTS+1];
+  char watched[HWLOCD_NR_WATCHED][256];
+  struct sigaction sa;
+  char *callname;
+  const char *path;
+  unsigned nr_clients = 0;
+  unsigned long next_watch = 0;
+  long watch = 5;
+  int listenfd;
+  unsigned i;
+
+  callname = strrchr(argv[0], '/');
+  if (!callname)
+    callname = argv[0];
+  else
+    callname++;
+  /* skip argv[0], handle options */
+  argc--;
+  argv++;
+
+  hwloc_utils_check_api_version(callname);
+
+  path = getenv("HWLOC_DAEMON_SOCKET");
+  /* don't let our own topology loads try to connect to ourself */
+  unsetenv("HWLOC_DAEMON_SOCKET");
+
+  while (argc >= 1 && argv[0][0] == '-') {
+    int opt = 0;
+    if (!strcmp(argv[0], "--whole-system")) {
+      flags |= HWLOC_TOPOLOGY_FLAG_WHOLE_SYSTEM;
+    } else if (!strcmp(argv[0], "--watch")) {
+      char *end;
+      if (argc < 2) {
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      watch = strtol(argv[1], &end, 10);
+      if (*end || watch < 0) {
+	fprintf(stderr, "Invalid watch interval %s\n", argv[1]);
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      opt = 1;
+    } else if (!strcmp(argv[0], "--mode")) {
+      unsigned long mode;
+      char *end;
+      if (argc < 2) {
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      mode = strtoul(argv[1], &end, 8);
+      if (!*argv[1] || *end || mode > 0777) {
+	fprintf(stderr, "Invalid socket mode %s\n", argv[1]);
+	usage(callname, stderr);
+	exit(EXIT_FAILURE);
+      }
+      socket_mode = (mode_t) mode;
+      opt = 1;
+    } else if (hwloc_utils_lookup_input_option(argv, argc, &opt,
+					       &input, &input_format,
+					       callname)) {
+      /* we'll enable later */
+    } else if (!strcmp(argv[0], "-v") || !strcmp(argv[0], "--verbose")) {
+      verbose = 1;
+    } else if (!strcmp(argv[0], "-h") || !strcmp(argv[0], "--help")) {
+      usage(callname, stdout);
+      exit(EXIT_SUCCESS);
+    } else if (!strcmp(argv[0], "--version")) {
+      printf("%s %s\n", callname, HWLOC_VERSION);
+      exit(EXIT_SUCCESS);
+    } else {
+      fprintf(stderr, "Unrecognized option: %s\n", argv[0]);
+      usage(callname, stderr);
+      exit(EXIT_FAILURE);
+    }
+    argc -= opt+1;
+    argv += opt+1;
+  }
+
+  if (argc == 1)
+    path = argv[0];
+  else if (argc > 1)
+    path = NULL;
+  if (!path || !*path) {
+    usage(callname, stderr);
+    exit(EXIT_FAILURE);
+  }
+
+#ifndef HWLOCD_HAVE_PEERCRED
+  if (socket_mode & 0077)
+    fprintf(stderr, "Client credentials cannot be checked on this system, cpubind requests will be refused on socket mode %04o\n",
+	    (unsigned) socket_mode);
+#endif
+
+  /* only watch the local system */
+  if (input)
+    watch = 0;
+  if (watch) {
+    hwlocd_watch(watched);
+    next_watch = hwlocd_now_ms() + watch * 1000UL;
+  }
+
+  topo.topology = NULL;
+  if (hwlocd_load(&topo, callname) < 0)
+    exit(EXIT_FAILURE);
+
+  listenfd = hwlocd_listen(path);
+  if (listenfd < 0) {
+    hwloc_free_xmlbuffer(topo.topology, topo.xmlbuffer);
+    hwloc_topology_destroy(topo.topology);
+    exit(EXIT_FAILURE);
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = hwlocd_signal_handler;
+  sigemptyset(&sa.sa_mask);
+  /* no SA_RESTART, poll() must return on signals */
+  sigaction(SIGHUP, &sa, NULL);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sa.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &sa, NULL);
+
+  if (verbose) {
+    printf("Listening on %s\n", path);
+    fflush(stdout);
+  }
+
+  while (!exit_requested) {
+    int timeout = -1;
+    int ret;
+
+    fds[0].fd = listenfd;
+    fds[0].events = POLLIN;
+    for(i = 0; i < nr_clients; i++) {
+      fds[i+1].fd = clients[i]->fd;
+      fds[i+1].events = POLLIN;
+    }
+
+    /* wake up for the next hotplug check */
+    if (watch) {
+      unsigned long now = hwlocd_now_ms();
+      if (next_watch <= now)
+	timeout = 0;
+      else if (next_watch - now < INT_MAX)
+	timeout = (int) (next_watch - now);
+      else
+	timeout = INT_MAX;
+    }
+
+    ret = poll(fds, nr_clients+1, timeout);
+    if (ret < 0 && errno != EINTR) {
+      fprintf(stderr, "Failed to wait for requests (%s)\n", strerror(errno));
+      break;
+    }
+
+    /* check on schedule even if clients keep the daemon busy */
+    if (watch) {
+      unsigned long now = hwlocd_now_ms();
+      if (now >= next_watch) {
+	next_watch = now + watch * 1000UL;
+	if (hwlocd_watch(watched)) {
+	  if (verbose)
+	    printf("Processors or NUMA nodes changed\n");
+	  reload_requested = 1;
+	}
+      }
+    }
+    if (reload_requested) {
+      reload_requested = 0;
+      hwlocd_load(&topo, callname);
+    }
+    if (ret <= 0) {
+      fflush(stdout);
+      continue;
+    }
+
+    /* serve existing clients first, the array is compacted when they disconnect */
+    for(i = nr_clients; i >= 1; i--) {
+      if (!fds[i].revents)
+	continue;
+      if (hwlocd_handle_client(clients[i-1], &topo) < 0) {
+	close(clients[i-1]->fd);
+	free(clients[i-1]);
+	clients[i-1] = clients[--nr_clients];
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(listenfd, NULL, NULL);
+      if (fd >= 0) {
+	struct hwlocd_client_s *client = NULL;
+	if (nr_clients < HWLOCD_MAX_CLIENTS)
+	  client = malloc(sizeof(*client));
+	if (client) {
+	  /* don't let a client that doesn't read its replies block the daemon forever */
+	  struct timeval tv = { 1, 0 };
+	  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	  client->fd = fd;
+	  client->len = 0;
+	  clients[nr_clients++] = client;
+	} else {
+	  hwlocd_error(fd, "too many clients");
+	  close(fd);
+	}
+      }
+    }
+    fflush(stdout);
+  }
+
+  for(i = 0; i < nr_clients; i++) {
+    close(clients[i]->fd);
+    free(clients[i]);
+  }
+  close(listenfd);
+  unlink(path);
+  hwloc_free_xmlbuffer(topo.topology, topo.xmlbuffer);
+  hwloc_topology_destroy(topo.topology);
+  return EXIT_SUCCESS;
+}
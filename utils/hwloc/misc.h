@@ -175,6 +175,18 @@ hwloc_utils_autodetect_input_format(const char *input, int verbose)
     return HWLOC_UTILS_INPUT_SYNTHETIC;
   }
   if (S_ISREG(inputst.st_mode)) {
+    /* single-file cpuid dumps start like the hwloc-cpuid-info summary of directories */
+    FILE *file = fopen(input, "r");
+    if (file) {
+      char line[32];
+      int cpuid = fgets(line, sizeof(line), file) && !strcmp(line, "Architecture: x86\n");
+      fclose(file);
+      if (cpuid) {
+	if (verbose > 0)
+	  printf("assuming `%s' is a cpuid dump\n", input);
+	return HWLOC_UTILS_INPUT_CPUID;
+      }
+    }
     if (verbose > 0)
       printf("assuming `%s' is a XML file\n", input);
     return HWLOC_UTILS_INPUT_XML;
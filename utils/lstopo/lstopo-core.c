@@ -29,6 +29,7 @@ lstopo_init(struct lstopo_output *loutput)
   loutput->legend_append_nr = 0;
 
   loutput->show_distances_only = 0;
+  loutput->show_stats_only = 0;
   loutput->show_only = HWLOC_OBJ_TYPE_NONE;
   loutput->show_cpuset = 0;
   loutput->show_taskset = 0;
@@ -218,6 +218,33 @@ static void output_distances(struct lstopo_output *loutput)
   free(dist);
 }
 
+static void output_stats(struct lstopo_output *loutput)
+{
+  hwloc_topology_t topology = loutput->topology;
+  FILE *output = loutput->file;
+  struct hwloc_topology_discovery_stats_s *stats;
+  unsigned long total_us = 0;
+  unsigned nr = 0, j;
+  int err = hwloc_topology_get_discovery_stats(topology, &nr, NULL);
+  if (err < 0 || !nr)
+    return;
+  stats = malloc(nr * sizeof(*stats));
+  if (!stats)
+    return;
+  err = hwloc_topology_get_discovery_stats(topology, &nr, stats);
+  if (!err) {
+    fprintf(output, "%-12s %12s %10s %10s %10s\n", "Backend", "Time (us)", "Inserted", "Merged", "Dropped");
+    for(j=0; j<nr; j++) {
+      fprintf(output, "%-12s %12lu %10lu %10lu %10lu\n",
+	      stats[j].name, stats[j].time_us,
+	      stats[j].nr_inserted, stats[j].nr_merged, stats[j].nr_dropped);
+      total_us += stats[j].time_us;
+    }
+    fprintf(output, "%-12s %12lu\n", "Total", total_us);
+  }
+  free(stats);
+}
+
 void output_console(struct lstopo_output *loutput, const char *filename)
 {
   hwloc_topology_t topology = loutput->topology;
@@ -236,6 +263,11 @@ void output_console(struct lstopo_output *loutput, const char *filename)
     return;
   }
 
+  if (loutput->show_stats_only) {
+    output_stats(loutput);
+    return;
+  }
+
   /*
    * if verbose_mode == 0, only print the summary.
    * if verbose_mode == 1, only print the topology tree.